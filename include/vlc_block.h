@@ -166,6 +166,24 @@ static inline void block_Release( block_t *p_block )
     p_block->pf_release( p_block );
 }
 
+/****************************************************************************
+ * Shared blocks:
+ ****************************************************************************
+ * - block_Shareable : turn a block into one whose payload is reference
+ *      counted. The block is consumed; the returned block (the same one if it
+ *      was already shareable) must not be written to in place anymore:
+ *      block_Realloc() and block_Unshare() copy the payload when needed.
+ * - block_Share : get a new block referencing the payload of a shareable
+ *      block, without copying it (falls back to block_Duplicate() for other
+ *      blocks). NULL on error.
+ * - block_Unshare : get a block whose payload can be written to, copying it
+ *      if it is still referenced elsewhere. The block is consumed. NULL on
+ *      error.
+ ****************************************************************************/
+VLC_API block_t *block_Shareable( block_t * ) VLC_USED;
+VLC_API block_t *block_Share( block_t * ) VLC_USED;
+VLC_API block_t *block_Unshare( block_t * ) VLC_USED;
+
 VLC_API block_t *block_heap_Alloc(void *, size_t) VLC_USED VLC_MALLOC;
 VLC_API block_t *block_mmap_Alloc(void *addr, size_t length) VLC_USED VLC_MALLOC;
 VLC_API block_t * block_shm_Alloc(void *addr, size_t length) VLC_USED VLC_MALLOC;
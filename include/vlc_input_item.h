@@ -330,6 +330,17 @@ VLC_API int libvlc_ArtRequest(libvlc_int_t *, input_item_t *,
 /******************
  * Input stats
  ******************/
+
+/* Latency histogram: pi_buckets[i] counts the samples of at most (1 << i)
+ * milliseconds, the last bucket counts all the larger ones */
+#define INPUT_STATS_LATENCY_BUCKETS 16
+
+typedef struct
+{
+    uint64_t pi_buckets[INPUT_STATS_LATENCY_BUCKETS];
+    uint64_t i_sum; /* in microseconds */
+} input_latency_stats_t;
+
 struct input_stats_t
 {
     vlc_mutex_t         lock;
@@ -360,10 +371,16 @@ struct input_stats_t
     int64_t i_sent_packets;
     int64_t i_sent_bytes;
     float f_send_bitrate;
+    int64_t i_late_packets; /**< sent later than their date by the access */
 
     /* Aout */
     int64_t i_played_abuffers;
     int64_t i_lost_abuffers;
+
+    /* Latencies */
+    input_latency_stats_t demux_decode;   /* demuxer output to decoding */
+    input_latency_stats_t decode_display; /* decoded picture to display date */
+    input_latency_stats_t aout_delay;     /* decoded audio to playback date */
 };
 
 #endif
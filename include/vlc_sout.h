@@ -101,6 +101,11 @@ VLC_API int sout_AccessOutSeek( sout_access_out_t *, off_t );
 VLC_API ssize_t sout_AccessOutRead( sout_access_out_t *, block_t * );
 VLC_API ssize_t sout_AccessOutWrite( sout_access_out_t *, block_t * );
 VLC_API int sout_AccessOutControl( sout_access_out_t *, int, ... );
+/**
+ * Accounts packets the access output sent too late in the statistics of
+ * the input feeding the stream output. Can be called from any thread.
+ */
+VLC_API void sout_AccessOutReportLate( sout_access_out_t *, unsigned );
 
 static inline bool sout_AccessOutCanControlPace( sout_access_out_t *p_ao )
 {
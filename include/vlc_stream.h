@@ -64,6 +64,8 @@ struct stream_t
     /* */
     int         (*pf_read)   ( stream_t *, void *p_read, unsigned int i_read );
     int         (*pf_peek)   ( stream_t *, const uint8_t **pp_peek, unsigned int i_peek );
+    /* Optional, stream_ReadBlock() copies through pf_read without it */
+    block_t    *(*pf_block)  ( stream_t *, unsigned int i_size );
     input_item_t *(*pf_readdir)( stream_t * );
     int         (*pf_control)( stream_t *, int i_query, va_list );
 
@@ -102,6 +104,8 @@ enum stream_query_e
      * FIXME find a way to avoid it */
     STREAM_UPDATE_SIZE,
 
+    STREAM_GET_BUFFERED,        /**< arg1= uint64_t *     res=can fail, data readable without waiting */
+
     /* */
     STREAM_GET_PTS_DELAY = 0x101,/**< arg1= int64_t* res=cannot fail */
     STREAM_GET_TITLE_INFO, /**< arg1=input_title_t*** arg2=int* res=can fail */
@@ -117,6 +121,8 @@ enum stream_query_e
 
     /* XXX only data read through stream_Read/Block will be recorded */
     STREAM_SET_RECORD_STATE,     /**< arg1=bool, arg2=const char *psz_ext (if arg1 is true)  res=can fail */
+    /* Records data read ahead before the recording was started */
+    STREAM_RECORD_DATA,          /**< arg1=const uint8_t *, arg2=size_t   res=can fail */
 
     STREAM_SET_PRIVATE_ID_STATE = 0x1000, /* arg1= int i_private_data, bool b_selected    res=can fail */
     STREAM_SET_PRIVATE_ID_CA,             /* arg1= int i_program_number, uint16_t i_vpid, uint16_t i_apid1, uint16_t i_apid2, uint16_t i_apid3, uint8_t i_length, uint8_t *p_data */
@@ -130,6 +136,7 @@ VLC_API void stream_Delete( stream_t *s );
 VLC_API int stream_Control( stream_t *s, int i_query, ... );
 VLC_API block_t * stream_Block( stream_t *s, int i_size );
 VLC_API block_t * stream_BlockRemaining( stream_t *s, int i_max_size );
+VLC_API block_t * stream_ReadBlock( stream_t *s, int i_size );
 VLC_API char * stream_ReadLine( stream_t * );
 VLC_API input_item_t *stream_ReadDir( stream_t * );
 
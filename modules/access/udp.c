@@ -37,6 +37,9 @@
 #endif
 
 #include <errno.h>
+#ifdef HAVE_RECVMMSG
+# include <sys/socket.h>
+#endif
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_access.h>
@@ -44,6 +47,8 @@
 #include <vlc_block.h>
 
 #define MTU 65535
+/* Maximum number of datagrams received at once */
+#define UDP_BATCH 16
 
 /*****************************************************************************
  * Module descriptor
@@ -76,6 +81,7 @@ struct access_sys_t
     size_t fifo_size;
     block_fifo_t *fifo;
     vlc_thread_t thread;
+    uint8_t *slab; /* UDP_BATCH receive buffers of MTU bytes */
 };
 
 /*****************************************************************************
@@ -160,9 +166,13 @@ static int Open( vlc_object_t *p_this )
         goto error;
     }
 
+    sys->slab = malloc( UDP_BATCH * MTU );
     sys->fifo = block_FifoNew();
-    if( unlikely( sys->fifo == NULL ) )
+    if( unlikely( sys->fifo == NULL || sys->slab == NULL ) )
     {
+        if( sys->fifo != NULL )
+            block_FifoRelease( sys->fifo );
+        free( sys->slab );
         net_Close( sys->fd );
         goto error;
     }
@@ -174,6 +184,7 @@ static int Open( vlc_object_t *p_this )
                    VLC_THREAD_PRIORITY_INPUT ) )
     {
         block_FifoRelease( sys->fifo );
+        free( sys->slab );
         net_Close( sys->fd );
 error:
         free( sys );
@@ -194,6 +205,7 @@ static void Close( vlc_object_t *p_this )
     vlc_cancel( sys->thread );
     vlc_join( sys->thread, NULL );
     block_FifoRelease( sys->fifo );
+    free( sys->slab );
     net_Close( sys->fd );
     free( sys );
 }
@@ -250,6 +262,103 @@ static block_t *BlockUDP( access_t *p_access )
     return block;
 }
 
+/*****************************************************************************
+ * ReceiveBatch: receive pending datagrams into the slab
+ *****************************************************************************
+ * Waits for at least one datagram. Returns the number of datagrams received,
+ * each in its own MTU-sized slot, or -1 on error. Errors reported on the
+ * socket, such as ICMP port unreachable on a connected socket, are waited
+ * through; only errors on the socket itself end the reception.
+ *****************************************************************************/
+#ifdef HAVE_RECVMMSG
+static bool IsSocketError( int errnum )
+{
+    switch( errnum )
+    {
+        case EBADF:
+        case ENOTSOCK:
+        case EFAULT:
+        case EINVAL:
+            return true;
+    }
+    return false;
+}
+#endif
+
+static int ReceiveBatch( access_t *access, size_t *lens )
+{
+    access_sys_t *sys = access->p_sys;
+#ifdef HAVE_RECVMMSG
+    struct mmsghdr msgs[UDP_BATCH];
+    struct iovec iov[UDP_BATCH];
+
+    for( unsigned i = 0; i < UDP_BATCH; i++ )
+    {
+        iov[i].iov_base = sys->slab + i * MTU;
+        iov[i].iov_len = MTU;
+        memset( &msgs[i].msg_hdr, 0, sizeof( msgs[i].msg_hdr ) );
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    for(;;)
+    {
+        int n = recvmmsg( sys->fd, msgs, UDP_BATCH, MSG_DONTWAIT, NULL );
+        if( n > 0 )
+        {
+            for( int i = 0; i < n; i++ )
+                lens[i] = msgs[i].msg_len;
+            return n;
+        }
+
+        if( n == -1 )
+        {
+            if( IsSocketError( errno ) )
+                return -1;
+            switch( errno )
+            {
+                case EAGAIN:
+#if (EAGAIN != EWOULDBLOCK)
+                case EWOULDBLOCK:
+#endif
+                case EINTR:
+                    break;
+                default:
+                    /* The pending error (if any) was returned and cleared */
+                    continue;
+            }
+        }
+
+        /* Wait for the first datagram with net_Read(), which gives up once
+         * the input is stopping, then take the ones queued behind it */
+        ssize_t len = net_Read( access, sys->fd, sys->slab, MTU, false );
+        if( len == -1 )
+        {
+            if( errno == EINTR )
+                return -1;
+            continue;
+        }
+        lens[0] = len;
+
+        n = recvmmsg( sys->fd, &msgs[1], UDP_BATCH - 1, MSG_DONTWAIT, NULL );
+        for( int i = 0; i < n; i++ )
+            lens[i + 1] = msgs[i + 1].msg_len;
+        return 1 + (n > 0 ? n : 0);
+    }
+#else
+    ssize_t len;
+
+    do
+        len = net_Read( access, sys->fd, sys->slab, MTU, false );
+    while( len == -1 && errno != EINTR );
+
+    if( len == -1 )
+        return -1;
+    lens[0] = len;
+    return 1;
+#endif
+}
+
 /*****************************************************************************
  * ThreadRead: Pull packets from socket as soon as possible.
  *****************************************************************************/
@@ -260,30 +369,27 @@ static void* ThreadRead( void *data )
 
     for(;;)
     {
-        block_t *pkt = block_Alloc(MTU);
-        if (unlikely(pkt == NULL))
-        {   /* OOM - dequeue and discard one packet */
-            char dummy;
-            net_Read(access, sys->fd, &dummy, 1, false);
-            continue;
-        }
+        size_t lens[UDP_BATCH], len = 0;
+        int n = ReceiveBatch(access, lens);
 
-        ssize_t len;
+        if (n == -1)
+            break;
+
+        /* Coalesce the datagrams into one right-sized block */
+        for (int i = 0; i < n; i++)
+            len += lens[i];
 
-        block_cleanup_push(pkt);
-        do
-            len = net_Read(access, sys->fd, pkt->p_buffer, MTU, false);
-        while (len == -1 && errno != EINTR);
-        vlc_cleanup_pop();
+        block_t *pkt = block_Alloc(len);
+        if (unlikely(pkt == NULL))
+            continue; /* OOM - discard the datagrams */
 
-        if (len == -1)
+        uint8_t *p = pkt->p_buffer;
+        for (int i = 0; i < n; i++)
         {
-            block_Release(pkt);
-            break;
+            memcpy(p, sys->slab + i * MTU, lens[i]);
+            p += lens[i];
         }
 
-        pkt->i_buffer = len;
-
         vlc_fifo_Lock(sys->fifo);
         /* Discard old buffers on overflow */
         while (vlc_fifo_GetBytes(sys->fifo) + len > sys->fifo_size)
@@ -965,6 +965,10 @@ static ssize_t writeSegment( sout_access_out_t *p_access )
                 memcpy( output->p_buffer, p_sys->stuffing_bytes, p_sys->stuffing_size );
                 p_sys->stuffing_size = 0;
             }
+            /* A single block is not gathered and is encrypted in place */
+            output = block_Unshare( output );
+            if( unlikely(!output ) )
+                return VLC_ENOMEM;
             size_t original = output->i_buffer;
             size_t padded = (output->i_buffer + 15 ) & ~15;
             size_t pad = padded - original;
@@ -50,6 +50,8 @@
 #include <vlc_network.h>
 
 #define MAX_EMPTY_BLOCKS 200
+/* Maximum number of packets sent at once */
+#define UDP_BATCH 32
 
 /*****************************************************************************
  * Module descriptor
@@ -71,6 +73,11 @@ static void Close( vlc_object_t * );
                           "helps reducing the scheduling load on " \
                           "heavily-loaded systems." )
 
+#define WINDOW_TEXT N_("Pacing window (ms)")
+#define WINDOW_LONGTEXT N_("Packets due within this delay after the one " \
+                           "being waited for are sent along with it, " \
+                           "in a single system call." )
+
 vlc_module_begin ()
     set_description( N_("UDP stream output") )
     set_shortname( "UDP" )
@@ -79,6 +86,8 @@ vlc_module_begin ()
     add_integer( SOUT_CFG_PREFIX "caching", DEFAULT_PTS_DELAY / 1000, CACHING_TEXT, CACHING_LONGTEXT, true )
     add_integer( SOUT_CFG_PREFIX "group", 1, GROUP_TEXT, GROUP_LONGTEXT,
                                  true )
+    add_integer( SOUT_CFG_PREFIX "window", 1, WINDOW_TEXT, WINDOW_LONGTEXT,
+                                 true )
 
     set_capability( "sout access", 0 )
     add_shortcut( "udp" )
@@ -92,6 +101,7 @@ vlc_module_end ()
 static const char *const ppsz_sout_options[] = {
     "caching",
     "group",
+    "window",
     NULL
 };
 
@@ -122,6 +132,7 @@ struct sout_access_out_sys_t
     block_t      *p_buffer;
 
     vlc_thread_t  thread;
+    mtime_t       i_window;
 };
 
 #define DEFAULT_PORT 1234
@@ -213,6 +224,8 @@ static int Open( vlc_object_t *p_this )
     p_sys->p_fifo = block_FifoNew();
     p_sys->p_empty_blocks = block_FifoNew();
     p_sys->p_buffer = NULL;
+    p_sys->i_window = UINT64_C(1000)
+                    * var_GetInteger( p_access, SOUT_CFG_PREFIX "window" );
 
     if( vlc_clone( &p_sys->thread, ThreadWrite, p_access,
                            VLC_THREAD_PRIORITY_HIGHEST ) )
@@ -392,6 +405,65 @@ static block_t *NewUDPPacket( sout_access_out_t *p_access, mtime_t i_dts)
     return p_buffer;
 }
 
+/*****************************************************************************
+ * SendBatch: send packets with as few system calls as possible
+ *****************************************************************************/
+static void SendBatch( sout_access_out_t *p_access, block_t **pp_pk,
+                       unsigned i_count )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr msgs[UDP_BATCH];
+    struct iovec iov[UDP_BATCH];
+
+    for( unsigned i = 0; i < i_count; i++ )
+    {
+        iov[i].iov_base = pp_pk[i]->p_buffer;
+        iov[i].iov_len = pp_pk[i]->i_buffer;
+        memset( &msgs[i].msg_hdr, 0, sizeof( msgs[i].msg_hdr ) );
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    for( unsigned i = 0; i < i_count; )
+    {
+        int n = sendmmsg( p_sys->i_handle, msgs + i, i_count - i, 0 );
+        if( n == -1 )
+        {
+            if( errno == EINTR )
+                continue;
+            /* skip the packet that failed */
+            msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
+            n = 1;
+        }
+        i += n;
+    }
+#else
+    for( unsigned i = 0; i < i_count; i++ )
+        if( send( p_sys->i_handle, pp_pk[i]->p_buffer,
+                  pp_pk[i]->i_buffer, 0 ) == -1 )
+            msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
+#endif
+}
+
+typedef struct
+{
+    block_t  *pp_pk[UDP_BATCH];
+    unsigned  i_count;
+    block_t  *p_pending; /* dequeued for the next batch */
+    mtime_t   i_date_last; /* of the last packet dequeued */
+} udp_batch_t;
+
+static void BatchCleanup( void *data )
+{
+    udp_batch_t *p_batch = data;
+
+    for( unsigned i = 0; i < p_batch->i_count; i++ )
+        block_Release( p_batch->pp_pk[i] );
+    if( p_batch->p_pending )
+        block_Release( p_batch->p_pending );
+}
+
 /*****************************************************************************
  * ThreadWrite: Write a packet on the network at the good time.
  *****************************************************************************/
@@ -399,50 +471,82 @@ static void* ThreadWrite( void *data )
 {
     sout_access_out_t *p_access = data;
     sout_access_out_sys_t *p_sys = p_access->p_sys;
-    mtime_t i_date_last = -1;
     const unsigned i_group = var_GetInteger( p_access,
                                              SOUT_CFG_PREFIX "group" );
     mtime_t i_to_send = i_group;
     unsigned i_dropped_packets = 0;
+    udp_batch_t batch = { .i_count = 0, .p_pending = NULL, .i_date_last = -1 };
 
+    vlc_cleanup_push( BatchCleanup, &batch );
     for (;;)
     {
-        block_t *p_pk = block_FifoGet( p_sys->p_fifo );
-        mtime_t       i_date, i_sent;
+        mtime_t i_wait = VLC_TS_INVALID, i_sent;
 
-        i_date = p_sys->i_caching + p_pk->i_dts;
-        if( i_date_last > 0 )
+        /* Gather the packets due along with the one to wait for */
+        do
         {
-            if( i_date - i_date_last > 2000000 )
+            block_t *p_pk = batch.p_pending;
+            mtime_t i_date;
+
+            if( p_pk != NULL )
+                batch.p_pending = NULL;
+            else if( batch.i_count == 0 )
+                p_pk = block_FifoGet( p_sys->p_fifo );
+            else
+            {
+                vlc_fifo_Lock( p_sys->p_fifo );
+                if( !vlc_fifo_IsEmpty( p_sys->p_fifo ) )
+                    p_pk = vlc_fifo_DequeueUnlocked( p_sys->p_fifo );
+                vlc_fifo_Unlock( p_sys->p_fifo );
+                if( p_pk == NULL )
+                    break;
+            }
+
+            i_date = p_sys->i_caching + p_pk->i_dts;
+            if( batch.i_date_last > 0 )
             {
-                if( !i_dropped_packets )
-                    msg_Dbg( p_access, "mmh, hole (%"PRId64" > 2s) -> drop",
-                             i_date - i_date_last );
+                if( i_date - batch.i_date_last > 2000000 )
+                {
+                    if( !i_dropped_packets )
+                        msg_Dbg( p_access, "mmh, hole (%"PRId64" > 2s) -> drop",
+                                 i_date - batch.i_date_last );
 
-                block_FifoPut( p_sys->p_empty_blocks, p_pk );
+                    block_FifoPut( p_sys->p_empty_blocks, p_pk );
 
-                i_date_last = i_date;
-                i_dropped_packets++;
-                continue;
+                    batch.i_date_last = i_date;
+                    i_dropped_packets++;
+                    continue;
+                }
+                else if( i_date - batch.i_date_last < -1000 )
+                {
+                    if( !i_dropped_packets )
+                        msg_Dbg( p_access, "mmh, packets in the past (%"PRId64")",
+                                 batch.i_date_last - i_date );
+                }
             }
-            else if( i_date - i_date_last < -1000 )
+
+            if( i_wait != VLC_TS_INVALID && i_date > i_wait + p_sys->i_window )
             {
-                if( !i_dropped_packets )
-                    msg_Dbg( p_access, "mmh, packets in the past (%"PRId64")",
-                             i_date_last - i_date );
+                batch.p_pending = p_pk;
+                break;
             }
-        }
 
-        block_cleanup_push( p_pk );
-        i_to_send--;
-        if( !i_to_send || (p_pk->i_flags & BLOCK_FLAG_CLOCK) )
-        {
-            mwait( i_date );
-            i_to_send = i_group;
+            batch.pp_pk[batch.i_count++] = p_pk;
+            batch.i_date_last = i_date;
+
+            i_to_send--;
+            if( !i_to_send || (p_pk->i_flags & BLOCK_FLAG_CLOCK) )
+            {
+                if( i_wait == VLC_TS_INVALID )
+                    i_wait = i_date;
+                i_to_send = i_group;
+            }
         }
-        if ( send( p_sys->i_handle, p_pk->p_buffer, p_pk->i_buffer, 0 ) == -1 )
-            msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
-        vlc_cleanup_pop();
+        while( batch.i_count < UDP_BATCH );
+
+        if( i_wait != VLC_TS_INVALID )
+            mwait( i_wait );
+        SendBatch( p_access, batch.pp_pk, batch.i_count );
 
         if( i_dropped_packets )
         {
@@ -450,18 +554,26 @@ static void* ThreadWrite( void *data )
             i_dropped_packets = 0;
         }
 
-#if 1
         i_sent = mdate();
-        if ( i_sent > i_date + 20000 )
+        if ( i_sent > p_sys->i_caching + batch.pp_pk[0]->i_dts + 20000 )
         {
             msg_Dbg( p_access, "packet has been sent too late (%"PRId64 ")",
-                     i_sent - i_date );
+                     i_sent - p_sys->i_caching - batch.pp_pk[0]->i_dts );
         }
-#endif
 
-        block_FifoPut( p_sys->p_empty_blocks, p_pk );
+        unsigned i_late = 0;
+        for( unsigned i = 0; i < batch.i_count; i++ )
+        {
+            block_t *p_pk = batch.pp_pk[i];
 
-        i_date_last = i_date;
+            if( i_sent > p_sys->i_caching + p_pk->i_dts + 20000 )
+                i_late++;
+            block_FifoPut( p_sys->p_empty_blocks, p_pk );
+        }
+        if( i_late )
+            sout_AccessOutReportLate( p_access, i_late );
+        batch.i_count = 0;
     }
+    vlc_cleanup_pop();
     return NULL;
 }
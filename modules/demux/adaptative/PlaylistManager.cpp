@@ -29,9 +29,11 @@
 #include "playlist/BasePeriod.h"
 #include "playlist/BaseAdaptationSet.h"
 #include "http/HTTPConnectionManager.h"
+#include "http/Downloader.hpp"
 #include "logic/AlwaysBestAdaptationLogic.h"
 #include "logic/RateBasedAdaptationLogic.h"
 #include "logic/AlwaysLowestAdaptationLogic.hpp"
+#include "logic/HybridAdaptationLogic.hpp"
 #include <vlc_stream.h>
 
 #include <ctime>
@@ -44,6 +46,9 @@ PlaylistManager::PlaylistManager( AbstractPlaylist *pl,
                                   AbstractAdaptationLogic::LogicType type,
                                   stream_t *stream) :
              conManager     ( NULL ),
+             downloader     ( NULL ),
+             prefetchSegments( 0 ),
+             prefetchBudget ( 0 ),
              logicType      ( type ),
              playlist       ( pl ),
              streamOutputFactory( NULL ),
@@ -56,9 +61,11 @@ PlaylistManager::PlaylistManager( AbstractPlaylist *pl,
 
 PlaylistManager::~PlaylistManager   ()
 {
-    delete conManager;
+    /* streams cancel their downloads */
     for(int i=0; i<StreamTypeCount; i++)
         delete streams[i];
+    delete downloader;
+    delete conManager;
 }
 
 bool PlaylistManager::start(demux_t *demux)
@@ -67,6 +74,11 @@ bool PlaylistManager::start(demux_t *demux)
     if(!period)
         return false;
 
+    conManager = new (std::nothrow) HTTPConnectionManager(VLC_OBJECT(stream));
+    if(!conManager)
+        return false;
+
+    unsigned streamCount = 0;
     for(int i=0; i<StreamTypeCount; i++)
     {
         StreamType type = static_cast<StreamType>(i);
@@ -91,7 +103,9 @@ bool PlaylistManager::start(demux_t *demux)
                 if(!tracker)
                     throw VLC_ENOMEM;
                 streams[type]->create(demux, logic, tracker,
-                                      (streamOutputFactory) ? *streamOutputFactory : defaultfactory );
+                                      (streamOutputFactory) ? *streamOutputFactory : defaultfactory,
+                                      conManager );
+                streamCount++;
             } catch (int) {
                 delete streams[type];
                 delete logic;
@@ -101,9 +115,37 @@ bool PlaylistManager::start(demux_t *demux)
         }
     }
 
-    conManager = new (std::nothrow) HTTPConnectionManager(VLC_OBJECT(stream));
-    if(!conManager)
-        return false;
+    /* Live playlists are only fetched ahead by a segment duration, so that
+     * downloads stay close to the live edge. The prefetched chunks keep
+     * their segments from being pruned by the playlist updates. */
+    if(prefetchSegments && streamCount)
+    {
+        mtime_t prefetchTime = 0;
+        if(playlist->isLive())
+        {
+            prefetchTime = playlist->maxSegmentDuration.Get();
+            if(!prefetchTime) /* unknown, a single segment */
+                prefetchTime = 1;
+        }
+
+        /* One download for each stream, plus one fetching ahead */
+        downloader = new (std::nothrow) Downloader(conManager, streamCount + 1,
+                                                   prefetchBudget);
+        if(downloader && downloader->start())
+        {
+            for(int type=0; type<StreamTypeCount; type++)
+            {
+                if(streams[type])
+                    streams[type]->setDownloader(downloader, prefetchSegments,
+                                                 prefetchTime);
+            }
+        }
+        else
+        {
+            delete downloader;
+            downloader = NULL;
+        }
+    }
 
     playlist->playbackStart.Set(time(NULL));
     nextPlaylistupdate = playlist->playbackStart.Get();
@@ -121,7 +163,7 @@ Stream::status PlaylistManager::demux(mtime_t nzdeadline, bool send)
             continue;
 
         Stream::status i_ret =
-                streams[type]->demux(conManager, nzdeadline, send);
+                streams[type]->demux(nzdeadline, send);
 
         if(i_ret == Stream::status_buffering)
         {
@@ -244,6 +286,8 @@ AbstractAdaptationLogic *PlaylistManager::createLogic(AbstractAdaptationLogic::L
         case AbstractAdaptationLogic::Default:
         case AbstractAdaptationLogic::RateBased:
             return new (std::nothrow) RateBasedAdaptationLogic(0, 0);
+        case AbstractAdaptationLogic::Hybrid:
+            return new (std::nothrow) HybridAdaptationLogic(0, 0);
         default:
             return NULL;
     }
@@ -35,6 +35,7 @@ namespace adaptative
     namespace http
     {
         class HTTPConnectionManager;
+        class Downloader;
     }
 
     using namespace playlist;
@@ -67,6 +68,9 @@ namespace adaptative
             virtual AbstractAdaptationLogic *createLogic(AbstractAdaptationLogic::LogicType);
 
             HTTPConnectionManager              *conManager;
+            Downloader                         *downloader;
+            unsigned                            prefetchSegments;
+            size_t                              prefetchBudget;
             AbstractAdaptationLogic::LogicType  logicType;
             AbstractPlaylist                    *playlist;
             AbstractStreamOutputFactory         *streamOutputFactory;
@@ -108,6 +108,16 @@ Chunk * SegmentTracker::getNextChunk(StreamType type, bool switch_allowed)
     return chunk;
 }
 
+/* Whether the next chunk is listed in the current period */
+bool SegmentTracker::hasNextChunk() const
+{
+    if(!currentPeriod)
+        return false;
+    if(!prevRepresentation || initializing || !indexed)
+        return true;
+    return prevRepresentation->getSegment(BaseRepresentation::INFOTYPE_MEDIA, count) != NULL;
+}
+
 bool SegmentTracker::setPosition(mtime_t time, bool restarted, bool tryonly)
 {
     uint64_t segcount;
@@ -59,6 +59,7 @@ namespace adaptative
             void setAdaptationLogic(AbstractAdaptationLogic *);
             void resetCounter();
             Chunk* getNextChunk(StreamType, bool);
+            bool hasNextChunk() const;
             bool setPosition(mtime_t, bool, bool);
             mtime_t getSegmentStart() const;
             void pruneFromCurrent();
@@ -21,6 +21,7 @@
 #include "StreamsType.hpp"
 #include "http/HTTPConnection.hpp"
 #include "http/HTTPConnectionManager.h"
+#include "http/Downloader.hpp"
 #include "http/Chunk.h"
 #include "logic/AbstractAdaptationLogic.h"
 #include "SegmentTracker.hpp"
@@ -47,14 +48,20 @@ void Stream::init(const StreamType type_, const StreamFormat format_)
     format = format_;
     output = NULL;
     adaptationLogic = NULL;
+    connManager = NULL;
     currentChunk = NULL;
+    downloader = NULL;
+    currentDownload = NULL;
+    prefetch = 0;
+    prefetchTime = 0;
     eof = false;
     segmentTracker = NULL;
 }
 
 Stream::~Stream()
 {
-    delete currentChunk;
+    dropPrefetched();
+    releaseChunk();
     delete adaptationLogic;
     delete output;
     delete segmentTracker;
@@ -90,11 +97,21 @@ StreamFormat Stream::mimeToFormat(const std::string &mime)
 }
 
 void Stream::create(demux_t *demux, AbstractAdaptationLogic *logic,
-                    SegmentTracker *tracker, AbstractStreamOutputFactory &factory)
+                    SegmentTracker *tracker, AbstractStreamOutputFactory &factory,
+                    HTTPConnectionManager *conn)
 {
     output = factory.create(demux, format);
     adaptationLogic = logic;
     segmentTracker = tracker;
+    connManager = conn;
+}
+
+void Stream::setDownloader(Downloader *downloader_, unsigned prefetch_,
+                           mtime_t prefetchTime_)
+{
+    downloader = downloader_;
+    prefetch = prefetch_;
+    prefetchTime = prefetchTime_;
 }
 
 bool Stream::isEOF() const
@@ -131,24 +148,123 @@ Chunk * Stream::getChunk()
 {
     if (currentChunk == NULL)
     {
-        currentChunk = segmentTracker->getNextChunk(type, output->switchAllowed());
-        if (currentChunk == NULL)
-            eof = true;
+        if(!prefetched.empty())
+        {
+            currentChunk = prefetched.front().chunk;
+            currentDownload = prefetched.front().download;
+            prefetched.pop_front();
+        }
+        else
+        {
+            currentChunk = getNextChunk(NULL);
+            if (currentChunk == NULL)
+                eof = true;
+            else if(downloader)
+                currentDownload = downloader->schedule(currentChunk);
+        }
+
+        if(currentChunk)
+            prefetchChunks();
     }
     return currentChunk;
 }
 
+/* The representation is chosen by the logic when a chunk is scheduled,
+ * so the lookahead is also the latency for switching. */
+void Stream::prefetchChunks()
+{
+    if(!downloader)
+        return;
+
+    mtime_t ahead = 0;
+    std::list<Prefetched>::const_iterator it;
+    for(it = prefetched.begin(); it != prefetched.end(); ++it)
+        ahead += (*it).duration;
+
+    while(prefetched.size() < prefetch && (!prefetchTime || ahead < prefetchTime))
+    {
+        /* does not move on to the next period ahead of playback, nor past
+         * the last segment of a live playlist before it is updated */
+        if(!segmentTracker->hasNextChunk())
+            break;
+
+        Prefetched next;
+        next.chunk = getNextChunk(&next.duration);
+        if(!next.chunk)
+            break;
+        /* falls back to synchronous reading if it can't be scheduled */
+        next.download = downloader->schedule(next.chunk);
+        prefetched.push_back(next);
+        ahead += next.duration;
+    }
+}
+
+Chunk * Stream::getNextChunk(mtime_t *pi_duration)
+{
+    mtime_t start = segmentTracker->getSegmentStart();
+    Chunk *chunk = segmentTracker->getNextChunk(type, output->switchAllowed());
+    if(pi_duration)
+    {
+        /* none for init and index chunks, or unknown timings */
+        *pi_duration = segmentTracker->getSegmentStart() - start;
+        if(*pi_duration < 0)
+            *pi_duration = 0;
+    }
+    return chunk;
+}
+
+/* Media time of the chunks entirely downloaded after the current one */
+mtime_t Stream::getBufferLevel() const
+{
+    mtime_t level = 0;
+    bool b_known = false;
+    bool b_contiguous = true;
+    std::list<Prefetched>::const_iterator it;
+    for(it = prefetched.begin(); it != prefetched.end(); ++it)
+    {
+        b_known |= ((*it).duration > 0);
+        if(b_contiguous && (*it).download && downloader->isDone((*it).download))
+            level += (*it).duration;
+        else
+            b_contiguous = false;
+    }
+    return b_known ? level : -1;
+}
+
+void Stream::releaseChunk()
+{
+    if(currentDownload)
+        downloader->cancel(currentDownload);
+    else if(currentChunk)
+        connManager->releaseChunk(currentChunk);
+    delete currentChunk;
+    currentChunk = NULL;
+    currentDownload = NULL;
+}
+
+void Stream::dropPrefetched()
+{
+    std::list<Prefetched>::const_iterator it;
+    for(it = prefetched.begin(); it != prefetched.end(); ++it)
+    {
+        if((*it).download)
+            downloader->cancel((*it).download);
+        delete (*it).chunk;
+    }
+    prefetched.clear();
+}
+
 bool Stream::seekAble() const
 {
     return (output && output->seekAble());
 }
 
-Stream::status Stream::demux(HTTPConnectionManager *connManager, mtime_t nz_deadline, bool send)
+Stream::status Stream::demux(mtime_t nz_deadline, bool send)
 {
     if(nz_deadline + VLC_TS_0 > output->getPCR()) /* not already demuxed */
     {
         /* need to read, demuxer still buffering, ... */
-        if(read(connManager) <= 0)
+        if(read() <= 0)
             return Stream::status_eof;
 
         if(nz_deadline + VLC_TS_0 > output->getPCR()) /* need to read more */
@@ -160,12 +276,18 @@ Stream::status Stream::demux(HTTPConnectionManager *connManager, mtime_t nz_dead
     return Stream::status_demuxed;
 }
 
-size_t Stream::read(HTTPConnectionManager *connManager)
+size_t Stream::read()
 {
     Chunk *chunk = getChunk();
     if(!chunk)
         return 0;
 
+    if(currentDownload)
+    {
+        adaptationLogic->updateBufferLevel(getBufferLevel());
+        return readDownload(chunk);
+    }
+
     if(!chunk->getConnection())
     {
        if(!connManager->connectChunk(chunk))
@@ -179,9 +301,7 @@ size_t Stream::read(HTTPConnectionManager *connManager)
     {
         if(chunk->getConnection()->query(chunk->getPath()) != VLC_SUCCESS)
         {
-            chunk->getConnection()->releaseChunk();
-            currentChunk = NULL;
-            delete chunk;
+            releaseChunk();
             return 0;
         }
     }
@@ -203,9 +323,7 @@ size_t Stream::read(HTTPConnectionManager *connManager)
     if(ret < 0)
     {
         block_Release(block);
-        chunk->getConnection()->releaseChunk();
-        currentChunk = NULL;
-        delete chunk;
+        releaseChunk();
         return 0;
     }
     else
@@ -216,11 +334,7 @@ size_t Stream::read(HTTPConnectionManager *connManager)
         chunk->onDownload(&block);
 
         if (chunk->getBytesToRead() == 0)
-        {
-            chunk->getConnection()->releaseChunk();
-            currentChunk = NULL;
-            delete chunk;
-        }
+            releaseChunk();
     }
 
     readsize = block->i_buffer;
@@ -230,21 +344,45 @@ size_t Stream::read(HTTPConnectionManager *connManager)
     return readsize;
 }
 
+/* Data was received by the downloader on a copy of the chunk. Account
+ * it here, as the segment handlers rely on the chunk counters. */
+size_t Stream::readDownload(Chunk *chunk)
+{
+    block_t *block = downloader->read(currentDownload);
+    if(!block) /* over or failed */
+    {
+        releaseChunk();
+        return 0;
+    }
+
+    if(chunk->getBytesRead() == 0)
+        chunk->setLength(downloader->getLength(currentDownload));
+    chunk->setBytesRead(chunk->getBytesRead() + block->i_buffer);
+
+    adaptationLogic->updateDownloadRate(block->i_buffer, block->i_length);
+    block->i_length = 0;
+    chunk->onDownload(&block);
+
+    if (chunk->getBytesToRead() == 0)
+        releaseChunk();
+
+    size_t readsize = block->i_buffer;
+
+    output->pushBlock(block);
+
+    return readsize;
+}
+
 bool Stream::setPosition(mtime_t time, bool tryonly)
 {
     bool ret = segmentTracker->setPosition(time, output->reinitsOnSeek(), tryonly);
     if(!tryonly && ret)
     {
         output->setPosition(time);
+        /* were taken from the previous position */
+        dropPrefetched();
         if(output->reinitsOnSeek())
-        {
-            if(currentChunk)
-            {
-                currentChunk->getConnection()->releaseChunk();
-                delete currentChunk;
-            }
-            currentChunk = NULL;
-        }
+            releaseChunk();
     }
     return ret;
 }
@@ -38,6 +38,8 @@ namespace adaptative
     {
         class HTTPConnectionManager;
         class Chunk;
+        class Downloader;
+        class Download;
     }
 
     namespace logic
@@ -62,7 +64,9 @@ namespace adaptative
         static StreamType mimeToType(const std::string &mime);
         static StreamFormat mimeToFormat(const std::string &mime);
         void create(demux_t *, AbstractAdaptationLogic *,
-                    SegmentTracker *, AbstractStreamOutputFactory &);
+                    SegmentTracker *, AbstractStreamOutputFactory &,
+                    HTTPConnectionManager *);
+        void setDownloader(Downloader *, unsigned, mtime_t);
         bool isEOF() const;
         mtime_t getPCR() const;
         mtime_t getFirstDTS() const;
@@ -70,21 +74,40 @@ namespace adaptative
         int esCount() const;
         bool seekAble() const;
         typedef enum {status_eof, status_buffering, status_demuxed} status;
-        status demux(HTTPConnectionManager *, mtime_t, bool);
+        status demux(mtime_t, bool);
         bool setPosition(mtime_t, bool);
         mtime_t getPosition() const;
         void prune();
 
     private:
         Chunk *getChunk();
+        Chunk *getNextChunk(mtime_t *);
+        void prefetchChunks();
+        mtime_t getBufferLevel() const;
+        void releaseChunk();
+        void dropPrefetched();
         void init(const StreamType, const StreamFormat);
-        size_t read(HTTPConnectionManager *);
+        size_t read();
+        size_t readDownload(Chunk *);
         StreamType type;
         StreamFormat format;
         AbstractStreamOutput *output;
         AbstractAdaptationLogic *adaptationLogic;
         SegmentTracker *segmentTracker;
+        HTTPConnectionManager *connManager;
         http::Chunk *currentChunk;
+        http::Downloader *downloader;
+        http::Download *currentDownload;
+        /* next chunks, already scheduled for download */
+        struct Prefetched
+        {
+            Chunk *chunk;
+            Download *download;
+            mtime_t duration;
+        };
+        std::list<Prefetched> prefetched;
+        unsigned prefetch;
+        mtime_t prefetchTime; /* media time ahead, 0 if unbounded */
         bool eof;
     };
 
@@ -0,0 +1,333 @@
+/*
+ * Downloader.cpp
+ *****************************************************************************
+ * Copyright (C) 2015 - VideoLAN authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "Downloader.hpp"
+#include "HTTPConnection.hpp"
+#include "HTTPConnectionManager.h"
+#include "Chunk.h"
+
+#include <vlc_block.h>
+
+using namespace adaptative::http;
+
+Download::Download(Chunk *chunk)
+{
+    transport = chunk;
+    length = 0;
+    p_head = NULL;
+    pp_tail = &p_head;
+    buffered = 0;
+    running = false;
+    finished = false;
+    needed = false;
+    cancelled = false;
+}
+
+Download::~Download()
+{
+    block_ChainRelease(p_head);
+    delete transport;
+}
+
+Downloader::Downloader(HTTPConnectionManager *connManager_,
+                       unsigned threads_, size_t budget_)
+{
+    connManager = connManager_;
+    threadCount = threads_;
+    buffered = 0;
+    budget = budget_;
+    killed = false;
+    vlc_mutex_init(&lock);
+    vlc_cond_init(&waitcond);
+    vlc_cond_init(&datacond);
+}
+
+Downloader::~Downloader()
+{
+    /* The threads stop between two reads. A read blocking on the network
+     * returns once the input is killed. */
+    vlc_mutex_lock(&lock);
+    killed = true;
+    vlc_cond_broadcast(&waitcond);
+    vlc_mutex_unlock(&lock);
+
+    std::vector<vlc_thread_t>::const_iterator it;
+    for(it = threads.begin(); it != threads.end(); ++it)
+        vlc_join(*it, NULL);
+
+    std::list<Download *>::const_iterator dl;
+    for(dl = queue.begin(); dl != queue.end(); ++dl)
+    {
+        if((*dl)->transport->getConnection())
+            connManager->releaseChunk((*dl)->transport);
+        delete *dl;
+    }
+
+    vlc_cond_destroy(&datacond);
+    vlc_cond_destroy(&waitcond);
+    vlc_mutex_destroy(&lock);
+}
+
+bool Downloader::start()
+{
+    for(unsigned i = 0; i < threadCount; i++)
+    {
+        vlc_thread_t thread;
+        if(vlc_clone(&thread, downloaderThread, this, VLC_THREAD_PRIORITY_INPUT))
+            break;
+        threads.push_back(thread);
+    }
+    return !threads.empty();
+}
+
+Download * Downloader::schedule(const Chunk *chunk)
+{
+    Chunk *transport;
+    try
+    {
+        transport = new (std::nothrow) Chunk(chunk->getUrl());
+        if(!transport)
+            return NULL;
+    }
+    catch (int)
+    {
+        return NULL;
+    }
+
+    if(chunk->usesByteRange())
+    {
+        transport->setStartByte(chunk->getStartByte());
+        transport->setEndByte(chunk->getEndByte());
+    }
+
+    Download *dl = new (std::nothrow) Download(transport);
+    if(!dl)
+    {
+        delete transport;
+        return NULL;
+    }
+
+    vlc_mutex_lock(&lock);
+    queue.push_back(dl);
+    vlc_cond_signal(&waitcond);
+    vlc_mutex_unlock(&lock);
+    return dl;
+}
+
+block_t * Downloader::read(Download *dl)
+{
+    block_t *p_block = NULL;
+
+    vlc_mutex_lock(&lock);
+    if(!dl->needed)
+    {
+        /* Lift the budget for the download being played */
+        dl->needed = true;
+        vlc_cond_broadcast(&waitcond);
+    }
+
+    /* Transfers are interrupted when the input is killed */
+    while(!dl->p_head && !dl->finished)
+        vlc_cond_wait(&datacond, &lock);
+
+    if(dl->p_head)
+    {
+        p_block = dl->p_head;
+        dl->p_head = p_block->p_next;
+        if(!dl->p_head)
+            dl->pp_tail = &dl->p_head;
+        p_block->p_next = NULL;
+        dl->buffered -= p_block->i_buffer;
+        buffered -= p_block->i_buffer;
+        vlc_cond_broadcast(&waitcond);
+    }
+    vlc_mutex_unlock(&lock);
+
+    return p_block;
+}
+
+void Downloader::cancel(Download *dl)
+{
+    vlc_mutex_lock(&lock);
+    buffered -= dl->buffered;
+    dl->buffered = 0;
+    if(dl->running)
+    {
+        /* The download thread will delete it */
+        dl->cancelled = true;
+        vlc_cond_broadcast(&waitcond);
+    }
+    else
+    {
+        queue.remove(dl);
+        delete dl;
+    }
+    vlc_mutex_unlock(&lock);
+}
+
+bool Downloader::isDone(Download *dl)
+{
+    vlc_mutex_lock(&lock);
+    bool b_done = dl->finished;
+    vlc_mutex_unlock(&lock);
+    return b_done;
+}
+
+uint64_t Downloader::getLength(Download *dl)
+{
+    vlc_mutex_lock(&lock);
+    uint64_t length = dl->length;
+    vlc_mutex_unlock(&lock);
+    return length;
+}
+
+void * Downloader::downloaderThread(void *opaque)
+{
+    Downloader *instance = static_cast<Downloader *>(opaque);
+    instance->run();
+    return NULL;
+}
+
+/* Oldest pending download first. Only one download at a time fetches
+ * ahead, within budget, so that a thread is always left for each of the
+ * downloads being played. */
+Download * Downloader::next()
+{
+    bool b_prefetching = false;
+    std::list<Download *>::const_iterator it;
+    for(it = queue.begin(); it != queue.end(); ++it)
+    {
+        if((*it)->running && !(*it)->needed && !(*it)->cancelled)
+            b_prefetching = true;
+    }
+
+    for(it = queue.begin(); it != queue.end(); ++it)
+    {
+        Download *dl = *it;
+        if(dl->running || dl->finished || dl->cancelled)
+            continue;
+        if(dl->needed || (!b_prefetching && buffered < budget))
+            return dl;
+    }
+    return NULL;
+}
+
+void Downloader::run()
+{
+    vlc_mutex_lock(&lock);
+    for(;;)
+    {
+        Download *dl = NULL;
+        while(!killed && (dl = next()) == NULL)
+            vlc_cond_wait(&waitcond, &lock);
+        if(killed)
+            break;
+
+        dl->running = true;
+        vlc_mutex_unlock(&lock);
+
+        fetch(dl);
+
+        vlc_mutex_lock(&lock);
+        dl->running = false;
+        dl->finished = true;
+        vlc_cond_broadcast(&datacond);
+        if(dl->cancelled)
+        {
+            queue.remove(dl);
+            delete dl;
+        }
+    }
+    vlc_mutex_unlock(&lock);
+}
+
+/* A download fetching ahead is paused while over budget, until it is
+ * played. */
+void Downloader::fetch(Download *dl)
+{
+    Chunk *chunk = dl->transport;
+
+    bool b_connected = connManager->connectChunk(chunk) &&
+                       chunk->getConnection()->query(chunk->getPath()) == VLC_SUCCESS;
+    if(!b_connected)
+    {
+        if(chunk->getConnection())
+            connManager->releaseChunk(chunk);
+        return;
+    }
+
+    vlc_mutex_lock(&lock);
+    dl->length = chunk->getLength();
+    vlc_mutex_unlock(&lock);
+
+    for(;;)
+    {
+        vlc_mutex_lock(&lock);
+        while(!dl->needed && buffered >= budget && !dl->cancelled && !killed)
+            vlc_cond_wait(&waitcond, &lock);
+        const bool b_stop = dl->cancelled || killed;
+        vlc_mutex_unlock(&lock);
+        if(b_stop)
+            break;
+
+        size_t readsize = chunk->getBytesToRead();
+        if(readsize > READSIZE)
+            readsize = READSIZE;
+        if(readsize == 0)
+            break;
+
+        block_t *p_block = block_Alloc(readsize);
+        if(!p_block)
+            break;
+
+        mtime_t time = mdate();
+        ssize_t ret = chunk->getConnection()->read(p_block->p_buffer, readsize);
+        time = mdate() - time;
+
+        if(ret <= 0)
+        {
+            block_Release(p_block);
+            break;
+        }
+
+        p_block->i_buffer = ret;
+        p_block->i_length = time;
+        append(dl, p_block);
+    }
+
+    connManager->releaseChunk(chunk);
+}
+
+void Downloader::append(Download *dl, block_t *p_block)
+{
+    vlc_mutex_lock(&lock);
+    *dl->pp_tail = p_block;
+    dl->pp_tail = &p_block->p_next;
+    if(!dl->cancelled)
+    {
+        dl->buffered += p_block->i_buffer;
+        buffered += p_block->i_buffer;
+    }
+    vlc_cond_broadcast(&datacond);
+    vlc_mutex_unlock(&lock);
+}
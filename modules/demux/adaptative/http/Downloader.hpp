@@ -0,0 +1,100 @@
+/*
+ * Downloader.hpp
+ *****************************************************************************
+ * Copyright (C) 2015 - VideoLAN authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef DOWNLOADER_HPP
+#define DOWNLOADER_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <list>
+#include <vector>
+
+namespace adaptative
+{
+    namespace http
+    {
+        class HTTPConnectionManager;
+        class Chunk;
+
+        /* A chunk being fetched in the background. The scheduled chunk
+         * itself is never touched by the download threads: they work on a
+         * copy, and the consumer accounts the bytes it is handed. */
+        class Download
+        {
+            friend class Downloader;
+
+            private:
+                Download(Chunk *);
+                ~Download();
+
+                Chunk      *transport;
+                uint64_t    length; /* known once connected */
+                block_t    *p_head;
+                block_t   **pp_tail;
+                size_t      buffered;
+                bool        running;
+                bool        finished;
+                bool        needed;
+                bool        cancelled;
+        };
+
+        class Downloader
+        {
+            public:
+                Downloader(HTTPConnectionManager *, unsigned threads, size_t budget);
+                ~Downloader();
+
+                bool        start   ();
+                Download *  schedule(const Chunk *);
+                /* Blocks until data is available. Returns NULL once the
+                 * download is over or failed. The time spent receiving the
+                 * block is stored in its i_length. */
+                block_t *   read    (Download *);
+                void        cancel  (Download *);
+                bool        isDone  (Download *);
+                /* Known once data has been read */
+                uint64_t    getLength(Download *);
+
+            private:
+                static void * downloaderThread(void *);
+                void        run     ();
+                Download *  next    ();
+                void        fetch   (Download *);
+                void        append  (Download *, block_t *);
+
+                HTTPConnectionManager  *connManager;
+                vlc_mutex_t             lock;
+                vlc_cond_t              waitcond; /* download threads */
+                vlc_cond_t              datacond; /* consumers */
+                std::list<Download *>   queue;
+                std::vector<vlc_thread_t> threads;
+                unsigned                threadCount;
+                size_t                  buffered;
+                size_t                  budget;
+                bool                    killed;
+
+                static const size_t     READSIZE = 32768;
+        };
+    }
+}
+
+#endif // DOWNLOADER_HPP
@@ -49,9 +49,11 @@ namespace adaptative
                 void    closeAllConnections ();
                 void    releaseAllConnections ();
                 bool    connectChunk        (Chunk *chunk);
+                void    releaseChunk        (Chunk *chunk);
 
             private:
                 std::vector<HTTPConnection *>                       connectionPool;
+                vlc_mutex_t                                         lock; /* pool, chunk bindings */
                 vlc_object_t                                       *stream;
 
                 static const uint64_t   CHUNKDEFAULTBITRATE;
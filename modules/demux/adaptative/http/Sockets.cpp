@@ -61,10 +61,11 @@ void Socket::disconnect()
 ssize_t Socket::read(vlc_object_t *stream, void *p_buffer, size_t len)
 {
     ssize_t size;
+    /* EINTR means the object was killed: signals are handled by net_Read */
     do
     {
         size = net_Read(stream, netfd, p_buffer, len, true);
-    } while (size < 0 && (errno == EINTR || errno==EAGAIN) );
+    } while (size < 0 && errno==EAGAIN);
     return size;
 }
 
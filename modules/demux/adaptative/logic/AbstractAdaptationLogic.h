@@ -48,6 +48,8 @@ namespace adaptative
 
                 virtual BaseRepresentation* getCurrentRepresentation(StreamType, BasePeriod *) const = 0;
                 virtual void                updateDownloadRate     (size_t, mtime_t);
+                /* Media time downloaded ahead of the demuxer, < 0 if unknown */
+                virtual void                updateBufferLevel      (mtime_t);
 
                 enum LogicType
                 {
@@ -55,7 +57,8 @@ namespace adaptative
                     AlwaysBest,
                     AlwaysLowest,
                     RateBased,
-                    FixedRate
+                    FixedRate,
+                    Hybrid
                 };
         };
     }
@@ -0,0 +1,174 @@
+/*
+ * HybridAdaptationLogic.cpp
+ *****************************************************************************
+ * Copyright (C) 2015 - VideoLAN authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "HybridAdaptationLogic.hpp"
+#include "Representationselectors.hpp"
+
+#include "../playlist/BaseRepresentation.h"
+#include "../playlist/BasePeriod.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace adaptative::logic;
+
+/* Reads are merged until that long, as a single small one mostly
+ * measures the socket buffers */
+#define SAMPLE_MIN_TIME (CLOCK_FREQ / 20)
+/* Half lives of the averages, in seconds of download */
+#define FAST_HALFLIFE   2.0
+#define SLOW_HALFLIFE   8.0
+
+#define BUFFER_LOW      (4 * CLOCK_FREQ)
+#define BUFFER_HIGH     (16 * CLOCK_FREQ)
+
+/* Going up needs that much more bandwidth for that long */
+#define RISE_MARGIN     5 /* 1/5th */
+#define RISE_DELAY      (4 * CLOCK_FREQ)
+#define FALL_MARGIN     10 /* 1/10th */
+
+HybridAdaptationLogic::Average::Average(double halfLife_)
+{
+    halfLife = halfLife_;
+    estimate = 0.0;
+    totalWeight = 0.0;
+}
+
+void HybridAdaptationLogic::Average::push(double weight, double value)
+{
+    double alpha = pow(0.5, weight / halfLife);
+    estimate = value * (1.0 - alpha) + estimate * alpha;
+    totalWeight += weight;
+}
+
+double HybridAdaptationLogic::Average::get() const
+{
+    /* The average starts from 0, which would bias the first estimates */
+    double zeroFactor = 1.0 - pow(0.5, totalWeight / halfLife);
+    return (zeroFactor > 0.0) ? estimate / zeroFactor : 0.0;
+}
+
+HybridAdaptationLogic::HybridAdaptationLogic(int w, int h) :
+                       AbstractAdaptationLogic(),
+                       fast(FAST_HALFLIFE), slow(SLOW_HALFLIFE)
+{
+    width  = w;
+    height = h;
+    pendingBytes = 0;
+    pendingTime = 0;
+    bufferLevel = -1;
+    currentBps = 0;
+    risingBps = 0;
+    risingSince = VLC_TS_INVALID;
+}
+
+BaseRepresentation *HybridAdaptationLogic::getCurrentRepresentation(StreamType type, BasePeriod *period) const
+{
+    if(period == NULL)
+        return NULL;
+
+    RepresentationSelector selector;
+    BaseRepresentation *rep = selector.select(period, type, currentBps, width, height);
+    if ( rep == NULL )
+    {
+        rep = selector.select(period, type);
+        if ( rep == NULL )
+            return NULL;
+    }
+    return rep;
+}
+
+void HybridAdaptationLogic::updateDownloadRate(size_t size, mtime_t time)
+{
+    pendingBytes += size;
+    pendingTime += time;
+    if(pendingTime < SAMPLE_MIN_TIME)
+        return;
+
+    double weight = (double) pendingTime / CLOCK_FREQ;
+    double bps = pendingBytes * 8 / weight;
+    fast.push(weight, bps);
+    slow.push(weight, bps);
+    pendingBytes = 0;
+    pendingTime = 0;
+
+    updateTarget();
+}
+
+void HybridAdaptationLogic::updateBufferLevel(mtime_t level)
+{
+    bufferLevel = level;
+    if(currentBps)
+        updateTarget();
+}
+
+void HybridAdaptationLogic::updateTarget()
+{
+    const bool b_low = (bufferLevel >= 0 && bufferLevel < BUFFER_LOW);
+
+    /* The less is buffered, the more margin is left for bandwidth drops */
+    double share;
+    if(bufferLevel < 0)
+        share = 0.80;
+    else if(b_low)
+        share = 0.60;
+    else if(bufferLevel < BUFFER_HIGH)
+        share = 0.80;
+    else
+        share = 0.95;
+
+    uint64_t target = std::min(fast.get(), slow.get()) * share;
+
+    if(currentBps == 0)
+    {
+        currentBps = target;
+    }
+    else if(target < currentBps - currentBps / FALL_MARGIN || (b_low && target < currentBps))
+    {
+        currentBps = target;
+        risingSince = VLC_TS_INVALID;
+    }
+    else if(target > currentBps + currentBps / RISE_MARGIN && !b_low)
+    {
+        mtime_t now = mdate();
+        if(risingSince == VLC_TS_INVALID)
+        {
+            risingSince = now;
+            risingBps = target;
+        }
+        else
+        {
+            risingBps = std::min(risingBps, target);
+            if(now - risingSince >= RISE_DELAY)
+            {
+                /* lowest value seen while rising */
+                currentBps = risingBps;
+                risingSince = VLC_TS_INVALID;
+            }
+        }
+    }
+    else
+    {
+        risingSince = VLC_TS_INVALID;
+    }
+}
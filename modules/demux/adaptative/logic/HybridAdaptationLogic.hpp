@@ -0,0 +1,72 @@
+/*
+ * HybridAdaptationLogic.hpp
+ *****************************************************************************
+ * Copyright (C) 2015 - VideoLAN authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef HYBRIDADAPTATIONLOGIC_HPP
+#define HYBRIDADAPTATIONLOGIC_HPP
+
+#include "AbstractAdaptationLogic.h"
+
+namespace adaptative
+{
+    namespace logic
+    {
+        /* Bandwidth estimated by two moving averages weighted by the download
+         * time, the lowest one being trusted. The share of it used depends on
+         * the buffer level, and the target only goes up once it has been
+         * sustained, to avoid oscillating between representations. */
+        class HybridAdaptationLogic : public AbstractAdaptationLogic
+        {
+            public:
+                HybridAdaptationLogic(int, int);
+
+                virtual BaseRepresentation *getCurrentRepresentation(StreamType, BasePeriod *) const;
+                virtual void updateDownloadRate(size_t, mtime_t);
+                virtual void updateBufferLevel(mtime_t);
+
+            private:
+                class Average
+                {
+                    public:
+                        Average(double);
+                        void    push(double, double);
+                        double  get() const;
+
+                    private:
+                        double  halfLife;
+                        double  estimate;
+                        double  totalWeight;
+                };
+
+                void                    updateTarget();
+
+                int                     width;
+                int                     height;
+                Average                 fast;
+                Average                 slow;
+                size_t                  pendingBytes;
+                mtime_t                 pendingTime;
+                mtime_t                 bufferLevel;
+                uint64_t                currentBps;
+                uint64_t                risingBps;
+                mtime_t                 risingSince;
+        };
+    }
+}
+
+#endif // HYBRIDADAPTATIONLOGIC_HPP
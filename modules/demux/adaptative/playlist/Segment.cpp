@@ -42,12 +42,14 @@ ISegment::ISegment(const ICanonicalUrl *parent):
     classId = CLASSID_ISEGMENT;
     startTime.Set(0);
     duration.Set(0);
-    chunksuse.Set(0);
+    chunksuse = 0;
+    vlc_mutex_init(&chunkslock);
 }
 
 ISegment::~ISegment()
 {
-    assert(chunksuse.Get() == 0);
+    assert(chunksuse == 0);
+    vlc_mutex_destroy(&chunkslock);
 }
 
 Chunk * ISegment::getChunk(const std::string &url)
@@ -136,17 +138,29 @@ int ISegment::getClassId() const
     return classId;
 }
 
+bool ISegment::isUsed() const
+{
+    vlc_mutex_lock(const_cast<vlc_mutex_t *>(&chunkslock));
+    bool b_used = chunksuse > 0;
+    vlc_mutex_unlock(const_cast<vlc_mutex_t *>(&chunkslock));
+    return b_used;
+}
+
 ISegment::SegmentChunk::SegmentChunk(ISegment *segment_, const std::string &url) :
     Chunk(url)
 {
     segment = segment_;
-    segment->chunksuse.Set(segment->chunksuse.Get() + 1);
+    vlc_mutex_lock(&segment->chunkslock);
+    segment->chunksuse++;
+    vlc_mutex_unlock(&segment->chunkslock);
 }
 
 ISegment::SegmentChunk::~SegmentChunk()
 {
-    assert(segment->chunksuse.Get() > 0);
-    segment->chunksuse.Set(segment->chunksuse.Get() - 1);
+    vlc_mutex_lock(&segment->chunkslock);
+    assert(segment->chunksuse > 0);
+    segment->chunksuse--;
+    vlc_mutex_unlock(&segment->chunkslock);
 }
 
 void ISegment::SegmentChunk::setRepresentation(BaseRepresentation *rep_)
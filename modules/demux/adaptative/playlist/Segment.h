@@ -60,9 +60,10 @@ namespace adaptative
                 virtual bool                            contains        (size_t byte) const;
                 virtual int                             compare         (ISegment *) const;
                 int                                     getClassId      () const;
+                /* Whether chunks of that segment still exist */
+                bool                                    isUsed          () const;
                 Property<mtime_t>       startTime;
                 Property<mtime_t>       duration;
-                Property<unsigned>      chunksuse;
 
                 static const int CLASSID_ISEGMENT = 0;
 
@@ -71,6 +72,9 @@ namespace adaptative
                 size_t                  endByte;
                 std::string             debugName;
                 int                     classId;
+                /* chunks are created and deleted outside of the demux thread */
+                vlc_mutex_t             chunkslock;
+                unsigned                chunksuse;
 
                 class SegmentChunk : public Chunk
                 {
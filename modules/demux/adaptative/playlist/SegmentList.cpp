@@ -76,7 +76,7 @@ void SegmentList::pruneBySegmentNumber(uint64_t tobelownum)
     while(it != segments.end() && current < tobelownum)
     {
         ISegment *seg = *it;
-        if(seg->chunksuse.Get()) /* can't prune from here, still in use */
+        if(seg->isUsed()) /* can't prune from here, still in use */
             break;
         delete *it;
         it = segments.erase(it);
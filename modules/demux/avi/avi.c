@@ -45,6 +45,7 @@
 
 #include "libavi.h"
 #include "../rawdv.h"
+#include "../seekindex.h"
 
 /*****************************************************************************
  * Module descriptor
@@ -82,6 +83,8 @@ vlc_module_begin ()
     add_integer( "avi-index", 0,
               INDEX_TEXT, INDEX_LONGTEXT, false )
         change_integer_list( pi_index, ppsz_indexes )
+    add_bool( "avi-seekindex", true,
+              SEEKINDEX_TEXT, SEEKINDEX_LONGTEXT, true )
 
     set_callbacks( Open, Close )
 vlc_module_end ()
@@ -224,6 +227,9 @@ static int AVI_PacketSearch   ( demux_t * );
 
 static void AVI_IndexLoad    ( demux_t * );
 static void AVI_IndexCreate  ( demux_t * );
+static bool AVI_IndexScanEnded( demux_t *, off_t );
+static bool AVI_IndexCacheLoad( demux_t *, seekindex_t * );
+static void AVI_IndexCacheSave( demux_t *, seekindex_t * );
 
 static void AVI_ExtractSubtitle( demux_t *, unsigned int i_stream, avi_chunk_list_t *, avi_chunk_STRING_t * );
 
@@ -2552,6 +2558,8 @@ static void AVI_IndexCreate( demux_t *p_demux )
 
     mtime_t i_dialog_update;
     dialog_progress_bar_t *p_dialog = NULL;
+    seekindex_t *p_cache = NULL;
+    bool b_complete = false;
 
     p_riff = AVI_ChunkFind( &p_sys->ck_root, AVIFOURCC_RIFF, 0);
     p_movi = AVI_ChunkFind( p_riff, AVIFOURCC_movi, 0);
@@ -2565,6 +2573,12 @@ static void AVI_IndexCreate( demux_t *p_demux )
     for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
         avi_index_Init( &p_sys->track[i_stream]->idx );
 
+    /* Reuse the index created by a previous scan of the same file */
+    if( var_InheritBool( p_demux, "avi-seekindex" ) )
+        p_cache = SeekIndex_New( p_demux, "avi", 0 );
+    if( p_cache && AVI_IndexCacheLoad( p_demux, p_cache ) )
+        goto print_stat;
+
     i_movi_end = __MIN( (off_t)(p_movi->i_chunk_pos + p_movi->i_chunk_size),
                         stream_Size( p_demux->s ) );
 
@@ -2586,7 +2600,15 @@ static void AVI_IndexCreate( demux_t *p_demux )
         if( p_dialog && mdate() - i_dialog_update > 100000 )
         {
             if( dialog_ProgressCancelled( p_dialog ) )
+            {
+                /* Do not keep a partial index */
+                if( p_cache )
+                {
+                    SeekIndex_Delete( p_cache );
+                    p_cache = NULL;
+                }
                 break;
+            }
 
             double f_current = stream_Tell( p_demux->s );
             double f_size    = stream_Size( p_demux->s );
@@ -2597,7 +2619,10 @@ static void AVI_IndexCreate( demux_t *p_demux )
         }
 
         if( AVI_PacketGetHeader( p_demux, &pk ) )
+        {
+            b_complete = AVI_IndexScanEnded( p_demux, i_movi_end );
             break;
+        }
 
         if( pk.i_stream < p_sys->i_track &&
             pk.i_cat == p_sys->track[pk.i_stream]->i_cat )
@@ -2628,6 +2653,7 @@ static void AVI_IndexCreate( demux_t *p_demux )
                         goto print_stat;
                     break;
                 }
+                b_complete = true;
                 goto print_stat;
 
             case AVIFOURCC_RIFF:
@@ -2645,12 +2671,19 @@ static void AVI_IndexCreate( demux_t *p_demux )
                     msg_Warn( p_demux, "lost sync, abord index creation" );
                     goto print_stat;
                 }
+                /* pk is not a packet: go on from the one found */
+                continue;
             }
         }
 
-        if( ( !p_sys->b_odml && pk.i_pos + pk.i_size >= i_movi_end ) ||
-            AVI_PacketNext( p_demux ) )
+        if( !p_sys->b_odml && pk.i_pos + pk.i_size >= i_movi_end )
+        {
+            b_complete = true;
+            break;
+        }
+        if( AVI_PacketNext( p_demux ) )
         {
+            b_complete = AVI_IndexScanEnded( p_demux, i_movi_end );
             break;
         }
     }
@@ -2659,6 +2692,14 @@ print_stat:
     if( p_dialog != NULL )
         dialog_ProgressDestroy( p_dialog );
 
+    if( p_cache )
+    {
+        /* Do not keep a partial index either */
+        if( b_complete )
+            AVI_IndexCacheSave( p_demux, p_cache );
+        SeekIndex_Delete( p_cache );
+    }
+
     for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
     {
         msg_Dbg( p_demux, "stream[%d] creating %d index entries",
@@ -2666,6 +2707,85 @@ print_stat:
     }
 }
 
+/* Whether the index scan stopped at the end of the data rather than on a
+ * read error */
+static bool AVI_IndexScanEnded( demux_t *p_demux, off_t i_movi_end )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    int64_t i_end = p_sys->b_odml ? (int64_t)stream_Size( p_demux->s )
+                                  : i_movi_end;
+
+    return stream_Tell( p_demux->s ) + 16 > i_end;
+}
+
+static bool AVI_IndexCacheLoad( demux_t *p_demux, seekindex_t *p_cache )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    size_t i_count;
+    const seekindex_entry_t *p_entries = SeekIndex_Get( p_cache, &i_count );
+
+    if( !SeekIndex_IsComplete( p_cache ) || i_count == 0 )
+        return false;
+
+    for( size_t i = 0; i < i_count; i++ )
+    {
+        if( p_entries[i].i_track >= p_sys->i_track )
+        {
+            msg_Warn( p_demux, "invalid cached index, recreating it" );
+            SeekIndex_Clear( p_cache );
+            return false;
+        }
+    }
+
+    for( size_t i = 0; i < i_count; i++ )
+    {
+
+        avi_entry_t index;
+        index.i_id      = p_entries[i].i_id;
+        index.i_flags   = p_entries[i].i_flags;
+        index.i_pos     = p_entries[i].i_pos;
+        index.i_length  = p_entries[i].i_size;
+        index.i_lengthtotal = p_entries[i].i_size;
+        avi_index_Append( &p_sys->track[p_entries[i].i_track]->idx,
+                          &p_sys->i_movi_lastchunk_pos, &index );
+    }
+    msg_Dbg( p_demux, "using the cached index" );
+    return true;
+}
+
+static void AVI_IndexCacheSave( demux_t *p_demux, seekindex_t *p_cache )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    /* Already loaded from the cache */
+    if( SeekIndex_IsComplete( p_cache ) )
+        return;
+
+    SeekIndex_Clear( p_cache );
+
+    for( unsigned i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
+    {
+        avi_track_t *tk = p_sys->track[i_stream];
+
+        for( unsigned i = 0; i < tk->idx.i_size; i++ )
+        {
+            const avi_entry_t *p_index = &tk->idx.p_entry[i];
+            seekindex_entry_t entry = {
+                .i_time  = AVI_GetDPTS( tk, tk->i_samplesize ?
+                                            p_index->i_lengthtotal : i ),
+                .i_pos   = p_index->i_pos,
+                .i_track = i_stream,
+                .i_size  = p_index->i_length,
+                .i_flags = p_index->i_flags,
+                .i_id    = p_index->i_id,
+            };
+            if( SeekIndex_Append( p_cache, &entry ) )
+                return;
+        }
+    }
+    SeekIndex_SetComplete( p_cache );
+}
+
 /* */
 static void AVI_MetaLoad( demux_t *p_demux,
                           avi_chunk_list_t *p_riff, avi_chunk_avih_t *p_avih )
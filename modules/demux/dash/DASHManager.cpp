@@ -32,6 +32,7 @@
 #include "mpd/MPDFactory.h"
 #include "xml/DOMParser.h"
 #include "../adaptative/logic/RateBasedAdaptationLogic.h"
+#include "../adaptative/logic/HybridAdaptationLogic.hpp"
 #include <vlc_stream.h>
 #include "../adaptative/tools/Retrieve.hpp"
 
@@ -46,6 +47,8 @@ DASHManager::DASHManager(MPD *mpd,
                          AbstractAdaptationLogic::LogicType type, stream_t *stream) :
              PlaylistManager(mpd, type, stream)
 {
+    prefetchSegments = var_InheritInteger(stream, "dash-prefetch");
+    prefetchBudget = var_InheritInteger(stream, "dash-prefetch-size") * 1024;
 }
 
 DASHManager::~DASHManager   ()
@@ -145,6 +148,12 @@ AbstractAdaptationLogic *DASHManager::createLogic(AbstractAdaptationLogic::Logic
             int height = var_InheritInteger(stream, "dash-prefheight");
             return new (std::nothrow) RateBasedAdaptationLogic(width, height);
         }
+        case AbstractAdaptationLogic::Hybrid:
+        {
+            int width = var_InheritInteger(stream, "dash-prefwidth");
+            int height = var_InheritInteger(stream, "dash-prefheight");
+            return new (std::nothrow) HybridAdaptationLogic(width, height);
+        }
         default:
             return PlaylistManager::createLogic(type);
     }
@@ -68,15 +68,26 @@ static void Close   (vlc_object_t *);
 
 #define DASH_LOGIC_TEXT N_("Adaptation Logic")
 
+#define DASH_PREFETCH_TEXT N_("Segments to prefetch")
+#define DASH_PREFETCH_LONGTEXT N_("Number of segments downloaded in background " \
+    "ahead of the one being played. On live streams, no more than the " \
+    "maximum segment duration is fetched ahead. 0 to disable.")
+
+#define DASH_PREFETCH_SIZE_TEXT N_("Prefetch budget in KiB")
+#define DASH_PREFETCH_SIZE_LONGTEXT N_("Maximum amount of prefetched data " \
+    "held in memory")
+
 static const int pi_logics[] = {AbstractAdaptationLogic::RateBased,
                                 AbstractAdaptationLogic::FixedRate,
                                 AbstractAdaptationLogic::AlwaysLowest,
-                                AbstractAdaptationLogic::AlwaysBest};
+                                AbstractAdaptationLogic::AlwaysBest,
+                                AbstractAdaptationLogic::Hybrid};
 
 static const char *const ppsz_logics[] = { N_("Bandwidth Adaptive"),
                                            N_("Fixed Bandwidth"),
                                            N_("Lowest Bandwidth/Quality"),
-                                           N_("Highest Bandwith/Quality")};
+                                           N_("Highest Bandwith/Quality"),
+                                           N_("Bandwidth and Buffer Adaptive")};
 
 vlc_module_begin ()
         set_shortname( N_("DASH"))
@@ -90,6 +101,10 @@ vlc_module_begin ()
         add_integer( "dash-prefwidth",  480, DASH_WIDTH_TEXT,  DASH_WIDTH_LONGTEXT,  true )
         add_integer( "dash-prefheight", 360, DASH_HEIGHT_TEXT, DASH_HEIGHT_LONGTEXT, true )
         add_integer( "dash-prefbw",     250, DASH_BW_TEXT,     DASH_BW_LONGTEXT,     false )
+        add_integer( "dash-prefetch",   2,   DASH_PREFETCH_TEXT, DASH_PREFETCH_LONGTEXT, true )
+            change_integer_range( 0, 16 )
+        add_integer( "dash-prefetch-size", 16384, DASH_PREFETCH_SIZE_TEXT,
+                     DASH_PREFETCH_SIZE_LONGTEXT, true )
         set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -24,6 +24,7 @@
 
 #include "HLSManager.hpp"
 #include "../adaptative/logic/RateBasedAdaptationLogic.h"
+#include "../adaptative/logic/HybridAdaptationLogic.hpp"
 #include "../adaptative/tools/Retrieve.hpp"
 #include "playlist/Parser.hpp"
 #include <vlc_stream.h>
@@ -38,6 +39,8 @@ HLSManager::HLSManager(M3U8 *playlist,
                        AbstractAdaptationLogic::LogicType type, stream_t *stream) :
              PlaylistManager(playlist, type, stream)
 {
+    prefetchSegments = var_InheritInteger(stream, "hls-prefetch");
+    prefetchBudget = var_InheritInteger(stream, "hls-prefetch-size") * 1024;
 }
 
 HLSManager::~HLSManager()
@@ -60,6 +63,12 @@ AbstractAdaptationLogic *HLSManager::createLogic(AbstractAdaptationLogic::LogicT
             int height = var_InheritInteger(stream, "hls-prefheight");
             return new (std::nothrow) RateBasedAdaptationLogic(width, height);
         }
+        case AbstractAdaptationLogic::Hybrid:
+        {
+            int width = var_InheritInteger(stream, "hls-prefwidth");
+            int height = var_InheritInteger(stream, "hls-prefheight");
+            return new (std::nothrow) HybridAdaptationLogic(width, height);
+        }
         default:
             return PlaylistManager::createLogic(type);
     }
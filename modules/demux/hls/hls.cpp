@@ -65,15 +65,26 @@ static void Close   (vlc_object_t *);
 
 #define HLS_LOGIC_TEXT N_("Adaptation Logic")
 
+#define HLS_PREFETCH_TEXT N_("Segments to prefetch")
+#define HLS_PREFETCH_LONGTEXT N_("Number of segments downloaded in background " \
+    "ahead of the one being played. On live streams, no more than the " \
+    "maximum segment duration is fetched ahead. 0 to disable.")
+
+#define HLS_PREFETCH_SIZE_TEXT N_("Prefetch budget in KiB")
+#define HLS_PREFETCH_SIZE_LONGTEXT N_("Maximum amount of prefetched data " \
+    "held in memory")
+
 static const int pi_logics[] = {AbstractAdaptationLogic::RateBased,
                                 AbstractAdaptationLogic::FixedRate,
                                 AbstractAdaptationLogic::AlwaysLowest,
-                                AbstractAdaptationLogic::AlwaysBest};
+                                AbstractAdaptationLogic::AlwaysBest,
+                                AbstractAdaptationLogic::Hybrid};
 
 static const char *const ppsz_logics[] = { N_("Bandwidth Adaptive"),
                                            N_("Fixed Bandwidth"),
                                            N_("Lowest Bandwidth/Quality"),
-                                           N_("Highest Bandwith/Quality")};
+                                           N_("Highest Bandwith/Quality"),
+                                           N_("Bandwidth and Buffer Adaptive")};
 
 vlc_module_begin ()
         set_shortname( N_("hls"))
@@ -87,6 +98,10 @@ vlc_module_begin ()
         add_integer( "hls-prefwidth",  480, HLS_WIDTH_TEXT,  HLS_WIDTH_LONGTEXT,  true )
         add_integer( "hls-prefheight", 360, HLS_HEIGHT_TEXT, HLS_HEIGHT_LONGTEXT, true )
         add_integer( "hls-prefbw",     250, HLS_BW_TEXT,     HLS_BW_LONGTEXT,     false )
+        add_integer( "hls-prefetch",   2,   HLS_PREFETCH_TEXT, HLS_PREFETCH_LONGTEXT, true )
+            change_integer_range( 0, 16 )
+        add_integer( "hls-prefetch-size", 16384, HLS_PREFETCH_SIZE_TEXT,
+                     HLS_PREFETCH_SIZE_LONGTEXT, true )
         set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -28,6 +28,8 @@
 #include "util.hpp"
 #include "Ebml_parser.hpp"
 
+#include <climits>
+
 matroska_segment_c::matroska_segment_c( demux_sys_t & demuxer, EbmlStream & estream )
     :segment(NULL)
     ,es(estream)
@@ -52,6 +54,9 @@ matroska_segment_c::matroska_segment_c( demux_sys_t & demuxer, EbmlStream & estr
     ,b_cues(false)
     ,i_index(0)
     ,i_index_max(1024)
+    ,p_index_cache(NULL)
+    ,i_index_cached(0)
+    ,b_index_complete(false)
     ,psz_muxing_application(NULL)
     ,psz_writing_application(NULL)
     ,psz_segment_filename(NULL)
@@ -83,6 +88,8 @@ matroska_segment_c::~matroska_segment_c()
     free( psz_segment_filename );
     free( psz_title );
     free( psz_date_utc );
+    if( p_index_cache )
+        IndexCacheSave();
     free( p_indexes );
 
     delete ep;
@@ -611,6 +618,94 @@ void matroska_segment_c::IndexAppendCluster( KaxCluster *cluster )
 #undef idx
 }
 
+/* Whether the parser stopped at the end of the segment, and not on a read
+ * error or in a truncated file */
+bool matroska_segment_c::ReachedSegmentEnd()
+{
+    uint64 i_pos = es.I_O().getFilePointer();
+
+    if( segment->IsFiniteSize() )
+        return i_pos >= segment->GetEndPosition();
+
+    uint64_t i_size = stream_Size( sys.demuxer.s );
+    return i_size > 0 && i_pos >= i_size;
+}
+
+void matroska_segment_c::IndexCacheLoad()
+{
+    /* Only the segments of the opened file, not of the linked ones */
+    if( b_cues || sys.streams.empty() || sys.streams[0] == NULL ||
+        sys.streams[0]->p_estream != &es ||
+        !var_InheritBool( &sys.demuxer, "mkv-seekindex" ) )
+        return;
+
+    p_index_cache = SeekIndex_New( &sys.demuxer, "mkv", i_start_pos );
+    if( p_index_cache == NULL )
+        return;
+
+    size_t i_count;
+    const seekindex_entry_t *p_entries = SeekIndex_Get( p_index_cache, &i_count );
+    if( i_count == 0 || i_count > INT_MAX )
+        return;
+
+    if( (int)i_count >= i_index_max )
+    {
+        mkv_index_t *p_realloc = (mkv_index_t*)realloc( p_indexes,
+                                    sizeof( mkv_index_t ) * (i_count + 1024) );
+        if( p_realloc == NULL )
+            return;
+        p_indexes = p_realloc;
+        i_index_max = i_count + 1024;
+    }
+
+    for( size_t i = 0; i < i_count; i++ )
+    {
+        mkv_index_t *p_idx = &p_indexes[i];
+        p_idx->i_track        = -1;
+        p_idx->i_block_number = -1;
+        p_idx->i_position     = p_entries[i].i_pos;
+        p_idx->i_mk_time      = p_entries[i].i_time;
+        p_idx->b_key          = p_entries[i].i_flags != 0;
+    }
+    i_index = i_index_cached = i_count;
+
+    /* The clusters of the whole segment are known, seek by time as with
+     * cues */
+    if( SeekIndex_IsComplete( p_index_cache ) )
+    {
+        b_index_complete = b_cues = true;
+        msg_Dbg( &sys.demuxer, "using the cached clusters index" );
+    }
+}
+
+void matroska_segment_c::IndexCacheSave()
+{
+    if( i_index > i_index_cached ||
+        ( b_index_complete && !SeekIndex_IsComplete( p_index_cache ) ) )
+    {
+        SeekIndex_Clear( p_index_cache );
+        for( int i = 0; i < i_index; i++ )
+        {
+            if( p_indexes[i].i_mk_time == -1 )
+                continue;
+
+            seekindex_entry_t entry;
+            entry.i_time  = p_indexes[i].i_mk_time;
+            entry.i_pos   = p_indexes[i].i_position;
+            entry.i_track = 0;
+            entry.i_size  = 0;
+            entry.i_flags = p_indexes[i].b_key;
+            entry.i_id    = 0;
+            if( SeekIndex_Append( p_index_cache, &entry ) )
+                break;
+        }
+        if( b_index_complete )
+            SeekIndex_SetComplete( p_index_cache );
+    }
+    SeekIndex_Delete( p_index_cache );
+    p_index_cache = NULL;
+}
+
 bool matroska_segment_c::PreloadFamily( const matroska_segment_c & of_segment )
 {
     if ( b_preloaded )
@@ -759,6 +854,8 @@ bool matroska_segment_c::Preload( )
 
     ComputeTrackPriority();
 
+    IndexCacheLoad();
+
     b_preloaded = true;
 
     EnsureDuration();
@@ -928,6 +1025,9 @@ void matroska_segment_c::Seek( mtime_t i_mk_date, mtime_t i_mk_time_offset, int6
                     break;
             }
         }
+        /* All the clusters were indexed */
+        if( el == NULL && ReachedSegmentEnd() )
+            b_index_complete = true;
     }
 
     /* Don't try complex seek if we seek to 0 */
@@ -1446,6 +1546,10 @@ int matroska_segment_c::BlockGet( KaxBlock * & pp_block, KaxSimpleBlock * & pp_s
                 continue;
             }
             msg_Warn( &sys.demuxer, "EOF" );
+            /* Only a clean end of the segment means that every cluster was
+             * indexed: a complete index is saved and loaded as Cues */
+            if( ReachedSegmentEnd() )
+                b_index_complete = true;
             return VLC_EGENERIC;
         }
 
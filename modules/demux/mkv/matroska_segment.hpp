@@ -26,6 +26,7 @@
 #define _MATROSKA_SEGMENT_HPP_
 
 #include "mkv.hpp"
+#include "../seekindex.h"
 
 class EbmlParser;
 
@@ -111,6 +112,11 @@ public:
     int                     i_index_max;
     mkv_index_t             *p_indexes;
 
+    /* clusters index kept across opens when there are no cues */
+    seekindex_t             *p_index_cache;
+    int                     i_index_cached;
+    bool                    b_index_complete;
+
     /* info */
     char                    *psz_muxing_application;
     char                    *psz_writing_application;
@@ -161,6 +167,9 @@ private:
     void ParseCluster( KaxCluster *cluster, bool b_update_start_time = true, ScopeMode read_fully = SCOPE_ALL_DATA );
     SimpleTag * ParseSimpleTags( KaxTagSimple *tag, int level = 50 );
     void IndexAppendCluster( KaxCluster *cluster );
+    bool ReachedSegmentEnd();
+    void IndexCacheLoad();
+    void IndexCacheSave();
     int32_t TrackInit( mkv_track_t * p_tk );
     void ComputeTrackPriority();
     void EnsureDuration();
@@ -74,6 +74,9 @@ vlc_module_begin ()
             N_("Dummy Elements"),
             N_("Read and discard unknown EBML elements (not good for broken files)."), true );
 
+    add_bool( "mkv-seekindex", true,
+            SEEKINDEX_TEXT, SEEKINDEX_LONGTEXT, true );
+
     add_shortcut( "mka", "mkv" )
 vlc_module_end ()
 
@@ -57,6 +57,14 @@ vlc_module_end ()
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
+/* Coalesced reads when seeking between tracks (b_seekmode): the samples
+ * of all selected tracks in the next window are read together, as long as
+ * they are not further apart than the gap, and kept in a few spans */
+#define MP4_READ_SPAN_COUNT  4
+#define MP4_READ_SPAN_SIZE   (2 * 1024 * 1024)
+#define MP4_READ_SPAN_GAP    (128 * 1024)
+#define MP4_READ_SPAN_WINDOW (2 * CLOCK_FREQ)
+
 static int   Demux   ( demux_t * );
 static int   DemuxRef( demux_t *p_demux ){ (void)p_demux; return 0;}
 static int   DemuxFrg( demux_t * );
@@ -104,6 +112,15 @@ struct demux_sys_t
     /* */
     input_title_t *p_title;
 
+    /* coalesced reads (b_seekmode) */
+    struct
+    {
+        uint64_t i_pos;     /* file position of the span */
+        block_t  *p_block;
+        uint64_t i_date;    /* last use, for replacement */
+    } readspan[MP4_READ_SPAN_COUNT];
+    uint64_t i_readspan_date;
+
     /* ASF in MP4 */
     asf_packet_sys_t asfpacketsys;
     uint64_t i_preroll;         /* foobar */
@@ -127,6 +144,7 @@ static void MP4_TrackUnselect(demux_t *, mp4_track_t * );
 static int  MP4_TrackSeek   ( demux_t *, mp4_track_t *, mtime_t );
 
 static uint64_t MP4_TrackGetPos    ( mp4_track_t * );
+static uint64_t MP4_TrackGetPosAt  ( const mp4_track_t *, uint32_t, uint32_t );
 static uint32_t MP4_TrackGetReadSize( mp4_track_t *, uint32_t * );
 static int      MP4_TrackNextSample( demux_t *, mp4_track_t *, uint32_t );
 static void     MP4_TrackSetELST( demux_t *, mp4_track_t *, int64_t );
@@ -230,6 +248,38 @@ static MP4_Box_t * MP4_GetTrakByTrackID( MP4_Box_t *p_moov, const uint32_t i_id
     return p_trak;
 }
 
+/* Return the sample count of the i_index-th time run of a chunk, the first
+ * run being possibly shared with the previous chunks */
+static inline uint32_t MP4_ChunkRunCount( const uint32_t *p_sample_count,
+                                          uint32_t i_skip, uint32_t i_index )
+{
+    return i_index ? p_sample_count[i_index] : p_sample_count[0] - i_skip;
+}
+
+/* Return the dts of the i_sample-th sample of a chunk relative to its first
+ * one, in track timescale */
+static inline int64_t MP4_ChunkGetDTSOffset( const mp4_chunk_t *p_chunk,
+                                             uint32_t i_sample )
+{
+    int64_t i_dts = 0;
+
+    for( uint32_t i_index = 0;
+         i_sample > 0 && i_index < p_chunk->i_entries_dts; i_index++ )
+    {
+        uint32_t i_count = MP4_ChunkRunCount( p_chunk->p_sample_count_dts,
+                                              p_chunk->i_skip_dts, i_index );
+        if( i_sample <= i_count )
+        {
+            i_dts += (int64_t)i_sample * p_chunk->p_sample_delta_dts[i_index];
+            break;
+        }
+        i_dts += (int64_t)i_count * p_chunk->p_sample_delta_dts[i_index];
+        i_sample -= i_count;
+    }
+
+    return i_dts;
+}
+
 /* Return time in microsecond of a track */
 static inline int64_t MP4_TrackGetDTS( demux_t *p_demux, mp4_track_t *p_track )
 {
@@ -240,25 +290,8 @@ static inline int64_t MP4_TrackGetDTS( demux_t *p_demux, mp4_track_t *p_track )
     else
         p_chunk = &p_track->chunk[p_track->i_chunk];
 
-    unsigned int i_index = 0;
-    unsigned int i_sample = p_track->i_sample - p_chunk->i_sample_first;
-    int64_t i_dts = p_chunk->i_first_dts;
-
-    while( i_sample > 0 && i_index < p_chunk->i_entries_dts )
-    {
-        if( i_sample > p_chunk->p_sample_count_dts[i_index] )
-        {
-            i_dts += p_chunk->p_sample_count_dts[i_index] *
-                p_chunk->p_sample_delta_dts[i_index];
-            i_sample -= p_chunk->p_sample_count_dts[i_index];
-            i_index++;
-        }
-        else
-        {
-            i_dts += i_sample * p_chunk->p_sample_delta_dts[i_index];
-            break;
-        }
-    }
+    int64_t i_dts = p_chunk->i_first_dts +
+        MP4_ChunkGetDTSOffset( p_chunk, p_track->i_sample - p_chunk->i_sample_first );
 
     /* now handle elst */
     if( p_track->p_elst )
@@ -302,14 +335,16 @@ static inline bool MP4_TrackGetPTSDelta( demux_t *p_demux, mp4_track_t *p_track,
 
     for( i_index = 0; i_index < ck->i_entries_pts ; i_index++ )
     {
-        if( i_sample < ck->p_sample_count_pts[i_index] )
+        uint32_t i_count = MP4_ChunkRunCount( ck->p_sample_count_pts,
+                                              ck->i_skip_pts, i_index );
+        if( i_sample < i_count )
         {
             *pi_delta = ck->p_sample_offset_pts[i_index] * CLOCK_FREQ /
                         (int64_t)p_track->i_timescale;
             return true;
         }
 
-        i_sample -= ck->p_sample_count_pts[i_index];
+        i_sample -= i_count;
     }
     return false;
 }
@@ -485,12 +520,8 @@ static block_t * MP4_EIA608_Convert( block_t * p_block )
     return p_newblock;
 }
 
-static block_t * MP4_Block_Read( demux_t *p_demux, const mp4_track_t *p_track, int i_size )
+static block_t * MP4_Block_Convert( const mp4_track_t *p_track, block_t *p_block )
 {
-    block_t *p_block = stream_Block( p_demux->s, i_size );
-    if ( !p_block )
-        return NULL;
-
     /* might have some encap */
     if( p_track->fmt.i_cat == SPU_ES )
     {
@@ -512,6 +543,145 @@ static block_t * MP4_Block_Read( demux_t *p_demux, const mp4_track_t *p_track, i
     return p_block;
 }
 
+static block_t * MP4_Block_Read( demux_t *p_demux, const mp4_track_t *p_track, int i_size )
+{
+    block_t *p_block = stream_Block( p_demux->s, i_size );
+    if ( !p_block )
+        return NULL;
+
+    return MP4_Block_Convert( p_track, p_block );
+}
+
+typedef struct
+{
+    uint64_t i_start;
+    uint64_t i_end;
+} mp4_read_range_t;
+
+static int ReadRangeCompare( const void *a, const void *b )
+{
+    const mp4_read_range_t *ra = a, *rb = b;
+    return ( ra->i_start > rb->i_start ) - ( ra->i_start < rb->i_start );
+}
+
+/* Return the end of the read starting at i_pos: it covers at least up to
+ * i_end and merges the chunks of the selected tracks in the next window
+ * that are close enough */
+static uint64_t ReadSpanPlan( demux_t *p_demux, uint64_t i_pos, uint64_t i_end )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    mp4_read_range_t *p_ranges = NULL;
+    size_t i_ranges = 0, i_ranges_max = 0;
+
+    for( unsigned i_track = 0; i_track < p_sys->i_tracks; i_track++ )
+    {
+        const mp4_track_t *tk = &p_sys->track[i_track];
+        if( !tk->b_ok || tk->b_chapter || !tk->b_selected ||
+            tk->i_sample >= tk->i_sample_count || tk->i_timescale == 0 )
+            continue;
+
+        const uint64_t i_last_dts = tk->chunk[tk->i_chunk].i_first_dts +
+            MP4_READ_SPAN_WINDOW * tk->i_timescale / CLOCK_FREQ;
+
+        for( uint32_t i_chunk = tk->i_chunk; i_chunk < tk->i_chunk_count &&
+             tk->chunk[i_chunk].i_first_dts <= i_last_dts; i_chunk++ )
+        {
+            const mp4_chunk_t *ck = &tk->chunk[i_chunk];
+            mp4_read_range_t range;
+
+            range.i_start = ( i_chunk == tk->i_chunk ) ? MP4_TrackGetPos( (mp4_track_t *)tk )
+                                                       : ck->i_offset;
+            range.i_end = MP4_TrackGetPosAt( tk, i_chunk,
+                              __MIN( ck->i_sample_first + ck->i_sample_count,
+                                     tk->i_sample_count ) );
+            if( range.i_end <= i_pos || range.i_start >= i_pos + MP4_READ_SPAN_SIZE )
+                continue;
+
+            if( i_ranges == i_ranges_max )
+            {
+                size_t i_max = i_ranges_max ? i_ranges_max * 2 : 64;
+                mp4_read_range_t *p_realloc = realloc( p_ranges, i_max * sizeof(*p_ranges) );
+                if( !p_realloc )
+                    break;
+                p_ranges = p_realloc;
+                i_ranges_max = i_max;
+            }
+            p_ranges[i_ranges++] = range;
+        }
+    }
+
+    qsort( p_ranges, i_ranges, sizeof(*p_ranges), ReadRangeCompare );
+
+    for( size_t i = 0; i < i_ranges; i++ )
+    {
+        if( p_ranges[i].i_start > i_end + MP4_READ_SPAN_GAP )
+            break;
+        if( p_ranges[i].i_end > i_end )
+            i_end = __MIN( p_ranges[i].i_end, i_pos + MP4_READ_SPAN_SIZE );
+    }
+    free( p_ranges );
+
+    return i_end;
+}
+
+/* Read a sample from the spans, reading a new span if it is in none.
+ * Returns NULL if the sample cannot be read that way */
+static block_t * ReadSpanBlock( demux_t *p_demux, uint64_t i_pos, uint32_t i_size )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    unsigned i_span = 0;
+
+    if( i_size > MP4_READ_SPAN_SIZE )
+        return NULL;
+
+    for( unsigned i = 0; i < MP4_READ_SPAN_COUNT; i++ )
+    {
+        const block_t *p_span = p_sys->readspan[i].p_block;
+        if( p_span && i_pos >= p_sys->readspan[i].i_pos &&
+            i_pos + i_size <= p_sys->readspan[i].i_pos + p_span->i_buffer )
+        {
+            i_span = i;
+            goto copy;
+        }
+        if( p_sys->readspan[i].i_date < p_sys->readspan[i_span].i_date )
+            i_span = i;
+    }
+
+    /* replace the least recently used span */
+    if( p_sys->readspan[i_span].p_block )
+    {
+        block_Release( p_sys->readspan[i_span].p_block );
+        p_sys->readspan[i_span].p_block = NULL;
+    }
+
+    uint64_t i_current_pos;
+    if( !MP4_stream_Tell( p_demux->s, &i_current_pos ) ||
+        ( i_current_pos != i_pos && stream_Seek( p_demux->s, i_pos ) ) )
+        return NULL;
+
+    block_t *p_span = stream_Block( p_demux->s,
+                                    ReadSpanPlan( p_demux, i_pos, i_pos + i_size ) - i_pos );
+    if( !p_span )
+        return NULL;
+    if( p_span->i_buffer < i_size )
+    {
+        block_Release( p_span );
+        return NULL;
+    }
+    p_sys->readspan[i_span].i_pos = i_pos;
+    p_sys->readspan[i_span].p_block = p_span;
+
+copy:
+    p_sys->readspan[i_span].i_date = ++p_sys->i_readspan_date;
+
+    block_t *p_block = block_Alloc( i_size );
+    if( !p_block )
+        return NULL;
+    memcpy( p_block->p_buffer, p_sys->readspan[i_span].p_block->p_buffer +
+                               ( i_pos - p_sys->readspan[i_span].i_pos ), i_size );
+    return p_block;
+}
+
 static void MP4_Block_Send( demux_t *p_demux, mp4_track_t *p_track, block_t *p_block )
 {
     if ( p_track->b_chans_reorder && aout_BitsPerSample( p_track->fmt.i_codec ) )
@@ -1089,16 +1259,6 @@ static int Demux( demux_t *p_demux )
         msg_Dbg( p_demux, "Could not select track by data position" );
         goto end;
     }
-    else if ( p_sys->b_seekmode )
-    {
-        if( stream_Seek( p_demux->s, i_candidate_pos ) )
-        {
-            msg_Warn( p_demux, "track[0x%x] will be disabled (eof?)",
-                      tk->i_track_ID );
-            MP4_TrackUnselect( p_demux, tk );
-            goto end;
-        }
-    }
 
 #if 0
     msg_Dbg( p_demux, "tk(%i)=%"PRId64" mv=%"PRId64" pos=%"PRIu64, tk->i_track_ID,
@@ -1110,35 +1270,45 @@ static int Demux( demux_t *p_demux )
     uint32_t i_samplessize = MP4_TrackGetReadSize( tk, &i_nb_samples );
     if( i_samplessize > 0 )
     {
-        block_t *p_block;
+        block_t *p_block = NULL;
         int64_t i_delta;
-        uint64_t i_current_pos;
 
         /* go,go go ! */
-        if ( !MP4_stream_Tell( p_demux->s, &i_current_pos ) )
-            goto end;
+        if( p_sys->b_seekmode )
+            p_block = ReadSpanBlock( p_demux, i_candidate_pos, i_samplessize );
 
-        if( i_current_pos != i_candidate_pos )
+        if( p_block )
         {
-            if( stream_Seek( p_demux->s, i_candidate_pos ) )
+            p_block = MP4_Block_Convert( tk, p_block );
+        }
+        else
+        {
+            uint64_t i_current_pos;
+            if ( !MP4_stream_Tell( p_demux->s, &i_current_pos ) )
+                goto end;
+
+            if( i_current_pos != i_candidate_pos )
+            {
+                if( stream_Seek( p_demux->s, i_candidate_pos ) )
+                {
+                    msg_Warn( p_demux, "track[0x%x] will be disabled (eof?)"
+                              ": Failed to seek to %"PRIu64,
+                              tk->i_track_ID, i_candidate_pos );
+                    MP4_TrackUnselect( p_demux, tk );
+                    goto end;
+                }
+                i_current_pos = i_candidate_pos;
+            }
+
+            /* now read pes */
+            if( !(p_block = MP4_Block_Read( p_demux, tk, i_samplessize )) )
             {
                 msg_Warn( p_demux, "track[0x%x] will be disabled (eof?)"
-                          ": Failed to seek to %"PRIu64,
-                          tk->i_track_ID, i_candidate_pos );
+                          ": Failed to read %d bytes sample at %"PRIu64,
+                          tk->i_track_ID, i_samplessize, i_current_pos );
                 MP4_TrackUnselect( p_demux, tk );
                 goto end;
             }
-            i_current_pos = i_candidate_pos;
-        }
-
-        /* now read pes */
-        if( !(p_block = MP4_Block_Read( p_demux, tk, i_samplessize )) )
-        {
-            msg_Warn( p_demux, "track[0x%x] will be disabled (eof?)"
-                      ": Failed to read %d bytes sample at %"PRIu64,
-                      tk->i_track_ID, i_samplessize, i_current_pos );
-            MP4_TrackUnselect( p_demux, tk );
-            goto end;
         }
 
         /* dts */
@@ -1743,6 +1913,12 @@ static void Close ( vlc_object_t * p_this )
     }
     free( p_sys->moovfragment.p_durations );
 
+    for( unsigned i = 0; i < MP4_READ_SPAN_COUNT; i++ )
+    {
+        if( p_sys->readspan[i].p_block )
+            block_Release( p_sys->readspan[i].p_block );
+    }
+
     free( p_sys );
 }
 
@@ -1903,9 +2079,11 @@ static int TrackCreateChunksIndex( demux_t *p_demux,
 
         ck->i_first_dts = 0;
         ck->i_entries_dts = 0;
+        ck->i_skip_dts = 0;
         ck->p_sample_count_dts = NULL;
         ck->p_sample_delta_dts = NULL;
         ck->i_entries_pts = 0;
+        ck->i_skip_pts = 0;
         ck->p_sample_count_pts = NULL;
         ck->p_sample_offset_pts = NULL;
     }
@@ -1958,49 +2136,35 @@ static int TrackCreateChunksIndex( demux_t *p_demux,
     return VLC_SUCCESS;
 }
 
-static int xTTS_CountEntries( demux_t *p_demux, uint32_t *pi_entry /* out */,
-                              const uint32_t i_index,
-                              uint32_t i_index_samples_left,
-                              uint32_t i_sample_count,
-                              const uint32_t *pi_index_sample_count,
-                              const uint32_t i_table_count )
+/* Map the samples of a chunk onto the runs of a stts/ctts table, starting
+ * from the position left by the previous chunk, and move that position
+ * past them */
+static int xTTS_MapChunk( demux_t *p_demux, uint32_t *pi_entry /* out */,
+                          uint32_t *pi_index, uint32_t *pi_skip,
+                          uint32_t i_sample_count,
+                          const uint32_t *pi_index_sample_count,
+                          const uint32_t i_table_count )
 {
-    uint32_t i_array_offset;
+    *pi_entry = 0;
     while( i_sample_count > 0 )
     {
-        if ( likely((UINT32_MAX - i_index) >= *pi_entry) )
-            i_array_offset = i_index + *pi_entry;
-        else
-            return VLC_EGENERIC;
-
-        if ( i_array_offset >= i_table_count )
+        if ( *pi_index >= i_table_count )
         {
-            msg_Err( p_demux, "invalid index counting total samples %u %u", i_array_offset,  i_table_count );
+            msg_Err( p_demux, "invalid index counting total samples %u %u", *pi_index,  i_table_count );
             return VLC_ENOVAR;
         }
 
-        if ( i_index_samples_left )
+        uint32_t i_run = pi_index_sample_count[*pi_index] - *pi_skip;
+        *pi_entry += 1;
+        if ( i_run > i_sample_count )
         {
-            if ( i_index_samples_left > i_sample_count )
-            {
-                i_index_samples_left -= i_sample_count;
-                i_sample_count = 0;
-                *pi_entry +=1; /* No samples left, go copy */
-                break;
-            }
-            else
-            {
-                i_sample_count -= i_index_samples_left;
-                i_index_samples_left = 0;
-                *pi_entry += 1;
-                continue;
-            }
-        }
-        else
-        {
-            i_sample_count -= __MIN( i_sample_count, pi_index_sample_count[i_array_offset] );
-            *pi_entry += 1;
+            /* keep going from the same index with the next chunk */
+            *pi_skip += i_sample_count;
+            break;
         }
+        i_sample_count -= i_run;
+        *pi_index += 1;
+        *pi_skip = 0;
     }
 
     return VLC_SUCCESS;
@@ -2028,7 +2192,7 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
     }
     stsz = p_box->data.p_stsz;
 
-    /* Use stsz table to create a sample number -> sample size table */
+    /* Use stsz table as the sample number -> sample size table */
     p_demux_track->i_sample_count = stsz->i_sample_count;
     if( stsz->i_sample_size )
     {
@@ -2040,16 +2204,7 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
     {
         /* 2: each sample can have a different size */
         p_demux_track->i_sample_size = 0;
-        p_demux_track->p_sample_size =
-            calloc( p_demux_track->i_sample_count, sizeof( uint32_t ) );
-        if( p_demux_track->p_sample_size == NULL )
-            return VLC_ENOMEM;
-
-        for( uint32_t i_sample = 0; i_sample < p_demux_track->i_sample_count; i_sample++ )
-        {
-            p_demux_track->p_sample_size[i_sample] =
-                    stsz->i_entry_size[i_sample];
-        }
+        p_demux_track->p_sample_size = stsz->i_entry_size;
     }
 
     if ( p_demux_track->i_chunk_count )
@@ -2082,13 +2237,11 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
 
     /* Use stts table to create a sample number -> dts table.
      * XXX: if we don't want to waste too much memory, we can't expand
-     *  the box! so each chunk will contain an "extract" of this table
-     *  for fast research (problem with raw stream where a sample is sometime
+     *  the box! so each chunk only points to the runs of the table it
+     *  covers, and keeps its first dts so that the chunks are a sparse
+     *  index for seeking (problem with raw stream where a sample is sometime
      *  just channels*bits_per_sample/8 */
 
-     /* FIXME: refactor STTS & CTTS, STTS having now only few extra lines and
-      *        differing in 2/2 fields and 1 signedness */
-
     mtime_t i_next_dts = 0;
     /* Find stts
      *  Gives mapping between sample and decoding time
@@ -2105,96 +2258,40 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
 
         msg_Warn( p_demux, "STTS table of %"PRIu32" entries", stts->i_entry_count );
 
-        /* Create sample -> dts table per chunk */
+        /* Map sample -> dts runs per chunk */
         uint32_t i_index = 0;
-        uint32_t i_current_index_samples_left = 0;
+        uint32_t i_skip = 0;
+        int i_ret = VLC_SUCCESS;
 
         for( uint32_t i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
         {
             mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-            uint32_t i_sample_count;
 
             /* save first dts */
             ck->i_first_dts = i_next_dts;
             ck->i_last_dts  = i_next_dts;
 
-            /* count how many entries are needed for this chunk
-             * for p_sample_delta_dts and p_sample_count_dts */
-            ck->i_entries_dts = 0;
-
-            int i_ret = xTTS_CountEntries( p_demux, &ck->i_entries_dts, i_index,
-                                           i_current_index_samples_left,
-                                           ck->i_sample_count,
-                                           stts->pi_sample_count,
-                                           stts->i_entry_count );
-            if ( i_ret == VLC_EGENERIC )
-                return i_ret;
-
-            /* allocate them */
-            ck->p_sample_count_dts = calloc( ck->i_entries_dts, sizeof( uint32_t ) );
-            ck->p_sample_delta_dts = calloc( ck->i_entries_dts, sizeof( uint32_t ) );
-            if( !ck->p_sample_count_dts || !ck->p_sample_delta_dts )
-            {
-                free( ck->p_sample_count_dts );
-                free( ck->p_sample_delta_dts );
-                msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, ck->i_entries_dts );
-                ck->i_entries_dts = 0;
-                return VLC_ENOMEM;
-            }
+            if( i_ret != VLC_SUCCESS )
+                continue;
+
+            ck->i_skip_dts = i_skip;
+            ck->p_sample_count_dts = &stts->pi_sample_count[i_index];
+            ck->p_sample_delta_dts = (uint32_t *) &stts->pi_sample_delta[i_index];
 
-            /* now copy */
-            i_sample_count = ck->i_sample_count;
+            i_ret = xTTS_MapChunk( p_demux, &ck->i_entries_dts,
+                                   &i_index, &i_skip, ck->i_sample_count,
+                                   stts->pi_sample_count,
+                                   stts->i_entry_count );
 
+            uint32_t i_sample_count = ck->i_sample_count;
             for( uint32_t i = 0; i < ck->i_entries_dts; i++ )
             {
-                if ( i_current_index_samples_left )
-                {
-                    if ( i_current_index_samples_left > i_sample_count )
-                    {
-                        if ( i_sample_count ) ck->i_last_dts = i_next_dts;
-                        ck->p_sample_count_dts[i] = i_sample_count;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        i_current_index_samples_left -= i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_dts - 1 );
-                        break;
-                    }
-                    else
-                    {
-                        if ( i_current_index_samples_left ) ck->i_last_dts = i_next_dts;
-                        ck->p_sample_count_dts[i] = i_current_index_samples_left;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        i_sample_count -= i_current_index_samples_left;
-                        i_current_index_samples_left = 0;
-                        i_index++;
-                    }
-                }
-                else
-                {
-                    if ( stts->pi_sample_count[i_index] > i_sample_count )
-                    {
-                        if ( i_sample_count ) ck->i_last_dts = i_next_dts;
-                        ck->p_sample_count_dts[i] = i_sample_count;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        i_current_index_samples_left = stts->pi_sample_count[i_index] - i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_dts - 1 );
-                        // keep building from same index
-                    }
-                    else
-                    {
-                        if ( stts->pi_sample_count[i_index] ) ck->i_last_dts = i_next_dts;
-                        ck->p_sample_count_dts[i] = stts->pi_sample_count[i_index];
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        i_sample_count -= stts->pi_sample_count[i_index];
-                        i_index++;
-                    }
-                }
-
+                uint32_t i_count = MP4_ChunkRunCount( ck->p_sample_count_dts,
+                                                      ck->i_skip_dts, i );
+                i_count = __MIN( i_count, i_sample_count );
+                if ( i_count ) ck->i_last_dts = i_next_dts;
+                i_next_dts += (uint64_t)i_count * ck->p_sample_delta_dts[i];
+                i_sample_count -= i_count;
             }
         }
     }
@@ -2210,85 +2307,23 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
 
         msg_Warn( p_demux, "CTTS table of %"PRIu32" entries", ctts->i_entry_count );
 
-        /* Create pts-dts table per chunk */
+        /* Map pts-dts runs per chunk */
         uint32_t i_index = 0;
-        uint32_t i_current_index_samples_left = 0;
+        uint32_t i_skip = 0;
 
         for( uint32_t i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
         {
             mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-            uint32_t i_sample_count;
-
-            /* count how many entries are needed for this chunk
-             * for p_sample_offset_pts and p_sample_count_pts */
-            ck->i_entries_pts = 0;
-            int i_ret = xTTS_CountEntries( p_demux, &ck->i_entries_pts, i_index,
-                                           i_current_index_samples_left,
-                                           ck->i_sample_count,
-                                           ctts->pi_sample_count,
-                                           ctts->i_entry_count );
-            if ( i_ret == VLC_EGENERIC )
-                return i_ret;
-
-            /* allocate them */
-            ck->p_sample_count_pts = calloc( ck->i_entries_pts, sizeof( uint32_t ) );
-            ck->p_sample_offset_pts = calloc( ck->i_entries_pts, sizeof( int32_t ) );
-            if( !ck->p_sample_count_pts || !ck->p_sample_offset_pts )
-            {
-                free( ck->p_sample_count_pts );
-                free( ck->p_sample_offset_pts );
-                msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, ck->i_entries_pts );
-                ck->i_entries_pts = 0;
-                return VLC_ENOMEM;
-            }
 
-            /* now copy */
-            i_sample_count = ck->i_sample_count;
+            ck->i_skip_pts = i_skip;
+            ck->p_sample_count_pts = &ctts->pi_sample_count[i_index];
+            ck->p_sample_offset_pts = &ctts->pi_sample_offset[i_index];
 
-            for( uint32_t i = 0; i < ck->i_entries_pts; i++ )
-            {
-                if ( i_current_index_samples_left )
-                {
-                    if ( i_current_index_samples_left > i_sample_count )
-                    {
-                        ck->p_sample_count_pts[i] = i_sample_count;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_current_index_samples_left -= i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_pts - 1 );
-                        break;
-                    }
-                    else
-                    {
-                        ck->p_sample_count_pts[i] = i_current_index_samples_left;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_sample_count -= i_current_index_samples_left;
-                        i_current_index_samples_left = 0;
-                        i_index++;
-                    }
-                }
-                else
-                {
-                    if ( ctts->pi_sample_count[i_index] > i_sample_count )
-                    {
-                        ck->p_sample_count_pts[i] = i_sample_count;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_current_index_samples_left = ctts->pi_sample_count[i_index] - i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_pts - 1 );
-                        // keep building from same index
-                    }
-                    else
-                    {
-                        ck->p_sample_count_pts[i] = ctts->pi_sample_count[i_index];
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_sample_count -= ctts->pi_sample_count[i_index];
-                        i_index++;
-                    }
-                }
-
-
-            }
+            if( xTTS_MapChunk( p_demux, &ck->i_entries_pts,
+                               &i_index, &i_skip, ck->i_sample_count,
+                               ctts->pi_sample_count,
+                               ctts->i_entry_count ) != VLC_SUCCESS )
+                break;
         }
     }
 
@@ -2459,7 +2494,7 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
     uint64_t     i_dts;
     unsigned int i_sample;
     unsigned int i_chunk;
-    int          i_index;
+    uint32_t     i_index;
 
     /* FIXME see if it's needed to check p_track->i_chunk_count */
     if( p_track->i_chunk_count == 0 )
@@ -2503,52 +2538,50 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
         i_start = i_start * p_track->i_timescale / CLOCK_FREQ;
     }
 
-    /* we start from sample 0/chunk 0, hope it won't take too much time */
     /* *** find good chunk *** */
-    for( i_chunk = 0; ; i_chunk++ )
-    {
-        if( i_chunk + 1 >= p_track->i_chunk_count )
-        {
-            /* at the end and can't check if i_start in this chunk,
-               it will be check while searching i_sample */
-            i_chunk = p_track->i_chunk_count - 1;
-            break;
-        }
-
-        if( (uint64_t)i_start >= p_track->chunk[i_chunk].i_first_dts &&
-            (uint64_t)i_start <  p_track->chunk[i_chunk + 1].i_first_dts )
-        {
-            break;
-        }
+    /* the chunks first dts are a sparse index of the stts table: look for
+       the last chunk starting before i_start */
+    uint32_t i_lo = 0, i_hi = p_track->i_chunk_count - 1;
+    while( i_lo < i_hi )
+    {
+        uint32_t i_mid = i_lo + ( i_hi - i_lo + 1 ) / 2;
+        if( (uint64_t)i_start >= p_track->chunk[i_mid].i_first_dts )
+            i_lo = i_mid;
+        else
+            i_hi = i_mid - 1;
     }
+    /* if at the end, i_start will be checked while searching i_sample */
+    i_chunk = i_lo;
 
     /* *** find sample in the chunk *** */
-    i_sample = p_track->chunk[i_chunk].i_sample_first;
-    i_dts    = p_track->chunk[i_chunk].i_first_dts;
-    for( i_index = 0; i_sample < p_track->chunk[i_chunk].i_sample_count; )
+    const mp4_chunk_t *ck = &p_track->chunk[i_chunk];
+    uint32_t i_samples_left = ck->i_sample_count;
+    i_sample = ck->i_sample_first;
+    i_dts    = ck->i_first_dts;
+    for( i_index = 0; i_samples_left > 0 && i_index < ck->i_entries_dts;
+         i_index++ )
     {
-        if( i_dts +
-            p_track->chunk[i_chunk].p_sample_count_dts[i_index] *
-            p_track->chunk[i_chunk].p_sample_delta_dts[i_index] < (uint64_t)i_start )
-        {
-            i_dts    +=
-                p_track->chunk[i_chunk].p_sample_count_dts[i_index] *
-                p_track->chunk[i_chunk].p_sample_delta_dts[i_index];
+        uint32_t i_count = MP4_ChunkRunCount( ck->p_sample_count_dts,
+                                              ck->i_skip_dts, i_index );
+        i_count = __MIN( i_count, i_samples_left );
 
-            i_sample += p_track->chunk[i_chunk].p_sample_count_dts[i_index];
-            i_index++;
+        if( i_dts + (uint64_t)i_count * ck->p_sample_delta_dts[i_index] <=
+            (uint64_t)i_start )
+        {
+            i_dts    += (uint64_t)i_count * ck->p_sample_delta_dts[i_index];
+            i_sample += i_count;
+            i_samples_left -= i_count;
         }
         else
         {
-            if( p_track->chunk[i_chunk].p_sample_delta_dts[i_index] <= 0 )
-            {
-                break;
-            }
-            i_sample += ( i_start - i_dts ) /
-                p_track->chunk[i_chunk].p_sample_delta_dts[i_index];
+            if( ck->p_sample_delta_dts[i_index] > 0 )
+                i_sample += ( i_start - i_dts ) / ck->p_sample_delta_dts[i_index];
             break;
         }
     }
+    /* past the last chunk: keep its last sample */
+    if( i_samples_left == 0 && ck->i_sample_count > 0 )
+        i_sample--;
 
     if( i_sample >= p_track->i_sample_count )
     {
@@ -2565,31 +2598,37 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
         MP4_Box_data_stss_t *p_stss = p_box_stss->data.p_stss;
         msg_Dbg( p_demux, "track[Id 0x%x] using Sync Sample Box (stss)",
                  p_track->i_track_ID );
-        for( unsigned i_index = 0; i_index < p_stss->i_entry_count; i_index++ )
+        if( p_stss->i_entry_count > 0 )
         {
-            if( i_index >= p_stss->i_entry_count - 1 ||
-                i_sample < p_stss->i_sample_number[i_index+1] )
+            /* look for the last sync sample before i_sample */
+            uint32_t i_lo = 0, i_hi = p_stss->i_entry_count - 1;
+            while( i_lo < i_hi )
             {
-                unsigned i_sync_sample = p_stss->i_sample_number[i_index];
-                msg_Dbg( p_demux, "stss gives %d --> %d (sample number)",
-                         i_sample, i_sync_sample );
-
-                if( i_sync_sample <= i_sample )
-                {
-                    while( i_chunk > 0 &&
-                           i_sync_sample < p_track->chunk[i_chunk].i_sample_first )
-                        i_chunk--;
-                }
+                uint32_t i_mid = i_lo + ( i_hi - i_lo + 1 ) / 2;
+                if( i_sample >= p_stss->i_sample_number[i_mid] )
+                    i_lo = i_mid;
                 else
-                {
-                    while( i_chunk < p_track->i_chunk_count - 1 &&
-                           i_sync_sample >= p_track->chunk[i_chunk].i_sample_first +
-                                            p_track->chunk[i_chunk].i_sample_count )
-                        i_chunk++;
-                }
-                i_sample = i_sync_sample;
-                break;
+                    i_hi = i_mid - 1;
+            }
+
+            unsigned i_sync_sample = p_stss->i_sample_number[i_lo];
+            msg_Dbg( p_demux, "stss gives %d --> %d (sample number)",
+                     i_sample, i_sync_sample );
+
+            if( i_sync_sample <= i_sample )
+            {
+                while( i_chunk > 0 &&
+                       i_sync_sample < p_track->chunk[i_chunk].i_sample_first )
+                    i_chunk--;
+            }
+            else
+            {
+                while( i_chunk < p_track->i_chunk_count - 1 &&
+                       i_sync_sample >= p_track->chunk[i_chunk].i_sample_first +
+                                        p_track->chunk[i_chunk].i_sample_count )
+                    i_chunk++;
             }
+            i_sample = i_sync_sample;
         }
     }
     else
@@ -2990,11 +3029,7 @@ static void MP4_TrackDestroy( demux_t *p_demux, mp4_track_t *p_track )
     if( p_track->p_es )
         es_out_Del( p_demux->out, p_track->p_es );
 
-    if( p_track->chunk )
-    {
-        for( unsigned int i_chunk = 0; i_chunk < p_track->i_chunk_count; i_chunk++ )
-            DestroyChunk( &p_track->chunk[i_chunk] );
-    }
+    /* the chunks built from the moov only point to its tables */
     free( p_track->chunk );
 
     if( p_track->cchunk )
@@ -3004,9 +3039,6 @@ static void MP4_TrackDestroy( demux_t *p_demux, mp4_track_t *p_track )
         free( p_track->cchunk );
     }
 
-    if( !p_track->i_sample_size )
-        free( p_track->p_sample_size );
-
     if ( p_track->asfinfo.p_frame )
         block_ChainRelease( p_track->asfinfo.p_frame );
 }
@@ -3258,12 +3290,13 @@ static uint32_t MP4_TrackGetReadSize( mp4_track_t *p_track, uint32_t *pi_nb_samp
     return i_size;
 }
 
-static uint64_t MP4_TrackGetPos( mp4_track_t *p_track )
+/* Return the file position of the i_sample-th sample of the track,
+ * stored in its i_chunk-th chunk */
+static uint64_t MP4_TrackGetPosAt( const mp4_track_t *p_track,
+                                   uint32_t i_chunk, uint32_t i_sample )
 {
-    unsigned int i_sample;
-    uint64_t i_pos;
-
-    i_pos = p_track->chunk[p_track->i_chunk].i_offset;
+    const mp4_chunk_t *p_chunk = &p_track->chunk[i_chunk];
+    uint64_t i_pos = p_chunk->i_offset;
 
     if( p_track->i_sample_size )
     {
@@ -3277,8 +3310,7 @@ static uint64_t MP4_TrackGetPos( mp4_track_t *p_track )
             switch( p_track->fmt.i_codec )
             {
             case VLC_CODEC_GSM: /* # Samples > data size */
-                i_pos += ( p_track->i_sample -
-                           p_track->chunk[p_track->i_chunk].i_sample_first ) / 160 * 33;
+                i_pos += ( i_sample - p_chunk->i_sample_first ) / 160 * 33;
                 return i_pos;
             default:
                 break;
@@ -3289,29 +3321,30 @@ static uint64_t MP4_TrackGetPos( mp4_track_t *p_track )
             p_track->fmt.audio.i_blockalign <= 1 ||
             p_soun->i_sample_per_packet * p_soun->i_bytes_per_frame == 0 )
         {
-            i_pos += ( p_track->i_sample -
-                       p_track->chunk[p_track->i_chunk].i_sample_first ) *
+            i_pos += ( i_sample - p_chunk->i_sample_first ) *
                      MP4_GetFixedSampleSize( p_track, p_soun );
         }
         else
         {
             /* we read chunk by chunk unless a blockalign is requested */
-            i_pos += ( p_track->i_sample - p_track->chunk[p_track->i_chunk].i_sample_first ) /
+            i_pos += ( i_sample - p_chunk->i_sample_first ) /
                         p_soun->i_sample_per_packet * p_soun->i_bytes_per_frame;
         }
     }
     else
     {
-        for( i_sample = p_track->chunk[p_track->i_chunk].i_sample_first;
-             i_sample < p_track->i_sample; i_sample++ )
-        {
-            i_pos += p_track->p_sample_size[i_sample];
-        }
+        for( uint32_t i = p_chunk->i_sample_first; i < i_sample; i++ )
+            i_pos += p_track->p_sample_size[i];
     }
 
     return i_pos;
 }
 
+static uint64_t MP4_TrackGetPos( mp4_track_t *p_track )
+{
+    return MP4_TrackGetPosAt( p_track, p_track->i_chunk, p_track->i_sample );
+}
+
 static int MP4_TrackNextSample( demux_t *p_demux, mp4_track_t *p_track, uint32_t i_samples )
 {
     if ( UINT32_MAX - p_track->i_sample < i_samples )
@@ -4760,26 +4793,7 @@ static int LeafMOOVGetSamplesSize( const mp4_track_t *p_track, const uint32_t i_
 
 static inline mtime_t LeafGetMOOVTimeInChunk( const mp4_chunk_t *p_chunk, uint32_t i_sample )
 {
-    mtime_t i_time = 0;
-    uint32_t i_index = 0;
-
-    while( i_sample > 0 )
-    {
-        if( i_sample > p_chunk->p_sample_count_dts[i_index] )
-        {
-            i_time += p_chunk->p_sample_count_dts[i_index] *
-                p_chunk->p_sample_delta_dts[i_index];
-            i_sample -= p_chunk->p_sample_count_dts[i_index];
-            i_index++;
-        }
-        else
-        {
-            i_time += i_sample * p_chunk->p_sample_delta_dts[i_index];
-            break;
-        }
-    }
-
-    return i_time;
+    return MP4_ChunkGetDTSOffset( p_chunk, i_sample );
 }
 
 static int LeafParseMDATwithMOOV( demux_t *p_demux )
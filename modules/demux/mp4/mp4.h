@@ -49,11 +49,17 @@ typedef struct
     uint64_t     i_first_dts;   /* DTS of the first sample */
     uint64_t     i_last_dts;    /* DTS of the last sample */
 
+    /* The runs point into the track stts/ctts tables, unless b_fragmented
+       is true, and the first run of a chunk can then start within an entry
+       already used by the previous chunks: i_skip_* of its samples are not
+       part of this chunk. The last run can extend past the chunk too. */
     uint32_t     i_entries_dts;
+    uint32_t     i_skip_dts;
     uint32_t     *p_sample_count_dts;
     uint32_t     *p_sample_delta_dts;   /* dts delta */
 
     uint32_t     i_entries_pts;
+    uint32_t     i_skip_pts;
     uint32_t     *p_sample_count_pts;
     int32_t      *p_sample_offset_pts;  /* pts-dts */
 
@@ -108,9 +114,10 @@ typedef struct
     mp4_chunk_t    *cchunk; /* current chunk if b_fragmented is true */
 
     /* sample size, p_sample_size defined only if i_sample_size == 0
-        else i_sample_size is size for all sample */
+        else i_sample_size is size for all sample. It points to the stsz
+        table and is not owned by the track */
     uint32_t         i_sample_size;
-    uint32_t         *p_sample_size; /* XXX perhaps add file offset if take
+    const uint32_t   *p_sample_size; /* XXX perhaps add file offset if take
                                     too much time to do sumations each time*/
 
     uint32_t     i_sample_first; /* i_sample_first value
@@ -450,7 +450,11 @@ static bool Parse( demux_t *p_demux, block_t **pp_output )
             return true;
     }
 
-    p_block_in = stream_Block( p_demux->s, p_sys->i_packet_size );
+    /* Words are swapped in place, do not share the stream data then */
+    if( p_sys->codec.b_use_word && !p_sys->b_big_endian )
+        p_block_in = stream_Block( p_demux->s, p_sys->i_packet_size );
+    else
+        p_block_in = stream_ReadBlock( p_demux->s, p_sys->i_packet_size );
     bool b_eof = p_block_in == NULL;
 
     if( p_block_in )
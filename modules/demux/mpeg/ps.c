@@ -634,7 +634,7 @@ static block_t *ps_pkt_read( stream_t *s, uint32_t i_code )
                 if( p_peek[i_size] == 0x00 && p_peek[i_size+1] == 0x00 &&
                     p_peek[i_size+2] == 0x01 && p_peek[i_size+3] >= 0xb9 )
                 {
-                    return stream_Block( s, i_size );
+                    return stream_ReadBlock( s, i_size );
                 }
                 i_size++;
             }
@@ -643,7 +643,7 @@ static block_t *ps_pkt_read( stream_t *s, uint32_t i_code )
     else
     {
         /* Normal case */
-        return stream_Block( s, i_size );
+        return stream_ReadBlock( s, i_size );
     }
 
     VLC_UNUSED(i_code);
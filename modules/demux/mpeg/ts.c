@@ -69,6 +69,7 @@
 #include "../../codec/opus_header.h"
 
 #include "../opus.h"
+#include "../seekindex.h"
 
 #include "pes.h"
 #include "mpeg4_iod.h"
@@ -169,6 +170,7 @@ vlc_module_begin ()
 
     add_bool( "ts-split-es", true, SPLIT_ES_TEXT, SPLIT_ES_LONGTEXT, false )
     add_bool( "ts-seek-percent", false, SEEK_PERCENT_TEXT, SEEK_PERCENT_LONGTEXT, true )
+    add_bool( "ts-seekindex", true, SEEKINDEX_TEXT, SEEKINDEX_LONGTEXT, true )
 
     add_integer( "ts-arib", ARIBMODE_AUTO, SUPPORT_ARIB_TEXT, SUPPORT_ARIB_LONGTEXT, false )
         change_integer_list( arib_mode_list, arib_mode_list_text )
@@ -228,6 +230,9 @@ typedef struct
 
     mtime_t i_last_dts;
 
+    /* PCR positions seen while playing, kept across opens */
+    seekindex_t *p_seekindex;
+
 } ts_pmt_t;
 
 typedef struct
@@ -254,8 +259,10 @@ typedef struct
     ts_es_data_type_t data_type;
     int         i_data_size;
     int         i_data_gathered;
+    /* unit being gathered, its payload is appended up to i_data_alloc */
     block_t     *p_data;
-    block_t     **pp_last;
+    size_t      i_data_alloc;
+    size_t      i_data_prealloc; /* average size of the previous units */
 
     block_t *   p_prepcr_outqueue;
 
@@ -344,6 +351,7 @@ typedef struct
 #define MIN_PAT_INTERVAL CLOCK_FREQ // DVB is 500ms
 
 #define PID_ALLOC_CHUNK 16
+#define TS_PID_COUNT 8192
 
 struct demux_sys_t
 {
@@ -360,6 +368,8 @@ struct demux_sys_t
 
     /* how many TS packet we read at once */
     unsigned    i_ts_read;
+    /* TS packets read at once and not demuxed yet */
+    block_t    *p_ts_batch;
 
     bool        b_force_seek_per_percent;
 
@@ -381,9 +391,8 @@ struct demux_sys_t
         ts_pid_t **pp_all;
         int        i_all;
         int        i_all_alloc;
-        /* last recently used */
-        uint16_t   i_last_pid;
-        ts_pid_t  *p_last;
+        /* same ones, indexed by pid */
+        ts_pid_t  *index[TS_PID_COUNT];
     } pids;
 
     bool        b_user_pmt;
@@ -468,21 +477,24 @@ static bool ProgramIsSelected( demux_sys_t *, uint16_t i_pgrm );
 static void UpdatePESFilters( demux_t *p_demux, bool b_all );
 static inline void FlushESBuffer( ts_pes_t *p_pes );
 static void UpdateScrambledState( demux_t *p_demux, ts_pid_t *p_pid, bool );
-static inline int PIDGet( block_t *p )
+static inline int PIDGet( const uint8_t *p )
 {
-    return ( (p->p_buffer[1]&0x1f)<<8 )|p->p_buffer[2];
+    return ( (p[1]&0x1f)<<8 )|p[2];
 }
 
-static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk );
+static bool GatherData( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p );
 static void AddAndCreateES( demux_t *p_demux, ts_pid_t *pid, bool );
 static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_prg, mtime_t i_pcr );
 
 static block_t* ReadTSPacket( demux_t *p_demux );
+static const uint8_t *ReadTSPacketBatch( demux_t *p_demux );
+static void FlushTSBatch( demux_sys_t *p_sys );
 static int ProbeStart( demux_t *p_demux, int i_program );
 static int ProbeEnd( demux_t *p_demux, int i_program );
 static int SeekToTime( demux_t *p_demux, ts_pmt_t *, int64_t time );
 static void ReadyQueuesPostSeek( demux_t *p_demux );
-static void PCRHandle( demux_t *p_demux, ts_pid_t *, block_t * );
+static void PCRHandle( demux_t *p_demux, ts_pid_t *, const uint8_t * );
+static void ProgramIndexPCR( demux_t *, ts_pmt_t *, mtime_t );
 static void PCRFixHandle( demux_t *, ts_pmt_t *, block_t * );
 static int64_t TimeStampWrapAround( ts_pmt_t *, int64_t );
 
@@ -502,6 +514,29 @@ static int  SetPIDFilter( demux_sys_t *, ts_pid_t *, bool b_selected );
 #define TS_PACKET_SIZE_204 204
 #define TS_PACKET_SIZE_MAX 204
 #define TS_HEADER_SIZE 4
+#define PES_PREALLOC_MIN (TS_PACKET_SIZE_188 * 4)
+/* Units without a size are not preallocated beyond this, larger ones grow */
+#define PES_PREALLOC_MAX (256 * 1024)
+/* Larger allocation slack is not passed on with the unit */
+#define PES_SLACK_MAX 2048
+
+/* Finds the first sync byte followed by another one i_stride bytes later.
+ * memchr() is vectorized by the C library, so the scan only falls back to
+ * byte compares on candidate positions. */
+static const uint8_t *FindSync( const uint8_t *p, size_t i_size, unsigned i_stride )
+{
+    if( i_size <= i_stride )
+        return NULL;
+
+    const uint8_t *p_end = p + i_size - i_stride;
+    while( p < p_end && (p = memchr( p, 0x47, p_end - p )) != NULL )
+    {
+        if( p[i_stride] == 0x47 )
+            return p;
+        p++;
+    }
+    return NULL;
+}
 
 static int DetectPacketSize( demux_t *p_demux, unsigned *pi_header_size, int i_offset )
 {
@@ -513,8 +548,11 @@ static int DetectPacketSize( demux_t *p_demux, unsigned *pi_header_size, int i_o
 
     for( int i_sync = 0; i_sync < TS_PACKET_SIZE_MAX; i_sync++ )
     {
-        if( p_peek[i_offset + i_sync] != 0x47 )
-            continue;
+        const uint8_t *p_sync = memchr( &p_peek[i_offset + i_sync], 0x47,
+                                        TS_PACKET_SIZE_MAX - i_sync );
+        if( p_sync == NULL )
+            break;
+        i_sync = p_sync - &p_peek[i_offset];
 
         /* Check next 3 sync bytes */
         int i_peek = i_offset + TS_PACKET_SIZE_MAX * 3 + i_sync + 1;
@@ -1003,6 +1041,7 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_packet_size = i_packet_size;
     p_sys->i_packet_header_size = i_packet_header_size;
     p_sys->i_ts_read = 50;
+    p_sys->p_ts_batch = NULL;
     p_sys->csa = NULL;
     p_sys->b_start_record = false;
 
@@ -1187,6 +1226,8 @@ static void Close( vlc_object_t *p_this )
 
     vlc_mutex_destroy( &p_sys->csa_lock );
 
+    FlushTSBatch( p_sys );
+
     /* Release all non default pids */
     for( int i = 0; i < p_sys->pids.i_all; i++ )
     {
@@ -1240,24 +1281,31 @@ static int Demux( demux_t *p_demux )
     for( unsigned i_pkt = 0; i_pkt < p_sys->i_ts_read; i_pkt++ )
     {
         bool         b_frame = false;
-        block_t     *p_pkt;
-        if( !(p_pkt = ReadTSPacket( p_demux )) )
+        const uint8_t *p_pkt;
+        if( !(p_pkt = ReadTSPacketBatch( p_demux )) )
         {
             return VLC_DEMUXER_EOF;
         }
 
         if( p_sys->b_start_record )
         {
-            /* Enable recording once synchronized */
-            stream_Control( p_sys->stream, STREAM_SET_RECORD_STATE, true, "ts" );
+            /* Enable recording once synchronized. This packet and the ones
+             * read ahead with it were read before, hand them over */
+            const block_t *p_batch = p_sys->p_ts_batch;
+
             p_sys->b_start_record = false;
+            if( stream_Control( p_sys->stream, STREAM_SET_RECORD_STATE,
+                                true, "ts" ) == VLC_SUCCESS )
+                stream_Control( p_sys->stream, STREAM_RECORD_DATA,
+                                p_batch->p_buffer - p_sys->i_packet_size,
+                                (size_t)p_sys->i_packet_size + p_batch->i_buffer );
         }
 
         /* Parse the TS packet */
         ts_pid_t *p_pid = GetPID( p_sys, PIDGet( p_pkt ) );
 
-        if( SCRAMBLED(*p_pid) != !!(p_pkt->p_buffer[3] & 0x80) )
-            UpdateScrambledState( p_demux, p_pid, p_pkt->p_buffer[3] & 0x80 );
+        if( SCRAMBLED(*p_pid) != !!(p_pkt[3] & 0x80) )
+            UpdateScrambledState( p_demux, p_pid, p_pkt[3] & 0x80 );
 
         if( !SEEN(p_pid) )
         {
@@ -1267,34 +1315,31 @@ static int Demux( demux_t *p_demux )
         }
 
         if ( SCRAMBLED(*p_pid) && !p_demux->p_sys->csa )
-        {
-            block_Release( p_pkt );
             continue;
-        }
 
         /* Probe streams to build PAT/PMT after MIN_PAT_INTERVAL in case we don't see any PAT */
         if( !SEEN( GetPID( p_sys, 0 ) ) &&
             (p_pid->probed.i_type == 0 || p_pid->i_pid == p_sys->patfix.i_timesourcepid) &&
-            (p_pkt->p_buffer[1] & 0xC0) == 0x40 && /* Payload start but not corrupt */
-            (p_pkt->p_buffer[3] & 0xD0) == 0x10 )  /* Has payload but is not encrypted */
+            (p_pkt[1] & 0xC0) == 0x40 && /* Payload start but not corrupt */
+            (p_pkt[3] & 0xD0) == 0x10 )  /* Has payload but is not encrypted */
         {
-            ProbePES( p_demux, p_pid, p_pkt->p_buffer + TS_HEADER_SIZE,
-                      p_pkt->i_buffer - TS_HEADER_SIZE, p_pkt->p_buffer[3] & 0x20 /* Adaptation field */);
+            ProbePES( p_demux, p_pid, p_pkt + TS_HEADER_SIZE,
+                      p_sys->i_packet_size - p_sys->i_packet_header_size - TS_HEADER_SIZE,
+                      p_pkt[3] & 0x20 /* Adaptation field */);
         }
 
         switch( p_pid->type )
         {
         case TYPE_PAT:
-            dvbpsi_packet_push( p_pid->u.p_pat->handle, p_pkt->p_buffer );
-            block_Release( p_pkt );
+            dvbpsi_packet_push( p_pid->u.p_pat->handle, (uint8_t *)p_pkt );
             break;
 
         case TYPE_PMT:
-            dvbpsi_packet_push( p_pid->u.p_pmt->handle, p_pkt->p_buffer );
-            block_Release( p_pkt );
+            dvbpsi_packet_push( p_pid->u.p_pmt->handle, (uint8_t *)p_pkt );
             break;
 
         case TYPE_PES:
+        {
             p_sys->b_end_preparse = true;
 
             if( p_sys->es_creation == DELAY_ES ) /* No longer delay ES since that pid's program sends data */
@@ -1306,25 +1351,23 @@ static int Demux( demux_t *p_demux )
             if( !p_sys->b_access_control && !(p_pid->i_flags & FLAG_FILTERED) )
             {
                 /* That packet is for an unselected ES, don't waste time/memory gathering its data */
-                block_Release( p_pkt );
                 continue;
             }
 
             b_frame = GatherData( p_demux, p_pid, p_pkt );
             break;
+        }
 
         case TYPE_SDT:
         case TYPE_TDT:
         case TYPE_EIT:
             if( p_sys->b_dvb_meta )
-                dvbpsi_packet_push( p_pid->u.p_psi->handle, p_pkt->p_buffer );
-            block_Release( p_pkt );
+                dvbpsi_packet_push( p_pid->u.p_psi->handle, (uint8_t *)p_pkt );
             break;
 
         default:
             /* We have to handle PCR if present */
             PCRHandle( p_demux, p_pid, p_pkt );
-            block_Release( p_pkt );
             break;
         }
 
@@ -1484,6 +1527,8 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
         if( (i64 = stream_Size( p_sys->stream) ) > 0 )
         {
             int64_t offset = stream_Tell( p_sys->stream );
+            if( p_sys->p_ts_batch )
+                offset -= p_sys->p_ts_batch->i_buffer;
             *pf = (double)offset / (double)i64;
             return VLC_SUCCESS;
         }
@@ -2470,7 +2515,28 @@ static void ParseData( demux_t *p_demux, ts_pid_t *pid )
     pid->u.p_pes->p_data = NULL;
     pid->u.p_pes->i_data_size = 0;
     pid->u.p_pes->i_data_gathered = 0;
-    pid->u.p_pes->pp_last = &pid->u.p_pes->p_data;
+    pid->u.p_pes->i_data_alloc = 0;
+    pid->u.p_pes->i_data_prealloc =
+        __MIN( (3 * pid->u.p_pes->i_data_prealloc + p_data->i_buffer) / 4,
+               PES_PREALLOC_MAX );
+
+    /* Do not pass a large allocation slack on to the decoders. The unit is
+     * copied into a new block, which keeps the payload aligned */
+    const size_t i_slack = p_data->p_start + p_data->i_size
+                         - (p_data->p_buffer + p_data->i_buffer);
+    if( p_data->i_buffer > 0 && i_slack > PES_SLACK_MAX )
+    {
+        block_t *p_trim = block_Alloc( p_data->i_buffer );
+        if( likely(p_trim != NULL) )
+        {
+            block_CopyProperties( p_trim, p_data );
+            memcpy( p_trim->p_buffer, p_data->p_buffer, p_data->i_buffer );
+            p_trim->p_next = p_data->p_next;
+            p_data->p_next = NULL;
+            block_Release( p_data );
+            p_data = p_trim;
+        }
+    }
 
     if( pid->u.p_pes->data_type == TS_ES_DATA_PES )
     {
@@ -2493,7 +2559,7 @@ static block_t* ReadTSPacket( demux_t *p_demux )
     block_t     *p_pkt;
 
     /* Get a new TS packet */
-    if( !( p_pkt = stream_Block( p_sys->stream, p_sys->i_packet_size ) ) )
+    if( !( p_pkt = stream_ReadBlock( p_sys->stream, p_sys->i_packet_size ) ) )
     {
         if( stream_Tell( p_sys->stream ) == stream_Size( p_sys->stream ) )
             msg_Dbg( p_demux, "EOF at %"PRId64, stream_Tell( p_sys->stream ) );
@@ -2534,15 +2600,13 @@ static block_t* ReadTSPacket( demux_t *p_demux )
                 return NULL;
             }
 
-            while( i_skip < i_peek - p_sys->i_packet_size )
-            {
-                if( p_peek[i_skip + p_sys->i_packet_header_size] == 0x47 &&
-                        p_peek[i_skip + p_sys->i_packet_header_size + p_sys->i_packet_size] == 0x47 )
-                {
-                    break;
-                }
-                i_skip++;
-            }
+            const uint8_t *p_sync = FindSync( &p_peek[p_sys->i_packet_header_size],
+                                              i_peek - p_sys->i_packet_header_size,
+                                              p_sys->i_packet_size );
+            if( p_sync )
+                i_skip = p_sync - &p_peek[p_sys->i_packet_header_size];
+            else
+                i_skip = i_peek - p_sys->i_packet_size;
             msg_Dbg( p_demux, "skipping %d bytes of garbage", i_skip );
             stream_Read( p_sys->stream, NULL, i_skip );
 
@@ -2551,12 +2615,122 @@ static block_t* ReadTSPacket( demux_t *p_demux )
                 break;
             }
         }
-        if( !( p_pkt = stream_Block( p_sys->stream, p_sys->i_packet_size ) ) )
+        if( !( p_pkt = stream_ReadBlock( p_sys->stream, p_sys->i_packet_size ) ) )
+        {
+            msg_Dbg( p_demux, "eof ?" );
+            return NULL;
+        }
+    }
+    return p_pkt;
+}
+
+static void FlushTSBatch( demux_sys_t *p_sys )
+{
+    if( p_sys->p_ts_batch )
+    {
+        block_Release( p_sys->p_ts_batch );
+        p_sys->p_ts_batch = NULL;
+    }
+}
+
+/* Makes sure at least i_min bytes are buffered, keeping the bytes left over
+ * from the previous batch in front of the new ones. */
+static bool FillTSBatch( demux_t *p_demux, size_t i_min )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    block_t *p_batch = p_sys->p_ts_batch;
+    const size_t i_left = p_batch ? p_batch->i_buffer : 0;
+
+    if( i_left >= i_min )
+        return true;
+
+    size_t i_read = p_sys->i_packet_size * p_sys->i_ts_read;
+
+    /* Do not wait for a whole batch on live inputs, take what is there */
+    if( !p_sys->b_canseek )
+    {
+        uint64_t i_buffered;
+        if( stream_Control( p_sys->stream, STREAM_GET_BUFFERED, &i_buffered ) )
+            i_buffered = 0;
+        if( i_buffered < i_read )
+            i_read = i_buffered - i_buffered % p_sys->i_packet_size;
+    }
+    if( i_read < i_min - i_left )
+        i_read = i_min - i_left;
+
+    if( i_left == 0 )
+    {
+        FlushTSBatch( p_sys );
+        p_sys->p_ts_batch = stream_ReadBlock( p_sys->stream, i_read );
+    }
+    else
+    {
+        block_t *p_new = block_Alloc( i_left + i_read );
+        if( unlikely(p_new == NULL) )
+            return false;
+        memcpy( p_new->p_buffer, p_batch->p_buffer, i_left );
+        int i_ret = stream_Read( p_sys->stream, &p_new->p_buffer[i_left], i_read );
+        p_new->i_buffer = i_left + __MAX( i_ret, 0 );
+        block_Release( p_batch );
+        p_sys->p_ts_batch = p_new;
+    }
+
+    return p_sys->p_ts_batch && p_sys->p_ts_batch->i_buffer >= i_min;
+}
+
+/* Returns the next TS packet, starting at its sync byte, out of a batch read
+ * at once. The packet stays valid until the next call. */
+static const uint8_t *ReadTSPacketBatch( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const unsigned i_size = p_sys->i_packet_size;
+    const unsigned i_header = p_sys->i_packet_header_size;
+
+    if( !FillTSBatch( p_demux, i_size ) )
+    {
+        msg_Dbg( p_demux, "EOF at %"PRId64, stream_Tell( p_sys->stream ) );
+        return NULL;
+    }
+
+    block_t *p_batch = p_sys->p_ts_batch;
+
+    /* Check sync byte and re-sync if needed */
+    if( p_batch->p_buffer[i_header] != 0x47 )
+    {
+        msg_Warn( p_demux, "lost synchro" );
+        for( ;; )
+        {
+            if( !FillTSBatch( p_demux, i_header + i_size + 1 ) )
+            {
+                msg_Dbg( p_demux, "eof ?" );
+                return NULL;
+            }
+            p_batch = p_sys->p_ts_batch;
+
+            const uint8_t *p_sync = FindSync( &p_batch->p_buffer[i_header],
+                                              p_batch->i_buffer - i_header, i_size );
+            size_t i_skip = p_sync ? (size_t)(p_sync - &p_batch->p_buffer[i_header])
+                                   : p_batch->i_buffer - i_header - i_size;
+            msg_Dbg( p_demux, "skipping %zu bytes of garbage", i_skip );
+            p_batch->p_buffer += i_skip;
+            p_batch->i_buffer -= i_skip;
+
+            if( p_sync )
+                break;
+        }
+
+        if( !FillTSBatch( p_demux, i_size ) )
         {
             msg_Dbg( p_demux, "eof ?" );
             return NULL;
         }
+        p_batch = p_sys->p_ts_batch;
     }
+
+    /* Skip header (BluRay streams) */
+    const uint8_t *p_pkt = &p_batch->p_buffer[i_header];
+    p_batch->p_buffer += i_size;
+    p_batch->i_buffer -= i_size;
     return p_pkt;
 }
 
@@ -2569,10 +2743,8 @@ static int64_t TimeStampWrapAround( ts_pmt_t *p_pmt, int64_t i_time )
     return i_time + i_adjust;
 }
 
-static mtime_t GetPCR( block_t *p_pkt )
+static mtime_t GetPCR( const uint8_t *p )
 {
-    const uint8_t *p = p_pkt->p_buffer;
-
     mtime_t i_pcr = -1;
 
     if( ( p[3]&0x20 ) && /* adaptation */
@@ -2620,9 +2792,9 @@ static inline void FlushESBuffer( ts_pes_t *p_pes )
     if( p_pes->p_data )
     {
         p_pes->i_data_gathered = p_pes->i_data_size = 0;
-        block_ChainRelease( p_pes->p_data );
+        block_Release( p_pes->p_data );
         p_pes->p_data = NULL;
-        p_pes->pp_last = &p_pes->p_data;
+        p_pes->i_data_alloc = 0;
     }
 
     if( p_pes->sl.p_data )
@@ -2637,6 +2809,9 @@ static void ReadyQueuesPostSeek( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
+    /* Packets read ahead belong to the old position */
+    FlushTSBatch( p_sys );
+
     ts_pat_t *p_pat = GetPID(p_sys, 0)->u.p_pat;
     for( int i=0; i< p_pat->programs.i_size; i++ )
     {
@@ -2673,25 +2848,12 @@ static void ReadyQueuesPostSeek( demux_t *p_demux )
     }
 }
 
-static int SeekToTime( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
+/* Find the time position by using binary search algorithm. */
+static bool SeekBisect( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime,
+                        int64_t i_head_pos, int64_t i_tail_pos )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
-    /* Deal with common but worst binary search case */
-    if( p_pmt->pcr.i_first == i_scaledtime && p_sys->b_canseek )
-        return stream_Seek( p_sys->stream, 0 );
-
-    if( !p_sys->b_canfastseek )
-        return VLC_EGENERIC;
-
-    int64_t i_initial_pos = stream_Tell( p_sys->stream );
-
-    /* Find the time position by using binary search algorithm. */
-    int64_t i_head_pos = 0;
-    int64_t i_tail_pos = stream_Size( p_sys->stream ) - p_sys->i_packet_size;
-    if( i_head_pos >= i_tail_pos )
-        return VLC_EGENERIC;
-
     bool b_found = false;
     while( (i_head_pos + p_sys->i_packet_size) <= i_tail_pos && !b_found )
     {
@@ -2716,7 +2878,7 @@ static int SeekToTime( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
             else
                 i_pos = stream_Tell( p_sys->stream );
 
-            int i_pid = PIDGet( p_pkt );
+            int i_pid = PIDGet( p_pkt->p_buffer );
             if( i_pid != 0x1FFF && GetPID(p_sys, i_pid)->type == TYPE_PES &&
                 GetPID(p_sys, i_pid)->p_parent->u.p_pmt == p_pmt &&
                (p_pkt->p_buffer[1] & 0xC0) == 0x40 && /* Payload start but not corrupt */
@@ -2728,7 +2890,7 @@ static int SeekToTime( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
                 {
                     if( p_pkt->i_buffer >= 4 + 2 + 5 )
                     {
-                        i_pcr = GetPCR( p_pkt );
+                        i_pcr = GetPCR( p_pkt->p_buffer );
                         i_skip += 1 + p_pkt->p_buffer[4];
                     }
                 }
@@ -2765,6 +2927,51 @@ static int SeekToTime( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
             i_tail_pos = i_splitpos - p_sys->i_packet_size;
     }
 
+    return b_found;
+}
+
+static int SeekToTime( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    /* Deal with common but worst binary search case */
+    if( p_pmt->pcr.i_first == i_scaledtime && p_sys->b_canseek )
+        return stream_Seek( p_sys->stream, 0 );
+
+    if( !p_sys->b_canfastseek )
+        return VLC_EGENERIC;
+
+    int64_t i_initial_pos = stream_Tell( p_sys->stream );
+
+    int64_t i_head_pos = 0;
+    int64_t i_tail_pos = stream_Size( p_sys->stream ) - p_sys->i_packet_size;
+    if( i_head_pos >= i_tail_pos )
+        return VLC_EGENERIC;
+
+    bool b_found = false;
+
+    /* Start from the known PCR positions around the target */
+    ssize_t i_entry = p_pmt->p_seekindex ?
+                      SeekIndex_Find( p_pmt->p_seekindex, i_scaledtime ) : -1;
+    if( i_entry >= 0 )
+    {
+        size_t i_count;
+        const seekindex_entry_t *p_entries = SeekIndex_Get( p_pmt->p_seekindex, &i_count );
+
+        if( i_scaledtime - p_entries[i_entry].i_time < TO_SCALE(VLC_TS_0 + CLOCK_FREQ / 2) &&
+            stream_Seek( p_sys->stream, p_entries[i_entry].i_pos ) == VLC_SUCCESS )
+            return VLC_SUCCESS;
+
+        int64_t i_index_tail = (size_t)i_entry + 1 < i_count ?
+                               (int64_t)p_entries[i_entry + 1].i_pos : i_tail_pos;
+        b_found = SeekBisect( p_demux, p_pmt, i_scaledtime,
+                              p_entries[i_entry].i_pos,
+                              __MIN( i_index_tail, i_tail_pos ) );
+    }
+
+    if( !b_found )
+        b_found = SeekBisect( p_demux, p_pmt, i_scaledtime, i_head_pos, i_tail_pos );
+
     if( !b_found )
     {
         msg_Dbg( p_demux, "Seek():cannot find a time position." );
@@ -2783,21 +2990,12 @@ static ts_pid_t *GetPID( demux_sys_t *p_sys, uint16_t i_pid )
         case 0x1FFF:
             return &p_sys->pids.dummy;
         default:
-            if( p_sys->pids.i_last_pid == i_pid )
-                return p_sys->pids.p_last;
+            assert( i_pid < TS_PID_COUNT );
+            if( likely(p_sys->pids.index[i_pid] != NULL) )
+                return p_sys->pids.index[i_pid];
         break;
     }
 
-    for( int i=0; i < p_sys->pids.i_all; i++ )
-    {
-        if( p_sys->pids.pp_all[i]->i_pid == i_pid )
-        {
-            p_sys->pids.p_last = p_sys->pids.pp_all[i];
-            p_sys->pids.i_last_pid = i_pid;
-            return p_sys->pids.p_last;
-        }
-    }
-
     if( p_sys->pids.i_all >= p_sys->pids.i_all_alloc )
     {
         ts_pid_t **p_realloc = realloc( p_sys->pids.pp_all,
@@ -2817,9 +3015,7 @@ static ts_pid_t *GetPID( demux_sys_t *p_sys, uint16_t i_pid )
 
     p_pid->i_pid = i_pid;
     p_sys->pids.pp_all[p_sys->pids.i_all++] = p_pid;
-
-    p_sys->pids.p_last = p_pid;
-    p_sys->pids.i_last_pid = i_pid;
+    p_sys->pids.index[i_pid] = p_pid;
 
     return p_pid;
 }
@@ -2857,7 +3053,7 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
             break;
         }
 
-        const int i_pid = PIDGet( p_pkt );
+        const int i_pid = PIDGet( p_pkt->p_buffer );
         ts_pid_t *p_pid = GetPID(p_sys, i_pid);
 
         p_pid->i_flags |= FLAG_SEEN;
@@ -2868,7 +3064,7 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
             bool b_adaptfield = p_pkt->p_buffer[3] & 0x20;
 
             if( b_adaptfield && p_pkt->i_buffer >= 4 + 2 + 5 )
-                *pi_pcr = GetPCR( p_pkt );
+                *pi_pcr = GetPCR( p_pkt->p_buffer );
 
             if( *pi_pcr == -1 &&
                 (p_pkt->p_buffer[1] & 0xC0) == 0x40 && /* payload start */
@@ -3039,11 +3235,45 @@ static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_pmt, mtime_t i_pcr )
     }
 }
 
-static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
+/* One entry per second is enough to start bisecting close to the target */
+#define SEEKINDEX_INTERVAL TO_SCALE(VLC_TS_0 + CLOCK_FREQ)
+
+static void ProgramIndexPCR( demux_t *p_demux, ts_pmt_t *p_pmt, mtime_t i_pcr )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( p_pmt->p_seekindex == NULL || p_pmt->pcr.i_first == -1 )
+        return;
+
+    /* Position of the packet carrying the PCR */
+    int64_t i_pos = stream_Tell( p_sys->stream ) - p_sys->i_packet_size;
+    if( p_sys->p_ts_batch )
+        i_pos -= p_sys->p_ts_batch->i_buffer;
+    if( i_pos < 0 )
+        return;
+
+    size_t i_count;
+    const seekindex_entry_t *p_entries = SeekIndex_Get( p_pmt->p_seekindex, &i_count );
+    int64_t i_time = TimeStampWrapAround( p_pmt, i_pcr );
+
+    /* Only keep entries in both time and file order */
+    if( i_count > 0 &&
+        ( i_time < p_entries[i_count - 1].i_time + SEEKINDEX_INTERVAL ||
+          (uint64_t)i_pos <= p_entries[i_count - 1].i_pos ) )
+        return;
+
+    seekindex_entry_t entry = {
+        .i_time = i_time,
+        .i_pos  = i_pos,
+    };
+    SeekIndex_Append( p_pmt->p_seekindex, &entry );
+}
+
+static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p_pkt )
 {
     demux_sys_t   *p_sys = p_demux->p_sys;
 
-    mtime_t i_pcr = GetPCR( p_bk );
+    mtime_t i_pcr = GetPCR( p_pkt );
     if( i_pcr < 0 )
         return;
 
@@ -3068,6 +3298,7 @@ static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
             {
                 /* ? update PCR for the whole group program ? */
                 ProgramSetPCR( p_demux, p_pmt, i_program_pcr );
+                ProgramIndexPCR( p_demux, p_pmt, i_program_pcr );
             }
         }
         else /* set PCR provided by current pid to program(s) referencing it */
@@ -3077,6 +3308,7 @@ static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
             {
                 /* We've found a target group for update */
                 ProgramSetPCR( p_demux, p_pmt, i_program_pcr );
+                ProgramIndexPCR( p_demux, p_pmt, i_program_pcr );
             }
         }
 
@@ -3151,9 +3383,51 @@ static void PCRFixHandle( demux_t *p_demux, ts_pmt_t *p_pmt, block_t *p_block )
     }
 }
 
-static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
+/* Appends payload to the unit being gathered. The unit is allocated at once
+ * from its announced size, or the average size of the previous units of that
+ * PID, so that reassembly does not need a chain of blocks to be gathered. */
+static bool PESAppend( ts_pes_t *p_pes, const uint8_t *p_payload, size_t i_payload )
+{
+    block_t *p_data = p_pes->p_data;
+    const size_t i_gathered = p_data ? p_data->i_buffer : 0;
+
+    if( i_gathered + i_payload > p_pes->i_data_alloc )
+    {
+        size_t i_alloc = __MAX( p_pes->i_data_alloc * 2, i_gathered + i_payload );
+        if( p_data == NULL )
+        {
+            if( p_pes->i_data_size > 0 )
+                i_alloc = __MAX( i_alloc, (size_t)p_pes->i_data_size );
+            else
+                i_alloc = __MAX( i_alloc, p_pes->i_data_prealloc );
+            i_alloc = __MAX( i_alloc, PES_PREALLOC_MIN );
+            p_data = block_Alloc( i_alloc );
+        }
+        else
+            p_data = block_Realloc( p_data, 0, i_alloc );
+
+        if( unlikely(p_data == NULL) )
+        {
+            /* block_Realloc() released the partial unit */
+            p_pes->p_data = NULL;
+            p_pes->i_data_size = p_pes->i_data_gathered = 0;
+            p_pes->i_data_alloc = 0;
+            return false;
+        }
+        p_data->i_buffer = i_gathered;
+        p_pes->p_data = p_data;
+        p_pes->i_data_alloc = i_alloc;
+    }
+
+    memcpy( &p_data->p_buffer[i_gathered], p_payload, i_payload );
+    p_data->i_buffer += i_payload;
+    p_pes->i_data_gathered += i_payload;
+    return true;
+}
+
+static bool GatherData( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p )
 {
-    const uint8_t *p = p_bk->p_buffer;
+    uint8_t    decrypted[TS_PACKET_SIZE_188];
     const bool b_unit_start = p[1]&0x40;
     const bool b_adaptation = p[3]&0x20;
     const bool b_payload    = p[3]&0x10;
@@ -3170,10 +3444,6 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
              b_payload, i_cc );
 #endif
 
-    /* For now, ignore additional error correction
-     * TODO: handle Reed-Solomon 204,188 error correction */
-    p_bk->i_buffer = TS_PACKET_SIZE_188;
-
     if( p[1]&0x80 )
     {
         msg_Dbg( p_demux, "transport_error_indicator set (pid=%d)",
@@ -3184,9 +3454,12 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
 
     if( p_demux->p_sys->csa )
     {
+        /* The packet may be shared with the stream cache, decrypt a copy */
+        memcpy( decrypted, p, TS_PACKET_SIZE_188 );
         vlc_mutex_lock( &p_demux->p_sys->csa_lock );
-        csa_Decrypt( p_demux->p_sys->csa, p_bk->p_buffer, p_demux->p_sys->i_csa_pkt_size );
+        csa_Decrypt( p_demux->p_sys->csa, decrypted, p_demux->p_sys->i_csa_pkt_size );
         vlc_mutex_unlock( &p_demux->p_sys->csa_lock );
+        p = decrypted;
     }
 
     if( !b_adaptation )
@@ -3252,84 +3525,75 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
         }
     }
 
-    PCRHandle( p_demux, pid, p_bk );
+    PCRHandle( p_demux, pid, p );
 
-    if( i_skip >= 188 )
-    {
-        block_Release( p_bk );
+    /* For now, ignore additional error correction
+     * TODO: handle Reed-Solomon 204,188 error correction */
+    if( i_skip >= TS_PACKET_SIZE_188 )
         return i_ret;
-    }
 
     /* We have to gather it */
-    p_bk->p_buffer += i_skip;
-    p_bk->i_buffer -= i_skip;
+    ts_pes_t *p_pes = pid->u.p_pes;
+    const uint8_t *p_payload = &p[i_skip];
+    size_t i_payload = TS_PACKET_SIZE_188 - i_skip;
 
     if( b_unit_start )
     {
-        if( pid->u.p_pes->data_type == TS_ES_DATA_TABLE_SECTION && p_bk->i_buffer > 0 )
+        if( p_pes->data_type == TS_ES_DATA_TABLE_SECTION && i_payload > 0 )
         {
-            int i_pointer_field = __MIN( p_bk->p_buffer[0], p_bk->i_buffer - 1 );
-            block_t *p = block_Duplicate( p_bk );
-            if( p )
-            {
-                p->i_buffer = i_pointer_field;
-                p->p_buffer++;
-                block_ChainLastAppend( &pid->u.p_pes->pp_last, p );
-            }
-            p_bk->i_buffer -= 1 + i_pointer_field;
-            p_bk->p_buffer += 1 + i_pointer_field;
-        }
-        if( pid->u.p_pes->p_data )
+            /* The pointer field tells where the previous section ends */
+            size_t i_pointer_field = __MIN( p_payload[0], i_payload - 1 );
+            if( p_pes->p_data )
+                PESAppend( p_pes, &p_payload[1], i_pointer_field );
+            p_payload += 1 + i_pointer_field;
+            i_payload -= 1 + i_pointer_field;
+        }
+        if( p_pes->p_data )
         {
             ParseData( p_demux, pid );
             i_ret = true;
         }
 
-        block_ChainLastAppend( &pid->u.p_pes->pp_last, p_bk );
-        if( pid->u.p_pes->data_type == TS_ES_DATA_PES )
+        if( p_pes->data_type == TS_ES_DATA_PES )
         {
-            if( p_bk->i_buffer > 6 )
+            if( i_payload > 6 )
             {
-                pid->u.p_pes->i_data_size = GetWBE( &p_bk->p_buffer[4] );
-                if( pid->u.p_pes->i_data_size > 0 )
+                p_pes->i_data_size = GetWBE( &p_payload[4] );
+                if( p_pes->i_data_size > 0 )
                 {
-                    pid->u.p_pes->i_data_size += 6;
+                    p_pes->i_data_size += 6;
                 }
             }
         }
-        else if( pid->u.p_pes->data_type == TS_ES_DATA_TABLE_SECTION )
+        else if( p_pes->data_type == TS_ES_DATA_TABLE_SECTION )
         {
-            if( p_bk->i_buffer > 3 && p_bk->p_buffer[0] != 0xff )
+            if( i_payload > 3 && p_payload[0] != 0xff )
             {
-                pid->u.p_pes->i_data_size = 3 + (((p_bk->p_buffer[1] & 0xf) << 8) | p_bk->p_buffer[2]);
+                p_pes->i_data_size = 3 + (((p_payload[1] & 0xf) << 8) | p_payload[2]);
             }
         }
-        pid->u.p_pes->i_data_gathered += p_bk->i_buffer;
-        if( pid->u.p_pes->i_data_size > 0 &&
-            pid->u.p_pes->i_data_gathered >= pid->u.p_pes->i_data_size )
+
+        if( PESAppend( p_pes, p_payload, i_payload ) &&
+            p_pes->i_data_size > 0 &&
+            p_pes->i_data_gathered >= p_pes->i_data_size )
         {
             ParseData( p_demux, pid );
             i_ret = true;
         }
     }
+    else if( p_pes->p_data == NULL )
+    {
+        /* msg_Dbg( p_demux, "broken packet" ); */
+    }
     else
     {
-        if( pid->u.p_pes->p_data == NULL )
-        {
-            /* msg_Dbg( p_demux, "broken packet" ); */
-            block_Release( p_bk );
-        }
-        else
-        {
-            block_ChainLastAppend( &pid->u.p_pes->pp_last, p_bk );
-            pid->u.p_pes->i_data_gathered += p_bk->i_buffer;
+        PESAppend( p_pes, p_payload, i_payload );
 
-            if( pid->u.p_pes->i_data_size > 0 &&
-                pid->u.p_pes->i_data_gathered >= pid->u.p_pes->i_data_size )
-            {
-                ParseData( p_demux, pid );
-                i_ret = true;
-            }
+        if( p_pes->i_data_size > 0 &&
+            p_pes->i_data_gathered >= p_pes->i_data_size )
+        {
+            ParseData( p_demux, pid );
+            i_ret = true;
         }
     }
 
@@ -5414,6 +5678,9 @@ static void PMTCallBack( void *data, dvbpsi_pmt_t *p_dvbpsipmt )
         p_pmt->i_last_dts = 0;
         ProbeStart( p_demux, p_pmt->i_number );
         ProbeEnd( p_demux, p_pmt->i_number );
+
+        if( var_InheritBool( p_demux, "ts-seekindex" ) )
+            p_pmt->p_seekindex = SeekIndex_New( p_demux, "ts", p_pmt->i_number );
     }
 }
 
@@ -5593,6 +5860,7 @@ static ts_pmt_t *ts_pmt_New( demux_t *p_demux )
     ARRAY_INIT( pmt->od.objects );
 
     pmt->i_last_dts = -1;
+    pmt->p_seekindex = NULL;
 
     pmt->pcr.i_current = -1;
     pmt->pcr.i_first  = -1;
@@ -5615,6 +5883,8 @@ static void ts_pmt_Del( demux_t *p_demux, ts_pmt_t *pmt )
     ARRAY_RESET( pmt->e_streams );
     if( pmt->iod )
         ODFree( pmt->iod );
+    if( pmt->p_seekindex )
+        SeekIndex_Delete( pmt->p_seekindex );
     for( int i=0; i<pmt->od.objects.i_size; i++ )
         ODFree( pmt->od.objects.p_elems[i] );
     ARRAY_RESET( pmt->od.objects );
@@ -5639,7 +5909,8 @@ static ts_pes_t *ts_pes_New( demux_t *p_demux )
     pes->i_data_size = 0;
     pes->i_data_gathered = 0;
     pes->p_data = NULL;
-    pes->pp_last = &pes->p_data;
+    pes->i_data_alloc = 0;
+    pes->i_data_prealloc = 0;
     pes->p_prepcr_outqueue = NULL;
     pes->sl.p_data = NULL;
     pes->sl.pp_last = &pes->sl.p_data;
@@ -5658,7 +5929,7 @@ static void ts_pes_Del( demux_t *p_demux, ts_pes_t *pes )
     }
 
     if( pes->p_data )
-        block_ChainRelease( pes->p_data );
+        block_Release( pes->p_data );
 
     if( pes->p_prepcr_outqueue )
         block_ChainRelease( pes->p_prepcr_outqueue );
@@ -0,0 +1,440 @@
+/*****************************************************************************
+ * seekindex.c: seek index cache shared by the demuxers
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_block.h>
+#include <vlc_configuration.h>
+#include <vlc_fs.h>
+
+#include "seekindex.h"
+
+/*
+ * The file is a header followed by the entries, both in host byte order so
+ * that the mapped entries are used in place.
+ */
+#define SEEKINDEX_MAGIC   "VLCSIDX1"
+#define SEEKINDEX_ENDIAN  0x01020304
+#define SEEKINDEX_DIR     "seekindex"
+#define SEEKINDEX_SUFFIX  ".idx"
+
+/* Indexes kept in the directory, the least recently written are removed */
+#define SEEKINDEX_MAX_FILES 512
+
+#define SEEKINDEX_FLAG_COMPLETE 0x1
+
+typedef struct
+{
+    char     magic[8];
+    uint32_t i_endian;
+    uint32_t i_entry_size;
+    uint64_t i_key;
+    uint64_t i_file_size;
+    int64_t  i_file_mtime;
+    uint64_t i_count;
+    uint32_t i_flags;
+    uint32_t i_reserved;
+    uint64_t i_reserved2;
+} seekindex_header_t;
+
+struct seekindex_t
+{
+    vlc_object_t *p_obj;
+    char         *psz_path;
+
+    uint64_t i_key;
+    uint64_t i_file_size;
+    int64_t  i_file_mtime;
+    uint32_t i_flags;
+
+    /* Entries either point into the mapped file, or to p_alloc once
+     * entries are appended */
+    block_t                 *p_file;
+    const seekindex_entry_t *p_entries;
+    seekindex_entry_t       *p_alloc;
+    size_t                   i_count;
+    size_t                   i_max;
+
+    bool b_dirty;
+};
+
+static uint64_t Hash( uint64_t h, const void *p_data, size_t i_data )
+{
+    const uint8_t *p = p_data;
+
+    /* FNV-1a */
+    for( size_t i = 0; i < i_data; i++ )
+    {
+        h ^= p[i];
+        h *= UINT64_C(0x100000001b3);
+    }
+    return h;
+}
+
+static void Load( seekindex_t *p_idx )
+{
+    int fd = vlc_open( p_idx->psz_path, O_RDONLY );
+    if( fd == -1 )
+        return;
+
+    block_t *p_file = block_File( fd );
+    close( fd );
+    if( p_file == NULL )
+        return;
+
+    seekindex_header_t hdr;
+    if( p_file->i_buffer < sizeof(hdr) )
+        goto error;
+    memcpy( &hdr, p_file->p_buffer, sizeof(hdr) );
+
+    if( memcmp( hdr.magic, SEEKINDEX_MAGIC, sizeof(hdr.magic) ) ||
+        hdr.i_endian != SEEKINDEX_ENDIAN ||
+        hdr.i_entry_size != sizeof(seekindex_entry_t) ||
+        hdr.i_key != p_idx->i_key )
+        goto error;
+
+    if( hdr.i_file_size != p_idx->i_file_size ||
+        hdr.i_file_mtime != p_idx->i_file_mtime )
+    {
+        msg_Dbg( p_idx->p_obj, "discarding the seek index of a modified file" );
+        goto error;
+    }
+
+    if( hdr.i_count > (p_file->i_buffer - sizeof(hdr)) / sizeof(seekindex_entry_t) )
+        goto error;
+
+    p_idx->p_file = p_file;
+    p_idx->p_entries = (const seekindex_entry_t *)&p_file->p_buffer[sizeof(hdr)];
+    p_idx->i_count = hdr.i_count;
+    p_idx->i_flags = hdr.i_flags;
+    msg_Dbg( p_idx->p_obj, "loaded %zu seek index entries from %s",
+             p_idx->i_count, p_idx->psz_path );
+    return;
+
+error:
+    block_Release( p_file );
+}
+
+static int SelectIndex( const char *psz_name )
+{
+    size_t i_len = strlen( psz_name );
+    size_t i_suffix = strlen( SEEKINDEX_SUFFIX );
+
+    return i_len > i_suffix &&
+           !strcmp( &psz_name[i_len - i_suffix], SEEKINDEX_SUFFIX );
+}
+
+typedef struct
+{
+    char   *psz_path;
+    time_t  i_mtime;
+} seekindex_file_t;
+
+static int CompareFiles( const void *a, const void *b )
+{
+    const seekindex_file_t *p_a = a, *p_b = b;
+
+    return (p_a->i_mtime > p_b->i_mtime) - (p_a->i_mtime < p_b->i_mtime);
+}
+
+/* Keeps at most SEEKINDEX_MAX_FILES indexes in the directory */
+static void Prune( seekindex_t *p_idx, const char *psz_dir )
+{
+    char **ppsz_names;
+    int i_names = vlc_scandir( psz_dir, &ppsz_names, SelectIndex, NULL );
+    if( i_names <= 0 )
+        return;
+
+    seekindex_file_t *p_files = NULL;
+    int i_files = 0;
+
+    if( i_names > SEEKINDEX_MAX_FILES )
+        p_files = malloc( i_names * sizeof(*p_files) );
+
+    for( int i = 0; i < i_names; i++ )
+    {
+        struct stat st;
+        char *psz_path;
+
+        if( p_files != NULL &&
+            asprintf( &psz_path, "%s"DIR_SEP"%s", psz_dir,
+                      ppsz_names[i] ) != -1 )
+        {
+            if( !vlc_stat( psz_path, &st ) )
+            {
+                p_files[i_files].psz_path = psz_path;
+                p_files[i_files].i_mtime = st.st_mtime;
+                i_files++;
+            }
+            else
+                free( psz_path );
+        }
+        free( ppsz_names[i] );
+    }
+    free( ppsz_names );
+
+    if( p_files == NULL )
+        return;
+
+    qsort( p_files, i_files, sizeof(*p_files), CompareFiles );
+    for( int i = 0; i < i_files; i++ )
+    {
+        if( i < i_files - SEEKINDEX_MAX_FILES )
+        {
+            msg_Dbg( p_idx->p_obj, "removing the old seek index %s",
+                     p_files[i].psz_path );
+            vlc_unlink( p_files[i].psz_path );
+        }
+        free( p_files[i].psz_path );
+    }
+    free( p_files );
+}
+
+/* Creates the directory along with the missing parent ones, as
+ * config_CreateDir() does */
+static int CreateDir( vlc_object_t *p_obj, const char *psz_dir )
+{
+    if( vlc_mkdir( psz_dir, 0700 ) == 0 || errno == EEXIST )
+        return 0;
+
+    if( errno == ENOENT )
+    {
+        char psz_parent[strlen( psz_dir ) + 1], *psz_end;
+        strcpy( psz_parent, psz_dir );
+
+        psz_end = strrchr( psz_parent, DIR_SEP_CHAR );
+        if( psz_end && psz_end != psz_parent )
+        {
+            *psz_end = '\0';
+            if( CreateDir( p_obj, psz_parent ) == 0 &&
+                vlc_mkdir( psz_dir, 0700 ) == 0 )
+                return 0;
+        }
+    }
+
+    msg_Dbg( p_obj, "cannot create %s: %s", psz_dir, vlc_strerror_c(errno) );
+    return -1;
+}
+
+static void Save( seekindex_t *p_idx )
+{
+    char *psz_tmp;
+
+    char *psz_dir = strdup( p_idx->psz_path );
+    if( psz_dir == NULL )
+        return;
+    *strrchr( psz_dir, DIR_SEP_CHAR ) = '\0';
+    if( CreateDir( p_idx->p_obj, psz_dir ) ||
+        asprintf( &psz_tmp, "%s.%"PRIu32, p_idx->psz_path,
+                  (uint32_t)getpid() ) == -1 )
+    {
+        free( psz_dir );
+        return;
+    }
+
+    FILE *file = vlc_fopen( psz_tmp, "wb" );
+    if( file == NULL )
+    {
+        msg_Warn( p_idx->p_obj, "cannot create %s: %s", psz_tmp,
+                  vlc_strerror_c(errno) );
+        free( psz_tmp );
+        free( psz_dir );
+        return;
+    }
+
+    seekindex_header_t hdr;
+    memset( &hdr, 0, sizeof(hdr) );
+    memcpy( hdr.magic, SEEKINDEX_MAGIC, sizeof(hdr.magic) );
+    hdr.i_endian = SEEKINDEX_ENDIAN;
+    hdr.i_entry_size = sizeof(seekindex_entry_t);
+    hdr.i_key = p_idx->i_key;
+    hdr.i_file_size = p_idx->i_file_size;
+    hdr.i_file_mtime = p_idx->i_file_mtime;
+    hdr.i_count = p_idx->i_count;
+    hdr.i_flags = p_idx->i_flags;
+
+    if( fwrite( &hdr, sizeof(hdr), 1, file ) != 1 ||
+        fwrite( p_idx->p_entries, sizeof(seekindex_entry_t), p_idx->i_count,
+                file ) != p_idx->i_count ||
+        fflush( file ) )
+    {
+        msg_Warn( p_idx->p_obj, "cannot write %s: %s", psz_tmp,
+                  vlc_strerror_c(errno) );
+        fclose( file );
+        vlc_unlink( psz_tmp );
+        free( psz_tmp );
+        free( psz_dir );
+        return;
+    }
+
+#if !defined( _WIN32 ) && !defined( __OS2__ )
+    vlc_rename( psz_tmp, p_idx->psz_path ); /* atomically replace old index */
+    fclose( file );
+#else
+    vlc_unlink( p_idx->psz_path );
+    fclose( file );
+    vlc_rename( psz_tmp, p_idx->psz_path );
+#endif
+    msg_Dbg( p_idx->p_obj, "saved %zu seek index entries to %s",
+             p_idx->i_count, p_idx->psz_path );
+    free( psz_tmp );
+
+    Prune( p_idx, psz_dir );
+    free( psz_dir );
+}
+
+seekindex_t *SeekIndex_New( demux_t *p_demux, const char *psz_demux,
+                            uint64_t i_stream )
+{
+    struct stat st;
+
+    if( p_demux->psz_file == NULL ||
+        ( p_demux->psz_access[0] && strcmp( p_demux->psz_access, "file" ) ) ||
+        vlc_stat( p_demux->psz_file, &st ) || !S_ISREG( st.st_mode ) ||
+        (uint64_t)st.st_size != (uint64_t)stream_Size( p_demux->s ) )
+        return NULL;
+
+    seekindex_t *p_idx = calloc( 1, sizeof(*p_idx) );
+    if( unlikely(p_idx == NULL) )
+        return NULL;
+
+    uint64_t h = UINT64_C(0xcbf29ce484222325);
+    h = Hash( h, p_demux->psz_file, strlen( p_demux->psz_file ) + 1 );
+    h = Hash( h, psz_demux, strlen( psz_demux ) + 1 );
+    h = Hash( h, &i_stream, sizeof(i_stream) );
+
+    char *psz_dir = config_GetUserDir( VLC_CACHE_DIR );
+    if( psz_dir == NULL ||
+        asprintf( &p_idx->psz_path, "%s"DIR_SEP SEEKINDEX_DIR DIR_SEP
+                  "%016"PRIx64 SEEKINDEX_SUFFIX, psz_dir, h ) == -1 )
+    {
+        free( psz_dir );
+        free( p_idx );
+        return NULL;
+    }
+    free( psz_dir );
+
+    p_idx->p_obj = VLC_OBJECT(p_demux);
+    p_idx->i_key = h;
+    p_idx->i_file_size = st.st_size;
+    p_idx->i_file_mtime = st.st_mtime;
+
+    Load( p_idx );
+    return p_idx;
+}
+
+void SeekIndex_Delete( seekindex_t *p_idx )
+{
+    if( p_idx->b_dirty && p_idx->i_count > 0 )
+        Save( p_idx );
+
+    if( p_idx->p_file )
+        block_Release( p_idx->p_file );
+    free( p_idx->p_alloc );
+    free( p_idx->psz_path );
+    free( p_idx );
+}
+
+const seekindex_entry_t *SeekIndex_Get( const seekindex_t *p_idx,
+                                        size_t *pi_count )
+{
+    *pi_count = p_idx->i_count;
+    return p_idx->p_entries;
+}
+
+bool SeekIndex_IsComplete( const seekindex_t *p_idx )
+{
+    return p_idx->i_flags & SEEKINDEX_FLAG_COMPLETE;
+}
+
+void SeekIndex_SetComplete( seekindex_t *p_idx )
+{
+    if( !(p_idx->i_flags & SEEKINDEX_FLAG_COMPLETE) )
+    {
+        p_idx->i_flags |= SEEKINDEX_FLAG_COMPLETE;
+        p_idx->b_dirty = true;
+    }
+}
+
+int SeekIndex_Append( seekindex_t *p_idx, const seekindex_entry_t *p_entry )
+{
+    if( p_idx->p_alloc == NULL || p_idx->i_count >= p_idx->i_max )
+    {
+        size_t i_max = __MAX( 2 * p_idx->i_count, 1024 );
+        seekindex_entry_t *p_alloc = realloc( p_idx->p_alloc,
+                                              i_max * sizeof(*p_alloc) );
+        if( unlikely(p_alloc == NULL) )
+            return VLC_ENOMEM;
+
+        /* Leave the mapped entries */
+        if( p_idx->p_alloc == NULL && p_idx->i_count > 0 )
+            memcpy( p_alloc, p_idx->p_entries,
+                    p_idx->i_count * sizeof(*p_alloc) );
+        if( p_idx->p_file )
+        {
+            block_Release( p_idx->p_file );
+            p_idx->p_file = NULL;
+        }
+        p_idx->p_alloc = p_alloc;
+        p_idx->p_entries = p_alloc;
+        p_idx->i_max = i_max;
+    }
+
+    p_idx->p_alloc[p_idx->i_count++] = *p_entry;
+    p_idx->b_dirty = true;
+    return VLC_SUCCESS;
+}
+
+void SeekIndex_Clear( seekindex_t *p_idx )
+{
+    if( p_idx->p_file )
+    {
+        block_Release( p_idx->p_file );
+        p_idx->p_file = NULL;
+        p_idx->p_entries = NULL;
+    }
+    p_idx->i_count = 0;
+    p_idx->i_flags = 0;
+    p_idx->b_dirty = true;
+}
+
+ssize_t SeekIndex_Find( const seekindex_t *p_idx, int64_t i_time )
+{
+    size_t i_low = 0, i_high = p_idx->i_count;
+
+    while( i_low < i_high )
+    {
+        size_t i_mid = i_low + (i_high - i_low) / 2;
+        if( p_idx->p_entries[i_mid].i_time <= i_time )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    return (ssize_t)i_low - 1;
+}
@@ -0,0 +1,76 @@
+/*****************************************************************************
+ * seekindex.h: seek index cache shared by the demuxers
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_DEMUX_SEEKINDEX_H_
+#define VLC_DEMUX_SEEKINDEX_H_
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
+/*
+ * The index a demuxer builds by scanning a local file, or while playing it,
+ * is kept in the user cache directory. It is identified by the file path,
+ * the demuxer and a demuxer defined stream number, and is only loaded back
+ * while the file keeps the same size and modification time. Only the most
+ * recently written indexes are kept (a few hundreds), older ones are removed
+ * when a new one is saved.
+ */
+
+#define SEEKINDEX_TEXT N_("Cache the seek index")
+#define SEEKINDEX_LONGTEXT N_( \
+    "Keep the index built while scanning or playing a local file, so that " \
+    "it can be seeked accurately right away when it is opened again." )
+
+typedef struct
+{
+    int64_t  i_time;    /* in the demuxer timescale */
+    uint64_t i_pos;     /* byte offset in the file */
+    uint32_t i_track;
+    uint32_t i_size;
+    uint32_t i_flags;
+    uint32_t i_id;
+} seekindex_entry_t;
+
+typedef struct seekindex_t seekindex_t;
+
+/* Returns NULL when the input is not a local file */
+seekindex_t *SeekIndex_New( demux_t *, const char *psz_demux,
+                            uint64_t i_stream );
+/* Saves the index if entries were appended, and releases it */
+void SeekIndex_Delete( seekindex_t * );
+
+const seekindex_entry_t *SeekIndex_Get( const seekindex_t *, size_t *pi_count );
+/* Whether the entries cover the whole file */
+bool SeekIndex_IsComplete( const seekindex_t * );
+void SeekIndex_SetComplete( seekindex_t * );
+
+int SeekIndex_Append( seekindex_t *, const seekindex_entry_t * );
+/* Drops all the entries, to build the index again */
+void SeekIndex_Clear( seekindex_t * );
+
+/* For indexes appended in time order: the last entry not after i_time,
+ * or -1 */
+ssize_t SeekIndex_Find( const seekindex_t *, int64_t i_time );
+
+# ifdef __cplusplus
+}
+# endif
+
+#endif
@@ -103,6 +103,7 @@ static vlc_log_cb Open(vlc_object_t *obj, void **sysp)
 
     verbosity += VLC_MSG_ERR;
     *sysp = (void *)(uintptr_t)verbosity;
+    var_SetInteger(obj, "log-verbosity", verbosity);
 
 #if defined (HAVE_ISATTY) && !defined (_WIN32)
     if (isatty(STDERR_FILENO) && var_InheritBool(obj, "color"))
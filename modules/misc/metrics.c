@@ -0,0 +1,510 @@
+/*****************************************************************************
+ * metrics.c : export of the input statistics for monitoring systems
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * The statistics of the current input are written in the Prometheus text
+ * exposition format, either periodically to a local file, or on request
+ * through the HTTP server (see --http-host and --http-port), e.g.
+ *  $ vlc --extraintf=metrics --metrics-url=/metrics
+ */
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <unistd.h>
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_interface.h>
+#include <vlc_input.h>
+#include <vlc_playlist.h>
+#include <vlc_httpd.h>
+#include <vlc_fs.h>
+
+/*****************************************************************************
+ * Local prototypes
+ *****************************************************************************/
+static int  Open    ( vlc_object_t * );
+static void Close   ( vlc_object_t * );
+
+#define FILE_TEXT N_("Metrics file")
+#define FILE_LONGTEXT N_( \
+    "Write the statistics of the current input periodically to this file." )
+#define PERIOD_TEXT N_("Metrics file period")
+#define PERIOD_LONGTEXT N_( \
+    "Delay in seconds between two writes of the metrics file." )
+#define URL_TEXT N_("Metrics URL")
+#define URL_LONGTEXT N_( \
+    "Serve the statistics of the current input at this path of the HTTP " \
+    "server, e.g. /metrics." )
+
+/*****************************************************************************
+ * Module descriptor
+ *****************************************************************************/
+vlc_module_begin ()
+    set_shortname( N_("Metrics") )
+    set_description( N_("Statistics export for monitoring") )
+
+    set_category( CAT_ADVANCED )
+    set_subcategory( SUBCAT_ADVANCED_MISC )
+
+    add_savefile( "metrics-file", NULL, FILE_TEXT, FILE_LONGTEXT, false )
+    add_integer_with_range( "metrics-period", 10, 1, 3600,
+                            PERIOD_TEXT, PERIOD_LONGTEXT, true )
+    add_string( "metrics-url", NULL, URL_TEXT, URL_LONGTEXT, false )
+
+    set_capability( "interface", 0 )
+    set_callbacks( Open, Close )
+vlc_module_end ()
+
+struct intf_sys_t
+{
+    /* File */
+    char         *psz_file;
+    vlc_timer_t   timer;
+
+    /* HTTP */
+    httpd_host_t *p_host;
+    httpd_file_t *p_url;
+};
+
+/*****************************************************************************
+ * Formatting
+ *****************************************************************************/
+enum
+{
+    METRIC_COUNTER, /* int64_t total */
+    METRIC_RATE,    /* float, in bytes per microsecond */
+    METRIC_LATENCY, /* input_latency_stats_t */
+};
+
+static const struct
+{
+    const char *psz_name;
+    const char *psz_help;
+    int         i_type;
+    size_t      i_offset;
+} p_metrics[] =
+{
+#define M(name, help, type, field) \
+    { "vlc_" name, help, METRIC_##type, offsetof(input_stats_t, field) }
+    M( "read_packets_total", "Packets read from the access",
+       COUNTER, i_read_packets ),
+    M( "read_bytes_total", "Bytes read from the access",
+       COUNTER, i_read_bytes ),
+    M( "input_bytes_per_second", "Access bitrate",
+       RATE, f_input_bitrate ),
+    M( "demux_read_bytes_total", "Bytes output by the demuxer",
+       COUNTER, i_demux_read_bytes ),
+    M( "demux_bytes_per_second", "Demuxer output bitrate",
+       RATE, f_demux_bitrate ),
+    M( "demux_corrupted_total", "Corrupted blocks output by the demuxer",
+       COUNTER, i_demux_corrupted ),
+    M( "demux_discontinuity_total", "Discontinuities output by the demuxer",
+       COUNTER, i_demux_discontinuity ),
+    M( "decoded_video_total", "Decoded video blocks",
+       COUNTER, i_decoded_video ),
+    M( "decoded_audio_total", "Decoded audio blocks",
+       COUNTER, i_decoded_audio ),
+    M( "displayed_pictures_total", "Displayed pictures",
+       COUNTER, i_displayed_pictures ),
+    M( "lost_pictures_total", "Pictures lost before display",
+       COUNTER, i_lost_pictures ),
+    M( "played_abuffers_total", "Played audio buffers",
+       COUNTER, i_played_abuffers ),
+    M( "lost_abuffers_total", "Audio buffers lost before playback",
+       COUNTER, i_lost_abuffers ),
+    M( "sout_sent_packets_total", "Packets sent by the stream output",
+       COUNTER, i_sent_packets ),
+    M( "sout_sent_bytes_total", "Bytes sent by the stream output",
+       COUNTER, i_sent_bytes ),
+    M( "sout_late_packets_total", "Packets sent late by the stream output",
+       COUNTER, i_late_packets ),
+    M( "sout_bytes_per_second", "Stream output bitrate",
+       RATE, f_send_bitrate ),
+    M( "demux_decode_latency_seconds",
+       "Delay from the demuxer output to the decoding",
+       LATENCY, demux_decode ),
+    M( "decode_display_latency_seconds",
+       "Delay from the decoded picture to its display date",
+       LATENCY, decode_display ),
+    M( "aout_delay_seconds",
+       "Delay from the decoded audio to its playback date",
+       LATENCY, aout_delay ),
+#undef M
+};
+
+/* Copies the statistics of the metrics, but not the lock */
+static void CopyStats( input_stats_t *p_dst, const input_stats_t *p_src )
+{
+    for( size_t i = 0; i < ARRAY_SIZE(p_metrics); i++ )
+    {
+        size_t i_offset = p_metrics[i].i_offset;
+        size_t i_size = 0;
+
+        switch( p_metrics[i].i_type )
+        {
+            case METRIC_COUNTER:
+                i_size = sizeof(int64_t);
+                break;
+            case METRIC_RATE:
+                i_size = sizeof(float);
+                break;
+            case METRIC_LATENCY:
+                i_size = sizeof(input_latency_stats_t);
+                break;
+        }
+        memcpy( (char *)p_dst + i_offset, (const char *)p_src + i_offset,
+                i_size );
+    }
+}
+
+/* Growing text buffer */
+typedef struct
+{
+    char  *psz;
+    size_t i_len;
+    size_t i_size;
+    bool   b_error;
+} metrics_text_t;
+
+VLC_FORMAT(2, 3)
+static void Print( metrics_text_t *p_text, const char *psz_format, ... )
+{
+    va_list ap;
+
+    if( p_text->b_error )
+        return;
+
+    for( ;; )
+    {
+        size_t i_avail = p_text->i_size - p_text->i_len;
+
+        va_start( ap, psz_format );
+        int i_ret = vsnprintf( p_text->psz + p_text->i_len, i_avail,
+                               psz_format, ap );
+        va_end( ap );
+        if( i_ret < 0 )
+            break;
+        if( (size_t)i_ret < i_avail )
+        {
+            p_text->i_len += i_ret;
+            return;
+        }
+
+        size_t i_size = __MAX( 2 * p_text->i_size,
+                               p_text->i_len + i_ret + 1 );
+        char *psz = realloc( p_text->psz, i_size );
+        if( unlikely(psz == NULL) )
+            break;
+        p_text->psz = psz;
+        p_text->i_size = i_size;
+    }
+    p_text->b_error = true;
+}
+
+/* Label value with the characters escaped as the format requires */
+static char *EscapeLabel( const char *psz_value )
+{
+    char *psz_escaped = malloc( 2 * strlen( psz_value ) + 1 );
+    if( unlikely(psz_escaped == NULL) )
+        return NULL;
+
+    char *d = psz_escaped;
+    for( const char *p = psz_value; *p; p++ )
+    {
+        if( *p == '\\' || *p == '"' || *p == '\n' )
+            *d++ = '\\';
+        *d++ = *p == '\n' ? 'n' : *p;
+    }
+    *d = '\0';
+    return psz_escaped;
+}
+
+/* Microseconds as seconds, independently of the locale */
+static void PrintSeconds( metrics_text_t *out, uint64_t i_us )
+{
+    Print( out, "%"PRIu64".%06u", i_us / CLOCK_FREQ,
+           (unsigned)(i_us % CLOCK_FREQ) );
+}
+
+static void PrintLatency( metrics_text_t *out, const char *psz_name,
+                          const char *psz_labels,
+                          const input_latency_stats_t *p_latency )
+{
+    uint64_t i_count = 0;
+
+    for( unsigned i = 0; i < INPUT_STATS_LATENCY_BUCKETS; i++ )
+    {
+        i_count += p_latency->pi_buckets[i];
+        Print( out, "%s_bucket{%s,le=\"", psz_name, psz_labels );
+        if( i < INPUT_STATS_LATENCY_BUCKETS - 1 )
+            PrintSeconds( out, (UINT64_C(1000) << i) );
+        else
+            Print( out, "+Inf" );
+        Print( out, "\"} %"PRIu64"\n", i_count );
+    }
+    Print( out, "%s_sum{%s} ", psz_name, psz_labels );
+    PrintSeconds( out, p_latency->i_sum );
+    Print( out, "\n%s_count{%s} %"PRIu64"\n", psz_name, psz_labels,
+           i_count );
+}
+
+static char *Format( intf_thread_t *p_intf, size_t *pi_len )
+{
+    metrics_text_t text = { .psz = malloc( 4096 ), .i_size = 4096 };
+    if( text.psz == NULL )
+        return NULL;
+
+    input_thread_t *p_input = playlist_CurrentInput( pl_Get(p_intf) );
+    if( p_input != NULL )
+    {
+        input_item_t *p_item = input_GetItem( p_input );
+        input_stats_t stats;
+        bool b_stats = false;
+
+        vlc_mutex_lock( &p_item->lock );
+        if( p_item->p_stats != NULL )
+        {
+            vlc_mutex_lock( &p_item->p_stats->lock );
+            CopyStats( &stats, p_item->p_stats );
+            vlc_mutex_unlock( &p_item->p_stats->lock );
+            b_stats = true;
+        }
+        vlc_mutex_unlock( &p_item->lock );
+
+        char *psz_uri = input_item_GetURI( p_item );
+        char *psz_label = psz_uri ? EscapeLabel( psz_uri ) : NULL;
+        char *psz_labels;
+        if( psz_label == NULL ||
+            asprintf( &psz_labels, "input=\"%s\"", psz_label ) == -1 )
+            psz_labels = NULL;
+        free( psz_label );
+        free( psz_uri );
+
+        for( size_t i = 0; b_stats && psz_labels != NULL &&
+                           i < ARRAY_SIZE(p_metrics); i++ )
+        {
+            const char *psz_name = p_metrics[i].psz_name;
+            const void *p_field = (const char *)&stats + p_metrics[i].i_offset;
+
+            Print( &text, "# HELP %s %s\n", psz_name, p_metrics[i].psz_help );
+            switch( p_metrics[i].i_type )
+            {
+                case METRIC_COUNTER:
+                    Print( &text, "# TYPE %s counter\n%s{%s} %"PRId64"\n",
+                           psz_name, psz_name, psz_labels,
+                           *(const int64_t *)p_field );
+                    break;
+                case METRIC_RATE:
+                    Print( &text, "# TYPE %s gauge\n%s{%s} %"PRId64"\n",
+                           psz_name, psz_name, psz_labels,
+                           (int64_t)(*(const float *)p_field * CLOCK_FREQ) );
+                    break;
+                case METRIC_LATENCY:
+                    Print( &text, "# TYPE %s histogram\n", psz_name );
+                    PrintLatency( &text, psz_name, psz_labels, p_field );
+                    break;
+            }
+        }
+        free( psz_labels );
+        vlc_object_release( p_input );
+    }
+
+    if( text.b_error )
+    {
+        free( text.psz );
+        return NULL;
+    }
+    *pi_len = text.i_len;
+    return text.psz;
+}
+
+/*****************************************************************************
+ * File
+ *****************************************************************************/
+static void WriteFile( void *data )
+{
+    intf_thread_t *p_intf = data;
+    intf_sys_t *p_sys = p_intf->p_sys;
+    char *psz_tmp;
+    size_t i_len;
+
+    char *psz_text = Format( p_intf, &i_len );
+    if( psz_text == NULL )
+        return;
+
+    if( asprintf( &psz_tmp, "%s.%"PRIu32, p_sys->psz_file,
+                  (uint32_t)getpid() ) == -1 )
+    {
+        free( psz_text );
+        return;
+    }
+
+    FILE *file = vlc_fopen( psz_tmp, "wb" );
+    if( file == NULL )
+    {
+        msg_Warn( p_intf, "cannot create %s: %s", psz_tmp,
+                  vlc_strerror_c(errno) );
+        goto out;
+    }
+
+    if( fwrite( psz_text, 1, i_len, file ) != i_len || fflush( file ) )
+    {
+        msg_Warn( p_intf, "cannot write %s: %s", psz_tmp,
+                  vlc_strerror_c(errno) );
+        fclose( file );
+        vlc_unlink( psz_tmp );
+        goto out;
+    }
+
+    /* Readers never see a partially written file */
+#if !defined( _WIN32 ) && !defined( __OS2__ )
+    vlc_rename( psz_tmp, p_sys->psz_file );
+    fclose( file );
+#else
+    vlc_unlink( p_sys->psz_file );
+    fclose( file );
+    vlc_rename( psz_tmp, p_sys->psz_file );
+#endif
+out:
+    free( psz_tmp );
+    free( psz_text );
+}
+
+/*****************************************************************************
+ * HTTP
+ *****************************************************************************/
+static int FillUrl( httpd_file_sys_t *data, httpd_file_t *p_file,
+                    uint8_t *psz_request, uint8_t **pp_data, int *pi_data )
+{
+    intf_thread_t *p_intf = (intf_thread_t *)data;
+    size_t i_len;
+    VLC_UNUSED(p_file); VLC_UNUSED(psz_request);
+
+    char *psz_text = Format( p_intf, &i_len );
+    if( psz_text == NULL || i_len > INT_MAX )
+    {
+        free( psz_text );
+        *pp_data = NULL;
+        *pi_data = 0;
+        return VLC_ENOMEM;
+    }
+    *pp_data = (uint8_t *)psz_text;
+    *pi_data = i_len;
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Open: initialize and create stuff
+ *****************************************************************************/
+static int Open( vlc_object_t *p_this )
+{
+    intf_thread_t *p_intf = (intf_thread_t *)p_this;
+
+    char *psz_file = var_InheritString( p_intf, "metrics-file" );
+    char *psz_url = var_InheritString( p_intf, "metrics-url" );
+    if( psz_file == NULL && psz_url == NULL )
+    {
+        msg_Err( p_intf, "no metrics file nor URL specified" );
+        return VLC_EGENERIC;
+    }
+
+    if( !var_InheritBool( p_intf, "stats" ) )
+        msg_Warn( p_intf, "statistics are disabled (see --stats)" );
+
+    intf_sys_t *p_sys = calloc( 1, sizeof(*p_sys) );
+    if( unlikely(p_sys == NULL) )
+        goto error;
+    p_intf->p_sys = p_sys;
+
+    if( psz_url != NULL )
+    {
+        p_sys->p_host = vlc_http_HostNew( p_this );
+        if( p_sys->p_host == NULL )
+            goto error;
+        p_sys->p_url = httpd_FileNew( p_sys->p_host, psz_url,
+                                      "text/plain; version=0.0.4",
+                                      NULL, NULL, FillUrl,
+                                      (httpd_file_sys_t *)p_intf );
+        if( p_sys->p_url == NULL )
+        {
+            msg_Err( p_intf, "cannot serve the metrics at %s", psz_url );
+            goto error;
+        }
+        free( psz_url );
+        psz_url = NULL;
+    }
+
+    if( psz_file != NULL )
+    {
+        if( vlc_timer_create( &p_sys->timer, WriteFile, p_intf ) )
+            goto error;
+        p_sys->psz_file = psz_file;
+
+        mtime_t i_period = var_InheritInteger( p_intf, "metrics-period" )
+                         * CLOCK_FREQ;
+        vlc_timer_schedule( p_sys->timer, false, i_period, i_period );
+    }
+    return VLC_SUCCESS;
+
+error:
+    if( p_sys != NULL )
+    {
+        if( p_sys->p_url != NULL )
+            httpd_FileDelete( p_sys->p_url );
+        if( p_sys->p_host != NULL )
+            httpd_HostDelete( p_sys->p_host );
+        free( p_sys );
+    }
+    free( psz_url );
+    free( psz_file );
+    return VLC_EGENERIC;
+}
+
+/*****************************************************************************
+ * Close: destroy interface stuff
+ *****************************************************************************/
+static void Close( vlc_object_t *p_this )
+{
+    intf_thread_t *p_intf = (intf_thread_t *)p_this;
+    intf_sys_t *p_sys = p_intf->p_sys;
+
+    if( p_sys->psz_file != NULL )
+    {
+        vlc_timer_destroy( p_sys->timer );
+        free( p_sys->psz_file );
+    }
+    if( p_sys->p_url != NULL )
+    {
+        httpd_FileDelete( p_sys->p_url );
+        httpd_HostDelete( p_sys->p_host );
+    }
+    free( p_sys );
+}
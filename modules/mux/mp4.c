@@ -782,6 +782,11 @@ static block_t *ConvertFromAnnexB(block_t *p_block)
         }
     }
 
+    /* The start codes are replaced in place */
+    p_block = block_Unshare(p_block);
+    if( !p_block )
+        return NULL;
+
     uint8_t *last = p_block->p_buffer;
     uint8_t *dat  = &p_block->p_buffer[4];
     uint8_t *end = &p_block->p_buffer[p_block->i_buffer];
@@ -285,14 +285,19 @@ static int Mux( sout_mux_t *p_mux )
     while( block_FifoCount( p_input->p_fifo ) > 0 )
     {
         block_t *p_block = block_FifoGet( p_input->p_fifo );
-        p_sys->i_data += p_block->i_buffer;
 
         /* Do the channel reordering */
         if( p_sys->i_chans_to_reorder )
+        {
+            p_block = block_Unshare( p_block );
+            if( unlikely(p_block == NULL) )
+                continue;
             aout_ChannelReorder( p_block->p_buffer, p_block->i_buffer,
                                  p_sys->i_chans_to_reorder,
                                  p_sys->pi_chan_table, p_input->p_fmt->i_codec );
+        }
 
+        p_sys->i_data += p_block->i_buffer;
         sout_AccessOutWrite( p_mux->p_access, p_block );
     }
 
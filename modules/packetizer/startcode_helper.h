@@ -0,0 +1,121 @@
+/*****************************************************************************
+ * startcode_helper.h: Annex B start code search
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_STARTCODE_HELPER_H_
+#define VLC_STARTCODE_HELPER_H_
+
+#include <vlc_cpu.h>
+
+#ifdef __SSE2__
+# include <emmintrin.h>
+# if VLC_GCC_VERSION(4,9)
+#  include <immintrin.h>
+#  define STARTCODE_CAN_AVX2
+# endif
+#endif
+
+/*
+ * All the functions below return a pointer to the first 00 00 01 sequence
+ * starting in [p, end) and fully contained in it, or NULL if there is none.
+ */
+
+static inline const uint8_t *startcode_FindAnnexB_C( const uint8_t *p,
+                                                     const uint8_t *end )
+{
+    /* No start code begins at any of the 3 bytes up to one greater than 1,
+     * so most bytes are skipped */
+    for( end -= 2; p < end; )
+    {
+        if( p[2] > 1 )
+            p += 3;
+        else if( p[2] == 0 )
+            p++;
+        else if( p[0] == 0 && p[1] == 0 )
+            return p;
+        else
+            p += 3;
+    }
+    return NULL;
+}
+
+#ifdef __SSE2__
+static inline const uint8_t *startcode_FindAnnexB_SSE2( const uint8_t *p,
+                                                        const uint8_t *end )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8( 1 );
+
+    /* Matches 16 positions at once from 3 shifted loads */
+    for( ; end - p >= 18; p += 16 )
+    {
+        __m128i b0 = _mm_loadu_si128( (const __m128i *)p );
+        __m128i b1 = _mm_loadu_si128( (const __m128i *)(p + 1) );
+        __m128i b2 = _mm_loadu_si128( (const __m128i *)(p + 2) );
+        __m128i m = _mm_and_si128( _mm_and_si128( _mm_cmpeq_epi8( b0, zero ),
+                                                  _mm_cmpeq_epi8( b1, zero ) ),
+                                   _mm_cmpeq_epi8( b2, one ) );
+        unsigned mask = _mm_movemask_epi8( m );
+
+        if( mask )
+            return p + ctz( mask );
+    }
+    return startcode_FindAnnexB_C( p, end );
+}
+#endif
+
+#ifdef STARTCODE_CAN_AVX2
+__attribute__ ((__target__ ("avx2")))
+static inline const uint8_t *startcode_FindAnnexB_AVX2( const uint8_t *p,
+                                                        const uint8_t *end )
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8( 1 );
+
+    for( ; end - p >= 34; p += 32 )
+    {
+        __m256i b0 = _mm256_loadu_si256( (const __m256i *)p );
+        __m256i b1 = _mm256_loadu_si256( (const __m256i *)(p + 1) );
+        __m256i b2 = _mm256_loadu_si256( (const __m256i *)(p + 2) );
+        __m256i m = _mm256_and_si256( _mm256_and_si256( _mm256_cmpeq_epi8( b0, zero ),
+                                                        _mm256_cmpeq_epi8( b1, zero ) ),
+                                      _mm256_cmpeq_epi8( b2, one ) );
+        unsigned mask = _mm256_movemask_epi8( m );
+
+        if( mask )
+            return p + ctz( mask );
+    }
+    return startcode_FindAnnexB_SSE2( p, end );
+}
+#endif
+
+static inline const uint8_t *startcode_FindAnnexB( const uint8_t *p,
+                                                   const uint8_t *end )
+{
+#ifdef STARTCODE_CAN_AVX2
+    if( vlc_CPU_AVX2() )
+        return startcode_FindAnnexB_AVX2( p, end );
+#endif
+#ifdef __SSE2__
+    return startcode_FindAnnexB_SSE2( p, end );
+#else
+    return startcode_FindAnnexB_C( p, end );
+#endif
+}
+
+#endif /* VLC_STARTCODE_HELPER_H_ */
@@ -66,6 +66,7 @@ struct stream_sys_t
  ****************************************************************************/
 static int  Read   ( stream_t *, void *p_read, unsigned int i_read );
 static int  Peek   ( stream_t *, const uint8_t **pp_peek, unsigned int i_peek );
+static block_t *Block( stream_t *, unsigned int i_size );
 static int  Control( stream_t *, int i_query, va_list );
 
 static int  Start  ( stream_t *, const char *psz_extension );
@@ -90,6 +91,7 @@ static int Open ( vlc_object_t *p_this )
     /* */
     s->pf_read = Read;
     s->pf_peek = Peek;
+    s->pf_block = Block;
     s->pf_control = Control;
     stream_FilterSetDefaultReadDir( s );
 
@@ -142,8 +144,32 @@ static int Peek( stream_t *s, const uint8_t **pp_peek, unsigned int i_peek )
     return stream_Peek( s->p_source, pp_peek, i_peek );
 }
 
+static block_t *Block( stream_t *s, unsigned int i_size )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    block_t *p_block = stream_ReadBlock( s->p_source, i_size );
+
+    /* Dump read data */
+    if( p_sys->f && p_block )
+        Write( s, p_block->p_buffer, p_block->i_buffer );
+
+    return p_block;
+}
+
 static int Control( stream_t *s, int i_query, va_list args )
 {
+    if( i_query == STREAM_RECORD_DATA )
+    {
+        const uint8_t *p_data = va_arg( args, const uint8_t * );
+        size_t i_data = va_arg( args, size_t );
+
+        if( !s->p_sys->f )
+            return VLC_EGENERIC;
+        Write( s, p_data, i_data );
+        return VLC_SUCCESS;
+    }
+
     if( i_query != STREAM_SET_RECORD_STATE )
         return stream_vaControl( s->p_source, i_query, args );
 
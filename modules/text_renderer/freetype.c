@@ -76,6 +76,12 @@
 #include "platform_fonts.h"
 #include "freetype.h"
 #include "text_layout.h"
+#include "text_cache.h"
+
+/* Bounds of the glyph and layout caches */
+#define GLYPH_CACHE_SIZE   (4 << 20)
+#define LAYOUT_CACHE_COUNT 32
+#define LAYOUT_CACHE_SIZE  (4 << 20)
 
 /*****************************************************************************
  * Module descriptor
@@ -1311,6 +1317,11 @@ static int Create( vlc_object_t *p_this )
     p_sys->faces_cache.i_cache_size = i_faces_size;
     p_sys->faces_cache.i_faces_count = 0;
 
+    /* Rendering still works without them */
+    p_sys->p_glyph_cache = GlyphCacheNew( GLYPH_CACHE_SIZE );
+    p_sys->p_layout_cache = LayoutCacheNew( LAYOUT_CACHE_COUNT,
+                                            LAYOUT_CACHE_SIZE );
+
     p_sys->pp_font_attachments = NULL;
     p_sys->i_font_attachments = 0;
 
@@ -1365,6 +1376,10 @@ static void Destroy( vlc_object_t *p_this )
     free( p_sys->faces_cache.p_faces );
     free( p_sys->faces_cache.p_styles );
 
+    /* The cached glyphs belong to the library */
+    LayoutCacheDelete( p_sys->p_layout_cache );
+    GlyphCacheDelete( p_sys->p_glyph_cache );
+
     if( p_sys->pp_font_attachments )
     {
         for( int k = 0; k < p_sys->i_font_attachments; k++ )
@@ -33,6 +33,9 @@ typedef struct faces_cache_t
     int            i_cache_size;
 } faces_cache_t;
 
+typedef struct glyph_cache_t glyph_cache_t;
+typedef struct layout_cache_t layout_cache_t;
+
 /*****************************************************************************
  * filter_sys_t: freetype local data
  *****************************************************************************
@@ -61,6 +64,10 @@ struct filter_sys_t
     /* Font faces cache */
     faces_cache_t  faces_cache;
 
+    /* Rendered glyphs and laid out texts caches */
+    glyph_cache_t  *p_glyph_cache;
+    layout_cache_t *p_layout_cache;
+
     char * (*pf_select) (filter_t *, const char* family,
                                bool bold, bool italic, int size,
                                int *index);
@@ -0,0 +1,606 @@
+/*****************************************************************************
+ * text_cache.c : Glyph and layout caches of the freetype text renderer
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_filter.h>
+#include <vlc_text_style.h>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_GLYPH_H
+#include FT_STROKER_H
+
+#include "text_renderer.h"
+#include "freetype.h"
+#include "text_layout.h"
+#include "text_cache.h"
+
+static size_t GlyphSize( FT_Glyph p_glyph )
+{
+    if( !p_glyph )
+        return 0;
+
+    if( p_glyph->format == FT_GLYPH_FORMAT_BITMAP )
+    {
+        const FT_Bitmap *p_bitmap = &((FT_BitmapGlyph)p_glyph)->bitmap;
+        return sizeof(FT_BitmapGlyphRec) + abs( p_bitmap->pitch ) * p_bitmap->rows;
+    }
+    if( p_glyph->format == FT_GLYPH_FORMAT_OUTLINE )
+    {
+        const FT_Outline *p_outline = &((FT_OutlineGlyph)p_glyph)->outline;
+        return sizeof(FT_OutlineGlyphRec)
+             + p_outline->n_points * ( sizeof(FT_Vector) + 1 )
+             + p_outline->n_contours * sizeof(short);
+    }
+    return sizeof(FT_GlyphRec);
+}
+
+static FT_Glyph GlyphCopy( FT_Glyph p_glyph )
+{
+    FT_Glyph p_copy;
+    if( !p_glyph || FT_Glyph_Copy( p_glyph, &p_copy ) )
+        return NULL;
+    return p_copy;
+}
+
+/*****************************************************************************
+ * Glyph cache
+ *****************************************************************************/
+#define GLYPH_CACHE_BUCKETS 1024
+/* Pen positions usually only have a few distinct subpixel offsets */
+#define GLYPH_CACHE_MAX_BITMAPS 8
+
+typedef struct glyph_bitmap_t glyph_bitmap_t;
+struct glyph_bitmap_t
+{
+    glyph_bitmap_t *p_next;
+    FT_Glyph        p_bitmap;   /* rendered at the subpixel offset only */
+    int             i_x_frac;
+    int             i_y_frac;
+    bool            b_outline;
+};
+
+typedef struct glyph_entry_t glyph_entry_t;
+struct glyph_entry_t
+{
+    glyph_key_t     key;
+    glyph_entry_t  *p_hash_next;
+    glyph_entry_t  *p_prev;     /* LRU order, most recent first */
+    glyph_entry_t  *p_next;
+
+    FT_Glyph        p_glyph;
+    FT_Glyph        p_outline;
+    FT_Vector       advance;
+    glyph_bitmap_t *p_bitmaps;
+    int             i_bitmaps;
+    size_t          i_size;
+};
+
+struct glyph_cache_t
+{
+    glyph_entry_t  *pp_buckets[GLYPH_CACHE_BUCKETS];
+    glyph_entry_t  *p_first;
+    glyph_entry_t  *p_last;
+    size_t          i_size;
+    size_t          i_max_size;
+};
+
+static unsigned GlyphKeyHash( const glyph_key_t *p_key )
+{
+    uint32_t i_hash = (uintptr_t)p_key->p_face >> 4;
+    i_hash = i_hash * 31 + p_key->i_glyph_index;
+    i_hash = i_hash * 31 + p_key->i_x_ppem;
+    i_hash = i_hash * 31 + p_key->i_y_ppem;
+    i_hash = i_hash * 31 + p_key->i_style_flags;
+    i_hash = i_hash * 31 + p_key->i_radius;
+    i_hash ^= i_hash >> 15;
+    return i_hash % GLYPH_CACHE_BUCKETS;
+}
+
+static bool GlyphKeyEquals( const glyph_key_t *p_a, const glyph_key_t *p_b )
+{
+    return p_a->p_face == p_b->p_face
+        && p_a->i_glyph_index == p_b->i_glyph_index
+        && p_a->i_x_ppem == p_b->i_x_ppem
+        && p_a->i_y_ppem == p_b->i_y_ppem
+        && p_a->i_style_flags == p_b->i_style_flags
+        && p_a->i_radius == p_b->i_radius;
+}
+
+static void GlyphCacheUnlink( glyph_cache_t *p_cache, glyph_entry_t *p_entry )
+{
+    if( p_entry->p_prev )
+        p_entry->p_prev->p_next = p_entry->p_next;
+    else
+        p_cache->p_first = p_entry->p_next;
+    if( p_entry->p_next )
+        p_entry->p_next->p_prev = p_entry->p_prev;
+    else
+        p_cache->p_last = p_entry->p_prev;
+}
+
+static void GlyphCacheLinkFirst( glyph_cache_t *p_cache, glyph_entry_t *p_entry )
+{
+    p_entry->p_prev = NULL;
+    p_entry->p_next = p_cache->p_first;
+    if( p_cache->p_first )
+        p_cache->p_first->p_prev = p_entry;
+    else
+        p_cache->p_last = p_entry;
+    p_cache->p_first = p_entry;
+}
+
+static glyph_entry_t *GlyphCacheFind( glyph_cache_t *p_cache,
+                                      const glyph_key_t *p_key )
+{
+    glyph_entry_t *p_entry = p_cache->pp_buckets[GlyphKeyHash( p_key )];
+    while( p_entry && !GlyphKeyEquals( &p_entry->key, p_key ) )
+        p_entry = p_entry->p_hash_next;
+
+    if( p_entry && p_entry != p_cache->p_first )
+    {
+        GlyphCacheUnlink( p_cache, p_entry );
+        GlyphCacheLinkFirst( p_cache, p_entry );
+    }
+    return p_entry;
+}
+
+static void GlyphBitmapDelete( glyph_bitmap_t *p_bitmap )
+{
+    FT_Done_Glyph( p_bitmap->p_bitmap );
+    free( p_bitmap );
+}
+
+static void GlyphEntryDelete( glyph_entry_t *p_entry )
+{
+    for( glyph_bitmap_t *p_bitmap = p_entry->p_bitmaps; p_bitmap; )
+    {
+        glyph_bitmap_t *p_next = p_bitmap->p_next;
+        GlyphBitmapDelete( p_bitmap );
+        p_bitmap = p_next;
+    }
+    if( p_entry->p_glyph )
+        FT_Done_Glyph( p_entry->p_glyph );
+    if( p_entry->p_outline )
+        FT_Done_Glyph( p_entry->p_outline );
+    free( p_entry );
+}
+
+static void GlyphCacheRemove( glyph_cache_t *p_cache, glyph_entry_t *p_entry )
+{
+    glyph_entry_t **pp_entry = &p_cache->pp_buckets[GlyphKeyHash( &p_entry->key )];
+    while( *pp_entry != p_entry )
+        pp_entry = &(*pp_entry)->p_hash_next;
+    *pp_entry = p_entry->p_hash_next;
+
+    GlyphCacheUnlink( p_cache, p_entry );
+    p_cache->i_size -= p_entry->i_size;
+    GlyphEntryDelete( p_entry );
+}
+
+/* Evicts the least recently used glyphs, but the one being added */
+static void GlyphCacheTrim( glyph_cache_t *p_cache, glyph_entry_t *p_keep )
+{
+    while( p_cache->i_size > p_cache->i_max_size
+        && p_cache->p_last && p_cache->p_last != p_keep )
+        GlyphCacheRemove( p_cache, p_cache->p_last );
+}
+
+glyph_cache_t *GlyphCacheNew( size_t i_max_size )
+{
+    glyph_cache_t *p_cache = calloc( 1, sizeof( *p_cache ) );
+    if( !p_cache )
+        return NULL;
+
+    p_cache->i_max_size = i_max_size;
+    return p_cache;
+}
+
+void GlyphCacheDelete( glyph_cache_t *p_cache )
+{
+    if( !p_cache )
+        return;
+
+    for( glyph_entry_t *p_entry = p_cache->p_first; p_entry; )
+    {
+        glyph_entry_t *p_next = p_entry->p_next;
+        GlyphEntryDelete( p_entry );
+        p_entry = p_next;
+    }
+    free( p_cache );
+}
+
+int GlyphCacheGet( glyph_cache_t *p_cache, const glyph_key_t *p_key,
+                   FT_Glyph *pp_glyph, FT_Glyph *pp_outline,
+                   FT_Vector *p_advance )
+{
+    if( !p_cache )
+        return VLC_EGENERIC;
+
+    glyph_entry_t *p_entry = GlyphCacheFind( p_cache, p_key );
+    if( !p_entry )
+        return VLC_EGENERIC;
+
+    FT_Glyph p_glyph = GlyphCopy( p_entry->p_glyph );
+    if( !p_glyph )
+        return VLC_ENOMEM;
+
+    FT_Glyph p_outline = NULL;
+    if( p_entry->p_outline )
+    {
+        p_outline = GlyphCopy( p_entry->p_outline );
+        if( !p_outline )
+        {
+            FT_Done_Glyph( p_glyph );
+            return VLC_ENOMEM;
+        }
+    }
+
+    *pp_glyph = p_glyph;
+    *pp_outline = p_outline;
+    *p_advance = p_entry->advance;
+    return VLC_SUCCESS;
+}
+
+void GlyphCachePut( glyph_cache_t *p_cache, const glyph_key_t *p_key,
+                    FT_Glyph p_glyph, FT_Glyph p_outline,
+                    const FT_Vector *p_advance )
+{
+    if( !p_cache || GlyphCacheFind( p_cache, p_key ) )
+        return;
+
+    glyph_entry_t *p_entry = calloc( 1, sizeof( *p_entry ) );
+    if( !p_entry )
+        return;
+
+    p_entry->key = *p_key;
+    p_entry->advance = *p_advance;
+    p_entry->p_glyph = GlyphCopy( p_glyph );
+    p_entry->p_outline = GlyphCopy( p_outline );
+    if( !p_entry->p_glyph || ( p_outline && !p_entry->p_outline ) )
+    {
+        GlyphEntryDelete( p_entry );
+        return;
+    }
+    p_entry->i_size = sizeof( *p_entry ) + GlyphSize( p_entry->p_glyph )
+                    + GlyphSize( p_entry->p_outline );
+
+    glyph_entry_t **pp_bucket = &p_cache->pp_buckets[GlyphKeyHash( p_key )];
+    p_entry->p_hash_next = *pp_bucket;
+    *pp_bucket = p_entry;
+    GlyphCacheLinkFirst( p_cache, p_entry );
+    p_cache->i_size += p_entry->i_size;
+
+    GlyphCacheTrim( p_cache, p_entry );
+}
+
+/* Rendering at an origin translated by whole pixels only moves the bitmap */
+static void GlyphOriginSplit( const FT_Vector *p_origin, FT_Vector *p_frac,
+                              FT_Vector *p_pixels )
+{
+    p_frac->x = p_origin->x & 63;
+    p_frac->y = p_origin->y & 63;
+    p_pixels->x = ( p_origin->x - p_frac->x ) / 64;
+    p_pixels->y = ( p_origin->y - p_frac->y ) / 64;
+}
+
+FT_Glyph GlyphCacheGetBitmap( glyph_cache_t *p_cache, const glyph_key_t *p_key,
+                              bool b_outline, const FT_Vector *p_origin )
+{
+    if( !p_cache )
+        return NULL;
+
+    glyph_entry_t *p_entry = GlyphCacheFind( p_cache, p_key );
+    if( !p_entry )
+        return NULL;
+
+    FT_Vector frac, pixels;
+    GlyphOriginSplit( p_origin, &frac, &pixels );
+
+    for( glyph_bitmap_t *p_bitmap = p_entry->p_bitmaps; p_bitmap;
+         p_bitmap = p_bitmap->p_next )
+    {
+        if( p_bitmap->b_outline != b_outline
+         || p_bitmap->i_x_frac != frac.x || p_bitmap->i_y_frac != frac.y )
+            continue;
+
+        FT_Glyph p_copy = GlyphCopy( p_bitmap->p_bitmap );
+        if( p_copy )
+        {
+            ((FT_BitmapGlyph)p_copy)->left += pixels.x;
+            ((FT_BitmapGlyph)p_copy)->top  += pixels.y;
+        }
+        return p_copy;
+    }
+    return NULL;
+}
+
+void GlyphCachePutBitmap( glyph_cache_t *p_cache, const glyph_key_t *p_key,
+                          bool b_outline, const FT_Vector *p_origin,
+                          FT_Glyph p_glyph )
+{
+    if( !p_cache || p_glyph->format != FT_GLYPH_FORMAT_BITMAP )
+        return;
+
+    glyph_entry_t *p_entry = GlyphCacheFind( p_cache, p_key );
+    if( !p_entry )
+        return;
+
+    glyph_bitmap_t *p_bitmap = malloc( sizeof( *p_bitmap ) );
+    if( !p_bitmap )
+        return;
+    p_bitmap->p_bitmap = GlyphCopy( p_glyph );
+    if( !p_bitmap->p_bitmap )
+    {
+        free( p_bitmap );
+        return;
+    }
+
+    FT_Vector frac, pixels;
+    GlyphOriginSplit( p_origin, &frac, &pixels );
+    ((FT_BitmapGlyph)p_bitmap->p_bitmap)->left -= pixels.x;
+    ((FT_BitmapGlyph)p_bitmap->p_bitmap)->top  -= pixels.y;
+    p_bitmap->i_x_frac = frac.x;
+    p_bitmap->i_y_frac = frac.y;
+    p_bitmap->b_outline = b_outline;
+
+    if( p_entry->i_bitmaps >= GLYPH_CACHE_MAX_BITMAPS )
+    {
+        /* Drop the oldest rendering */
+        glyph_bitmap_t **pp_last = &p_entry->p_bitmaps;
+        while( (*pp_last)->p_next )
+            pp_last = &(*pp_last)->p_next;
+        size_t i_size = sizeof( **pp_last ) + GlyphSize( (*pp_last)->p_bitmap );
+        p_entry->i_size -= i_size;
+        p_cache->i_size -= i_size;
+        GlyphBitmapDelete( *pp_last );
+        *pp_last = NULL;
+        p_entry->i_bitmaps--;
+    }
+
+    size_t i_size = sizeof( *p_bitmap ) + GlyphSize( p_bitmap->p_bitmap );
+    p_bitmap->p_next = p_entry->p_bitmaps;
+    p_entry->p_bitmaps = p_bitmap;
+    p_entry->i_bitmaps++;
+    p_entry->i_size += i_size;
+    p_cache->i_size += i_size;
+
+    GlyphCacheTrim( p_cache, p_entry );
+}
+
+/*****************************************************************************
+ * Layout cache
+ *****************************************************************************/
+typedef struct layout_entry_t layout_entry_t;
+struct layout_entry_t
+{
+    layout_entry_t *p_next;     /* most recent first */
+    uint32_t        i_hash;
+    size_t          i_key;
+    uint8_t        *p_key;
+    line_desc_t    *p_lines;
+    FT_BBox         bbox;
+    int             i_max_face_height;
+    size_t          i_size;
+};
+
+struct layout_cache_t
+{
+    layout_entry_t *p_first;
+    int             i_count;
+    int             i_max_count;
+    size_t          i_size;
+    size_t          i_max_size;
+};
+
+static uint32_t LayoutKeyHash( const void *p_key, size_t i_key )
+{
+    const uint8_t *p = p_key;
+    uint32_t i_hash = 2166136261u;
+    for( size_t i = 0; i < i_key; i++ )
+        i_hash = ( i_hash ^ p[i] ) * 16777619u;
+    return i_hash;
+}
+
+static line_desc_t *CopyLines( const line_desc_t *p_lines, size_t *pi_size )
+{
+    line_desc_t *p_first = NULL;
+    line_desc_t **pp_line = &p_first;
+    size_t i_size = 0;
+
+    for( const line_desc_t *p_src = p_lines; p_src; p_src = p_src->p_next )
+    {
+        line_desc_t *p_line = NewLine( __MAX( p_src->i_character_count, 1 ) );
+        if( !p_line )
+            goto error;
+        *pp_line = p_line;
+        pp_line = &p_line->p_next;
+
+        p_line->i_width = p_src->i_width;
+        p_line->i_height = p_src->i_height;
+        p_line->i_base_line = p_src->i_base_line;
+        p_line->bbox = p_src->bbox;
+        i_size += sizeof( *p_line );
+
+        for( int i = 0; i < p_src->i_character_count; i++ )
+        {
+            const line_character_t *p_ch_src = &p_src->p_character[i];
+            line_character_t *p_ch = &p_line->p_character[i];
+
+            *p_ch = *p_ch_src;
+            p_ch->p_glyph = (FT_BitmapGlyph)GlyphCopy( (FT_Glyph)p_ch_src->p_glyph );
+            p_ch->p_outline = (FT_BitmapGlyph)GlyphCopy( (FT_Glyph)p_ch_src->p_outline );
+            p_ch->p_shadow = (FT_BitmapGlyph)GlyphCopy( (FT_Glyph)p_ch_src->p_shadow );
+            if( !p_ch->p_glyph
+             || ( p_ch_src->p_outline && !p_ch->p_outline )
+             || ( p_ch_src->p_shadow && !p_ch->p_shadow ) )
+            {
+                if( p_ch->p_glyph )
+                    FT_Done_Glyph( (FT_Glyph)p_ch->p_glyph );
+                if( p_ch->p_outline )
+                    FT_Done_Glyph( (FT_Glyph)p_ch->p_outline );
+                if( p_ch->p_shadow )
+                    FT_Done_Glyph( (FT_Glyph)p_ch->p_shadow );
+                goto error;
+            }
+            p_line->i_character_count = i + 1;
+
+            i_size += sizeof( *p_ch ) + GlyphSize( (FT_Glyph)p_ch->p_glyph )
+                    + GlyphSize( (FT_Glyph)p_ch->p_outline )
+                    + GlyphSize( (FT_Glyph)p_ch->p_shadow );
+        }
+    }
+
+    if( pi_size )
+        *pi_size = i_size;
+    return p_first;
+
+error:
+    FreeLines( p_first );
+    return NULL;
+}
+
+static void LayoutEntryDelete( layout_entry_t *p_entry )
+{
+    FreeLines( p_entry->p_lines );
+    free( p_entry->p_key );
+    free( p_entry );
+}
+
+layout_cache_t *LayoutCacheNew( int i_max_count, size_t i_max_size )
+{
+    layout_cache_t *p_cache = calloc( 1, sizeof( *p_cache ) );
+    if( !p_cache )
+        return NULL;
+
+    p_cache->i_max_count = i_max_count;
+    p_cache->i_max_size = i_max_size;
+    return p_cache;
+}
+
+void LayoutCacheDelete( layout_cache_t *p_cache )
+{
+    if( !p_cache )
+        return;
+
+    for( layout_entry_t *p_entry = p_cache->p_first; p_entry; )
+    {
+        layout_entry_t *p_next = p_entry->p_next;
+        LayoutEntryDelete( p_entry );
+        p_entry = p_next;
+    }
+    free( p_cache );
+}
+
+int LayoutCacheGet( layout_cache_t *p_cache, const void *p_key, size_t i_key,
+                    line_desc_t **pp_lines, FT_BBox *p_bbox,
+                    int *pi_max_face_height )
+{
+    if( !p_cache )
+        return VLC_EGENERIC;
+
+    const uint32_t i_hash = LayoutKeyHash( p_key, i_key );
+    layout_entry_t **pp_entry = &p_cache->p_first;
+    for( ; *pp_entry; pp_entry = &(*pp_entry)->p_next )
+    {
+        layout_entry_t *p_entry = *pp_entry;
+        if( p_entry->i_hash != i_hash || p_entry->i_key != i_key
+         || memcmp( p_entry->p_key, p_key, i_key ) )
+            continue;
+
+        line_desc_t *p_lines = NULL;
+        if( p_entry->p_lines )
+        {
+            p_lines = CopyLines( p_entry->p_lines, NULL );
+            if( !p_lines )
+                return VLC_ENOMEM;
+        }
+
+        /* Move to the front */
+        *pp_entry = p_entry->p_next;
+        p_entry->p_next = p_cache->p_first;
+        p_cache->p_first = p_entry;
+
+        *pp_lines = p_lines;
+        *p_bbox = p_entry->bbox;
+        *pi_max_face_height = p_entry->i_max_face_height;
+        return VLC_SUCCESS;
+    }
+    return VLC_EGENERIC;
+}
+
+void LayoutCachePut( layout_cache_t *p_cache, const void *p_key, size_t i_key,
+                     const line_desc_t *p_lines, const FT_BBox *p_bbox,
+                     int i_max_face_height )
+{
+    if( !p_cache || p_cache->i_max_count <= 0 )
+        return;
+
+    layout_entry_t *p_entry = malloc( sizeof( *p_entry ) );
+    if( !p_entry )
+        return;
+
+    p_entry->p_key = malloc( i_key );
+    p_entry->p_lines = NULL;
+    size_t i_lines_size = 0;
+    if( p_lines )
+        p_entry->p_lines = CopyLines( p_lines, &i_lines_size );
+    if( !p_entry->p_key || ( p_lines && !p_entry->p_lines ) )
+    {
+        LayoutEntryDelete( p_entry );
+        return;
+    }
+
+    memcpy( p_entry->p_key, p_key, i_key );
+    p_entry->i_key = i_key;
+    p_entry->i_hash = LayoutKeyHash( p_key, i_key );
+    p_entry->bbox = *p_bbox;
+    p_entry->i_max_face_height = i_max_face_height;
+    p_entry->i_size = sizeof( *p_entry ) + i_key + i_lines_size;
+
+    if( p_entry->i_size > p_cache->i_max_size )
+    {
+        LayoutEntryDelete( p_entry );
+        return;
+    }
+
+    p_entry->p_next = p_cache->p_first;
+    p_cache->p_first = p_entry;
+    p_cache->i_count++;
+    p_cache->i_size += p_entry->i_size;
+
+    /* Evict the least recently used layouts */
+    while( p_cache->i_count > p_cache->i_max_count
+        || p_cache->i_size > p_cache->i_max_size )
+    {
+        layout_entry_t **pp_last = &p_cache->p_first;
+        while( (*pp_last)->p_next )
+            pp_last = &(*pp_last)->p_next;
+
+        p_cache->i_count--;
+        p_cache->i_size -= (*pp_last)->i_size;
+        LayoutEntryDelete( *pp_last );
+        *pp_last = NULL;
+    }
+}
@@ -0,0 +1,72 @@
+/*****************************************************************************
+ * text_cache.h : Glyph and layout caches of the freetype text renderer
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * Everything handed out by the caches is a copy owned by the caller, and
+ * everything stored is copied, so that the lines can still be freed with
+ * FreeLines().
+ */
+
+/*
+ * Glyphs are identified by their face, its size, the synthesized styles and
+ * the outline stroker radius (0 without outline). The cache keeps the loaded
+ * glyph, its stroked outline and the bitmaps rendered from them at each
+ * subpixel pen position.
+ */
+typedef struct
+{
+    FT_Face   p_face;
+    FT_UInt   i_glyph_index;
+    FT_UShort i_x_ppem;
+    FT_UShort i_y_ppem;
+    int       i_style_flags;
+    int       i_radius;
+} glyph_key_t;
+
+glyph_cache_t *GlyphCacheNew( size_t i_max_size );
+void GlyphCacheDelete( glyph_cache_t *p_cache );
+
+int GlyphCacheGet( glyph_cache_t *p_cache, const glyph_key_t *p_key,
+                   FT_Glyph *pp_glyph, FT_Glyph *pp_outline,
+                   FT_Vector *p_advance );
+void GlyphCachePut( glyph_cache_t *p_cache, const glyph_key_t *p_key,
+                    FT_Glyph p_glyph, FT_Glyph p_outline,
+                    const FT_Vector *p_advance );
+
+/* Bitmaps rendered from outline glyphs with FT_Glyph_To_Bitmap() */
+FT_Glyph GlyphCacheGetBitmap( glyph_cache_t *p_cache, const glyph_key_t *p_key,
+                              bool b_outline, const FT_Vector *p_origin );
+void GlyphCachePutBitmap( glyph_cache_t *p_cache, const glyph_key_t *p_key,
+                          bool b_outline, const FT_Vector *p_origin,
+                          FT_Glyph p_bitmap );
+
+/*
+ * Laid out texts are identified by an opaque key built by the layout,
+ * covering everything the lines depend on.
+ */
+layout_cache_t *LayoutCacheNew( int i_max_count, size_t i_max_size );
+void LayoutCacheDelete( layout_cache_t *p_cache );
+
+int LayoutCacheGet( layout_cache_t *p_cache, const void *p_key, size_t i_key,
+                    line_desc_t **pp_lines, FT_BBox *p_bbox,
+                    int *pi_max_face_height );
+void LayoutCachePut( layout_cache_t *p_cache, const void *p_key, size_t i_key,
+                     const line_desc_t *p_lines, const FT_BBox *p_bbox,
+                     int i_max_face_height );
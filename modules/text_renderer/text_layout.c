@@ -58,6 +58,7 @@
 #include "text_renderer.h"
 #include "text_layout.h"
 #include "freetype.h"
+#include "text_cache.h"
 
 /*
  * Within a paragraph, run_desc_t represents a run of characters
@@ -98,6 +99,7 @@ typedef struct glyph_bitmaps_t
     int      i_y_offset;
     int      i_x_advance;
     int      i_y_advance;
+    glyph_key_t cache_key;
 } glyph_bitmaps_t;
 
 typedef struct paragraph_t
@@ -788,18 +790,27 @@ static int LoadGlyphs( filter_t *p_filter, paragraph_t *p_paragraph,
         else
             p_face = p_run->p_face;
 
+        int i_radius = 0;
         if( p_sys->p_stroker )
         {
             double f_outline_thickness =
                 var_InheritInteger( p_filter, "freetype-outline-thickness" ) / 100.0;
             f_outline_thickness = VLC_CLIP( f_outline_thickness, 0.0, 0.5 );
-            int i_radius = ( p_style->i_font_size << 6 ) * f_outline_thickness;
+            i_radius = ( p_style->i_font_size << 6 ) * f_outline_thickness;
             FT_Stroker_Set( p_sys->p_stroker,
                             i_radius,
                             FT_STROKER_LINECAP_ROUND,
                             FT_STROKER_LINEJOIN_ROUND, 0 );
         }
 
+        int i_synthesized_flags = 0;
+        if( ( p_style->i_style_flags & STYLE_BOLD )
+              && !( p_face->style_flags & FT_STYLE_FLAG_BOLD ) )
+            i_synthesized_flags |= STYLE_BOLD;
+        if( ( p_style->i_style_flags & STYLE_ITALIC )
+              && !( p_face->style_flags & FT_STYLE_FLAG_ITALIC ) )
+            i_synthesized_flags |= STYLE_ITALIC;
+
         for( int j = p_run->i_start_offset; j < p_run->i_end_offset; ++j )
         {
             int i_glyph_index;
@@ -811,6 +822,30 @@ static int LoadGlyphs( filter_t *p_filter, paragraph_t *p_paragraph,
 
             glyph_bitmaps_t *p_bitmaps = p_paragraph->p_glyph_bitmaps + j;
 
+            glyph_key_t *p_key = &p_bitmaps->cache_key;
+            p_key->p_face = p_face;
+            p_key->i_glyph_index = i_glyph_index;
+            p_key->i_x_ppem = p_face->size->metrics.x_ppem;
+            p_key->i_y_ppem = p_face->size->metrics.y_ppem;
+            p_key->i_style_flags = i_synthesized_flags;
+            p_key->i_radius = i_radius;
+
+            FT_Vector advance;
+            if( GlyphCacheGet( p_sys->p_glyph_cache, p_key, &p_bitmaps->p_glyph,
+                               &p_bitmaps->p_outline, &advance ) == VLC_SUCCESS )
+            {
+                p_bitmaps->p_shadow = NULL;
+                if( p_sys->style.i_shadow_alpha > 0 )
+                    p_bitmaps->p_shadow = p_bitmaps->p_outline ?
+                                          p_bitmaps->p_outline : p_bitmaps->p_glyph;
+                if( b_overwrite_advance )
+                {
+                    p_bitmaps->i_x_advance = advance.x;
+                    p_bitmaps->i_y_advance = advance.y;
+                }
+                continue;
+            }
+
             if( FT_Load_Glyph( p_face, i_glyph_index,
                                FT_LOAD_NO_BITMAP | FT_LOAD_DEFAULT )
              && FT_Load_Glyph( p_face, i_glyph_index, FT_LOAD_DEFAULT ) )
@@ -823,11 +858,9 @@ static int LoadGlyphs( filter_t *p_filter, paragraph_t *p_paragraph,
                 continue;
             }
 
-            if( ( p_style->i_style_flags & STYLE_BOLD )
-                  && !( p_face->style_flags & FT_STYLE_FLAG_BOLD ) )
+            if( i_synthesized_flags & STYLE_BOLD )
                 FT_GlyphSlot_Embolden( p_face->glyph );
-            if( ( p_style->i_style_flags & STYLE_ITALIC )
-                  && !( p_face->style_flags & FT_STYLE_FLAG_ITALIC ) )
+            if( i_synthesized_flags & STYLE_ITALIC )
                 FT_GlyphSlot_Oblique( p_face->glyph );
 
             if( FT_Get_Glyph( p_face->glyph, &p_bitmaps->p_glyph ) )
@@ -857,11 +890,45 @@ static int LoadGlyphs( filter_t *p_filter, paragraph_t *p_paragraph,
                 p_bitmaps->i_x_advance = p_face->glyph->advance.x;
                 p_bitmaps->i_y_advance = p_face->glyph->advance.y;
             }
+
+            GlyphCachePut( p_sys->p_glyph_cache, p_key, p_bitmaps->p_glyph,
+                           p_bitmaps->p_outline, &p_face->glyph->advance );
         }
     }
     return VLC_SUCCESS;
 }
 
+/*
+ * FT_Glyph_To_Bitmap() through the glyph cache. Only outlines are cached, as
+ * rendering them at another whole pixel position just moves the bitmap.
+ */
+static FT_Error GlyphToBitmap( filter_t *p_filter, const glyph_key_t *p_key,
+                               bool b_outline, FT_Glyph *pp_glyph,
+                               FT_Vector *p_origin, FT_Bool b_destroy )
+{
+    glyph_cache_t *p_cache = p_filter->p_sys->p_glyph_cache;
+    FT_Glyph p_source = *pp_glyph;
+
+    if( p_source->format != FT_GLYPH_FORMAT_OUTLINE )
+        return FT_Glyph_To_Bitmap( pp_glyph, FT_RENDER_MODE_NORMAL,
+                                   p_origin, b_destroy );
+
+    FT_Glyph p_bitmap = GlyphCacheGetBitmap( p_cache, p_key, b_outline, p_origin );
+    if( p_bitmap )
+    {
+        if( b_destroy )
+            FT_Done_Glyph( p_source );
+        *pp_glyph = p_bitmap;
+        return 0;
+    }
+
+    FT_Error i_error = FT_Glyph_To_Bitmap( pp_glyph, FT_RENDER_MODE_NORMAL,
+                                          p_origin, b_destroy );
+    if( !i_error )
+        GlyphCachePutBitmap( p_cache, p_key, b_outline, p_origin, *pp_glyph );
+    return i_error;
+}
+
 static int LayoutLine( filter_t *p_filter,
                        paragraph_t *p_paragraph,
                        int i_start_offset, int i_end_offset,
@@ -947,8 +1014,9 @@ static int LayoutLine( filter_t *p_filter,
 
         if( p_bitmaps->p_shadow )
         {
-            if( FT_Glyph_To_Bitmap( &p_bitmaps->p_shadow, FT_RENDER_MODE_NORMAL,
-                                    &pen_shadow, 0 ) )
+            if( GlyphToBitmap( p_filter, &p_bitmaps->cache_key,
+                               p_bitmaps->p_shadow == p_bitmaps->p_outline,
+                               &p_bitmaps->p_shadow, &pen_shadow, 0 ) )
                 p_bitmaps->p_shadow = 0;
             else
                 FT_Glyph_Get_CBox( p_bitmaps->p_shadow, ft_glyph_bbox_pixels,
@@ -956,8 +1024,8 @@ static int LayoutLine( filter_t *p_filter,
         }
         if( p_bitmaps->p_glyph )
         {
-            if( FT_Glyph_To_Bitmap( &p_bitmaps->p_glyph, FT_RENDER_MODE_NORMAL,
-                                    &pen_new, 1 ) )
+            if( GlyphToBitmap( p_filter, &p_bitmaps->cache_key, false,
+                               &p_bitmaps->p_glyph, &pen_new, 1 ) )
             {
                 FT_Done_Glyph( p_bitmaps->p_glyph );
                 if( p_bitmaps->p_outline )
@@ -973,8 +1041,8 @@ static int LayoutLine( filter_t *p_filter,
         }
         if( p_bitmaps->p_outline )
         {
-            if( FT_Glyph_To_Bitmap( &p_bitmaps->p_outline, FT_RENDER_MODE_NORMAL,
-                                    &pen_new, 1 ) )
+            if( GlyphToBitmap( p_filter, &p_bitmaps->cache_key, true,
+                               &p_bitmaps->p_outline, &pen_new, 1 ) )
             {
                 FT_Done_Glyph( p_bitmaps->p_outline );
                 p_bitmaps->p_outline = 0;
@@ -1200,6 +1268,94 @@ error:
     return VLC_EGENERIC;
 }
 
+/*
+ * Key of the layout cache: the text, its styles and everything else the
+ * lines depend on.
+ */
+typedef struct
+{
+    uint8_t *p_data;
+    size_t   i_size;
+    size_t   i_alloc;
+    bool     b_error;
+} layout_key_t;
+
+static void LayoutKeyAppend( layout_key_t *p_key, const void *p_data,
+                             size_t i_size )
+{
+    if( p_key->b_error )
+        return;
+
+    if( p_key->i_size + i_size > p_key->i_alloc )
+    {
+        size_t i_alloc = __MAX( 2 * p_key->i_alloc, p_key->i_size + i_size );
+        uint8_t *p_new = realloc( p_key->p_data, i_alloc );
+        if( !p_new )
+        {
+            p_key->b_error = true;
+            return;
+        }
+        p_key->p_data = p_new;
+        p_key->i_alloc = i_alloc;
+    }
+    memcpy( p_key->p_data + p_key->i_size, p_data, i_size );
+    p_key->i_size += i_size;
+}
+
+static void LayoutKeyAppendString( layout_key_t *p_key, const char *psz )
+{
+    if( !psz )
+        psz = "";
+    LayoutKeyAppend( p_key, psz, strlen( psz ) + 1 );
+}
+
+static void LayoutKeyAppendStyle( layout_key_t *p_key,
+                                  const text_style_t *p_style )
+{
+    const int pi_values[] = {
+        p_style->i_font_size, p_style->i_font_color, p_style->i_font_alpha,
+        p_style->i_style_flags,
+        p_style->i_outline_color, p_style->i_outline_alpha,
+        p_style->i_shadow_color, p_style->i_shadow_alpha,
+        p_style->i_background_color, p_style->i_background_alpha,
+        p_style->i_karaoke_background_color, p_style->i_karaoke_background_alpha,
+        p_style->i_outline_width, p_style->i_shadow_width, p_style->i_spacing,
+    };
+    LayoutKeyAppend( p_key, pi_values, sizeof( pi_values ) );
+    LayoutKeyAppendString( p_key, p_style->psz_fontname );
+    LayoutKeyAppendString( p_key, p_style->psz_monofontname );
+}
+
+static void LayoutKeyBuild( filter_t *p_filter, layout_key_t *p_key,
+                            const uni_char_t *psz_text,
+                            text_style_t * const *pp_styles,
+                            int i_len, int i_max_width )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const int pi_values[] = {
+        i_len, i_max_width,
+        var_InheritInteger( p_filter, "freetype-outline-thickness" ),
+        p_sys->p_face->size->metrics.x_ppem,
+        p_sys->p_face->size->metrics.y_ppem,
+    };
+    const float pf_values[] = {
+        p_sys->f_shadow_vector_x, p_sys->f_shadow_vector_y,
+    };
+
+    LayoutKeyAppend( p_key, pi_values, sizeof( pi_values ) );
+    LayoutKeyAppend( p_key, pf_values, sizeof( pf_values ) );
+    LayoutKeyAppendStyle( p_key, &p_sys->style );
+    LayoutKeyAppend( p_key, psz_text, i_len * sizeof( *psz_text ) );
+
+    for( int i = 0; i < i_len; i++ )
+    {
+        if( i > 0 && pp_styles[ i ] == pp_styles[ i - 1 ] )
+            continue;
+        LayoutKeyAppend( p_key, &i, sizeof( i ) );
+        LayoutKeyAppendStyle( p_key, pp_styles[ i ] );
+    }
+}
+
 int LayoutText( filter_t *p_filter, line_desc_t **pp_lines,
                 FT_BBox *p_bbox, int *pi_max_face_height,
 
@@ -1212,6 +1368,28 @@ int LayoutText( filter_t *p_filter, line_desc_t **pp_lines,
     int i_paragraph_start = 0;
     int i_max_height = 0;
 
+    /*
+     * Set max line width to allow for outline and shadow glyphs,
+     * and any extra width caused by visual reordering
+     */
+    int i_max_width = ( int ) p_filter->fmt_out.video.i_visible_width
+                      - 2 * p_filter->p_sys->style.i_font_size;
+
+    /* Karaoke depends on the playback time, it is never cached */
+    layout_cache_t *p_cache = pi_k_dates ? NULL : p_filter->p_sys->p_layout_cache;
+    layout_key_t key = { .p_data = NULL };
+    if( p_cache )
+    {
+        LayoutKeyBuild( p_filter, &key, psz_text, pp_styles, i_len, i_max_width );
+        if( !key.b_error
+         && LayoutCacheGet( p_cache, key.p_data, key.i_size, pp_lines,
+                            p_bbox, pi_max_face_height ) == VLC_SUCCESS )
+        {
+            free( key.p_data );
+            return VLC_SUCCESS;
+        }
+    }
+
     for( int i = 0; i <= i_len; ++i )
     {
         if( i == i_len || psz_text[ i ] == '\n' )
@@ -1231,6 +1409,7 @@ int LayoutText( filter_t *p_filter, line_desc_t **pp_lines,
             if( !p_paragraph )
             {
                 if( p_first_line ) FreeLines( p_first_line );
+                free( key.p_data );
                 return VLC_ENOMEM;
             }
 
@@ -1263,12 +1442,6 @@ int LayoutText( filter_t *p_filter, line_desc_t **pp_lines,
                 goto error;
 #endif
 
-            /*
-             * Set max line width to allow for outline and shadow glyphs,
-             * and any extra width caused by visual reordering
-             */
-            int i_max_width = ( int ) p_filter->fmt_out.video.i_visible_width
-                              - 2 * p_filter->p_sys->style.i_font_size;
             if( LayoutParagraph( p_filter, p_paragraph,
                                  i_max_width, pp_line ) )
                 goto error;
@@ -1301,6 +1474,11 @@ int LayoutText( filter_t *p_filter, line_desc_t **pp_lines,
         i_base_line += i_max_height;
     }
 
+    if( p_cache && !key.b_error )
+        LayoutCachePut( p_cache, key.p_data, key.i_size,
+                        p_first_line, &bbox, i_max_height );
+    free( key.p_data );
+
     *pp_lines = p_first_line;
     *p_bbox = bbox;
     *pi_max_face_height = i_max_height;
@@ -1309,5 +1487,6 @@ int LayoutText( filter_t *p_filter, line_desc_t **pp_lines,
 error:
     if( p_first_line ) FreeLines( p_first_line );
     if( p_paragraph ) FreeParagraph( p_paragraph );
+    free( key.p_data );
     return VLC_EGENERIC;
 }
@@ -31,8 +31,19 @@
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
+#include <vlc_cpu.h>
 #include "filter_picture.h"
 
+#if defined(HAVE_SSE2_INTRINSICS) && (defined(__SSE2__) || VLC_GCC_VERSION(4, 9))
+# include <emmintrin.h>
+# define CAN_BLEND_SSE2
+# ifdef __SSE2__
+#  define BLEND_SSE2
+# else
+#  define BLEND_SSE2 __attribute__ ((__target__ ("sse2")))
+# endif
+#endif
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -82,6 +93,26 @@ public:
     {
         return true;
     }
+    unsigned getX() const
+    {
+        return x;
+    }
+    unsigned getY() const
+    {
+        return y;
+    }
+    int getPitch(unsigned plane) const
+    {
+        return picture->p[plane].i_pitch;
+    }
+    /* First pixel of the area in a plane subsampled by rx/ry, for the
+     * row kernels */
+    uint8_t *getPixels(unsigned plane, unsigned rx = 1, unsigned ry = 1,
+                       unsigned bytes = 1) const
+    {
+        return &picture->p[plane].p_pixels[(y / ry) * picture->p[plane].i_pitch +
+                                           (x / rx) * bytes];
+    }
 
 protected:
     template <unsigned ry>
@@ -622,6 +653,366 @@ static const struct {
 #undef YUV
 };
 
+#ifdef CAN_BLEND_SSE2
+/*
+ * SSE2 row kernels for the most common subpicture blendings. They compute
+ * exactly what the generic templates do: all the intermediate values of
+ * merge() and div255() fit in 16 bits, and a null alpha leaves the
+ * destination unchanged.
+ */
+BLEND_SSE2
+static inline __m128i Div255SSE2(__m128i v)
+{
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)),
+                                        _mm_set1_epi16(1)), 8);
+}
+
+/* Blends 8 samples held in 16 bits lanes, a being the source alpha */
+BLEND_SSE2
+static inline __m128i MergeSSE2(__m128i d, __m128i s, __m128i a, __m128i alpha)
+{
+    a = Div255SSE2(_mm_mullo_epi16(a, alpha));
+    return Div255SSE2(_mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(_mm_set1_epi16(255), a), d),
+                                    _mm_mullo_epi16(s, a)));
+}
+
+BLEND_SSE2
+static inline void Merge8SSE2(uint8_t *dst, __m128i s, __m128i a, __m128i alpha)
+{
+    __m128i d = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)dst),
+                                  _mm_setzero_si128());
+    d = MergeSSE2(d, s, a, alpha);
+    _mm_storel_epi64((__m128i *)dst, _mm_packus_epi16(d, d));
+}
+
+BLEND_SSE2
+static inline void Merge16SSE2(uint8_t *dst, __m128i slo, __m128i shi,
+                               __m128i alo, __m128i ahi, __m128i alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i d = _mm_loadu_si128((const __m128i *)dst);
+    __m128i lo = MergeSSE2(_mm_unpacklo_epi8(d, zero), slo, alo, alpha);
+    __m128i hi = MergeSSE2(_mm_unpackhi_epi8(d, zero), shi, ahi, alpha);
+    _mm_storeu_si128((__m128i *)dst, _mm_packus_epi16(lo, hi));
+}
+
+/* Even bytes of 16 bytes, in 16 bits lanes */
+BLEND_SSE2
+static inline __m128i LoadEvenSSE2(const uint8_t *src)
+{
+    return _mm_and_si128(_mm_loadu_si128((const __m128i *)src),
+                         _mm_set1_epi16(0xff));
+}
+
+/* Components of 8 RGBA pixels in 16 bits lanes */
+BLEND_SSE2
+static inline void SplitRGBASSE2(__m128i p0, __m128i p1,
+                                 __m128i *r, __m128i *g, __m128i *b, __m128i *a)
+{
+    const __m128i mask = _mm_set1_epi32(0xff);
+    *r = _mm_packs_epi32(_mm_and_si128(p0, mask),
+                         _mm_and_si128(p1, mask));
+    *g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask),
+                         _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+    *b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask),
+                         _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+    *a = _mm_packs_epi32(_mm_srli_epi32(p0, 24), _mm_srli_epi32(p1, 24));
+}
+
+/* Pixels 0 and 2 of 2 groups of 4 RGBA pixels */
+BLEND_SSE2
+static inline __m128i LoadEvenRGBASSE2(const uint8_t *src)
+{
+    __m128i p0 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)src),
+                                   _MM_SHUFFLE(3, 1, 2, 0));
+    __m128i p1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(src + 16)),
+                                   _MM_SHUFFLE(3, 1, 2, 0));
+    return _mm_unpacklo_epi64(p0, p1);
+}
+
+/* rgb_to_yuv() on 8 pixels */
+BLEND_SSE2
+static inline __m128i RGBToYSSE2(__m128i r, __m128i g, __m128i b)
+{
+    __m128i v = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)),
+                                            _mm_mullo_epi16(g, _mm_set1_epi16(129))),
+                              _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(25)),
+                                            _mm_set1_epi16(128)));
+    return _mm_add_epi16(_mm_srli_epi16(v, 8), _mm_set1_epi16(16));
+}
+
+BLEND_SSE2
+static inline __m128i RGBToChromaSSE2(__m128i r, __m128i g, __m128i b,
+                                      int16_t cr, int16_t cg, int16_t cb)
+{
+    __m128i v = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(cr)),
+                                            _mm_mullo_epi16(g, _mm_set1_epi16(cg))),
+                              _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(cb)),
+                                            _mm_set1_epi16(128)));
+    return _mm_add_epi16(_mm_srai_epi16(v, 8), _mm_set1_epi16(128));
+}
+
+/* dst[i] blended with src[i] */
+BLEND_SSE2
+static void BlendRowSSE2(uint8_t *dst, const uint8_t *src, const uint8_t *src_a,
+                         unsigned width, int alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i valpha = _mm_set1_epi16(alpha);
+    unsigned x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i *)&src[x]);
+        __m128i a = _mm_loadu_si128((const __m128i *)&src_a[x]);
+        Merge16SSE2(&dst[x], _mm_unpacklo_epi8(s, zero), _mm_unpackhi_epi8(s, zero),
+                    _mm_unpacklo_epi8(a, zero), _mm_unpackhi_epi8(a, zero), valpha);
+    }
+    for (; x < width; x++)
+        merge(&dst[x], src[x], div255(alpha * src_a[x]));
+}
+
+/* dst[i] blended with src[2i], from width source pixels */
+BLEND_SSE2
+static void BlendRowHalfSSE2(uint8_t *dst, const uint8_t *src, const uint8_t *src_a,
+                             unsigned width, int alpha)
+{
+    const __m128i valpha = _mm_set1_epi16(alpha);
+    unsigned x = 0;
+
+    for (; 2 * x + 16 <= width; x += 8)
+        Merge8SSE2(&dst[x], LoadEvenSSE2(&src[2 * x]), LoadEvenSSE2(&src_a[2 * x]),
+                   valpha);
+    for (; 2 * x < width; x++)
+        merge(&dst[x], src[2 * x], div255(alpha * src_a[2 * x]));
+}
+
+/* dst[2i] and dst[2i+1] blended with u[2i] and v[2i] */
+BLEND_SSE2
+static void BlendRowInterleavedSSE2(uint8_t *dst, const uint8_t *src_u,
+                                    const uint8_t *src_v, const uint8_t *src_a,
+                                    unsigned width, int alpha)
+{
+    const __m128i valpha = _mm_set1_epi16(alpha);
+    unsigned x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        __m128i u = LoadEvenSSE2(&src_u[x]);
+        __m128i v = LoadEvenSSE2(&src_v[x]);
+        __m128i a = LoadEvenSSE2(&src_a[x]);
+        Merge16SSE2(&dst[x], _mm_unpacklo_epi16(u, v), _mm_unpackhi_epi16(u, v),
+                    _mm_unpacklo_epi16(a, a), _mm_unpackhi_epi16(a, a), valpha);
+    }
+    for (; x < width; x += 2) {
+        unsigned a = div255(alpha * src_a[x]);
+        merge(&dst[x + 0], src_u[x], a);
+        merge(&dst[x + 1], src_v[x], a);
+    }
+}
+
+BLEND_SSE2
+static void BlendRowRGBAToRGB32SSE2(uint8_t *dst, const uint8_t *src,
+                                    unsigned width, int alpha, bool swap_rb)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i valpha = _mm_set1_epi16(alpha);
+    /* The fourth byte of the destination is left untouched */
+    const __m128i rgb = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    const __m128i mask_rb = _mm_set1_epi32(0x00ff00ff);
+    unsigned x = 0;
+
+    for (; x + 4 <= width; x += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *)&src[4 * x]);
+        if (swap_rb) {
+            __m128i rb = _mm_and_si128(s, mask_rb);
+            rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+            s = _mm_or_si128(_mm_andnot_si128(mask_rb, s), rb);
+        }
+        __m128i slo = _mm_unpacklo_epi8(s, zero);
+        __m128i shi = _mm_unpackhi_epi8(s, zero);
+        __m128i alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(slo, 0xff), 0xff);
+        __m128i ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(shi, 0xff), 0xff);
+        Merge16SSE2(&dst[4 * x], slo, shi,
+                    _mm_and_si128(alo, rgb), _mm_and_si128(ahi, rgb), valpha);
+    }
+    for (; x < width; x++) {
+        const uint8_t *s = &src[4 * x];
+        uint8_t *d = &dst[4 * x];
+        unsigned a = div255(alpha * s[3]);
+        merge(&d[swap_rb ? 2 : 0], s[0], a);
+        merge(&d[1], s[1], a);
+        merge(&d[swap_rb ? 0 : 2], s[2], a);
+    }
+}
+
+BLEND_SSE2
+static void BlendRowRGBAToYSSE2(uint8_t *dst, const uint8_t *src,
+                                unsigned width, int alpha)
+{
+    const __m128i valpha = _mm_set1_epi16(alpha);
+    unsigned x = 0;
+
+    for (; x + 8 <= width; x += 8) {
+        __m128i r, g, b, a;
+        SplitRGBASSE2(_mm_loadu_si128((const __m128i *)&src[4 * x]),
+                      _mm_loadu_si128((const __m128i *)&src[4 * x + 16]),
+                      &r, &g, &b, &a);
+        Merge8SSE2(&dst[x], RGBToYSSE2(r, g, b), a, valpha);
+    }
+    for (; x < width; x++) {
+        const uint8_t *s = &src[4 * x];
+        uint8_t y, u, v;
+        rgb_to_yuv(&y, &u, &v, s[0], s[1], s[2]);
+        merge(&dst[x], y, div255(alpha * s[3]));
+    }
+}
+
+/* dst_u[i] and dst_v[i] blended with the chroma of src[2i] */
+BLEND_SSE2
+static void BlendRowRGBAToUVSSE2(uint8_t *dst_u, uint8_t *dst_v, const uint8_t *src,
+                                 unsigned width, int alpha)
+{
+    const __m128i valpha = _mm_set1_epi16(alpha);
+    unsigned x = 0;
+
+    for (; 2 * x + 16 <= width; x += 8) {
+        __m128i r, g, b, a;
+        SplitRGBASSE2(LoadEvenRGBASSE2(&src[8 * x]),
+                      LoadEvenRGBASSE2(&src[8 * x + 32]),
+                      &r, &g, &b, &a);
+        Merge8SSE2(&dst_u[x], RGBToChromaSSE2(r, g, b, -38, -74, 112), a, valpha);
+        Merge8SSE2(&dst_v[x], RGBToChromaSSE2(r, g, b, 112, -94, -18), a, valpha);
+    }
+    for (; 2 * x < width; x++) {
+        const uint8_t *s = &src[8 * x];
+        uint8_t y, u, v;
+        rgb_to_yuv(&y, &u, &v, s[0], s[1], s[2]);
+        unsigned a = div255(alpha * s[3]);
+        merge(&dst_u[x], u, a);
+        merge(&dst_v[x], v, a);
+    }
+}
+
+/* Chroma is only blended from the pixels at even coordinates of the
+ * destination, as isFull() does for the generic blending */
+template <bool swap_uv>
+BLEND_SSE2
+void BlendYUVAToI420SSE2(const CPicture &dst, const CPicture &src,
+                         unsigned width, unsigned height, int alpha)
+{
+    const unsigned x0 = dst.getX() % 2;
+    const unsigned dst_u = swap_uv ? 2 : 1;
+    const unsigned dst_v = swap_uv ? 1 : 2;
+
+    for (unsigned y = 0; y < height; y++) {
+        const unsigned dy = dst.getY() + y;
+        const uint8_t *s[4];
+        for (unsigned plane = 0; plane < 4; plane++)
+            s[plane] = src.getPixels(plane) + y * src.getPitch(plane);
+
+        BlendRowSSE2(dst.getPixels(0) + y * dst.getPitch(0), s[0], s[3], width, alpha);
+        if (dy % 2 != 0 || width <= x0)
+            continue;
+
+        const unsigned cy = dy / 2 - dst.getY() / 2;
+        BlendRowHalfSSE2(dst.getPixels(dst_u, 2, 2) + cy * dst.getPitch(dst_u) + x0,
+                         s[1] + x0, s[3] + x0, width - x0, alpha);
+        BlendRowHalfSSE2(dst.getPixels(dst_v, 2, 2) + cy * dst.getPitch(dst_v) + x0,
+                         s[2] + x0, s[3] + x0, width - x0, alpha);
+    }
+}
+
+template <bool swap_uv>
+BLEND_SSE2
+void BlendYUVAToNV12SSE2(const CPicture &dst, const CPicture &src,
+                         unsigned width, unsigned height, int alpha)
+{
+    const unsigned x0 = dst.getX() % 2;
+
+    for (unsigned y = 0; y < height; y++) {
+        const unsigned dy = dst.getY() + y;
+        const uint8_t *s[4];
+        for (unsigned plane = 0; plane < 4; plane++)
+            s[plane] = src.getPixels(plane) + y * src.getPitch(plane);
+
+        BlendRowSSE2(dst.getPixels(0) + y * dst.getPitch(0), s[0], s[3], width, alpha);
+        if (dy % 2 != 0 || width <= x0)
+            continue;
+
+        const unsigned cy = dy / 2 - dst.getY() / 2;
+        BlendRowInterleavedSSE2(dst.getPixels(1, 2, 2, 2) + cy * dst.getPitch(1) + 2 * x0,
+                                s[swap_uv ? 2 : 1] + x0, s[swap_uv ? 1 : 2] + x0,
+                                s[3] + x0, width - x0, alpha);
+    }
+}
+
+template <bool swap_uv>
+BLEND_SSE2
+void BlendRGBAToI420SSE2(const CPicture &dst, const CPicture &src,
+                         unsigned width, unsigned height, int alpha)
+{
+    const unsigned x0 = dst.getX() % 2;
+    const unsigned dst_u = swap_uv ? 2 : 1;
+    const unsigned dst_v = swap_uv ? 1 : 2;
+
+    for (unsigned y = 0; y < height; y++) {
+        const unsigned dy = dst.getY() + y;
+        const uint8_t *s = src.getPixels(0, 1, 1, 4) + y * src.getPitch(0);
+
+        BlendRowRGBAToYSSE2(dst.getPixels(0) + y * dst.getPitch(0), s, width, alpha);
+        if (dy % 2 != 0 || width <= x0)
+            continue;
+
+        const unsigned cy = dy / 2 - dst.getY() / 2;
+        BlendRowRGBAToUVSSE2(dst.getPixels(dst_u, 2, 2) + cy * dst.getPitch(dst_u) + x0,
+                             dst.getPixels(dst_v, 2, 2) + cy * dst.getPitch(dst_v) + x0,
+                             s + 4 * x0, width - x0, alpha);
+    }
+}
+
+BLEND_SSE2
+static void BlendRGBAToRGB32SSE2(const CPicture &dst, const CPicture &src,
+                                 unsigned width, unsigned height, int alpha)
+{
+    const video_format_t *fmt = dst.getFormat();
+#ifdef WORDS_BIGENDIAN
+    const unsigned offset_r = (32 - fmt->i_lrshift) / 8;
+    const unsigned offset_g = (32 - fmt->i_lgshift) / 8;
+    const unsigned offset_b = (32 - fmt->i_lbshift) / 8;
+#else
+    const unsigned offset_r = fmt->i_lrshift / 8;
+    const unsigned offset_g = fmt->i_lgshift / 8;
+    const unsigned offset_b = fmt->i_lbshift / 8;
+#endif
+    /* Only the layouts with the padding byte last are handled */
+    if (offset_g != 1 || offset_r + offset_b != 2 || offset_r == 1) {
+        Blend<CPictureRGB32, CPictureRGBA, compose<convertNone, convertNone> >
+            (dst, src, width, height, alpha);
+        return;
+    }
+
+    for (unsigned y = 0; y < height; y++)
+        BlendRowRGBAToRGB32SSE2(dst.getPixels(0, 1, 1, 4) + y * dst.getPitch(0),
+                                src.getPixels(0, 1, 1, 4) + y * src.getPitch(0),
+                                width, alpha, offset_r == 2);
+}
+
+static const struct {
+    vlc_fourcc_t     dst;
+    vlc_fourcc_t     src;
+    blend_function_t blend;
+} blends_sse2[] = {
+    { VLC_CODEC_I420,  VLC_CODEC_YUVA, BlendYUVAToI420SSE2<false> },
+    { VLC_CODEC_J420,  VLC_CODEC_YUVA, BlendYUVAToI420SSE2<false> },
+    { VLC_CODEC_YV12,  VLC_CODEC_YUVA, BlendYUVAToI420SSE2<true> },
+    { VLC_CODEC_NV12,  VLC_CODEC_YUVA, BlendYUVAToNV12SSE2<false> },
+    { VLC_CODEC_NV21,  VLC_CODEC_YUVA, BlendYUVAToNV12SSE2<true> },
+    { VLC_CODEC_I420,  VLC_CODEC_RGBA, BlendRGBAToI420SSE2<false> },
+    { VLC_CODEC_J420,  VLC_CODEC_RGBA, BlendRGBAToI420SSE2<false> },
+    { VLC_CODEC_YV12,  VLC_CODEC_RGBA, BlendRGBAToI420SSE2<true> },
+    { VLC_CODEC_RGB32, VLC_CODEC_RGBA, BlendRGBAToRGB32SSE2 },
+};
+#endif
+
 struct filter_sys_t {
     filter_sys_t() : blend(NULL)
     {
@@ -674,6 +1065,14 @@ static int Open(vlc_object_t *object)
         if (blends[i].src == src && blends[i].dst == dst)
             sys->blend = blends[i].blend;
     }
+#ifdef CAN_BLEND_SSE2
+    if (vlc_CPU_SSE2()) {
+        for (size_t i = 0; i < sizeof(blends_sse2) / sizeof(*blends_sse2); i++) {
+            if (blends_sse2[i].src == src && blends_sse2[i].dst == dst)
+                sys->blend = blends_sse2[i].blend;
+        }
+    }
+#endif
 
     if (!sys->blend) {
        msg_Err(filter, "no matching alpha blending routine (chroma: %4.4s -> %4.4s)",
@@ -59,14 +59,17 @@ static picture_t *Filter( filter_t *, picture_t * );
 #define BASE_IMAGE_LONGTEXT N_("The image which will be used to blend onto")
 
 #define BASE_CHROMA_TEXT N_("Chroma for the base image")
-#define BASE_CHROMA_LONGTEXT N_("Chroma which the base image will be loaded in")
+#define BASE_CHROMA_LONGTEXT N_("Chroma which the base image will be loaded " \
+                                "in. Several comma-separated chromas can be " \
+                                "given to benchmark each of them.")
 
 #define BLEND_IMAGE_TEXT N_("Image which will be blended")
 #define BLEND_IMAGE_LONGTEXT N_("The image blended onto the base image")
 
 #define BLEND_CHROMA_TEXT N_("Chroma for the blend image")
 #define BLEND_CHROMA_LONGTEXT N_("Chroma which the blend image will be loaded" \
-                                 " in")
+                                 " in. Several comma-separated chromas can " \
+                                 "be given to benchmark each of them.")
 
 #define CFG_PREFIX "blendbench-"
 
@@ -111,11 +114,11 @@ struct filter_sys_t
     bool b_done;
     int i_loops, i_alpha;
 
-    picture_t *p_base_image;
-    picture_t *p_blend_image;
-
-    vlc_fourcc_t i_base_chroma;
-    vlc_fourcc_t i_blend_chroma;
+    /* One image per requested chroma */
+    int i_base_images;
+    picture_t **pp_base_images;
+    int i_blend_images;
+    picture_t **pp_blend_images;
 };
 
 static int blendbench_LoadImage( vlc_object_t *p_this, picture_t **pp_pic,
@@ -145,6 +148,49 @@ static int blendbench_LoadImage( vlc_object_t *p_this, picture_t **pp_pic,
     return VLC_SUCCESS;
 }
 
+/* Loads the image once in each chroma of the comma-separated list */
+static int blendbench_LoadImages( vlc_object_t *p_this, picture_t ***ppp_pics,
+                                  int *pi_pics, const char *psz_chromas,
+                                  char *psz_file, const char *psz_name )
+{
+    char *psz_list = strdup( psz_chromas );
+    if( psz_list == NULL )
+        return VLC_ENOMEM;
+
+    *ppp_pics = NULL;
+    *pi_pics = 0;
+
+    char *psz_state;
+    for( char *psz_chroma = strtok_r( psz_list, ",", &psz_state );
+         psz_chroma != NULL;
+         psz_chroma = strtok_r( NULL, ",", &psz_state ) )
+    {
+        if( strlen( psz_chroma ) < 4 )
+        {
+            msg_Err( p_this, "Invalid %s chroma %s", psz_name, psz_chroma );
+            continue;
+        }
+
+        picture_t *p_pic;
+        if( blendbench_LoadImage( p_this, &p_pic,
+                                  VLC_FOURCC( psz_chroma[0], psz_chroma[1],
+                                              psz_chroma[2], psz_chroma[3] ),
+                                  psz_file, psz_name ) != VLC_SUCCESS )
+            continue;
+        TAB_APPEND( *pi_pics, *ppp_pics, p_pic );
+    }
+    free( psz_list );
+
+    return *pi_pics > 0 ? VLC_SUCCESS : VLC_EGENERIC;
+}
+
+static void blendbench_ReleaseImages( picture_t **pp_pics, int i_pics )
+{
+    for( int i = 0; i < i_pics; i++ )
+        picture_Release( pp_pics[i] );
+    free( pp_pics );
+}
+
 /*****************************************************************************
  * Create: allocates video thread output method
  *****************************************************************************/
@@ -176,11 +222,10 @@ static int Create( vlc_object_t *p_this )
                                                   CFG_PREFIX "alpha" );
 
     psz_temp = var_CreateGetStringCommand( p_filter, CFG_PREFIX "base-chroma" );
-    p_sys->i_base_chroma = VLC_FOURCC( psz_temp[0], psz_temp[1],
-                                       psz_temp[2], psz_temp[3] );
     psz_cmd = var_CreateGetStringCommand( p_filter, CFG_PREFIX "base-image" );
-    i_ret = blendbench_LoadImage( p_this, &p_sys->p_base_image,
-                                  p_sys->i_base_chroma, psz_cmd, "Base" );
+    i_ret = blendbench_LoadImages( p_this, &p_sys->pp_base_images,
+                                   &p_sys->i_base_images, psz_temp, psz_cmd,
+                                   "Base" );
     free( psz_temp );
     free( psz_cmd );
     if( i_ret != VLC_SUCCESS )
@@ -191,13 +236,19 @@ static int Create( vlc_object_t *p_this )
 
     psz_temp = var_CreateGetStringCommand( p_filter,
                                            CFG_PREFIX "blend-chroma" );
-    p_sys->i_blend_chroma = VLC_FOURCC( psz_temp[0], psz_temp[1],
-                                        psz_temp[2], psz_temp[3] );
     psz_cmd = var_CreateGetStringCommand( p_filter, CFG_PREFIX "blend-image" );
-    blendbench_LoadImage( p_this, &p_sys->p_blend_image, p_sys->i_blend_chroma,
-                          psz_cmd, "Blend" );
+    i_ret = blendbench_LoadImages( p_this, &p_sys->pp_blend_images,
+                                   &p_sys->i_blend_images, psz_temp, psz_cmd,
+                                   "Blend" );
     free( psz_temp );
     free( psz_cmd );
+    if( i_ret != VLC_SUCCESS )
+    {
+        blendbench_ReleaseImages( p_sys->pp_base_images,
+                                  p_sys->i_base_images );
+        free( p_sys );
+        return i_ret;
+    }
 
     return VLC_SUCCESS;
 }
@@ -210,57 +261,81 @@ static void Destroy( vlc_object_t *p_this )
     filter_t *p_filter = (filter_t *)p_this;
     filter_sys_t *p_sys = p_filter->p_sys;
 
-    picture_Release( p_sys->p_base_image );
-    picture_Release( p_sys->p_blend_image );
+    blendbench_ReleaseImages( p_sys->pp_base_images, p_sys->i_base_images );
+    blendbench_ReleaseImages( p_sys->pp_blend_images, p_sys->i_blend_images );
+    free( p_sys );
 }
 
 /*****************************************************************************
- * Render: displays previously rendered output
+ * Benchmark: blends one image onto the other and reports the throughput
  *****************************************************************************/
-static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+static void Benchmark( filter_t *p_filter, picture_t *p_base,
+                       picture_t *p_blend )
 {
     filter_sys_t *p_sys = p_filter->p_sys;
-    filter_t *p_blend;
-
-    if( p_sys->b_done )
-        return p_pic;
-
-    p_blend = vlc_object_create( p_filter, sizeof(filter_t) );
-    if( !p_blend )
-    {
-        picture_Release( p_pic );
-        return NULL;
-    }
-    p_blend->fmt_out.video = p_sys->p_base_image->format;
-    p_blend->fmt_in.video = p_sys->p_blend_image->format;
-    p_blend->p_module = module_need( p_blend, "video blending", NULL, false );
-    if( !p_blend->p_module )
+    const vlc_fourcc_t i_base_chroma = p_base->format.i_chroma;
+    const vlc_fourcc_t i_blend_chroma = p_blend->format.i_chroma;
+    filter_t *p_blender;
+
+    p_blender = vlc_object_create( p_filter, sizeof(filter_t) );
+    if( !p_blender )
+        return;
+    p_blender->fmt_out.video = p_base->format;
+    p_blender->fmt_in.video = p_blend->format;
+    p_blender->p_module = module_need( p_blender, "video blending", NULL, false );
+    if( !p_blender->p_module )
     {
-        picture_Release( p_pic );
-        vlc_object_release( p_blend );
-        return NULL;
+        msg_Warn( p_filter, "Cannot blend %4.4s onto %4.4s",
+                  (const char *)&i_blend_chroma, (const char *)&i_base_chroma );
+        vlc_object_release( p_blender );
+        return;
     }
 
     mtime_t time = mdate();
     for( int i_iter = 0; i_iter < p_sys->i_loops; ++i_iter )
     {
-        p_blend->pf_video_blend( p_blend,
-                                 p_sys->p_base_image, p_sys->p_blend_image,
-                                 0, 0, p_sys->i_alpha );
+        p_blender->pf_video_blend( p_blender, p_base, p_blend,
+                                   0, 0, p_sys->i_alpha );
     }
     time = mdate() - time;
-
-    msg_Info( p_filter, "Blended %d images in %f sec", p_sys->i_loops,
-              time / 1000000.0f );
-    msg_Info( p_filter, "Speed is: %f images/second, %f pixels/second",
+    if( time <= 0 )
+        time = 1;
+
+    /* The blended area is the smallest of both images */
+    const float f_pixels =
+        (float)__MIN( p_base->format.i_visible_width,
+                      p_blend->format.i_visible_width ) *
+        __MIN( p_base->format.i_visible_height,
+               p_blend->format.i_visible_height );
+
+    msg_Info( p_filter, "%4.4s onto %4.4s: blended %d images in %f sec",
+              (const char *)&i_blend_chroma, (const char *)&i_base_chroma,
+              p_sys->i_loops, time / 1000000.0f );
+    msg_Info( p_filter, "%4.4s onto %4.4s: %f images/second, "
+              "%f pixels/second",
+              (const char *)&i_blend_chroma, (const char *)&i_base_chroma,
               (float) p_sys->i_loops / time * 1000000,
-              (float) p_sys->i_loops / time * 1000000 *
-                  p_sys->p_blend_image->p[Y_PLANE].i_visible_pitch *
-                  p_sys->p_blend_image->p[Y_PLANE].i_visible_lines );
+              (float) p_sys->i_loops / time * 1000000 * f_pixels );
+
+    module_unneed( p_blender, p_blender->p_module );
+
+    vlc_object_release( p_blender );
+}
 
-    module_unneed( p_blend, p_blend->p_module );
+/*****************************************************************************
+ * Render: displays previously rendered output
+ *****************************************************************************/
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( p_sys->b_done )
+        return p_pic;
 
-    vlc_object_release( p_blend );
+    for( int i = 0; i < p_sys->i_base_images; i++ )
+        for( int j = 0; j < p_sys->i_blend_images; j++ )
+            Benchmark( p_filter, p_sys->pp_base_images[i],
+                       p_sys->pp_blend_images[j] );
 
     p_sys->b_done = true;
     return p_pic;
@@ -84,6 +84,21 @@ struct decoder_owner_sys_t
 
     /* fifo */
     block_fifo_t *p_fifo;
+    /* decoder thread waiting for blocks (protected by the fifo lock) */
+    vlc_cond_t    wait_data;
+    /* blocks taken at once from the fifo, not decoded yet (protected by lock) */
+    block_t      *p_batch;
+    size_t        i_batch_size;
+    /* One block at a time is followed from the demuxer to the decoder, for
+     * the latency statistics: while queued (protected by the fifo lock),
+     * then once taken (decoder thread only) */
+    struct
+    {
+        block_t *p_queued;
+        mtime_t  i_queued_date;
+        block_t *p_taken;
+        mtime_t  i_taken_date;
+    } latency;
 
     /* Lock for communication with decoder thread */
     vlc_mutex_t lock;
@@ -184,6 +199,22 @@ static block_t *DecoderBlockFlushNew()
     return p_null;
 }
 
+/**
+ * Queues blocks into the locked decoder fifo.
+ *
+ * The decoder thread only waits on an empty fifo, and takes all the queued
+ * blocks at once, so it is woken up only when the fifo was empty.
+ */
+static void DecoderQueueUnlocked( decoder_owner_sys_t *p_owner,
+                                  block_t *p_block )
+{
+    const bool b_empty = vlc_fifo_IsEmpty( p_owner->p_fifo );
+
+    vlc_fifo_QueueUnlocked( p_owner->p_fifo, p_block );
+    if( b_empty && p_block != NULL )
+        vlc_cond_signal( &p_owner->wait_data );
+}
+
 /*****************************************************************************
  * Buffers allocation callbacks for the decoders
  *****************************************************************************/
@@ -685,6 +716,16 @@ static void DecoderFixTs( decoder_t *p_dec, mtime_t *pi_ts0, mtime_t *pi_ts1,
         *pi_rate = i_rate;
 }
 
+/* Counts the delay until a system date in a latency histogram */
+static void DecoderUpdateLatency( counter_t *p_counter, mtime_t i_date )
+{
+    if( p_counter != NULL )
+    {
+        mtime_t i_delay = i_date - mdate();
+        stats_Update( p_counter, __MAX( i_delay, 0 ), NULL );
+    }
+}
+
 /**
  * If *pb_reject, it does nothing, otherwise it waits for the given
  * deadline or a flush request (in which case it set *pi_reject to true.
@@ -842,8 +883,12 @@ static void DecoderGetCc( decoder_t *p_dec, decoder_t *p_dec_cc )
         if( !p_owner->cc.pp_decoder[i] )
             continue;
 
-        block_FifoPut( p_owner->cc.pp_decoder[i]->p_owner->p_fifo,
-            (i_cc_decoder > 1) ? block_Duplicate(p_cc) : p_cc);
+        decoder_owner_sys_t *p_ccowner = p_owner->cc.pp_decoder[i]->p_owner;
+
+        vlc_fifo_Lock( p_ccowner->p_fifo );
+        DecoderQueueUnlocked( p_ccowner,
+                              (i_cc_decoder > 1) ? block_Duplicate(p_cc) : p_cc );
+        vlc_fifo_Unlock( p_ccowner->p_fifo );
 
         i_cc_decoder--;
         b_processed = true;
@@ -907,6 +952,9 @@ static void DecoderPlayVideo( decoder_t *p_dec, picture_t *p_picture,
             vout_Flush( p_vout, p_picture->date );
             p_owner->i_last_rate = i_rate;
         }
+        if( p_owner->p_input != NULL )
+            DecoderUpdateLatency( p_owner->p_input->p->counters.p_decode_display,
+                                  p_picture->date );
         vout_PutPicture( p_vout, p_picture );
     }
     else
@@ -975,12 +1023,10 @@ static void DecoderDecodeVideo( decoder_t *p_dec, block_t *p_block )
 
     if( p_input != NULL && (i_decoded > 0 || i_lost > 0 || i_displayed > 0) )
     {
-        vlc_mutex_lock( &p_input->p->counters.counters_lock );
         stats_Update( p_input->p->counters.p_decoded_video, i_decoded, NULL );
         stats_Update( p_input->p->counters.p_lost_pictures, i_lost , NULL);
         stats_Update( p_input->p->counters.p_displayed_pictures,
                       i_displayed, NULL);
-        vlc_mutex_unlock( &p_input->p->counters.counters_lock );
     }
 }
 
@@ -1098,6 +1144,9 @@ race:
     if( !b_reject )
     {
         assert( !p_owner->b_paused );
+        if( p_owner->p_input != NULL )
+            DecoderUpdateLatency( p_owner->p_input->p->counters.p_aout_delay,
+                                  p_audio->i_pts );
         if( !aout_DecPlay( p_aout, p_audio, i_rate ) )
             *pi_played_sum += 1;
         *pi_lost_sum += aout_DecGetResetLost( p_aout );
@@ -1155,11 +1204,9 @@ static void DecoderDecodeAudio( decoder_t *p_dec, block_t *p_block )
 
     if( p_input != NULL && (i_decoded > 0 || i_lost > 0 || i_played > 0) )
     {
-        vlc_mutex_lock( &p_input->p->counters.counters_lock);
         stats_Update( p_input->p->counters.p_lost_abuffers, i_lost, NULL );
         stats_Update( p_input->p->counters.p_played_abuffers, i_played, NULL );
         stats_Update( p_input->p->counters.p_decoded_audio, i_decoded, NULL );
-        vlc_mutex_unlock( &p_input->p->counters.counters_lock);
     }
 }
 
@@ -1264,11 +1311,7 @@ static void DecoderProcessSpu( decoder_t *p_dec, block_t *p_block, bool b_flush
     while( (p_spu = p_dec->pf_decode_sub( p_dec, p_block ? &p_block : NULL ) ) )
     {
         if( p_input != NULL )
-        {
-            vlc_mutex_lock( &p_input->p->counters.counters_lock );
             stats_Update( p_input->p->counters.p_decoded_sub, 1, NULL );
-            vlc_mutex_unlock( &p_input->p->counters.counters_lock );
-        }
 
         p_vout = input_resource_HoldVout( p_owner->p_resource );
         if( p_vout && p_owner->p_spu_vout == p_vout )
@@ -1411,31 +1454,78 @@ static void *DecoderThread( void *p_data )
     {
         block_t *p_block;
 
-        vlc_fifo_Lock( p_owner->p_fifo );
-        vlc_cond_signal( &p_owner->wait_acknowledge );
-        vlc_mutex_unlock( &p_owner->lock );
-        vlc_fifo_CleanupPush( p_owner->p_fifo );
-
-        vlc_cond_signal( &p_owner->wait_fifo );
+        /* Discard the blocks taken before a flush request */
+        while( p_owner->b_flushing && p_owner->p_batch != NULL
+            && !(p_owner->p_batch->i_flags & BLOCK_FLAG_CORE_FLUSH) )
+        {
+            p_block = p_owner->p_batch;
+            p_owner->p_batch = p_block->p_next;
+            p_owner->i_batch_size -= p_block->i_buffer;
+            if( p_block == p_owner->latency.p_taken )
+                p_owner->latency.p_taken = NULL;
+            block_Release( p_block );
+        }
 
-        while( vlc_fifo_IsEmpty( p_owner->p_fifo ) )
+        if( p_owner->p_batch != NULL )
         {
-            if( p_owner->b_draining )
-            {   /* We have emptied the FIFO and there is a pending request to
-                 * drain. Pass p_block = NULL to decoder just once. */
-                p_owner->b_draining = false;
-                break;
+            p_block = p_owner->p_batch;
+            p_owner->p_batch = p_block->p_next;
+            p_owner->i_batch_size -= p_block->i_buffer;
+            p_block->p_next = NULL;
+            vlc_mutex_unlock( &p_owner->lock );
+        }
+        else
+        {
+            size_t i_size;
+
+            vlc_fifo_Lock( p_owner->p_fifo );
+            vlc_cond_signal( &p_owner->wait_acknowledge );
+            vlc_mutex_unlock( &p_owner->lock );
+            vlc_fifo_CleanupPush( p_owner->p_fifo );
+
+            vlc_cond_signal( &p_owner->wait_fifo );
+
+            while( vlc_fifo_IsEmpty( p_owner->p_fifo ) )
+            {
+                if( p_owner->b_draining )
+                {   /* We have emptied the FIFO and there is a pending request to
+                     * drain. Pass p_block = NULL to decoder just once. */
+                    p_owner->b_draining = false;
+                    break;
+                }
+
+                p_owner->b_idle = true;
+                vlc_fifo_WaitCond( p_owner->p_fifo, &p_owner->wait_data );
+                /* Make sure there is no cancellation point other than this one^^.
+                 * If you need one, be sure to push cleanup of p_block. */
+                p_owner->b_idle = false;
             }
 
-            p_owner->b_idle = true;
-            vlc_fifo_Wait( p_owner->p_fifo );
-            /* Make sure there is no cancellation point other than this one^^.
-             * If you need one, be sure to push cleanup of p_block. */
-            p_owner->b_idle = false;
+            /* Take all queued blocks at once, so that the FIFO is not locked
+             * again, nor this thread woken up, for each of them. */
+            i_size = vlc_fifo_GetBytes( p_owner->p_fifo );
+            p_block = vlc_fifo_DequeueAllUnlocked( p_owner->p_fifo );
+            p_owner->latency.p_taken = p_owner->latency.p_queued;
+            p_owner->latency.i_taken_date = p_owner->latency.i_queued_date;
+            p_owner->latency.p_queued = NULL;
+            vlc_cleanup_run();
+
+            if( p_block != NULL && p_block->p_next != NULL )
+            {
+                vlc_mutex_lock( &p_owner->lock );
+                p_owner->p_batch = p_block->p_next;
+                p_owner->i_batch_size = i_size - p_block->i_buffer;
+                vlc_mutex_unlock( &p_owner->lock );
+                p_block->p_next = NULL;
+            }
         }
 
-        p_block = vlc_fifo_DequeueUnlocked( p_owner->p_fifo );
-        vlc_cleanup_run();
+        if( p_block != NULL && p_block == p_owner->latency.p_taken )
+        {
+            stats_Update( p_owner->p_input->p->counters.p_demux_decode,
+                          mdate() - p_owner->latency.i_taken_date, NULL );
+            p_owner->latency.p_taken = NULL;
+        }
 
         int canc = vlc_savecancel();
         DecoderProcess( p_dec, p_block );
@@ -1531,6 +1621,10 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
     es_format_Init( &p_owner->fmt, UNKNOWN_ES, 0 );
 
     /* decoder fifo */
+    p_owner->p_batch = NULL;
+    p_owner->i_batch_size = 0;
+    p_owner->latency.p_queued = NULL;
+    p_owner->latency.p_taken = NULL;
     p_owner->p_fifo = block_FifoNew();
     if( unlikely(p_owner->p_fifo == NULL) )
     {
@@ -1543,6 +1637,7 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
     vlc_cond_init( &p_owner->wait_request );
     vlc_cond_init( &p_owner->wait_acknowledge );
     vlc_cond_init( &p_owner->wait_fifo );
+    vlc_cond_init( &p_owner->wait_data );
 
     /* Set buffers allocation callbacks for the decoders */
     p_dec->pf_aout_format_update = aout_update_format;
@@ -1640,6 +1735,7 @@ static void DeleteDecoder( decoder_t * p_dec )
 
     /* Free all packets still in the decoder fifo. */
     block_FifoRelease( p_owner->p_fifo );
+    block_ChainRelease( p_owner->p_batch );
 
     /* Cleanup */
     if( p_owner->p_aout )
@@ -1701,6 +1797,7 @@ static void DeleteDecoder( decoder_t * p_dec )
         vlc_object_release( p_owner->p_packetizer );
     }
 
+    vlc_cond_destroy( &p_owner->wait_data );
     vlc_cond_destroy( &p_owner->wait_fifo );
     vlc_cond_destroy( &p_owner->wait_acknowledge );
     vlc_cond_destroy( &p_owner->wait_request );
@@ -1864,6 +1961,7 @@ void input_DecoderDecode( decoder_t *p_dec, block_t *p_block, bool b_do_pace )
             msg_Warn( p_dec, "decoder/packetizer fifo full (data not "
                       "consumed quickly enough), resetting fifo!" );
             block_ChainRelease( vlc_fifo_DequeueAllUnlocked( p_owner->p_fifo ) );
+            p_owner->latency.p_queued = NULL;
         }
     }
     else
@@ -1875,7 +1973,14 @@ void input_DecoderDecode( decoder_t *p_dec, block_t *p_block, bool b_do_pace )
             vlc_fifo_WaitCond( p_owner->p_fifo, &p_owner->wait_fifo );
     }
 
-    vlc_fifo_QueueUnlocked( p_owner->p_fifo, p_block );
+    if( p_owner->latency.p_queued == NULL && p_owner->p_input != NULL
+     && p_owner->p_input->p->counters.p_demux_decode != NULL )
+    {
+        p_owner->latency.p_queued = p_block;
+        p_owner->latency.i_queued_date = mdate();
+    }
+
+    DecoderQueueUnlocked( p_owner, p_block );
     vlc_fifo_Unlock( p_owner->p_fifo );
 }
 
@@ -1891,7 +1996,9 @@ bool input_DecoderIsEmpty( decoder_t * p_dec )
     bool b_empty;
 
     vlc_mutex_lock( &p_owner->lock );
-    if( p_owner->fmt.i_cat == VIDEO_ES && p_owner->p_vout != NULL )
+    if( p_owner->p_batch != NULL )
+        b_empty = false;
+    else if( p_owner->fmt.i_cat == VIDEO_ES && p_owner->p_vout != NULL )
         b_empty = vout_IsEmpty( p_owner->p_vout );
     else if( p_owner->fmt.i_cat == AUDIO_ES )
         b_empty = p_owner->b_drained;
@@ -1916,7 +2023,7 @@ void input_DecoderDrain( decoder_t *p_dec )
 
     vlc_fifo_Lock( p_owner->p_fifo );
     p_owner->b_draining = true;
-    vlc_fifo_Signal( p_owner->p_fifo );
+    vlc_cond_signal( &p_owner->wait_data );
     vlc_fifo_Unlock( p_owner->p_fifo );
 }
 
@@ -1929,6 +2036,7 @@ static void DecoderFlush( decoder_t *p_dec )
     vlc_fifo_Lock( p_owner->p_fifo );
     /* Empty the fifo */
     block_ChainRelease( vlc_fifo_DequeueAllUnlocked( p_owner->p_fifo ) );
+    p_owner->latency.p_queued = NULL;
     p_owner->b_draining = false; /* flush supersedes drain */
     vlc_fifo_Unlock( p_owner->p_fifo );
 
@@ -2188,8 +2296,13 @@ bool input_DecoderHasFormatChanged( decoder_t *p_dec, es_format_t *p_fmt, vlc_me
 size_t input_DecoderGetFifoSize( decoder_t *p_dec )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    size_t i_size;
+
+    vlc_mutex_lock( &p_owner->lock );
+    i_size = p_owner->i_batch_size;
+    vlc_mutex_unlock( &p_owner->lock );
 
-    return block_FifoSize( p_owner->p_fifo );
+    return i_size + block_FifoSize( p_owner->p_fifo );
 }
 
 void input_DecoderGetObjects( decoder_t *p_dec,
@@ -1911,7 +1911,6 @@ static int EsOutSend( es_out_t *out, es_out_id_t *es, block_t *p_block )
     {
         uint64_t i_total;
 
-        vlc_mutex_lock( &p_input->p->counters.counters_lock );
         stats_Update( p_input->p->counters.p_demux_read,
                       p_block->i_buffer, &i_total );
         stats_Update( p_input->p->counters.p_demux_bitrate, i_total, NULL );
@@ -1926,7 +1925,6 @@ static int EsOutSend( es_out_t *out, es_out_id_t *es, block_t *p_block )
         {
             stats_Update( p_input->p->counters.p_demux_discontinuity, 1, NULL );
         }
-        vlc_mutex_unlock( &p_input->p->counters.counters_lock );
     }
 
     vlc_mutex_lock( &p_sys->lock );
@@ -36,6 +36,10 @@
 #endif
 #include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
+#ifdef HAVE_MMAP
+#  include <sys/mman.h>
+#endif
 
 #include <vlc_common.h>
 #include <vlc_fs.h>
@@ -83,7 +87,8 @@ typedef struct attribute_packed
 {
     es_out_id_t *p_es;
     block_t *p_block;
-    int     i_offset;  /* We do not use file > INT_MAX */
+    int     i_offset;  /* We do not use file > INT_MAX, -1 if lost */
+    bool    b_key;     /* Picture decodable on its own */
 } ts_cmd_send_t;
 
 typedef struct attribute_packed
@@ -150,6 +155,9 @@ typedef struct attribute_packed
     } u;
 } ts_cmd_t;
 
+#define TS_STORAGE_CMD_MAX (30000)
+#define TS_STORAGE_WRITE_SIZE (64 * 1024)
+
 typedef struct ts_storage_t ts_storage_t;
 struct ts_storage_t
 {
@@ -157,13 +165,25 @@ struct ts_storage_t
 
     /* */
     char    *psz_file;  /* Filename */
+    int     fd;         /* Data is appended with write(), through p_write */
     size_t  i_file_max; /* Max size in bytes */
-    int64_t i_file_size;/* Current size in bytes */
-    FILE    *p_filew;   /* FILE handle for data writing */
-    FILE    *p_filer;   /* FILE handle for data reading */
+    size_t  i_file_size;/* Current size in bytes, buffered data included */
+    uint8_t *p_write;   /* Data not written yet, or NULL */
+    size_t  i_write;
+#ifdef HAVE_MMAP
+    uint8_t *p_map;     /* Read-only mapping of i_file_max bytes, or NULL */
+#endif
+
+    /* Time index */
+    mtime_t i_date_last;  /* Date of the last command */
+    mtime_t i_time_first; /* Input time of the first/last ES_OUT_SET_TIMES */
+    mtime_t i_time_last;
 
     /* */
+    int      i_cmd_s;   /* First command one may seek back to */
     int      i_cmd_r;
+    int      i_cmd_x;   /* Commands already played once */
+    int      i_cmd_f;   /* First command with buffered data */
     int      i_cmd_w;
     int      i_cmd_max;
     ts_cmd_t *p_cmd;
@@ -175,6 +195,7 @@ typedef struct
     input_thread_t *p_input;
     es_out_t       *p_out;
     int64_t        i_tmp_size_max;
+    mtime_t        i_tmp_duration;
     const char     *psz_tmp_path;
 
     /* Lock for all following fields */
@@ -194,12 +215,19 @@ typedef struct
     /* */
     mtime_t        i_buffering_delay;
 
-    /* */
+    /* Segments from the oldest one kept for seeking back (h) to the one
+     * being written (w), and a played one kept for reuse (f) */
+    ts_storage_t   *p_storage_h;
     ts_storage_t   *p_storage_r;
     ts_storage_t   *p_storage_w;
+    ts_storage_t   *p_storage_f;
 
     mtime_t        i_cmd_delay;
 
+    /* Input time of the last command played for the first time */
+    mtime_t        i_time_x;
+    unsigned       i_seek;
+
 } ts_thread_t;
 
 struct es_out_id_t
@@ -214,6 +242,7 @@ struct es_out_sys_t
 
     /* Configuration */
     int64_t        i_tmp_size_max;    /* Maximal temporary file size in byte */
+    mtime_t        i_tmp_duration;    /* Played duration kept for seeking back */
     char           *psz_tmp_path;     /* Path for temporary files */
 
     /* Lock for all following fields */
@@ -241,27 +270,35 @@ static int          Control( es_out_t *, int i_query, va_list );
 static void         Destroy( es_out_t * );
 
 static int          TsStart( es_out_t * );
+static void         TsAutoStart( es_out_t * );
 static void         TsAutoStop( es_out_t * );
 
-static void         TsStop( ts_thread_t * );
+static void         TsStop( ts_thread_t *, bool b_apply );
 static void         TsPushCmd( ts_thread_t *, ts_cmd_t * );
 static int          TsPopCmdLocked( ts_thread_t *, ts_cmd_t *, bool b_flush );
 static bool         TsHasCmd( ts_thread_t * );
 static bool         TsIsUnused( ts_thread_t * );
 static int          TsChangePause( ts_thread_t *, bool b_source_paused, bool b_paused, mtime_t i_date );
 static int          TsChangeRate( ts_thread_t *, int i_src_rate, int i_rate );
+static int          TsSeek( ts_thread_t *, mtime_t i_time );
 
 static void         *TsRun( void * );
 
 static ts_storage_t *TsStorageNew( const char *psz_path, int64_t i_tmp_size_max );
 static void         TsStorageDelete( ts_storage_t * );
+static int          TsStorageReset( ts_storage_t * );
+static void         TsStorageUnmap( ts_storage_t * );
+static int          TsStorageFlush( ts_storage_t * );
 static void         TsStoragePack( ts_storage_t *p_storage );
 static bool         TsStorageIsFull( ts_storage_t *, const ts_cmd_t *p_cmd );
 static bool         TsStorageIsEmpty( ts_storage_t * );
-static void         TsStoragePushCmd( ts_storage_t *, const ts_cmd_t *p_cmd, bool b_flush );
-static void         TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush );
+static void         TsStoragePushCmd( ts_storage_t *, const ts_cmd_t *p_cmd );
+static int          TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush );
+
+static size_t       TsCmdSize( const ts_cmd_t * );
 
 static void CmdClean( ts_cmd_t * );
+static bool CmdIsReplayable( const ts_cmd_t * );
 static void cmd_cleanup_routine( void *p ) { CmdClean( p ); }
 
 static int  CmdInitAdd    ( ts_cmd_t *, es_out_id_t *, const es_format_t *, bool b_copy );
@@ -282,7 +319,7 @@ static int  CmdExecuteControl( es_out_t *, ts_cmd_t * );
 
 /* File helpers */
 static char *GetTmpPath( char *psz_path );
-static FILE *GetTmpFile( char **ppsz_file, const char *psz_path );
+static int GetTmpFile( char **ppsz_file, const char *psz_path );
 
 /*****************************************************************************
  * input_EsOutTimeshiftNew:
@@ -330,11 +367,16 @@ es_out_t *input_EsOutTimeshiftNew( input_thread_t *p_input, es_out_t *p_next_out
     else
         p_sys->i_tmp_size_max = __MAX( i_tmp_size_max, 1*1024*1024 );
 
+    const int i_tmp_duration = var_CreateGetInteger( p_input, "input-timeshift-duration" );
+    p_sys->i_tmp_duration = CLOCK_FREQ * __MAX( i_tmp_duration, 0 );
+
     char *psz_tmp_path = var_CreateGetNonEmptyString( p_input, "input-timeshift-path" );
     p_sys->psz_tmp_path = GetTmpPath( psz_tmp_path );
 
     msg_Dbg( p_input, "using timeshift granularity of %d MiB, in path '%s'",
              (int)p_sys->i_tmp_size_max/(1024*1024), p_sys->psz_tmp_path );
+    if( p_sys->i_tmp_duration > 0 )
+        msg_Dbg( p_input, "keeping %d s of played timeshift data", i_tmp_duration );
 
 #if 0
 #define S(t) msg_Err( p_input, "SIZEOF("#t")=%d", sizeof(t) )
@@ -358,7 +400,7 @@ static void Destroy( es_out_t *p_out )
 
     if( p_sys->b_delayed )
     {
-        TsStop( p_sys->p_ts );
+        TsStop( p_sys->p_ts, false );
         p_sys->b_delayed = false;
     }
 
@@ -384,6 +426,7 @@ static es_out_id_t *Add( es_out_t *p_out, const es_format_t *p_fmt )
     vlc_mutex_lock( &p_sys->lock );
 
     TsAutoStop( p_out );
+    TsAutoStart( p_out );
 
     if( CmdInitAdd( &cmd, p_es, p_fmt, p_sys->b_delayed ) )
     {
@@ -412,6 +455,8 @@ static int Send( es_out_t *p_out, es_out_id_t *p_es, block_t *p_block )
     vlc_mutex_lock( &p_sys->lock );
 
     TsAutoStop( p_out );
+    /* The pace control is not known yet when ES are added at opening */
+    TsAutoStart( p_out );
 
     CmdInitSend( &cmd, p_es, p_block );
     if( p_sys->b_delayed )
@@ -557,11 +602,27 @@ static int ControlLockedSetTime( es_out_t *p_out, mtime_t i_date )
     es_out_sys_t *p_sys = p_out->p_sys;
 
     if( !p_sys->b_delayed )
+    {
+        /* Nothing is kept to seek into */
+        if( i_date >= 0 )
+            return VLC_EGENERIC;
         return es_out_SetTime( p_sys->p_out, i_date );
+    }
 
-    /* TODO */
-    msg_Err( p_sys->p_input, "EsOutTimeshift does not yet support time change" );
-    return VLC_EGENERIC;
+    if( i_date >= 0 )
+        return TsSeek( p_sys->p_ts, i_date );
+
+    /* The input is seeking: the data not played yet is obsolete. The
+     * timeshift is restarted if still needed for the pause or rate */
+    TsStop( p_sys->p_ts, true );
+    p_sys->b_delayed = false;
+
+    const int i_ret = es_out_SetTime( p_sys->p_out, i_date );
+
+    if( ( p_sys->b_input_paused && !p_sys->b_input_paused_source ) ||
+        p_sys->i_input_rate != p_sys->i_input_rate_source )
+        TsStart( p_out );
+    return i_ret;
 }
 static int ControlLockedSetFrameNext( es_out_t *p_out )
 {
@@ -741,6 +802,7 @@ static int TsStart( es_out_t *p_out )
         return VLC_EGENERIC;
 
     p_ts->i_tmp_size_max = p_sys->i_tmp_size_max;
+    p_ts->i_tmp_duration = p_sys->i_tmp_duration;
     p_ts->psz_tmp_path = p_sys->psz_tmp_path;
     p_ts->p_input = p_sys->p_input;
     p_ts->p_out = p_sys->p_out;
@@ -754,8 +816,12 @@ static int TsStart( es_out_t *p_out )
     p_ts->i_rate_delay = 0;
     p_ts->i_buffering_delay = 0;
     p_ts->i_cmd_delay = 0;
+    p_ts->i_time_x = -1;
+    p_ts->i_seek = 0;
+    p_ts->p_storage_h = NULL;
     p_ts->p_storage_r = NULL;
     p_ts->p_storage_w = NULL;
+    p_ts->p_storage_f = NULL;
 
     p_sys->b_delayed = true;
     if( vlc_clone( &p_ts->thread, TsRun, p_ts, VLC_THREAD_PRIORITY_INPUT ) )
@@ -770,6 +836,17 @@ static int TsStart( es_out_t *p_out )
 
     return VLC_SUCCESS;
 }
+static void TsAutoStart( es_out_t *p_out )
+{
+    es_out_sys_t *p_sys = p_out->p_sys;
+
+    /* Played data can only be kept for seeking back when delayed */
+    if( p_sys->b_delayed || p_sys->i_tmp_duration <= 0 ||
+        p_sys->p_input->p->b_can_pace_control )
+        return;
+
+    TsStart( p_out );
+}
 static void TsAutoStop( es_out_t *p_out )
 {
     es_out_sys_t *p_sys = p_out->p_sys;
@@ -778,11 +855,14 @@ static void TsAutoStop( es_out_t *p_out )
         return;
 
     msg_Warn( p_sys->p_input, "es out timeshift: auto stop" );
-    TsStop( p_sys->p_ts );
+    TsStop( p_sys->p_ts, false );
 
     p_sys->b_delayed = false;
 }
-static void TsStop( ts_thread_t *p_ts )
+/* Stops the timeshift thread and drops the commands not played yet. With
+ * b_apply, the ones creating or deleting things (ES, meta...) are executed
+ * instead, as the output is going on without the timeshift */
+static void TsStop( ts_thread_t *p_ts, bool b_apply )
 {
     vlc_cancel( p_ts->thread );
     vlc_join( p_ts->thread, NULL );
@@ -795,11 +875,40 @@ static void TsStop( ts_thread_t *p_ts )
         if( TsPopCmdLocked( p_ts, &cmd, true ) )
             break;
 
-        CmdClean( &cmd );
+        if( !b_apply || CmdIsReplayable( &cmd ) )
+        {
+            CmdClean( &cmd );
+            continue;
+        }
+
+        switch( cmd.i_type )
+        {
+        case C_ADD:
+            CmdExecuteAdd( p_ts->p_out, &cmd );
+            CmdCleanAdd( &cmd );
+            break;
+        case C_CONTROL:
+            CmdExecuteControl( p_ts->p_out, &cmd );
+            CmdCleanControl( &cmd );
+            break;
+        case C_DEL:
+            CmdExecuteDel( p_ts->p_out, &cmd );
+            break;
+        default:
+            vlc_assert_unreachable();
+            break;
+        }
     }
     assert( !p_ts->p_storage_r || !p_ts->p_storage_r->p_next );
-    if( p_ts->p_storage_r )
-        TsStorageDelete( p_ts->p_storage_r );
+    while( p_ts->p_storage_h )
+    {
+        ts_storage_t *p_next = p_ts->p_storage_h->p_next;
+
+        TsStorageDelete( p_ts->p_storage_h );
+        p_ts->p_storage_h = p_next;
+    }
+    if( p_ts->p_storage_f )
+        TsStorageDelete( p_ts->p_storage_f );
     vlc_mutex_unlock( &p_ts->lock );
 
     TsDestroy( p_ts );
@@ -810,7 +919,16 @@ static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
 
     if( !p_ts->p_storage_w || TsStorageIsFull( p_ts->p_storage_w, p_cmd ) )
     {
-        ts_storage_t *p_storage = TsStorageNew( p_ts->psz_tmp_path, p_ts->i_tmp_size_max );
+        ts_storage_t *p_storage = p_ts->p_storage_f;
+        p_ts->p_storage_f = NULL;
+
+        if( !p_storage || TsStorageIsFull( p_storage, p_cmd ) )
+        {
+            if( p_storage )
+                TsStorageDelete( p_storage );
+            p_storage = TsStorageNew( p_ts->psz_tmp_path,
+                                      __MAX( (size_t)p_ts->i_tmp_size_max, TsCmdSize( p_cmd ) ) );
+        }
 
         if( !p_storage )
         {
@@ -822,7 +940,7 @@ static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
 
         if( !p_ts->p_storage_w )
         {
-            p_ts->p_storage_r = p_ts->p_storage_w = p_storage;
+            p_ts->p_storage_h = p_ts->p_storage_r = p_ts->p_storage_w = p_storage;
         }
         else
         {
@@ -833,30 +951,83 @@ static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
     }
 
     /* TODO return error and warn the user (but only once) */
-    TsStoragePushCmd( p_ts->p_storage_w, p_cmd, p_ts->p_storage_r == p_ts->p_storage_w );
+    TsStoragePushCmd( p_ts->p_storage_w, p_cmd );
 
     vlc_cond_signal( &p_ts->wait );
 
     vlc_mutex_unlock( &p_ts->lock );
 }
-static int TsPopCmdLocked( ts_thread_t *p_ts, ts_cmd_t *p_cmd, bool b_flush )
+static void TsNextStorageLocked( ts_thread_t *p_ts )
 {
-    vlc_assert_locked( &p_ts->lock );
-
-    if( TsStorageIsEmpty( p_ts->p_storage_r ) )
-        return VLC_EGENERIC;
-
-    TsStoragePopCmd( p_ts->p_storage_r, p_cmd, b_flush );
-
     while( p_ts->p_storage_r && TsStorageIsEmpty( p_ts->p_storage_r ) )
     {
         ts_storage_t *p_next = p_ts->p_storage_r->p_next;
         if( !p_next )
             break;
 
-        TsStorageDelete( p_ts->p_storage_r );
+        TsStorageUnmap( p_ts->p_storage_r );
         p_ts->p_storage_r = p_next;
     }
+}
+static void TsDropStorageLocked( ts_thread_t *p_ts, ts_storage_t *p_storage )
+{
+    /* Keep one played segment (and its file) around to write into */
+    if( !p_ts->p_storage_f && p_storage->i_file_max == (size_t)p_ts->i_tmp_size_max &&
+        !TsStorageReset( p_storage ) )
+        p_ts->p_storage_f = p_storage;
+    else
+        TsStorageDelete( p_storage );
+}
+/* Forget the played segments that went out of the seek window */
+static void TsTrimLocked( ts_thread_t *p_ts, mtime_t i_date )
+{
+    while( p_ts->p_storage_h != p_ts->p_storage_r &&
+           i_date - p_ts->p_storage_h->i_date_last > p_ts->i_tmp_duration )
+    {
+        ts_storage_t *p_next = p_ts->p_storage_h->p_next;
+
+        TsDropStorageLocked( p_ts, p_ts->p_storage_h );
+        p_ts->p_storage_h = p_next;
+    }
+}
+static int TsPopCmdLocked( ts_thread_t *p_ts, ts_cmd_t *p_cmd, bool b_flush )
+{
+    vlc_assert_locked( &p_ts->lock );
+
+    for( ;; )
+    {
+        TsNextStorageLocked( p_ts );
+        if( TsStorageIsEmpty( p_ts->p_storage_r ) )
+            return VLC_EGENERIC;
+
+        ts_storage_t *p_storage = p_ts->p_storage_r;
+        const bool b_replay = p_storage->i_cmd_r < p_storage->i_cmd_x;
+
+        /* Commands that can not be played twice are skipped on replay */
+        if( TsStoragePopCmd( p_storage, p_cmd, b_flush ) )
+            continue;
+
+        if( !b_replay && p_cmd->i_type == C_CONTROL &&
+            p_cmd->u.control.i_query == ES_OUT_SET_TIMES )
+            p_ts->i_time_x = p_cmd->u.control.u.times.i_time;
+
+        if( p_cmd->i_type == C_DEL )
+        {
+            /* The ES is gone, one can not seek back before its deletion */
+            while( p_ts->p_storage_h != p_storage )
+            {
+                ts_storage_t *p_next = p_ts->p_storage_h->p_next;
+
+                TsDropStorageLocked( p_ts, p_ts->p_storage_h );
+                p_ts->p_storage_h = p_next;
+            }
+            p_storage->i_cmd_s = p_storage->i_cmd_r;
+        }
+        break;
+    }
+
+    TsTrimLocked( p_ts, p_cmd->i_date );
+    TsNextStorageLocked( p_ts );
 
     return VLC_SUCCESS;
 }
@@ -875,7 +1046,8 @@ static bool TsIsUnused( ts_thread_t *p_ts )
     bool b_unused;
 
     vlc_mutex_lock( &p_ts->lock );
-    b_unused = !p_ts->b_paused &&
+    b_unused = p_ts->i_tmp_duration <= 0 &&
+               !p_ts->b_paused &&
                p_ts->i_rate == p_ts->i_rate_source &&
                TsStorageIsEmpty( p_ts->p_storage_r );
     vlc_mutex_unlock( &p_ts->lock );
@@ -932,16 +1104,111 @@ static int TsChangeRate( ts_thread_t *p_ts, int i_src_rate, int i_rate )
     return i_ret;
 }
 
+static int TsSeek( ts_thread_t *p_ts, mtime_t i_time )
+{
+    vlc_mutex_lock( &p_ts->lock );
+
+    if( p_ts->i_tmp_duration <= 0 || p_ts->i_time_x < 0 || i_time > p_ts->i_time_x )
+    {
+        vlc_mutex_unlock( &p_ts->lock );
+        return VLC_EGENERIC;
+    }
+
+    /* Use the time index to find the segment, then the last time update
+     * played in it before the requested time, then the last picture that
+     * can be decoded on its own up to it */
+    ts_storage_t *p_storage = NULL;
+    for( ts_storage_t *p = p_ts->p_storage_h; p && p->i_cmd_x > p->i_cmd_s; p = p->p_next )
+    {
+        if( p->i_time_first >= 0 && p->i_time_first <= i_time )
+            p_storage = p;
+    }
+
+    int i_cmd = -1;
+    for( int i = p_storage ? p_storage->i_cmd_s : 0; p_storage && i < p_storage->i_cmd_x; i++ )
+    {
+        const ts_cmd_t *p_cmd = &p_storage->p_cmd[i];
+
+        if( p_cmd->i_type != C_CONTROL || p_cmd->u.control.i_query != ES_OUT_SET_TIMES )
+            continue;
+        if( p_cmd->u.control.u.times.i_time > i_time )
+            break;
+        i_cmd = i;
+    }
+    if( i_cmd < 0 )
+    {
+        vlc_mutex_unlock( &p_ts->lock );
+        return VLC_EGENERIC;
+    }
+
+    /* Without such pictures (flags not set by the demuxer, or audio only),
+     * play from the time update */
+    ts_storage_t *p_key = NULL;
+    int i_key = -1;
+    for( ts_storage_t *p = p_ts->p_storage_h; p; p = p->p_next )
+    {
+        const int i_end = p == p_storage ? i_cmd : p->i_cmd_x;
+        for( int i = p->i_cmd_s; i < i_end; i++ )
+        {
+            if( p->p_cmd[i].i_type == C_SEND && p->p_cmd[i].u.send.b_key )
+            {
+                p_key = p;
+                i_key = i;
+            }
+        }
+        if( p == p_storage )
+            break;
+    }
+    if( p_key )
+    {
+        p_storage = p_key;
+        i_cmd = i_key;
+    }
+
+    /* Move the reader, the played segments before it are kept */
+    bool b_before = true;
+    for( ts_storage_t *p = p_ts->p_storage_h; p; p = p->p_next )
+    {
+        if( p == p_storage )
+        {
+            p->i_cmd_r = i_cmd;
+            b_before = false;
+        }
+        else
+        {
+            p->i_cmd_r = b_before ? p->i_cmd_w : p->i_cmd_s;
+        }
+    }
+    if( p_ts->p_storage_r != p_storage )
+        TsStorageUnmap( p_ts->p_storage_r );
+    p_ts->p_storage_r = p_storage;
+
+    /* Play it from now on (or when resuming). The decoders states and clock
+     * sync are reset by the thread before the first command played. */
+    const mtime_t i_now = p_ts->b_paused ? p_ts->i_pause_date : mdate();
+    p_ts->i_cmd_delay = i_now - p_storage->p_cmd[i_cmd].i_date;
+    p_ts->i_rate_date = -1;
+    p_ts->i_rate_delay = 0;
+    p_ts->i_buffering_delay = 0;
+    p_ts->i_seek++;
+
+    vlc_cond_signal( &p_ts->wait );
+    vlc_mutex_unlock( &p_ts->lock );
+    return VLC_SUCCESS;
+}
+
 static void *TsRun( void *p_data )
 {
     ts_thread_t *p_ts = p_data;
     mtime_t i_buffering_date = -1;
+    volatile unsigned i_seek = 0; /* modified within vlc_cleanup_push() */
 
     for( ;; )
     {
         ts_cmd_t cmd;
         mtime_t  i_deadline;
         bool b_buffering;
+        bool b_seek;
 
         /* Pop a command to execute */
         vlc_mutex_lock( &p_ts->lock );
@@ -962,6 +1229,13 @@ static void *TsRun( void *p_data )
             vlc_cond_wait( &p_ts->wait, &p_ts->lock );
         }
 
+        b_seek = i_seek != p_ts->i_seek;
+        if( b_seek )
+        {
+            i_seek = p_ts->i_seek;
+            i_buffering_date = -1;
+        }
+
         if( b_buffering && i_buffering_date < 0 )
         {
             i_buffering_date = cmd.i_date;
@@ -1013,6 +1287,16 @@ static void *TsRun( void *p_data )
 
         vlc_cleanup_run();
 
+        /* Reset the decoders states and clock sync after a seek back. This is
+         * done here without the lock, and before the data from the new
+         * position is played. */
+        if( b_seek )
+        {
+            const int canc = vlc_savecancel();
+            es_out_SetTime( p_ts->p_out, -1 );
+            vlc_restorecancel( canc );
+        }
+
         /* Regulate the speed of command processing to the same one than
          * reading  */
         vlc_cleanup_push( cmd_cleanup_routine, &cmd );
@@ -1021,6 +1305,16 @@ static void *TsRun( void *p_data )
 
         vlc_cleanup_pop();
 
+        /* Data popped before a seek is not played anymore */
+        vlc_mutex_lock( &p_ts->lock );
+        const bool b_stale = i_seek != p_ts->i_seek;
+        vlc_mutex_unlock( &p_ts->lock );
+        if( b_stale && cmd.i_type == C_SEND )
+        {
+            CmdCleanSend( &cmd );
+            continue;
+        }
+
         /* Execute the command  */
         const int canc = vlc_savecancel();
         switch( cmd.i_type )
@@ -1053,6 +1347,12 @@ static void *TsRun( void *p_data )
 /*****************************************************************************
  *
  *****************************************************************************/
+static size_t TsCmdSize( const ts_cmd_t *p_cmd )
+{
+    if( p_cmd->i_type != C_SEND )
+        return 0;
+    return sizeof(*p_cmd->u.send.p_block) + p_cmd->u.send.p_block->i_buffer;
+}
 static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_max )
 {
     ts_storage_t *p_storage = calloc( 1, sizeof(ts_storage_t) );
@@ -1065,18 +1365,29 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
     /* */
     p_storage->i_file_max = i_tmp_size_max;
     p_storage->i_file_size = 0;
-    p_storage->p_filew = GetTmpFile( &p_storage->psz_file, psz_tmp_path );
-    if( p_storage->psz_file )
-        p_storage->p_filer = vlc_fopen( p_storage->psz_file, "rb" );
+    p_storage->p_write = NULL;
+    p_storage->i_write = 0;
+    p_storage->fd = GetTmpFile( &p_storage->psz_file, psz_tmp_path );
+#ifdef HAVE_MMAP
+    p_storage->p_map = NULL;
+#endif
+
+    /* */
+    p_storage->i_date_last = -1;
+    p_storage->i_time_first = -1;
+    p_storage->i_time_last = -1;
 
     /* */
+    p_storage->i_cmd_s = 0;
     p_storage->i_cmd_w = 0;
     p_storage->i_cmd_r = 0;
-    p_storage->i_cmd_max = 30000;
+    p_storage->i_cmd_x = 0;
+    p_storage->i_cmd_f = 0;
+    p_storage->i_cmd_max = TS_STORAGE_CMD_MAX;
     p_storage->p_cmd = malloc( p_storage->i_cmd_max * sizeof(*p_storage->p_cmd) );
     //fprintf( stderr, "\nSTORAGE name=%s size=%d KiB\n", p_storage->psz_file, p_storage->i_cmd_max * sizeof(*p_storage->p_cmd) /1024 );
 
-    if( !p_storage->p_cmd || !p_storage->p_filew || !p_storage->p_filer )
+    if( !p_storage->p_cmd || p_storage->fd < 0 )
     {
         TsStorageDelete( p_storage );
         return NULL;
@@ -1085,6 +1396,8 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
 }
 static void TsStorageDelete( ts_storage_t *p_storage )
 {
+    /* Played commands do not own anything anymore */
+    p_storage->i_cmd_r = p_storage->i_cmd_x;
     while( p_storage->i_cmd_r < p_storage->i_cmd_w )
     {
         ts_cmd_t cmd;
@@ -1094,11 +1407,11 @@ static void TsStorageDelete( ts_storage_t *p_storage )
         CmdClean( &cmd );
     }
     free( p_storage->p_cmd );
+    free( p_storage->p_write );
 
-    if( p_storage->p_filer )
-        fclose( p_storage->p_filer );
-    if( p_storage->p_filew )
-        fclose( p_storage->p_filew );
+    TsStorageUnmap( p_storage );
+    if( p_storage->fd >= 0 )
+        close( p_storage->fd );
 
     if( p_storage->psz_file )
     {
@@ -1108,8 +1421,112 @@ static void TsStorageDelete( ts_storage_t *p_storage )
 
     free( p_storage );
 }
+/* Makes a fully played segment ready to be written again */
+static int TsStorageReset( ts_storage_t *p_storage )
+{
+    assert( p_storage->i_cmd_x >= p_storage->i_cmd_w );
+
+    if( p_storage->i_cmd_max < TS_STORAGE_CMD_MAX )
+    {
+        ts_cmd_t *p_new = realloc( p_storage->p_cmd, TS_STORAGE_CMD_MAX * sizeof(*p_storage->p_cmd) );
+        if( !p_new )
+            return VLC_EGENERIC;
+        p_storage->p_cmd = p_new;
+        p_storage->i_cmd_max = TS_STORAGE_CMD_MAX;
+    }
+    if( lseek( p_storage->fd, 0, SEEK_SET ) != 0 )
+        return VLC_EGENERIC;
+
+    TsStorageUnmap( p_storage );
+    p_storage->p_next = NULL;
+    p_storage->i_file_size = 0;
+    p_storage->i_write = 0;
+    p_storage->i_date_last = -1;
+    p_storage->i_time_first = -1;
+    p_storage->i_time_last = -1;
+    p_storage->i_cmd_s = 0;
+    p_storage->i_cmd_r = 0;
+    p_storage->i_cmd_x = 0;
+    p_storage->i_cmd_f = 0;
+    p_storage->i_cmd_w = 0;
+    return VLC_SUCCESS;
+}
+/* Only the segment being read is kept mapped, to spare the address space */
+static void TsStorageUnmap( ts_storage_t *p_storage )
+{
+#ifdef HAVE_MMAP
+    if( p_storage->p_map )
+        munmap( p_storage->p_map, p_storage->i_file_max );
+    p_storage->p_map = NULL;
+#else
+    VLC_UNUSED( p_storage );
+#endif
+}
+static int TsStorageRead( ts_storage_t *p_storage, size_t i_offset, void *p_data, size_t i_size )
+{
+    if( i_offset > p_storage->i_file_size || i_size > p_storage->i_file_size - i_offset )
+        return VLC_EGENERIC;
+
+    /* The data of a command is either all buffered or all written */
+    const size_t i_written = p_storage->i_file_size - p_storage->i_write;
+    if( i_offset >= i_written )
+    {
+        memcpy( p_data, &p_storage->p_write[i_offset - i_written], i_size );
+        return VLC_SUCCESS;
+    }
+
+#ifdef HAVE_MMAP
+    if( !p_storage->p_map )
+    {
+        void *p_map = mmap( NULL, p_storage->i_file_max, PROT_READ, MAP_SHARED,
+                            p_storage->fd, 0 );
+        if( p_map == MAP_FAILED )
+            return VLC_EGENERIC;
+        p_storage->p_map = p_map;
+    }
+    memcpy( p_data, &p_storage->p_map[i_offset], i_size );
+    return VLC_SUCCESS;
+#else
+    /* The writer expects the file offset at the end */
+    int i_ret = VLC_EGENERIC;
+    if( lseek( p_storage->fd, i_offset, SEEK_SET ) == (off_t)i_offset &&
+        read( p_storage->fd, p_data, i_size ) == (ssize_t)i_size )
+        i_ret = VLC_SUCCESS;
+    lseek( p_storage->fd, i_written, SEEK_SET );
+    return i_ret;
+#endif
+}
+/* Writes the buffered data out. On failure, the commands of that data
+ * are left without it */
+static int TsStorageFlush( ts_storage_t *p_storage )
+{
+    if( p_storage->i_write == 0 )
+        return VLC_SUCCESS;
+
+    const size_t i_written = p_storage->i_file_size - p_storage->i_write;
+    int i_ret = VLC_SUCCESS;
+
+    if( vlc_write( p_storage->fd, p_storage->p_write, p_storage->i_write ) != (ssize_t)p_storage->i_write )
+    {
+        lseek( p_storage->fd, i_written, SEEK_SET );
+        p_storage->i_file_size = i_written;
+        for( int i = p_storage->i_cmd_f; i < p_storage->i_cmd_w; i++ )
+        {
+            if( p_storage->p_cmd[i].i_type == C_SEND )
+                p_storage->p_cmd[i].u.send.i_offset = -1;
+        }
+        i_ret = VLC_EGENERIC;
+    }
+    p_storage->i_write = 0;
+    return i_ret;
+}
 static void TsStoragePack( ts_storage_t *p_storage )
 {
+    /* Nothing is written to it anymore */
+    TsStorageFlush( p_storage );
+    free( p_storage->p_write );
+    p_storage->p_write = NULL;
+
     /* Try to release a bit of memory */
     if( p_storage->i_cmd_w >= p_storage->i_cmd_max )
         return;
@@ -1122,20 +1539,16 @@ static void TsStoragePack( ts_storage_t *p_storage )
 }
 static bool TsStorageIsFull( ts_storage_t *p_storage, const ts_cmd_t *p_cmd )
 {
-    if( p_cmd && p_cmd->i_type == C_SEND && p_storage->i_cmd_w > 0 )
-    {
-        size_t i_size = sizeof(*p_cmd->u.send.p_block) + p_cmd->u.send.p_block->i_buffer;
-
-        if( p_storage->i_file_size + i_size >= p_storage->i_file_max )
-            return true;
-    }
+    /* The segment is mapped with a fixed size */
+    if( p_cmd && p_storage->i_file_size + TsCmdSize( p_cmd ) > p_storage->i_file_max )
+        return true;
     return p_storage->i_cmd_w >= p_storage->i_cmd_max;
 }
 static bool TsStorageIsEmpty( ts_storage_t *p_storage )
 {
     return !p_storage || p_storage->i_cmd_r >= p_storage->i_cmd_w;
 }
-static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, bool b_flush )
+static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd )
 {
     ts_cmd_t cmd = *p_cmd;
 
@@ -1144,44 +1557,72 @@ static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, bo
     if( cmd.i_type == C_SEND )
     {
         block_t *p_block = cmd.u.send.p_block;
+        const size_t i_size = sizeof(*p_block) + p_block->i_buffer;
+
+        /* Small blocks are gathered to be written at once */
+        if( p_storage->i_write + i_size > TS_STORAGE_WRITE_SIZE )
+            TsStorageFlush( p_storage );
+        if( p_storage->i_write == 0 )
+            p_storage->i_cmd_f = p_storage->i_cmd_w;
+        if( !p_storage->p_write && i_size <= TS_STORAGE_WRITE_SIZE )
+            p_storage->p_write = malloc( TS_STORAGE_WRITE_SIZE );
 
         cmd.u.send.p_block = NULL;
-        cmd.u.send.i_offset = ftell( p_storage->p_filew );
+        cmd.u.send.i_offset = p_storage->i_file_size;
 
-        if( fwrite( p_block, sizeof(*p_block), 1, p_storage->p_filew ) != 1 )
+        if( p_storage->p_write && i_size <= TS_STORAGE_WRITE_SIZE )
         {
+            uint8_t *p_dst = &p_storage->p_write[p_storage->i_write];
+
+            memcpy( p_dst, p_block, sizeof(*p_block) );
+            memcpy( &p_dst[sizeof(*p_block)], p_block->p_buffer, p_block->i_buffer );
+            p_storage->i_write += i_size;
             block_Release( p_block );
-            return;
         }
-        p_storage->i_file_size += sizeof(*p_block);
-        if( p_block->i_buffer > 0 )
+        else
         {
-            if( fwrite( p_block->p_buffer, p_block->i_buffer, 1, p_storage->p_filew ) != 1 )
+            /* Written data is read back through the mapping */
+            bool b_error = vlc_write( p_storage->fd, p_block, sizeof(*p_block) ) != sizeof(*p_block);
+            if( !b_error && p_block->i_buffer > 0 )
+                b_error = vlc_write( p_storage->fd, p_block->p_buffer,
+                                     p_block->i_buffer ) != (ssize_t)p_block->i_buffer;
+            block_Release( p_block );
+
+            if( b_error )
             {
-                block_Release( p_block );
+                lseek( p_storage->fd, p_storage->i_file_size, SEEK_SET );
                 return;
             }
         }
-        p_storage->i_file_size += p_block->i_buffer;
-        block_Release( p_block );
-
-        if( b_flush )
-            fflush( p_storage->p_filew );
+        p_storage->i_file_size += i_size;
     }
+    else if( cmd.i_type == C_CONTROL && cmd.u.control.i_query == ES_OUT_SET_TIMES )
+    {
+        if( p_storage->i_time_first < 0 )
+            p_storage->i_time_first = cmd.u.control.u.times.i_time;
+        p_storage->i_time_last = cmd.u.control.u.times.i_time;
+    }
+    p_storage->i_date_last = cmd.i_date;
     p_storage->p_cmd[p_storage->i_cmd_w++] = cmd;
 }
-static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush )
+static int TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush )
 {
     assert( !TsStorageIsEmpty( p_storage ) );
 
+    const bool b_replay = p_storage->i_cmd_r < p_storage->i_cmd_x;
+
     *p_cmd = p_storage->p_cmd[p_storage->i_cmd_r++];
+    if( !b_replay )
+        p_storage->i_cmd_x = p_storage->i_cmd_r;
+    else if( !CmdIsReplayable( p_cmd ) )
+        return VLC_EGENERIC;
+
     if( p_cmd->i_type == C_SEND )
     {
         block_t block;
 
-        if( !b_flush &&
-            !fseek( p_storage->p_filer, p_cmd->u.send.i_offset, SEEK_SET ) &&
-            fread( &block, sizeof(block), 1, p_storage->p_filer ) == 1 )
+        if( !b_flush && p_cmd->u.send.i_offset >= 0 &&
+            !TsStorageRead( p_storage, p_cmd->u.send.i_offset, &block, sizeof(block) ) )
         {
             block_t *p_block = block_Alloc( block.i_buffer );
             if( p_block )
@@ -1191,7 +1632,9 @@ static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_fl
                 p_block->i_flags    = block.i_flags;
                 p_block->i_length   = block.i_length;
                 p_block->i_nb_samples = block.i_nb_samples;
-                p_block->i_buffer = fread( p_block->p_buffer, 1, block.i_buffer, p_storage->p_filer );
+                if( TsStorageRead( p_storage, p_cmd->u.send.i_offset + sizeof(block),
+                                   p_block->p_buffer, block.i_buffer ) )
+                    p_block->i_buffer = 0;
             }
             p_cmd->u.send.p_block = p_block;
         }
@@ -1201,6 +1644,7 @@ static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_fl
             p_cmd->u.send.p_block = block_Alloc( 1 );
         }
     }
+    return VLC_SUCCESS;
 }
 
 /*****************************************************************************
@@ -1227,6 +1671,37 @@ static void CmdClean( ts_cmd_t *p_cmd )
     }
 }
 
+/* Whether a command may be executed again when seeking back: the ES are
+ * already created and the commands owning data gave it away */
+static bool CmdIsReplayable( const ts_cmd_t *p_cmd )
+{
+    switch( p_cmd->i_type )
+    {
+    case C_SEND:
+        return true;
+    case C_CONTROL:
+        switch( p_cmd->u.control.i_query )
+        {
+        case ES_OUT_SET_GROUP_META:
+        case ES_OUT_SET_META:
+        case ES_OUT_SET_GROUP_EPG:
+        case ES_OUT_SET_ES_FMT:
+        case ES_OUT_DEL_GROUP:
+        case ES_OUT_SET_EOS:
+        /* Replaying the selection would revert the user's choice */
+        case ES_OUT_SET_GROUP:
+        case ES_OUT_SET_ES:
+        case ES_OUT_SET_ES_DEFAULT:
+        case ES_OUT_SET_ES_STATE:
+            return false;
+        default:
+            return true;
+        }
+    default:
+        return false;
+    }
+}
+
 static int CmdInitAdd( ts_cmd_t *p_cmd, es_out_id_t *p_es, const es_format_t *p_fmt, bool b_copy )
 {
     p_cmd->i_type = C_ADD;
@@ -1261,6 +1736,7 @@ static void CmdInitSend( ts_cmd_t *p_cmd, es_out_id_t *p_es, block_t *p_block )
     p_cmd->i_date = mdate();
     p_cmd->u.send.p_es = p_es;
     p_cmd->u.send.p_block = p_block;
+    p_cmd->u.send.b_key = (p_block->i_flags & BLOCK_FLAG_TYPE_I) != 0;
 }
 static int CmdExecuteSend( es_out_t *p_out, ts_cmd_t *p_cmd )
 {
@@ -1586,29 +2062,17 @@ static char *GetTmpPath( char *psz_path )
     return psz_path;
 }
 
-static FILE *GetTmpFile( char **ppsz_file, const char *psz_path )
+static int GetTmpFile( char **ppsz_file, const char *psz_path )
 {
     char *psz_name;
-    int fd;
-    FILE *f;
 
     /* */
     *ppsz_file = NULL;
     if( asprintf( &psz_name, "%s"DIR_SEP"vlc-timeshift.XXXXXX", psz_path ) < 0 )
-        return NULL;
+        return -1;
 
     /* */
-    fd = vlc_mkstemp( psz_name );
     *ppsz_file = psz_name;
-
-    if( fd < 0 )
-        return NULL;
-
-    /* */
-    f = fdopen( fd, "w+b" );
-    if( !f )
-        close( fd );
-
-    return f;
+    return vlc_mkstemp( psz_name );
 }
 
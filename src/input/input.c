@@ -175,38 +175,45 @@ int input_Read( vlc_object_t *p_parent, input_item_t *p_item )
 }
 
 /**
- * Initialize an input and initialize it to preparse the item
- * This function is blocking. It will only accept parsing regular files.
+ * Create an input to preparse an item with input_Preparse().
  *
  * \param p_parent a vlc_object_t
  * \param p_item an input item
+ * \return a pointer to the input, to be released with vlc_object_release()
+ */
+input_thread_t *input_CreatePreparser( vlc_object_t *p_parent,
+                                       input_item_t *p_item )
+{
+    return Create( p_parent, p_item, NULL, true, NULL );
+}
+
+/**
+ * Initialize an input and initialize it to preparse the item
+ * This function is blocking. It will only accept parsing regular files.
+ * Another thread can abort it with input_Stop().
+ *
+ * \param p_input an input created with input_CreatePreparser()
  * \return VLC_SUCCESS or an error
  */
-int input_Preparse( vlc_object_t *p_parent, input_item_t *p_item )
+int input_Preparse( input_thread_t *p_input )
 {
-    input_thread_t *p_input;
+    input_item_t *p_item = p_input->p->p_item;
 
-    /* Allocate descriptor */
-    p_input = Create( p_parent, p_item, NULL, true, NULL );
-    if( !p_input )
+    if( Init( p_input ) )
         return VLC_EGENERIC;
 
-    if( !Init( p_input ) ) {
-        /* if the demux is a playlist, call Mainloop that will call
-         * demux_Demux in order to fetch sub items */
-        bool b_is_playlist = false;
-
-        if ( input_item_ShouldPreparseSubItems( p_item )
-          && demux_Control( p_input->p->input.p_demux,
-                            DEMUX_IS_PLAYLIST,
-                            &b_is_playlist ) )
-            b_is_playlist = false;
-        if( b_is_playlist )
-            MainLoop( p_input, false );
-        End( p_input );
-    }
+    /* if the demux is a playlist, call Mainloop that will call
+     * demux_Demux in order to fetch sub items */
+    bool b_is_playlist = false;
 
-    vlc_object_release( p_input );
+    if ( input_item_ShouldPreparseSubItems( p_item )
+      && demux_Control( p_input->p->input.p_demux,
+                        DEMUX_IS_PLAYLIST,
+                        &b_is_playlist ) )
+        b_is_playlist = false;
+    if( b_is_playlist )
+        MainLoop( p_input, false );
+    End( p_input );
 
     return VLC_SUCCESS;
 }
@@ -293,8 +300,6 @@ static void input_Destructor( vlc_object_t *obj )
 
     vlc_gc_decref( p_input->p->p_item );
 
-    vlc_mutex_destroy( &p_input->p->counters.counters_lock );
-
     for( int i = 0; i < p_input->p->i_control; i++ )
     {
         input_control_t *p_ctrl = &p_input->p->control[i];
@@ -513,7 +518,6 @@ static input_thread_t *Create( vlc_object_t *p_parent, input_item_t *p_item,
 
     /* */
     memset( &p_input->p->counters, 0, sizeof( p_input->p->counters ) );
-    vlc_mutex_init( &p_input->p->counters.counters_lock );
 
     p_input->p->p_es_out_display = input_EsOutNew( p_input, p_input->p->i_rate );
     p_input->p->p_es_out = NULL;
@@ -833,6 +837,9 @@ static void InitStatistics( input_thread_t * p_input )
         INIT_COUNTER( decoded_audio, COUNTER );
         INIT_COUNTER( decoded_video, COUNTER );
         INIT_COUNTER( decoded_sub, COUNTER );
+        INIT_COUNTER( demux_decode, HISTOGRAM );
+        INIT_COUNTER( decode_display, HISTOGRAM );
+        INIT_COUNTER( aout_delay, HISTOGRAM );
         p_input->p->counters.p_sout_send_bitrate = NULL;
         p_input->p->counters.p_sout_sent_packets = NULL;
         p_input->p->counters.p_sout_sent_bytes = NULL;
@@ -1306,6 +1313,9 @@ error:
         EXIT_COUNTER( decoded_audio );
         EXIT_COUNTER( decoded_video );
         EXIT_COUNTER( decoded_sub );
+        EXIT_COUNTER( demux_decode );
+        EXIT_COUNTER( decode_display );
+        EXIT_COUNTER( aout_delay );
 
         if( p_input->p->p_sout )
         {
@@ -1377,6 +1387,9 @@ static void End( input_thread_t * p_input )
             CL_CO( decoded_audio) ;
             CL_CO( decoded_video );
             CL_CO( decoded_sub) ;
+            CL_CO( demux_decode );
+            CL_CO( decode_display );
+            CL_CO( aout_delay );
         }
 
         /* Close optional stream output instance */
@@ -1677,6 +1690,13 @@ static bool Control( input_thread_t *p_input,
             if( i_time < 0 )
                 i_time = 0;
 
+            /* Seek back into the played data kept by the timeshift first */
+            if( !es_out_SetTime( p_input->p->p_es_out, i_time ) )
+            {
+                b_force_update = true;
+                break;
+            }
+
             /* Reset the decoders states and clock sync (before calling the demuxer */
             es_out_SetTime( p_input->p->p_es_out, -1 );
 
@@ -3024,7 +3044,6 @@ void input_UpdateStatistic( input_thread_t *p_input,
 {
     assert( p_input->p->i_state != INIT_S );
 
-    vlc_mutex_lock( &p_input->p->counters.counters_lock);
     switch( i_type )
     {
 #define I(c) stats_Update( p_input->p->counters.c, i_delta, NULL )
@@ -3053,7 +3072,6 @@ void input_UpdateStatistic( input_thread_t *p_input,
         msg_Err( p_input, "Invalid statistic type %d (internal error)", i_type );
         break;
     }
-    vlc_mutex_unlock( &p_input->p->counters.counters_lock);
 }
 
 /**/
@@ -154,7 +154,9 @@ struct input_thread_private_t
         counter_t *p_lost_abuffers;
         counter_t *p_displayed_pictures;
         counter_t *p_lost_pictures;
-        vlc_mutex_t counters_lock;
+        counter_t *p_demux_decode;
+        counter_t *p_decode_display;
+        counter_t *p_aout_delay;
     } counters;
 
     /* Buffer of pending actions */
@@ -27,13 +27,15 @@
 
 #include <vlc_common.h>
 #include "input/input_internal.h"
+#ifdef ENABLE_SOUT
+# include "stream_output/stream_output.h"
+#endif
 
 /**
  * Create a statistics counter
- * \param i_compute_type the aggregation type. One of STATS_LAST (always
- * keep the last value), STATS_COUNTER (increment by the passed value),
- * STATS_MAX (keep the maximum passed value), STATS_MIN, or STATS_DERIVATIVE
- * (keep a time derivative of the value)
+ * \param i_compute_type the aggregation type. One of STATS_COUNTER (increment
+ * by the passed value), STATS_DERIVATIVE (keep a time derivative of the
+ * value) or STATS_HISTOGRAM (count the passed latencies in microseconds)
  */
 counter_t * stats_CounterCreate( int i_compute_type )
 {
@@ -41,28 +43,51 @@ counter_t * stats_CounterCreate( int i_compute_type )
 
     if( !p_counter ) return NULL;
     p_counter->i_compute_type = i_compute_type;
+    atomic_init( &p_counter->value, 0 );
+
+    atomic_init( &p_counter->last_update, 0 );
+    vlc_mutex_init( &p_counter->lock );
     p_counter->i_samples = 0;
-    p_counter->pp_samples = NULL;
 
-    p_counter->last_update = 0;
+    for( unsigned i = 0; i < INPUT_STATS_LATENCY_BUCKETS; i++ )
+        atomic_init( &p_counter->buckets[i], 0 );
 
     return p_counter;
 }
 
 static inline int64_t stats_GetTotal(const counter_t *counter)
 {
-    if (counter == NULL || counter->i_samples == 0)
+    if (counter == NULL)
         return 0;
-    return counter->pp_samples[0]->value;
+    return atomic_load_explicit(&counter->value, memory_order_relaxed);
 }
 
-static inline float stats_GetRate(const counter_t *counter)
+static inline float stats_GetRate(counter_t *counter)
 {
-    if (counter == NULL || counter->i_samples < 2)
+    float rate = 0.;
+
+    if (counter == NULL)
         return 0.;
 
-    return (counter->pp_samples[0]->value - counter->pp_samples[1]->value)
-        / (float)(counter->pp_samples[0]->date - counter->pp_samples[1]->date);
+    vlc_mutex_lock(&counter->lock);
+    if (counter->i_samples == 2)
+        rate = (counter->samples[0].value - counter->samples[1].value)
+            / (float)(counter->samples[0].date - counter->samples[1].date);
+    vlc_mutex_unlock(&counter->lock);
+    return rate;
+}
+
+static inline void stats_GetLatency(const counter_t *counter,
+                                    input_latency_stats_t *latency)
+{
+    if (counter == NULL)
+        return;
+
+    for (unsigned i = 0; i < INPUT_STATS_LATENCY_BUCKETS; i++)
+        latency->pi_buckets[i] = atomic_load_explicit(&counter->buckets[i],
+                                                      memory_order_relaxed);
+    latency->i_sum = atomic_load_explicit(&counter->value,
+                                          memory_order_relaxed);
 }
 
 input_stats_t *stats_NewInputStats( input_thread_t *p_input )
@@ -83,7 +108,6 @@ void stats_ComputeInputStats(input_thread_t *input, input_stats_t *st)
     if (!libvlc_stats(input))
         return;
 
-    vlc_mutex_lock(&input->p->counters.counters_lock);
     vlc_mutex_lock(&st->lock);
 
     /* Input */
@@ -105,6 +129,9 @@ void stats_ComputeInputStats(input_thread_t *input, input_stats_t *st)
         st->i_sent_packets = stats_GetTotal(input->p->counters.p_sout_sent_packets);
         st->i_sent_bytes = stats_GetTotal(input->p->counters.p_sout_sent_bytes);
         st->f_send_bitrate = stats_GetRate(input->p->counters.p_sout_send_bitrate);
+#ifdef ENABLE_SOUT
+        st->i_late_packets = sout_GetLatePackets(input->p->p_sout);
+#endif
     }
 
     /* Aout */
@@ -115,8 +142,12 @@ void stats_ComputeInputStats(input_thread_t *input, input_stats_t *st)
     st->i_displayed_pictures = stats_GetTotal(input->p->counters.p_displayed_pictures);
     st->i_lost_pictures = stats_GetTotal(input->p->counters.p_lost_pictures);
 
+    /* Latencies */
+    stats_GetLatency(input->p->counters.p_demux_decode, &st->demux_decode);
+    stats_GetLatency(input->p->counters.p_decode_display, &st->decode_display);
+    stats_GetLatency(input->p->counters.p_aout_delay, &st->aout_delay);
+
     vlc_mutex_unlock(&st->lock);
-    vlc_mutex_unlock(&input->p->counters.counters_lock);
 }
 
 void stats_ReinitInputStats( input_stats_t *p_stats )
@@ -130,8 +161,11 @@ void stats_ReinitInputStats( input_stats_t *p_stats )
     p_stats->i_displayed_pictures = p_stats->i_lost_pictures =
     p_stats->i_played_abuffers = p_stats->i_lost_abuffers =
     p_stats->i_decoded_video = p_stats->i_decoded_audio =
-    p_stats->i_sent_bytes = p_stats->i_sent_packets = p_stats->f_send_bitrate
-     = 0;
+    p_stats->i_sent_bytes = p_stats->i_sent_packets = p_stats->f_send_bitrate =
+    p_stats->i_late_packets = 0;
+    memset( &p_stats->demux_decode, 0, sizeof(p_stats->demux_decode) );
+    memset( &p_stats->decode_display, 0, sizeof(p_stats->decode_display) );
+    memset( &p_stats->aout_delay, 0, sizeof(p_stats->aout_delay) );
     vlc_mutex_unlock( &p_stats->lock );
 }
 
@@ -139,14 +173,7 @@ void stats_CounterClean( counter_t *p_c )
 {
     if( p_c )
     {
-        int i = p_c->i_samples - 1 ;
-        while( i >= 0 )
-        {
-            counter_sample_t *p_s = p_c->pp_samples[i];
-            REMOVE_ELEM( p_c->pp_samples, p_c->i_samples, i );
-            free( p_s );
-            i--;
-        }
+        vlc_mutex_destroy( &p_c->lock );
         free( p_c );
     }
 }
@@ -154,9 +181,11 @@ void stats_CounterClean( counter_t *p_c )
 
 /** Update a counter element with new values
  * \param p_counter the counter to update
- * \param val the vlc_value union containing the new value to aggregate. For
- * more information on how data is aggregated, \see stats_Create
+ * \param val the new value to aggregate. For more information on how data
+ * is aggregated, \see stats_CounterCreate
  * \param val_new a pointer that will be filled with new data
+ *
+ * This does not lock, except for the derivatives once per second.
  */
 void stats_Update( counter_t *p_counter, uint64_t val, uint64_t *new_val )
 {
@@ -167,42 +196,44 @@ void stats_Update( counter_t *p_counter, uint64_t val, uint64_t *new_val )
     {
     case STATS_DERIVATIVE:
     {
-        counter_sample_t *p_new, *p_old;
         mtime_t now = mdate();
-        if( now - p_counter->last_update < CLOCK_FREQ )
+        int_fast64_t last = atomic_load_explicit( &p_counter->last_update,
+                                                  memory_order_relaxed );
+        /* Only one of the concurrent updates takes the sample */
+        if( now - last < CLOCK_FREQ ||
+            !atomic_compare_exchange_strong( &p_counter->last_update,
+                                             &last, now ) )
             return;
-        p_counter->last_update = now;
-        /* Insert the new one at the beginning */
-        p_new = (counter_sample_t*)malloc( sizeof( counter_sample_t ) );
-        p_new->value = val;
-        p_new->date = p_counter->last_update;
-        INSERT_ELEM( p_counter->pp_samples, p_counter->i_samples,
-                     0, p_new );
-
-        if( p_counter->i_samples == 3 )
-        {
-            p_old = p_counter->pp_samples[2];
-            REMOVE_ELEM( p_counter->pp_samples, p_counter->i_samples, 2 );
-            free( p_old );
-        }
+
+        vlc_mutex_lock( &p_counter->lock );
+        p_counter->samples[1] = p_counter->samples[0];
+        p_counter->samples[0].value = val;
+        p_counter->samples[0].date = now;
+        if( p_counter->i_samples < 2 )
+            p_counter->i_samples++;
+        vlc_mutex_unlock( &p_counter->lock );
         break;
     }
     case STATS_COUNTER:
-        if( p_counter->i_samples == 0 )
-        {
-            counter_sample_t *p_new = (counter_sample_t*)malloc(
-                                               sizeof( counter_sample_t ) );
-            p_new->value = 0;
-
-            INSERT_ELEM( p_counter->pp_samples, p_counter->i_samples,
-                         p_counter->i_samples, p_new );
-        }
-        if( p_counter->i_samples == 1 )
-        {
-            p_counter->pp_samples[0]->value += val;
-            if( new_val )
-                *new_val = p_counter->pp_samples[0]->value;
-        }
+    {
+        uint64_t total = atomic_fetch_add_explicit( &p_counter->value, val,
+                                                    memory_order_relaxed );
+        if( new_val )
+            *new_val = total + val;
         break;
     }
+    case STATS_HISTOGRAM:
+    {
+        unsigned i = 0;
+
+        while( i < INPUT_STATS_LATENCY_BUCKETS - 1 &&
+               val > (UINT64_C(1000) << i) )
+            i++;
+        atomic_fetch_add_explicit( &p_counter->buckets[i], 1,
+                                   memory_order_relaxed );
+        atomic_fetch_add_explicit( &p_counter->value, val,
+                                   memory_order_relaxed );
+        break;
+    }
+    }
 }
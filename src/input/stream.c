@@ -77,6 +77,9 @@
 /* Method1: Simple, for pf_block.
  *  We get blocks and put them in the linked list.
  *  We release blocks once the total size is bigger than CACHE_BLOCK_SIZE
+ *  Once stream_ReadBlock() is used, the blocks of the list are made shareable
+ *  (see block_Shareable()) so that the returned blocks can reference their
+ *  payload, copy-on-write.
  */
 
 /* Method2: A bit more complex, for pf_read
@@ -87,14 +90,46 @@
  *          if close enough, read data and use this ring
  *          else use the oldest ring, seek and use it.
  *
- *  TODO: - with access non seekable: use all space available for only one ring, but
- *          we have to support seekable/non-seekable switch on the fly.
- *        - compute a good value for i_read_size
- *        - ?
+ *  - The layout of the rings and the amount of read-ahead are chosen by a
+ *    policy (see below), switched on the fly from the observed seek pattern.
+ *  - Access reads are sized from the measured access throughput, and are
+ *    done by a background thread unless stream-prefetch is disabled.
  */
 #define STREAM_READ_ATONCE 1024
 #define STREAM_CACHE_TRACK_SIZE (STREAM_CACHE_SIZE/STREAM_CACHE_TRACK)
 
+/* Duration an access read should take, used to size reads from the
+ * measured throughput */
+#define STREAM_READ_PERIOD (CLOCK_FREQ/50)
+/* Throughput statistics are halved once they cover more than this */
+#define STREAM_STAT_WINDOW (10*CLOCK_FREQ)
+
+/* Method 2 cache policies */
+typedef struct
+{
+    const char *psz_name;
+    unsigned    i_tracks;       /* Number of rings the cache is split into */
+    unsigned    i_readahead;    /* Read-ahead, as a divider of a ring size */
+
+} stream_policy_t;
+
+enum
+{
+    STREAM_POLICY_SEQUENTIAL,
+    STREAM_POLICY_SEEK,
+    STREAM_POLICY_NOSEEK,
+};
+
+static const stream_policy_t p_stream_policies[] =
+{
+    /* Large read-ahead, keeps half a ring for short backward seeks */
+    [STREAM_POLICY_SEQUENTIAL] = { "sequential", STREAM_CACHE_TRACK, 2 },
+    /* Index jumps (MP4, MKV...): small read-ahead, many rings */
+    [STREAM_POLICY_SEEK]       = { "seek", STREAM_CACHE_TRACK, 16 },
+    /* Only one ring spanning the whole cache */
+    [STREAM_POLICY_NOSEEK]     = { "noseek", 1, 1 },
+};
+
 typedef struct
 {
     int64_t i_date;
@@ -139,6 +174,8 @@ struct stream_sys_t
         block_t *p_first;
         block_t **pp_last;
 
+        bool     b_share;       /* Blocks are shareable for stream_ReadBlock */
+
     } block;
 
     /* Method 2: for pf_read */
@@ -155,6 +192,32 @@ struct stream_sys_t
         unsigned i_used; /* Used since last read */
         unsigned i_read_size;
 
+        /* Layout, set by the current policy */
+        const stream_policy_t *p_policy;
+        bool     b_policy_auto;
+        unsigned i_tk_count;
+        unsigned i_tk_size;
+        unsigned i_readahead;
+
+        /* Access capabilities, cached as the access may be busy */
+        bool     b_can_seek;
+        bool     b_can_fastseek;
+
+        /* Seek pattern */
+        uint64_t i_jump_pos;    /* Position of the last far seek */
+        uint64_t i_run_avg;     /* Average data read between far seeks */
+
+        /* Prefetching, the lock protects the tracks and i_* fields */
+        bool         b_prefetch;
+        vlc_thread_t thread;
+        vlc_mutex_t  lock;
+        vlc_cond_t   wait;      /* Wakes up the prefetch thread */
+        vlc_cond_t   filled;    /* Signaled after each prefetch read */
+        bool         b_reading; /* The access is used by the thread */
+        bool         b_eof;
+        bool         b_exit;    /* The stream is being destroyed */
+        unsigned     i_need;    /* Data requested ahead of the position */
+
     } stream;
 
     /* Peek temporary buffer */
@@ -182,6 +245,7 @@ static int  AStreamReadBlock( stream_t *s, void *p_read, unsigned int i_read );
 static int  AStreamPeekBlock( stream_t *s, const uint8_t **p_peek, unsigned int i_read );
 static int  AStreamSeekBlock( stream_t *s, uint64_t i_pos );
 static void AStreamPrebufferBlock( stream_t *s );
+static block_t *AStreamBlockBlock( stream_t *s, unsigned int i_read );
 static block_t *AReadBlock( stream_t *s, bool *pb_eof );
 
 /* Method 2 */
@@ -190,6 +254,11 @@ static int  AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned in
 static int  AStreamSeekStream( stream_t *s, uint64_t i_pos );
 static void AStreamPrebufferStream( stream_t *s );
 static int  AReadStream( stream_t *s, void *p_read, unsigned int i_read );
+static const stream_policy_t *AStreamDefaultPolicy( stream_t *s );
+static void AStreamSetPolicy( stream_t *s, const stream_policy_t *p_policy );
+static void AStreamResetTracks( stream_t *s );
+static void AStreamPausePrefetch( stream_t *s );
+static void *AStreamPrefetchThread( void * );
 
 /* ReadDir */
 static input_item_t *AStreamReadDir( stream_t *s );
@@ -380,6 +449,7 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
         msg_Dbg( s, "Using block method for AStream*" );
         s->pf_read = AStreamReadBlock;
         s->pf_peek = AStreamPeekBlock;
+        s->pf_block = AStreamBlockBlock;
 
         /* Init all fields of p_sys->block */
         p_sys->block.i_start = p_sys->i_pos;
@@ -388,6 +458,7 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
         p_sys->block.i_size = 0;
         p_sys->block.p_first = NULL;
         p_sys->block.pp_last = &p_sys->block.p_first;
+        p_sys->block.b_share = false;
 
         /* Do the prebuffering */
         AStreamPrebufferBlock( s );
@@ -400,33 +471,38 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
     }
     else if ( p_sys->method == STREAM_METHOD_STREAM )
     {
-        int i;
-
         msg_Dbg( s, "Using stream method for AStream*" );
 
         s->pf_read = AStreamReadStream;
         s->pf_peek = AStreamPeekStream;
 
         /* Allocate/Setup our tracks */
-        p_sys->stream.i_offset = 0;
-        p_sys->stream.i_tk     = 0;
         p_sys->stream.p_buffer = malloc( STREAM_CACHE_SIZE );
         if( p_sys->stream.p_buffer == NULL )
             goto error;
-        p_sys->stream.i_used   = 0;
         p_sys->stream.i_read_size = STREAM_READ_ATONCE;
 #if STREAM_READ_ATONCE < 256
 #   error "Invalid STREAM_READ_ATONCE value"
 #endif
 
-        for( i = 0; i < STREAM_CACHE_TRACK; i++ )
-        {
-            p_sys->stream.tk[i].i_date  = 0;
-            p_sys->stream.tk[i].i_start = p_sys->i_pos;
-            p_sys->stream.tk[i].i_end   = p_sys->i_pos;
-            p_sys->stream.tk[i].p_buffer=
-                &p_sys->stream.p_buffer[i * STREAM_CACHE_TRACK_SIZE];
-        }
+        access_Control( p_access, ACCESS_CAN_SEEK,
+                        &p_sys->stream.b_can_seek );
+        access_Control( p_access, ACCESS_CAN_FASTSEEK,
+                        &p_sys->stream.b_can_fastseek );
+        p_sys->stream.i_jump_pos = p_sys->i_pos;
+        p_sys->stream.i_run_avg = STREAM_CACHE_TRACK_SIZE;
+
+        p_sys->stream.p_policy = NULL;
+        AStreamSetPolicy( s, AStreamDefaultPolicy( s ) );
+
+        p_sys->stream.b_prefetch = false;
+        vlc_mutex_init( &p_sys->stream.lock );
+        vlc_cond_init( &p_sys->stream.wait );
+        vlc_cond_init( &p_sys->stream.filled );
+        p_sys->stream.b_reading = false;
+        p_sys->stream.b_eof = false;
+        p_sys->stream.b_exit = false;
+        p_sys->stream.i_need = 0;
 
         /* Do the prebuffering */
         AStreamPrebufferStream( s );
@@ -434,8 +510,21 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
         if( p_sys->stream.tk[p_sys->stream.i_tk].i_end <= 0 )
         {
             msg_Err( s, "cannot pre fill buffer" );
+            vlc_cond_destroy( &p_sys->stream.filled );
+            vlc_cond_destroy( &p_sys->stream.wait );
+            vlc_mutex_destroy( &p_sys->stream.lock );
             goto error;
         }
+
+        /* From now on, the access is only read by the prefetch thread */
+        p_sys->stream.b_prefetch = var_InheritBool( s, "stream-prefetch" );
+        if( p_sys->stream.b_prefetch &&
+            vlc_clone( &p_sys->stream.thread, AStreamPrefetchThread, s,
+                       VLC_THREAD_PRIORITY_INPUT ) )
+        {
+            msg_Warn( s, "cannot start prefetch thread" );
+            p_sys->stream.b_prefetch = false;
+        }
     }
     else
     {
@@ -475,7 +564,23 @@ static void AStreamDestroy( stream_t *s )
     if( p_sys->method == STREAM_METHOD_BLOCK )
         block_ChainRelease( p_sys->block.p_first );
     else if( p_sys->method == STREAM_METHOD_STREAM )
+    {
+        if( p_sys->stream.b_prefetch )
+        {
+            /* The thread is not cancellable while it uses the access: ask it
+             * to exit and wake it up if it waits for data */
+            vlc_mutex_lock( &p_sys->stream.lock );
+            p_sys->stream.b_exit = true;
+            vlc_cond_signal( &p_sys->stream.wait );
+            vlc_mutex_unlock( &p_sys->stream.lock );
+            ObjectKillChildrens( VLC_OBJECT(p_sys->p_access) );
+            vlc_join( p_sys->stream.thread, NULL );
+        }
+        vlc_cond_destroy( &p_sys->stream.filled );
+        vlc_cond_destroy( &p_sys->stream.wait );
+        vlc_mutex_destroy( &p_sys->stream.lock );
         free( p_sys->stream.p_buffer );
+    }
 
     free( p_sys->p_peek );
 
@@ -520,24 +625,25 @@ static void AStreamControlReset( stream_t *s )
     }
     else
     {
-        int i;
-
         assert( p_sys->method == STREAM_METHOD_STREAM );
 
-        /* Setup our tracks */
-        p_sys->stream.i_offset = 0;
-        p_sys->stream.i_tk     = 0;
-        p_sys->stream.i_used   = 0;
+        /* The seekability may have changed with the title */
+        access_Control( p_sys->p_access, ACCESS_CAN_SEEK,
+                        &p_sys->stream.b_can_seek );
+        access_Control( p_sys->p_access, ACCESS_CAN_FASTSEEK,
+                        &p_sys->stream.b_can_fastseek );
+        p_sys->stream.i_jump_pos = p_sys->i_pos;
 
-        for( i = 0; i < STREAM_CACHE_TRACK; i++ )
-        {
-            p_sys->stream.tk[i].i_date  = 0;
-            p_sys->stream.tk[i].i_start = p_sys->i_pos;
-            p_sys->stream.tk[i].i_end   = p_sys->i_pos;
-        }
+        /* Setup our tracks */
+        AStreamSetPolicy( s, AStreamDefaultPolicy( s ) );
+        AStreamResetTracks( s );
+        p_sys->stream.b_eof = false;
+        p_sys->stream.b_exit = false;
+        p_sys->stream.i_need = 0;
 
         /* Do the prebuffering */
         AStreamPrebufferStream( s );
+        vlc_cond_signal( &p_sys->stream.wait );
     }
 }
 
@@ -560,6 +666,28 @@ static void AStreamControlUpdate( stream_t *s )
     }
 }
 
+/****************************************************************************
+ * AStreamAccessLock: gets exclusive use of the access
+ ****************************************************************************/
+static void AStreamAccessLock( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if( p_sys->method != STREAM_METHOD_STREAM )
+        return;
+
+    vlc_mutex_lock( &p_sys->stream.lock );
+    AStreamPausePrefetch( s );
+}
+
+static void AStreamAccessUnlock( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if( p_sys->method == STREAM_METHOD_STREAM )
+        vlc_mutex_unlock( &p_sys->stream.lock );
+}
+
 #define static_control_match(foo) \
     static_assert((unsigned) STREAM_##foo == ACCESS_##foo, "Mismatch")
 
@@ -589,10 +717,19 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
     static_control_match(SET_PRIVATE_ID_CA);
     static_control_match(GET_PRIVATE_ID_STATE);
 
+    int i_ret;
+
     switch( i_query )
     {
         case STREAM_CAN_SEEK:
         case STREAM_CAN_FASTSEEK:
+            if( p_sys->method == STREAM_METHOD_STREAM )
+            {
+                *va_arg( args, bool * ) = i_query == STREAM_CAN_SEEK ?
+                    p_sys->stream.b_can_seek : p_sys->stream.b_can_fastseek;
+                break;
+            }
+            /* fall through */
         case STREAM_CAN_PAUSE:
         case STREAM_CAN_CONTROL_PACE:
         case STREAM_GET_PTS_DELAY:
@@ -606,7 +743,10 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
         case STREAM_SET_PRIVATE_ID_STATE:
         case STREAM_SET_PRIVATE_ID_CA:
         case STREAM_GET_PRIVATE_ID_STATE:
-            return access_vaControl( p_access, i_query, args );
+            AStreamAccessLock( s );
+            i_ret = access_vaControl( p_access, i_query, args );
+            AStreamAccessUnlock( s );
+            return i_ret;
 
         case STREAM_GET_SIZE:
         {
@@ -619,7 +759,9 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
                     *pi_64 += s->p_sys->list[i]->i_size;
                 break;
             }
+            AStreamAccessLock( s );
             *pi_64 = access_GetSize( p_access );
+            AStreamAccessUnlock( s );
             break;
         }
 
@@ -635,7 +777,10 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
             case STREAM_METHOD_BLOCK:
                 return AStreamSeekBlock( s, offset );
             case STREAM_METHOD_STREAM:
-                return AStreamSeekStream( s, offset );
+                vlc_mutex_lock( &p_sys->stream.lock );
+                i_ret = AStreamSeekStream( s, offset );
+                vlc_mutex_unlock( &p_sys->stream.lock );
+                return i_ret;
             default:
                 vlc_assert_unreachable();
                 return VLC_EGENERIC;
@@ -643,15 +788,41 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
         }
 
         case STREAM_UPDATE_SIZE:
+            AStreamAccessLock( s );
             AStreamControlUpdate( s );
+            AStreamAccessUnlock( s );
             return VLC_SUCCESS;
 
+        case STREAM_GET_BUFFERED:
+        {
+            uint64_t *pi_64 = va_arg( args, uint64_t * );
+            switch( p_sys->method )
+            {
+            case STREAM_METHOD_BLOCK:
+                *pi_64 = p_sys->block.i_start + p_sys->block.i_size - p_sys->i_pos;
+                break;
+            case STREAM_METHOD_STREAM:
+            {
+                vlc_mutex_lock( &p_sys->stream.lock );
+                const stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
+                *pi_64 = tk->i_end > p_sys->i_pos ? tk->i_end - p_sys->i_pos : 0;
+                vlc_mutex_unlock( &p_sys->stream.lock );
+                break;
+            }
+            default:
+                return VLC_EGENERIC;
+            }
+            break;
+        }
+
         case STREAM_SET_TITLE:
         case STREAM_SET_SEEKPOINT:
         {
+            AStreamAccessLock( s );
             int ret = access_vaControl( p_access, i_query, args );
             if( ret == VLC_SUCCESS )
                 AStreamControlReset( s );
+            AStreamAccessUnlock( s );
             return ret;
         }
 
@@ -669,6 +840,7 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
         }
 
         case STREAM_SET_RECORD_STATE:
+        case STREAM_RECORD_DATA:
         default:
             msg_Err( s, "invalid stream_vaControl query=0x%x", i_query );
             return VLC_EGENERIC;
@@ -743,6 +915,7 @@ static void AStreamPrebufferBlock( stream_t *s )
 }
 
 static int AStreamRefillBlock( stream_t *s );
+static block_t *AStreamShareBlock( block_t *p_block );
 
 static int AStreamReadBlock( stream_t *s, void *p_read, unsigned int i_read )
 {
@@ -1037,6 +1210,11 @@ static int AStreamRefillBlock( stream_t *s )
     p_sys->stat.i_read_time += mdate() - i_start;
     while( b )
     {
+        block_t *p_next = b->p_next;
+
+        if( p_sys->block.b_share )
+            b = AStreamShareBlock( b );
+
         /* Append the block */
         p_sys->block.i_size += b->i_buffer;
         *p_sys->block.pp_last = b;
@@ -1050,43 +1228,140 @@ static int AStreamRefillBlock( stream_t *s )
         p_sys->stat.i_bytes += b->i_buffer;
         p_sys->stat.i_read_count++;
 
-        b = b->p_next;
+        b = p_next;
     }
     return VLC_SUCCESS;
 }
 
+/* Blocks much larger than their payload are not shared: views would pin
+ * too much memory. */
+static bool AStreamCanShareBlock( const block_t *p_block )
+{
+    return p_block->i_buffer >= p_block->i_size / 2;
+}
+
+static block_t *AStreamShareBlock( block_t *p_block )
+{
+    if( !AStreamCanShareBlock( p_block ) )
+        return p_block;
+    p_block->p_next = NULL;
+    return block_Shareable( p_block );
+}
+
+/* Makes the blocks already in the list shareable */
+static void AStreamShareBlocks( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    block_t **pp_block = &p_sys->block.p_first;
+
+    while( *pp_block != NULL )
+    {
+        block_t *b = *pp_block;
+        block_t *p_next = b->p_next;
+
+        b = AStreamShareBlock( b );
+        b->p_next = p_next;
+
+        if( p_sys->block.p_current == *pp_block )
+            p_sys->block.p_current = b;
+        *pp_block = b;
+        pp_block = &b->p_next;
+    }
+    p_sys->block.pp_last = pp_block;
+}
+
+/* Returns a block referencing the cached data when it lies within one
+ * block, otherwise falls back to a copy. */
+static block_t *AStreamBlockBlock( stream_t *s, unsigned int i_read )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    /* From now on, share the blocks */
+    if( !p_sys->block.b_share )
+    {
+        AStreamShareBlocks( s );
+        p_sys->block.b_share = true;
+    }
+
+    block_t *p_current = p_sys->block.p_current;
+    if( p_current == NULL )
+        return NULL; /* EOF */
+
+    if( !AStreamCanShareBlock( p_current ) ||
+        p_current->i_buffer - p_sys->block.i_offset < i_read )
+        return stream_Block( s, i_read );
+
+    block_t *p_view = block_Share( p_current );
+    if( unlikely(p_view == NULL) )
+        return NULL;
+
+    /* Like stream_Block(), none of the access block properties */
+    p_view->p_buffer += p_sys->block.i_offset;
+    p_view->i_buffer = i_read;
+    p_view->i_flags = 0;
+    p_view->i_nb_samples = 0;
+    p_view->i_pts = p_view->i_dts = VLC_TS_INVALID;
+    p_view->i_length = 0;
+
+    p_sys->block.i_offset += i_read;
+    p_sys->i_pos += i_read;
+    if( p_sys->block.i_offset >= p_current->i_buffer )
+    {
+        /* Current block is now empty, switch to next */
+        p_sys->block.i_offset = 0;
+        p_sys->block.p_current = p_current->p_next;
+
+        /* Get a new block if needed, a failure is the EOF of the next read */
+        if( !p_sys->block.p_current )
+            AStreamRefillBlock( s );
+    }
+
+    return p_view;
+}
+
 
 /****************************************************************************
  * Method 2:
  ****************************************************************************/
 static int AStreamRefillStream( stream_t *s );
 static int AStreamReadNoSeekStream( stream_t *s, void *p_read, unsigned int i_read );
+static void AStreamKickPrefetch( stream_t *s );
 
 static int AStreamReadStream( stream_t *s, void *p_read, unsigned int i_read )
 {
     stream_sys_t *p_sys = s->p_sys;
+    int i_ret;
 
+    vlc_mutex_lock( &p_sys->stream.lock );
     if( !p_read )
     {
         const uint64_t i_pos_wanted = p_sys->i_pos + i_read;
 
+        i_ret = i_read;
         if( AStreamSeekStream( s, i_pos_wanted ) )
         {
             if( p_sys->i_pos != i_pos_wanted )
-                return 0;
+                i_ret = 0;
         }
-        return i_read;
     }
-    return AStreamReadNoSeekStream( s, p_read, i_read );
+    else
+        i_ret = AStreamReadNoSeekStream( s, p_read, i_read );
+    vlc_mutex_unlock( &p_sys->stream.lock );
+
+    return i_ret;
 }
 
 static int AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned int i_read )
 {
     stream_sys_t *p_sys = s->p_sys;
-    stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
+    stream_track_t *tk;
     uint64_t i_off;
+    int i_ret = 0;
+
+    vlc_mutex_lock( &p_sys->stream.lock );
+    tk = &p_sys->stream.tk[p_sys->stream.i_tk];
 
-    if( tk->i_start >= tk->i_end ) return 0; /* EOF */
+    if( tk->i_start >= tk->i_end ) goto out; /* EOF */
 
 #ifdef STREAM_DEBUG
     msg_Dbg( s, "AStreamPeekStream: %d pos=%"PRId64" tk=%d "
@@ -1096,8 +1371,8 @@ static int AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned int
 #endif
 
     /* Avoid problem, but that should *never* happen */
-    if( i_read > STREAM_CACHE_TRACK_SIZE / 2 )
-        i_read = STREAM_CACHE_TRACK_SIZE / 2;
+    if( i_read > p_sys->stream.i_tk_size / 2 )
+        i_read = p_sys->stream.i_tk_size / 2;
 
     while( tk->i_end < tk->i_start + p_sys->stream.i_offset + i_read )
     {
@@ -1109,18 +1384,21 @@ static int AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned int
         if( AStreamRefillStream( s ) )
         {
             if( tk->i_end < tk->i_start + p_sys->stream.i_offset )
-                return 0; /* EOF */
+                goto out; /* EOF */
             i_read = tk->i_end - tk->i_start - p_sys->stream.i_offset;
             break;
         }
     }
 
-    /* Now, direct pointer or a copy ? */
-    i_off = (tk->i_start + p_sys->stream.i_offset) % STREAM_CACHE_TRACK_SIZE;
-    if( i_off + i_read <= STREAM_CACHE_TRACK_SIZE )
+    /* Now, direct pointer or a copy ?
+     * The prefetch thread never writes over data after the read position,
+     * so the pointer stays valid until the next stream call */
+    i_off = (tk->i_start + p_sys->stream.i_offset) % p_sys->stream.i_tk_size;
+    if( i_off + i_read <= p_sys->stream.i_tk_size )
     {
         *pp_peek = &tk->p_buffer[i_off];
-        return i_read;
+        i_ret = i_read;
+        goto out;
     }
 
     if( p_sys->i_peek < i_read )
@@ -1129,18 +1407,42 @@ static int AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned int
         if( !p_sys->p_peek )
         {
             p_sys->i_peek = 0;
-            return 0;
+            goto out;
         }
         p_sys->i_peek = i_read;
     }
 
     memcpy( p_sys->p_peek, &tk->p_buffer[i_off],
-            STREAM_CACHE_TRACK_SIZE - i_off );
-    memcpy( &p_sys->p_peek[STREAM_CACHE_TRACK_SIZE - i_off],
-            &tk->p_buffer[0], i_read - (STREAM_CACHE_TRACK_SIZE - i_off) );
+            p_sys->stream.i_tk_size - i_off );
+    memcpy( &p_sys->p_peek[p_sys->stream.i_tk_size - i_off],
+            &tk->p_buffer[0], i_read - (p_sys->stream.i_tk_size - i_off) );
 
     *pp_peek = p_sys->p_peek;
-    return i_read;
+    i_ret = i_read;
+out:
+    vlc_mutex_unlock( &p_sys->stream.lock );
+    return i_ret;
+}
+
+/* Keeps an average of the amount of data read between far seeks, and
+ * switches between the sequential and seek policies accordingly. */
+static void AStreamUpdatePolicy( stream_t *s, uint64_t i_pos )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    const uint64_t i_run = p_sys->i_pos > p_sys->stream.i_jump_pos ?
+                           p_sys->i_pos - p_sys->stream.i_jump_pos : 0;
+
+    p_sys->stream.i_run_avg = ( 3 * p_sys->stream.i_run_avg + i_run ) / 4;
+    p_sys->stream.i_jump_pos = i_pos;
+
+    if( !p_sys->stream.b_policy_auto || !p_sys->stream.b_can_seek )
+        return;
+
+    /* Hysteresis avoids flipping on every seek */
+    if( p_sys->stream.i_run_avg < STREAM_CACHE_TRACK_SIZE / 16 )
+        AStreamSetPolicy( s, &p_stream_policies[STREAM_POLICY_SEEK] );
+    else if( p_sys->stream.i_run_avg > STREAM_CACHE_TRACK_SIZE / 2 )
+        AStreamSetPolicy( s, &p_stream_policies[STREAM_POLICY_SEQUENTIAL] );
 }
 
 static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
@@ -1148,7 +1450,6 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
     stream_sys_t *p_sys = s->p_sys;
 
     stream_track_t *p_current = &p_sys->stream.tk[p_sys->stream.i_tk];
-    access_t *p_access = p_sys->p_access;
 
     if( p_current->i_start >= p_current->i_end  && i_pos >= p_current->i_end )
         return 0; /* EOF */
@@ -1162,24 +1463,28 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
              p_current->i_end );
 #endif
 
-    bool   b_aseek;
-    access_Control( p_access, ACCESS_CAN_SEEK, &b_aseek );
+    bool   b_aseek = p_sys->stream.b_can_seek;
     if( !b_aseek && i_pos < p_current->i_start )
     {
         msg_Warn( s, "AStreamSeekStream: can't seek" );
         return VLC_EGENERIC;
     }
 
-    bool   b_afastseek;
-    access_Control( p_access, ACCESS_CAN_FASTSEEK, &b_afastseek );
+    bool   b_afastseek = p_sys->stream.b_can_fastseek;
 
     /* FIXME compute seek cost (instead of static 'stupid' value) */
     uint64_t i_skip_threshold;
     if( b_aseek )
-        i_skip_threshold = b_afastseek ? 128 : 3*p_sys->stream.i_read_size;
+        i_skip_threshold = b_afastseek ? 128 :
+            3 * __MIN( p_sys->stream.i_read_size, p_sys->stream.i_readahead );
     else
         i_skip_threshold = INT64_MAX;
 
+    /* The prefetch thread must not complete a read over data behind the
+     * position, nor into a track we are about to change */
+    if( i_pos < p_sys->i_pos )
+        AStreamPausePrefetch( s );
+
     /* Date the current track */
     p_current->i_date = mdate();
 
@@ -1196,7 +1501,7 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
     if( !tk )
     {
         /* Try to maximize already read data */
-        for( int i = 0; i < STREAM_CACHE_TRACK; i++ )
+        for( unsigned i = 0; i < p_sys->stream.i_tk_count; i++ )
         {
             stream_track_t *t = &p_sys->stream.tk[i];
 
@@ -1213,7 +1518,7 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
     if( !tk )
     {
         /* Use the oldest unused */
-        for( int i = 0; i < STREAM_CACHE_TRACK; i++ )
+        for( unsigned i = 0; i < p_sys->stream.i_tk_count; i++ )
         {
             stream_track_t *t = &p_sys->stream.tk[i];
 
@@ -1224,10 +1529,19 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
             }
         }
     }
-    assert( i_tk_idx >= 0 && i_tk_idx < STREAM_CACHE_TRACK );
+    assert( i_tk_idx >= 0 && i_tk_idx < (int)p_sys->stream.i_tk_count );
 
     if( tk != p_current )
         i_skip_threshold = 0;
+
+    const bool b_jump = tk != p_current ||
+        i_pos < tk->i_start || i_pos > tk->i_end + i_skip_threshold;
+    if( b_jump )
+    {
+        AStreamPausePrefetch( s );
+        AStreamUpdatePolicy( s, i_pos );
+    }
+
     if( tk->i_start <= i_pos && i_pos <= tk->i_end + i_skip_threshold )
     {
 #ifdef STREAM_DEBUG
@@ -1274,6 +1588,14 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
     p_sys->stream.i_tk = i_tk_idx;
     p_sys->i_pos = i_pos;
 
+    if( b_jump )
+    {
+        p_sys->stream.b_eof = false;
+        p_sys->stream.b_exit = false;
+        p_sys->stream.i_need = 0;
+    }
+    AStreamKickPrefetch( s );
+
     /* If there is not enough data left in the track, refill  */
     /* TODO How to get a correct value for
      *    - refilling threshold
@@ -1310,10 +1632,10 @@ static int AStreamReadNoSeekStream( stream_t *s, void *p_read, unsigned int i_re
 
     while( i_data < i_read )
     {
-        unsigned i_off = (tk->i_start + p_sys->stream.i_offset) % STREAM_CACHE_TRACK_SIZE;
+        unsigned i_off = (tk->i_start + p_sys->stream.i_offset) % p_sys->stream.i_tk_size;
         unsigned int i_current =
             __MIN( tk->i_end - tk->i_start - p_sys->stream.i_offset,
-                   STREAM_CACHE_TRACK_SIZE - i_off );
+                   p_sys->stream.i_tk_size - i_off );
         int i_copy = __MIN( i_current, i_read - i_data );
 
         if( i_copy <= 0 ) break; /* EOF */
@@ -1350,22 +1672,94 @@ static int AStreamReadNoSeekStream( stream_t *s, void *p_read, unsigned int i_re
             }
         }
     }
+    AStreamKickPrefetch( s );
 
     return i_data;
 }
 
+/* Appends i_read bytes just written at the end of a track, keeping it
+ * within a window of i_tk_size */
+static void AStreamTrackAppend( stream_t *s, stream_track_t *tk,
+                                unsigned i_read )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    tk->i_end += i_read;
+
+    if( tk->i_start + p_sys->stream.i_tk_size < tk->i_end )
+    {
+        unsigned i_invalid = tk->i_end - tk->i_start - p_sys->stream.i_tk_size;
+
+        tk->i_start += i_invalid;
+        p_sys->stream.i_offset -= i_invalid;
+    }
+}
+
+/* Accounts an access read, and sizes the next ones so that each takes
+ * about STREAM_READ_PERIOD at the measured throughput */
+static void AStreamUpdateThroughput( stream_t *s, unsigned i_read,
+                                     mtime_t i_duration )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    p_sys->stat.i_bytes += i_read;
+    p_sys->stat.i_read_count++;
+    p_sys->stat.i_read_time += i_duration;
+
+    /* Forget old samples so that the estimation follows the network */
+    if( p_sys->stat.i_read_time > STREAM_STAT_WINDOW )
+    {
+        p_sys->stat.i_bytes /= 2;
+        p_sys->stat.i_read_time /= 2;
+        p_sys->stat.i_read_count = (p_sys->stat.i_read_count + 1) / 2;
+    }
+
+    const uint64_t i_size = p_sys->stat.i_bytes * STREAM_READ_PERIOD /
+                            (p_sys->stat.i_read_time + 1);
+    p_sys->stream.i_read_size = VLC_CLIP( i_size, STREAM_READ_ATONCE,
+                                          p_sys->stream.i_tk_size / 8 );
+}
+
+/* Waits for the prefetch thread to add data to the current track */
+static int AStreamWaitStream( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
+    const uint64_t i_end = tk->i_end;
+    const unsigned i_ahead = tk->i_end - tk->i_start - p_sys->stream.i_offset;
+
+    if( i_ahead >= p_sys->stream.i_tk_size )
+        return VLC_EGENERIC; /* Track is full */
+
+    p_sys->stream.i_need = i_ahead + __MAX( p_sys->stream.i_used, 1 );
+    p_sys->stream.b_eof = false;
+    vlc_cond_signal( &p_sys->stream.wait );
+
+    mutex_cleanup_push( &p_sys->stream.lock );
+    while( tk->i_end == i_end && !p_sys->stream.b_eof )
+        vlc_cond_wait( &p_sys->stream.filled, &p_sys->stream.lock );
+    vlc_cleanup_pop();
+
+    if( tk->i_end == i_end )
+        return VLC_EGENERIC; /* EOF */
+
+    p_sys->stream.i_used -= __MIN( p_sys->stream.i_used, tk->i_end - i_end );
+    return VLC_SUCCESS;
+}
 
 static int AStreamRefillStream( stream_t *s )
 {
     stream_sys_t *p_sys = s->p_sys;
     stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
 
+    if( p_sys->stream.b_prefetch )
+        return AStreamWaitStream( s );
+
     /* We read but won't increase i_start after initial start + offset */
     int i_toread =
-        __MIN( p_sys->stream.i_used, STREAM_CACHE_TRACK_SIZE -
+        __MIN( p_sys->stream.i_used, p_sys->stream.i_tk_size -
                (tk->i_end - tk->i_start - p_sys->stream.i_offset) );
     bool b_read = false;
-    int64_t i_start, i_stop;
 
     if( i_toread <= 0 ) return VLC_EGENERIC; /* EOF */
 
@@ -1374,16 +1768,16 @@ static int AStreamRefillStream( stream_t *s )
                  p_sys->stream.i_used, i_toread );
 #endif
 
-    i_start = mdate();
     while( i_toread > 0 )
     {
-        int i_off = tk->i_end % STREAM_CACHE_TRACK_SIZE;
+        int i_off = tk->i_end % p_sys->stream.i_tk_size;
         int i_read;
 
         if( !vlc_object_alive(s) )
             return VLC_EGENERIC;
 
-        i_read = __MIN( i_toread, STREAM_CACHE_TRACK_SIZE - i_off );
+        const mtime_t i_start = mdate();
+        i_read = __MIN( i_toread, (int)p_sys->stream.i_tk_size - i_off );
         i_read = AReadStream( s, &tk->p_buffer[i_off], i_read );
 
         /* msg_Dbg( s, "AStreamRefillStream: read=%d", i_read ); */
@@ -1399,27 +1793,12 @@ static int AStreamRefillStream( stream_t *s )
         }
         b_read = true;
 
-        /* Update end */
-        tk->i_end += i_read;
-
-        /* Windows of STREAM_CACHE_TRACK_SIZE */
-        if( tk->i_start + STREAM_CACHE_TRACK_SIZE < tk->i_end )
-        {
-            unsigned i_invalid = tk->i_end - tk->i_start - STREAM_CACHE_TRACK_SIZE;
-
-            tk->i_start += i_invalid;
-            p_sys->stream.i_offset -= i_invalid;
-        }
+        AStreamTrackAppend( s, tk, i_read );
+        AStreamUpdateThroughput( s, i_read, mdate() - i_start );
 
         i_toread -= i_read;
         p_sys->stream.i_used -= i_read;
-
-        p_sys->stat.i_bytes += i_read;
-        p_sys->stat.i_read_count++;
     }
-    i_stop = mdate();
-
-    p_sys->stat.i_read_time += i_stop - i_start;
 
     return VLC_SUCCESS;
 }
@@ -1460,7 +1839,7 @@ static void AStreamPrebufferStream( stream_t *s )
         }
 
         /* */
-        i_read = STREAM_CACHE_TRACK_SIZE - i_buffered;
+        i_read = p_sys->stream.i_tk_size - i_buffered;
         i_read = __MIN( (int)p_sys->stream.i_read_size, i_read );
         i_read = AReadStream( s, &tk->p_buffer[i_buffered], i_read );
         if( i_read <  0 )
@@ -1481,6 +1860,160 @@ static void AStreamPrebufferStream( stream_t *s )
     }
 }
 
+/****************************************************************************
+ * Method 2 policies and prefetching
+ ****************************************************************************/
+static const stream_policy_t *AStreamDefaultPolicy( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    char *psz_policy = var_InheritString( s, "stream-cache-policy" );
+
+    p_sys->stream.b_policy_auto = true;
+    if( psz_policy )
+    {
+        for( unsigned i = 0; i < ARRAY_SIZE(p_stream_policies); i++ )
+        {
+            if( !strcmp( psz_policy, p_stream_policies[i].psz_name ) )
+            {
+                p_sys->stream.b_policy_auto = false;
+                free( psz_policy );
+                return &p_stream_policies[i];
+            }
+        }
+        free( psz_policy );
+    }
+
+    if( !p_sys->stream.b_can_seek )
+        return &p_stream_policies[STREAM_POLICY_NOSEEK];
+    if( p_sys->stream.p_policy &&
+        p_sys->stream.p_policy != &p_stream_policies[STREAM_POLICY_NOSEEK] )
+        return p_sys->stream.p_policy;
+    return &p_stream_policies[STREAM_POLICY_SEQUENTIAL];
+}
+
+static void AStreamResetTracks( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    p_sys->stream.i_offset = 0;
+    p_sys->stream.i_tk     = 0;
+    p_sys->stream.i_used   = 0;
+
+    for( unsigned i = 0; i < p_sys->stream.i_tk_count; i++ )
+    {
+        p_sys->stream.tk[i].i_date  = 0;
+        p_sys->stream.tk[i].i_start = p_sys->i_pos;
+        p_sys->stream.tk[i].i_end   = p_sys->i_pos;
+        p_sys->stream.tk[i].p_buffer=
+            &p_sys->stream.p_buffer[i * p_sys->stream.i_tk_size];
+    }
+}
+
+/* Changing the number of tracks drops the cache content, so it must only
+ * happen when the access is at p_sys->i_pos (open, reset). */
+static void AStreamSetPolicy( stream_t *s, const stream_policy_t *p_policy )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    const stream_policy_t *p_old = p_sys->stream.p_policy;
+
+    if( p_old == p_policy )
+        return;
+
+    p_sys->stream.p_policy = p_policy;
+    if( p_old == NULL || p_old->i_tracks != p_policy->i_tracks )
+    {
+        p_sys->stream.i_tk_count = p_policy->i_tracks;
+        p_sys->stream.i_tk_size  = STREAM_CACHE_SIZE / p_policy->i_tracks;
+        AStreamResetTracks( s );
+    }
+    p_sys->stream.i_readahead = p_sys->stream.i_tk_size / p_policy->i_readahead;
+
+    msg_Dbg( s, "using %s cache policy (%u tracks, %u bytes read-ahead)",
+             p_policy->psz_name, p_sys->stream.i_tk_count,
+             p_sys->stream.i_readahead );
+}
+
+/* Waits until the prefetch thread is out of the access */
+static void AStreamPausePrefetch( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    mutex_cleanup_push( &p_sys->stream.lock );
+    while( p_sys->stream.b_reading )
+        vlc_cond_wait( &p_sys->stream.filled, &p_sys->stream.lock );
+    vlc_cleanup_pop();
+}
+
+/* Wakes the prefetch thread up once half the read-ahead was consumed */
+static void AStreamKickPrefetch( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
+
+    if( p_sys->stream.b_prefetch &&
+        tk->i_end - tk->i_start - p_sys->stream.i_offset <
+            p_sys->stream.i_readahead / 2 )
+        vlc_cond_signal( &p_sys->stream.wait );
+}
+
+static void *AStreamPrefetchThread( void *data )
+{
+    stream_t *s = data;
+    stream_sys_t *p_sys = s->p_sys;
+    int canc = vlc_savecancel();
+
+    vlc_mutex_lock( &p_sys->stream.lock );
+    for( ;; )
+    {
+        stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
+        unsigned i_off, i_toread;
+
+        if( p_sys->stream.b_exit )
+            break;
+
+        const unsigned i_ahead =
+            tk->i_end - tk->i_start - p_sys->stream.i_offset;
+        const unsigned i_target =
+            __MIN( __MAX( p_sys->stream.i_readahead, p_sys->stream.i_need ),
+                   p_sys->stream.i_tk_size );
+
+        if( p_sys->stream.b_eof || i_ahead >= i_target )
+        {
+            vlc_cond_wait( &p_sys->stream.wait, &p_sys->stream.lock );
+            continue;
+        }
+
+        /* Never write over data after the read position */
+        i_off = tk->i_end % p_sys->stream.i_tk_size;
+        i_toread = __MIN( i_target - i_ahead, p_sys->stream.i_read_size );
+        i_toread = __MIN( i_toread, p_sys->stream.i_tk_size - i_off );
+
+        p_sys->stream.b_reading = true;
+        vlc_mutex_unlock( &p_sys->stream.lock );
+
+        const mtime_t i_start = mdate();
+        int i_read = AReadStream( s, &tk->p_buffer[i_off], i_toread );
+        const mtime_t i_duration = mdate() - i_start;
+
+        vlc_mutex_lock( &p_sys->stream.lock );
+        p_sys->stream.b_reading = false;
+        if( i_read > 0 )
+        {
+            AStreamTrackAppend( s, tk, i_read );
+            AStreamUpdateThroughput( s, i_read, i_duration );
+        }
+        else if( i_read == 0 || !vlc_object_alive(s) )
+            /* EOF: wait for a reader to ask again */
+            p_sys->stream.b_eof = true;
+        /* else nothing this time, try again */
+        vlc_cond_broadcast( &p_sys->stream.filled );
+    }
+    vlc_mutex_unlock( &p_sys->stream.lock );
+
+    vlc_restorecancel( canc );
+    return NULL;
+}
+
 /****************************************************************************
  * stream_ReadLine:
  ****************************************************************************/
@@ -1693,11 +2226,9 @@ static int AReadStream( stream_t *s, void *p_read, unsigned int i_read )
         {
             uint64_t total;
 
-            vlc_mutex_lock( &p_input->p->counters.counters_lock );
             stats_Update( p_input->p->counters.p_read_bytes, i_read, &total );
             stats_Update( p_input->p->counters.p_input_bitrate, total, NULL );
             stats_Update( p_input->p->counters.p_read_packets, 1, NULL );
-            vlc_mutex_unlock( &p_input->p->counters.counters_lock );
         }
         return i_read;
     }
@@ -1731,11 +2262,9 @@ static int AReadStream( stream_t *s, void *p_read, unsigned int i_read )
     {
         uint64_t total;
 
-        vlc_mutex_lock( &p_input->p->counters.counters_lock );
         stats_Update( p_input->p->counters.p_read_bytes, i_read, &total );
         stats_Update( p_input->p->counters.p_input_bitrate, total, NULL );
         stats_Update( p_input->p->counters.p_read_packets, 1, NULL );
-        vlc_mutex_unlock( &p_input->p->counters.counters_lock );
     }
     return i_read;
 }
@@ -1756,13 +2285,11 @@ static block_t *AReadBlock( stream_t *s, bool *pb_eof )
         {
             uint64_t total;
 
-            vlc_mutex_lock( &p_input->p->counters.counters_lock );
             stats_Update( p_input->p->counters.p_read_bytes,
                           p_block->i_buffer, &total );
             stats_Update( p_input->p->counters.p_input_bitrate,
                           total, NULL );
             stats_Update( p_input->p->counters.p_read_packets, 1, NULL );
-            vlc_mutex_unlock( &p_input->p->counters.counters_lock );
         }
         return p_block;
     }
@@ -1797,12 +2324,10 @@ static block_t *AReadBlock( stream_t *s, bool *pb_eof )
         {
             uint64_t total;
 
-            vlc_mutex_lock( &p_input->p->counters.counters_lock );
             stats_Update( p_input->p->counters.p_read_bytes,
                           p_block->i_buffer, &total );
             stats_Update( p_input->p->counters.p_input_bitrate, total, NULL );
             stats_Update( p_input->p->counters.p_read_packets, 1 , NULL);
-            vlc_mutex_unlock( &p_input->p->counters.counters_lock );
         }
     }
     return p_block;
@@ -1951,6 +2476,22 @@ block_t *stream_Block( stream_t *s, int i_size )
     return NULL;
 }
 
+/**
+ * Read "i_size" bytes and store them in a block_t, like stream_Block().
+ * When the stream supports it, the returned block shares its payload with
+ * the stream cache instead of being a copy: it must go through
+ * block_Unshare() (or block_Realloc()) before its payload is written to,
+ * as the data may be read again after a backward seek.
+ */
+block_t *stream_ReadBlock( stream_t *s, int i_size )
+{
+    if( i_size <= 0 ) return NULL;
+
+    if( s->pf_block == NULL )
+        return stream_Block( s, i_size );
+    return s->pf_block( s, i_size );
+}
+
 /**
  * Read the remaining of the data if there is less than i_max_size bytes, otherwise
  * return NULL.
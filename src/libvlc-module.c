@@ -85,6 +85,14 @@ static const char *const ppsz_snap_formats[] =
     "This is the verbosity level (0=only errors and " \
     "standard messages, 1=warnings, 2=debug).")
 
+#define LOG_ASYNC_TEXT N_("Asynchronous logging")
+#define LOG_ASYNC_LONGTEXT N_( \
+    "Queue the messages and pass them to the logger from a dedicated " \
+    "thread, so that a slow logger does not stall the emitting threads. " \
+    "Messages above the verbosity level of the logger are discarded " \
+    "before being formatted, and messages are dropped when the queue is " \
+    "full.")
+
 #define OPEN_TEXT N_("Default stream")
 #define OPEN_LONGTEXT N_( \
     "This stream will always be opened at VLC startup." )
@@ -676,6 +684,28 @@ static const char *const ppsz_prefres[] = {
     "This is the maximum size in bytes of the temporary files " \
     "that will be used to store the timeshifted streams." )
 
+#define INPUT_TIMESHIFT_DURATION_TEXT N_("Timeshift duration")
+#define INPUT_TIMESHIFT_DURATION_LONGTEXT N_( \
+    "Duration in seconds of the already played part of live streams " \
+    "that is kept in the timeshift files, so that one can seek back " \
+    "into it. 0 disables it." )
+
+#define STREAM_PREFETCH_TEXT N_("Prefetch stream data")
+#define STREAM_PREFETCH_LONGTEXT N_( \
+    "Read data ahead of the demuxer from a separate thread, so that " \
+    "slow accesses do not stall the demuxer." )
+
+#define STREAM_CACHE_POLICY_TEXT N_("Stream cache policy")
+#define STREAM_CACHE_POLICY_LONGTEXT N_( \
+    "Select how the stream cache reads ahead. By default, it adapts to " \
+    "whether the stream is read sequentially or with frequent seeks." )
+
+static const char *const ppsz_stream_cache_policy[] = {
+    "auto", "sequential", "seek", "noseek" };
+static const char *const ppsz_stream_cache_policy_text[] = {
+    N_("Automatic"), N_("Sequential reading"), N_("Frequent seeking"),
+    N_("Non-seekable stream") };
+
 #define INPUT_TITLE_FORMAT_TEXT N_( "Change title according to current media" )
 #define INPUT_TITLE_FORMAT_LONGTEXT N_( "This option allows you to set the title according to what's being played<br>"  \
     "$a: Artist<br>$b: Album<br>$c: Copyright<br>$t: Title<br>$g: Genre<br>"  \
@@ -823,6 +853,11 @@ static const char *const ppsz_prefres[] = {
     "However allocation of port numbers below 1025 is usually restricted " \
     "by the operating system." )
 
+#define HTTP_STREAM_WINDOW_TEXT N_("HTTP stream window (kB)")
+#define HTTP_STREAM_WINDOW_LONGTEXT N_( \
+    "Amount of the last data kept for each stream served over HTTP. " \
+    "Clients falling further behind skip ahead." )
+
 #define HTTP_CERT_TEXT N_("HTTP/TLS server certificate")
 #define CERT_LONGTEXT N_( \
    "This X.509 certicate file (PEM format) is used for server-side TLS. " \
@@ -1091,6 +1126,15 @@ static const char *const ppsz_prefres[] = {
     "Automatically preparse files added to the playlist " \
     "(to retrieve some metadata)." )
 
+#define PREPARSE_THREADS_TEXT N_( "Preparsing threads" )
+#define PREPARSE_THREADS_LONGTEXT N_( \
+    "Maximum number of items preparsed at the same time." )
+
+#define PREPARSE_TIMEOUT_TEXT N_( "Preparsing timeout (ms)" )
+#define PREPARSE_TIMEOUT_LONGTEXT N_( \
+    "Preparsing of an item is aborted after this delay, so that slow " \
+    "items do not hold up the others. 0 means no timeout." )
+
 #define METADATA_NETWORK_TEXT N_( "Allow metadata network access" )
 
 #define SD_TEXT N_( "Services discovery modules")
@@ -1723,6 +1767,9 @@ vlc_module_begin ()
         change_integer_range( 1, 65535 )
     add_integer( "https-port", 8443, HTTPS_PORT_TEXT, HTTPS_PORT_LONGTEXT, true )
         change_integer_range( 1, 65535 )
+    add_integer( "http-stream-window", 5000, HTTP_STREAM_WINDOW_TEXT,
+                 HTTP_STREAM_WINDOW_LONGTEXT, true )
+        change_integer_range( 1, 1048576 )
     add_string( "rtsp-host", NULL, RTSP_HOST_TEXT, RTSP_HOST_LONGTEXT, true )
     add_integer( "rtsp-port", 554, RTSP_PORT_TEXT, RTSP_PORT_LONGTEXT, true )
         change_integer_range( 1, 65535 )
@@ -1839,6 +1886,15 @@ vlc_module_begin ()
                 INPUT_TIMESHIFT_PATH_LONGTEXT, true )
     add_integer( "input-timeshift-granularity", -1, INPUT_TIMESHIFT_GRANULARITY_TEXT,
                  INPUT_TIMESHIFT_GRANULARITY_LONGTEXT, true )
+    add_integer( "input-timeshift-duration", 0, INPUT_TIMESHIFT_DURATION_TEXT,
+                 INPUT_TIMESHIFT_DURATION_LONGTEXT, true )
+
+    add_bool( "stream-prefetch", true, STREAM_PREFETCH_TEXT,
+              STREAM_PREFETCH_LONGTEXT, true )
+    add_string( "stream-cache-policy", ppsz_stream_cache_policy[0],
+                STREAM_CACHE_POLICY_TEXT, STREAM_CACHE_POLICY_LONGTEXT, true )
+        change_string_list( ppsz_stream_cache_policy,
+                            ppsz_stream_cache_policy_text )
 
     add_string( "input-title-format", "$Z", INPUT_TITLE_FORMAT_TEXT, INPUT_TITLE_FORMAT_LONGTEXT, false );
 
@@ -2011,6 +2067,12 @@ vlc_module_begin ()
 
     add_bool( "auto-preparse", true, PREPARSE_TEXT,
               PREPARSE_LONGTEXT, false )
+    add_integer_with_range( "preparse-threads", 2, 1, 16,
+                            PREPARSE_THREADS_TEXT,
+                            PREPARSE_THREADS_LONGTEXT, true )
+    add_integer( "preparse-timeout", 5000, PREPARSE_TIMEOUT_TEXT,
+                 PREPARSE_TIMEOUT_LONGTEXT, true )
+        change_integer_range( 0, 3600000 )
 
     add_obsolete_integer( "album-art" )
     add_bool( "metadata-network-access", false, METADATA_NETWORK_TEXT,
@@ -2027,6 +2089,7 @@ vlc_module_begin ()
                  false )
         change_short('v')
         change_volatile ()
+    add_bool( "log-async", false, LOG_ASYNC_TEXT, LOG_ASYNC_LONGTEXT, true )
     add_obsolete_string( "verbose-objects" ) /* since 2.1.0 */
 #if !defined(_WIN32) && !defined(__OS2__)
     add_bool( "daemon", 0, DAEMON_TEXT, DAEMON_LONGTEXT, true )
@@ -487,6 +487,7 @@ dbus_out:
         free( psz_val );
     }
 
+    block_PoolInit();
     return VLC_SUCCESS;
 }
 
@@ -532,6 +533,9 @@ void libvlc_InternalCleanup( libvlc_int_t *p_libvlc )
     if( !var_InheritBool( p_libvlc, "ignore-config" ) )
         config_AutoSaveConfigFile( VLC_OBJECT(p_libvlc) );
 
+    block_PoolDump( VLC_OBJECT(p_libvlc) );
+    block_PoolEnd();
+
     /* Free module bank. It is refcounted, so we call this each time  */
     vlc_LogDeinit (p_libvlc);
     module_EndBank (true);
@@ -612,7 +616,8 @@ int libvlc_MetaRequest(libvlc_int_t *libvlc, input_item_t *item,
     if( item->i_preparse_depth == 0 )
         item->i_preparse_depth = 1;
     vlc_mutex_unlock( &item->lock );
-    playlist_preparser_Push(priv->parser, item, i_options);
+    playlist_preparser_Push(priv->parser, item, i_options,
+                            PREPARSER_PRIORITY_HIGH, NULL);
     return VLC_SUCCESS;
 }
 
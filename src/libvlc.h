@@ -25,6 +25,9 @@
 #ifndef LIBVLC_LIBVLC_H
 # define LIBVLC_LIBVLC_H 1
 
+# include <vlc_atomic.h>
+# include <vlc_input_item.h>
+
 extern const char psz_vlc_changeset[];
 
 typedef struct variable_t variable_t;
@@ -49,6 +52,9 @@ size_t EnumClockSource( vlc_object_t *, const char *, char ***, char *** );
 #endif
 void vlc_CPU_init(void);
 void vlc_CPU_dump(vlc_object_t *);
+void block_PoolInit(void);
+void block_PoolEnd(void);
+void block_PoolDump(vlc_object_t *);
 
 /*
  * Threads subsystem
@@ -188,6 +194,7 @@ enum
 {
     STATS_COUNTER,
     STATS_DERIVATIVE,
+    STATS_HISTOGRAM,
 };
 
 typedef struct counter_sample_t
@@ -196,13 +203,23 @@ typedef struct counter_sample_t
     mtime_t  date;
 } counter_sample_t;
 
+/* Counters are updated without locking from the threads producing the values
+ * (several for some counters, e.g. the access is read from the prefetch
+ * thread), and read back from the input thread. */
 typedef struct counter_t
 {
-    int                 i_compute_type;
-    int                 i_samples;
-    counter_sample_t ** pp_samples;
-
-    mtime_t             last_update;
+    int                  i_compute_type;
+    /* STATS_COUNTER: total, STATS_HISTOGRAM: sum of the samples */
+    atomic_uint_fast64_t value;
+
+    /* STATS_DERIVATIVE: the two last samples, at most one per second */
+    atomic_int_fast64_t  last_update;
+    vlc_mutex_t          lock;
+    int                  i_samples;
+    counter_sample_t     samples[2];
+
+    /* STATS_HISTOGRAM */
+    atomic_uint_fast64_t buckets[INPUT_STATS_LATENCY_BUCKETS];
 } counter_t;
 
 enum
@@ -37,6 +37,8 @@
 #include <vlc_common.h>
 #include <vlc_block.h>
 #include <vlc_fs.h>
+#include <vlc_atomic.h>
+#include "../libvlc.h"
 
 /**
  * @section Block handling functions.
@@ -126,6 +128,306 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 /* Maximum size of reserved footer before shrinking with realloc(). */
 #define BLOCK_WASTE_SIZE   2048
 
+/**
+ * @section Block pool
+ *
+ * Small blocks are allocated in power-of-two size classes and recycled
+ * through per-thread caches, backed by a global depot.
+ */
+#define BLOCK_POOL_MIN_SHIFT 9 /* 512 bytes */
+#define BLOCK_POOL_CLASSES   8 /* up to 64 KiB */
+/* Maximum size of the free blocks per class and thread */
+#define BLOCK_CACHE_SIZE     (1 << 18)
+/* Maximum size of the free blocks per class in the depot */
+#define BLOCK_DEPOT_SIZE     (1 << 20)
+
+typedef struct
+{
+    block_t  *free[BLOCK_POOL_CLASSES];
+    unsigned  count[BLOCK_POOL_CLASSES];
+} block_cache_t;
+
+static struct
+{
+    vlc_mutex_t     lock;
+    atomic_int      state; /* 0: not ready, 1: ready, -1: disabled */
+    vlc_threadvar_t key;
+    unsigned        refs; /* libvlc instances, protected by the lock */
+
+    /* depot, protected by the lock */
+    block_t        *free[BLOCK_POOL_CLASSES];
+    unsigned        count[BLOCK_POOL_CLASSES];
+
+    /* statistics */
+    atomic_uintmax_t hits[BLOCK_POOL_CLASSES];
+    atomic_uintmax_t misses[BLOCK_POOL_CLASSES];
+    atomic_size_t    outstanding[BLOCK_POOL_CLASSES];
+} block_pool = { .lock = VLC_STATIC_MUTEX };
+
+static size_t block_PoolClassSize (unsigned i)
+{
+    return (size_t)1 << (BLOCK_POOL_MIN_SHIFT + i);
+}
+
+/* Smallest class fitting the given allocation size, if any */
+static unsigned block_PoolClass (size_t alloc)
+{
+    unsigned i = 0;
+
+    while (i < BLOCK_POOL_CLASSES && block_PoolClassSize (i) < alloc)
+        i++;
+    return i;
+}
+
+static unsigned block_PoolCacheMax (unsigned i)
+{
+    return VLC_CLIP(BLOCK_CACHE_SIZE / block_PoolClassSize (i), 4, 64);
+}
+
+static unsigned block_PoolDepotMax (unsigned i)
+{
+    return BLOCK_DEPOT_SIZE / block_PoolClassSize (i);
+}
+
+/* Moves up to count blocks from a free list to another */
+static unsigned block_PoolMove (block_t **dst, block_t **src, unsigned count)
+{
+    unsigned moved = 0;
+
+    while (moved < count && *src != NULL)
+    {
+        block_t *b = *src;
+
+        *src = b->p_next;
+        b->p_next = *dst;
+        *dst = b;
+        moved++;
+    }
+    return moved;
+}
+
+static void block_PoolFreeList (block_t *list)
+{
+    while (list != NULL)
+    {
+        block_t *b = list;
+
+        list = b->p_next;
+        free (b);
+    }
+}
+
+static void block_CacheRelease (void *data)
+{
+    block_cache_t *cache = data;
+
+    vlc_mutex_lock (&block_pool.lock);
+    for (unsigned i = 0; i < BLOCK_POOL_CLASSES; i++)
+    {
+        unsigned room = block_PoolDepotMax (i) - block_pool.count[i];
+
+        block_pool.count[i] += block_PoolMove (&block_pool.free[i],
+                                               &cache->free[i], room);
+    }
+    vlc_mutex_unlock (&block_pool.lock);
+
+    for (unsigned i = 0; i < BLOCK_POOL_CLASSES; i++)
+        block_PoolFreeList (cache->free[i]);
+    free (cache);
+}
+
+static block_cache_t *block_CacheGet (void)
+{
+    int state = atomic_load_explicit (&block_pool.state, memory_order_acquire);
+
+    if (unlikely(state == 0))
+    {
+        vlc_mutex_lock (&block_pool.lock);
+        state = atomic_load_explicit (&block_pool.state,
+                                      memory_order_relaxed);
+        if (state == 0)
+        {
+            state = vlc_threadvar_create (&block_pool.key,
+                                          block_CacheRelease) ? -1 : 1;
+            atomic_store_explicit (&block_pool.state, state,
+                                   memory_order_release);
+        }
+        vlc_mutex_unlock (&block_pool.lock);
+    }
+    if (state < 0)
+        return NULL;
+
+    block_cache_t *cache = vlc_threadvar_get (block_pool.key);
+    if (unlikely(cache == NULL))
+    {
+        cache = calloc (1, sizeof (*cache));
+        if (cache != NULL && vlc_threadvar_set (block_pool.key, cache))
+        {
+            free (cache);
+            cache = NULL;
+        }
+    }
+    return cache;
+}
+
+static void block_pool_Release (block_t *block)
+{
+    unsigned i = block_PoolClass (sizeof (*block) + block->i_size);
+
+    assert (block->p_start == (unsigned char *)(block + 1));
+    assert (block_PoolClassSize (i) == sizeof (*block) + block->i_size);
+
+    block_Invalidate (block);
+    atomic_fetch_sub_explicit (&block_pool.outstanding[i],
+                               block_PoolClassSize (i), memory_order_relaxed);
+
+    block_cache_t *cache = block_CacheGet ();
+    if (unlikely(cache == NULL))
+    {
+        free (block);
+        return;
+    }
+
+    if (cache->count[i] >= block_PoolCacheMax (i))
+    {   /* Hand half of the cache over to the depot */
+        block_t *excess = NULL;
+        unsigned n = block_PoolMove (&excess, &cache->free[i],
+                                     block_PoolCacheMax (i) / 2);
+
+        cache->count[i] -= n;
+        vlc_mutex_lock (&block_pool.lock);
+        if (block_pool.count[i] + n <= block_PoolDepotMax (i))
+        {
+            block_pool.count[i] += block_PoolMove (&block_pool.free[i],
+                                                   &excess, n);
+        }
+        vlc_mutex_unlock (&block_pool.lock);
+
+        block_PoolFreeList (excess);
+    }
+
+    block->p_next = cache->free[i];
+    cache->free[i] = block;
+    cache->count[i]++;
+}
+
+static block_t *block_PoolAlloc (unsigned i)
+{
+    block_cache_t *cache = block_CacheGet ();
+    block_t *b = NULL;
+
+    if (likely(cache != NULL))
+    {
+        if (cache->free[i] == NULL)
+        {   /* Refill half of the cache from the depot */
+            vlc_mutex_lock (&block_pool.lock);
+            block_pool.count[i] -= block_PoolMove (&cache->free[i],
+                                                   &block_pool.free[i],
+                                                   block_PoolCacheMax (i) / 2);
+            vlc_mutex_unlock (&block_pool.lock);
+
+            for (block_t *f = cache->free[i]; f != NULL; f = f->p_next)
+                cache->count[i]++;
+        }
+
+        b = cache->free[i];
+        if (b != NULL)
+        {
+            cache->free[i] = b->p_next;
+            cache->count[i]--;
+        }
+    }
+
+    if (b != NULL)
+        atomic_fetch_add_explicit (&block_pool.hits[i], 1,
+                                   memory_order_relaxed);
+    else
+    {
+        b = malloc (block_PoolClassSize (i));
+        if (unlikely(b == NULL))
+            return NULL;
+        atomic_fetch_add_explicit (&block_pool.misses[i], 1,
+                                   memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit (&block_pool.outstanding[i],
+                               block_PoolClassSize (i), memory_order_relaxed);
+
+    block_Init (b, b + 1, block_PoolClassSize (i) - sizeof (*b));
+    b->pf_release = block_pool_Release;
+    return b;
+}
+
+void block_PoolInit (void)
+{
+    vlc_mutex_lock (&block_pool.lock);
+    block_pool.refs++;
+    vlc_mutex_unlock (&block_pool.lock);
+}
+
+/**
+ * Frees the pooled blocks once the last libvlc instance is cleaned up.
+ * The other threads using blocks must have exited by then: their caches were
+ * handed over to the depot.
+ */
+void block_PoolEnd (void)
+{
+    vlc_mutex_lock (&block_pool.lock);
+    assert (block_pool.refs > 0);
+    if (--block_pool.refs > 0)
+    {
+        vlc_mutex_unlock (&block_pool.lock);
+        return;
+    }
+
+    if (atomic_load_explicit (&block_pool.state, memory_order_relaxed) == 1)
+    {
+        block_cache_t *cache = vlc_threadvar_get (block_pool.key);
+
+        if (cache != NULL)
+        {
+            vlc_threadvar_set (block_pool.key, NULL);
+            for (unsigned i = 0; i < BLOCK_POOL_CLASSES; i++)
+                block_PoolFreeList (cache->free[i]);
+            free (cache);
+        }
+        vlc_threadvar_delete (&block_pool.key);
+        atomic_store_explicit (&block_pool.state, 0, memory_order_relaxed);
+    }
+
+    for (unsigned i = 0; i < BLOCK_POOL_CLASSES; i++)
+    {
+        block_PoolFreeList (block_pool.free[i]);
+        block_pool.free[i] = NULL;
+        block_pool.count[i] = 0;
+    }
+    vlc_mutex_unlock (&block_pool.lock);
+}
+
+void block_PoolDump (vlc_object_t *obj)
+{
+    for (unsigned i = 0; i < BLOCK_POOL_CLASSES; i++)
+    {
+        uintmax_t hits = atomic_load (&block_pool.hits[i]);
+        uintmax_t misses = atomic_load (&block_pool.misses[i]);
+
+        if (hits + misses == 0)
+            continue;
+        msg_Dbg (obj, "block pool %zu bytes: %ju%% hits (%ju allocations), "
+                 "%zu bytes outstanding", block_PoolClassSize (i),
+                 (100 * hits) / (hits + misses), hits + misses,
+                 atomic_load (&block_pool.outstanding[i]));
+    }
+}
+
+/* Whether reallocating would end up in the same size class anyway */
+static bool block_PoolFits (const block_t *block, size_t size)
+{
+    return block->pf_release == block_pool_Release
+        && block_PoolClass (sizeof (block_t) + BLOCK_ALIGN
+                            + (2 * BLOCK_PADDING) + size)
+           == block_PoolClass (sizeof (*block) + block->i_size);
+}
+
 block_t *block_Alloc (size_t size)
 {
     /* 2 * BLOCK_PADDING: pre + post padding */
@@ -134,20 +436,137 @@ block_t *block_Alloc (size_t size)
     if (unlikely(alloc <= size))
         return NULL;
 
-    block_t *b = malloc (alloc);
+    block_t *b;
+    unsigned i = block_PoolClass (alloc);
+
+    if (i < BLOCK_POOL_CLASSES)
+        b = block_PoolAlloc (i);
+    else
+    {
+        b = malloc (alloc);
+        if (likely(b != NULL))
+        {
+            block_Init (b, b + 1, alloc - sizeof (*b));
+            b->pf_release = block_generic_Release;
+        }
+    }
     if (unlikely(b == NULL))
         return NULL;
 
-    block_Init (b, b + 1, alloc - sizeof (*b));
     static_assert ((BLOCK_PADDING % BLOCK_ALIGN) == 0,
                    "BLOCK_PADDING must be a multiple of BLOCK_ALIGN");
     b->p_buffer += BLOCK_PADDING + BLOCK_ALIGN - 1;
     b->p_buffer = (void *)(((uintptr_t)b->p_buffer) & ~(BLOCK_ALIGN - 1));
     b->i_buffer = size;
-    b->pf_release = block_generic_Release;
     return b;
 }
 
+/**
+ * @section Shared blocks
+ *
+ * Each shared block is a view on the payload of the underlying block, which
+ * is released along with the last view.
+ */
+typedef struct
+{
+    atomic_uint refs;
+    block_t    *block; /**< Payload owner */
+} block_payload_t;
+
+typedef struct
+{
+    block_t          self;
+    block_payload_t *payload;
+} block_shared_t;
+
+static void block_shared_Release (block_t *block)
+{
+    block_payload_t *payload = ((block_shared_t *)block)->payload;
+
+    block_Invalidate (block);
+    free (block);
+
+    if (atomic_fetch_sub (&payload->refs, 1) == 1)
+    {
+        block_Release (payload->block);
+        free (payload);
+    }
+}
+
+static block_t *block_shared_New (block_payload_t *payload,
+                                  const block_t *from)
+{
+    block_shared_t *sh = malloc (sizeof (*sh));
+    if (unlikely(sh == NULL))
+        return NULL;
+
+    block_Init (&sh->self, from->p_start, from->i_size);
+    BlockMetaCopy (&sh->self, from);
+    sh->self.p_next = NULL;
+    sh->self.p_buffer = from->p_buffer;
+    sh->self.i_buffer = from->i_buffer;
+    sh->self.pf_release = block_shared_Release;
+    sh->payload = payload;
+    return &sh->self;
+}
+
+/* Whether the payload is also referenced by another block */
+static bool block_IsShared (const block_t *block)
+{
+    return block->pf_release == block_shared_Release
+        && atomic_load (&((block_shared_t *)block)->payload->refs) > 1;
+}
+
+block_t *block_Shareable (block_t *block)
+{
+    if (block->pf_release == block_shared_Release)
+        return block;
+
+    block_payload_t *payload = malloc (sizeof (*payload));
+    if (unlikely(payload == NULL))
+        return block; /* block_Share() will copy */
+
+    atomic_init (&payload->refs, 1);
+    payload->block = block;
+
+    block_t *shared = block_shared_New (payload, block);
+    if (unlikely(shared == NULL))
+    {
+        free (payload);
+        return block;
+    }
+    return shared;
+}
+
+block_t *block_Share (block_t *block)
+{
+    if (block->pf_release != block_shared_Release)
+        return block_Duplicate (block);
+
+    block_payload_t *payload = ((block_shared_t *)block)->payload;
+
+    atomic_fetch_add (&payload->refs, 1);
+    block_t *shared = block_shared_New (payload, block);
+    if (unlikely(shared == NULL))
+        atomic_fetch_sub (&payload->refs, 1);
+    return shared;
+}
+
+block_t *block_Unshare (block_t *block)
+{
+    if (!block_IsShared (block))
+        return block;
+
+    block_t *copy = block_Alloc (block->i_buffer);
+    if (likely(copy != NULL))
+    {
+        BlockMetaCopy (copy, block);
+        memcpy (copy->p_buffer, block->p_buffer, block->i_buffer);
+    }
+    block_Release (block);
+    return copy;
+}
+
 block_t *block_Realloc( block_t *p_block, ssize_t i_prebody, size_t i_body )
 {
     size_t requested = i_prebody + i_body;
@@ -165,12 +584,15 @@ block_t *block_Realloc( block_t *p_block, ssize_t i_prebody, size_t i_body )
     assert( p_block->p_start + p_block->i_size
                                     >= p_block->p_buffer + p_block->i_buffer );
 
+    /* A payload referenced elsewhere is copied rather than written to */
+    const bool b_shared = block_IsShared( p_block );
+
     /* Corner case: the current payload is discarded completely */
     if( i_prebody <= 0 && p_block->i_buffer <= (size_t)-i_prebody )
          p_block->i_buffer = 0; /* discard current payload */
     if( p_block->i_buffer == 0 )
     {
-        if( requested <= p_block->i_size )
+        if( requested <= p_block->i_size && !b_shared )
         {   /* Enough room: recycle buffer */
             size_t extra = p_block->i_size - requested;
 
@@ -209,7 +631,8 @@ block_t *block_Realloc( block_t *p_block, ssize_t i_prebody, size_t i_body )
      * minimize the payload size for memory copy. */
     assert( i_prebody >= 0 );
     if( (size_t)(p_block->p_buffer - p_start) < (size_t)i_prebody
-     || (size_t)(p_end - p_block->p_buffer) < i_body )
+     || (size_t)(p_end - p_block->p_buffer) < i_body
+     || (b_shared && (i_prebody > 0 || i_body > p_block->i_buffer)) )
     {
         block_t *p_rea = block_Alloc( requested );
         if( p_rea )
@@ -227,7 +650,8 @@ block_t *block_Realloc( block_t *p_block, ssize_t i_prebody, size_t i_body )
     else
     /* We have a very large reserved footer now? Release some of it.
      * XXX it might not preserve the alignment of p_buffer */
-    if( p_end - (p_block->p_buffer + i_body) > BLOCK_WASTE_SIZE )
+    if( p_end - (p_block->p_buffer + i_body) > BLOCK_WASTE_SIZE && !b_shared
+     && !block_PoolFits( p_block, requested ) )
     {
         block_t *p_rea = block_Alloc( requested );
         if( p_rea )
@@ -41,8 +41,39 @@
 #include <vlc_interface.h>
 #include <vlc_charset.h>
 #include <vlc_modules.h>
+#include <vlc_atomic.h>
 #include "../libvlc.h"
 
+/* Asynchronous logging: the emitting threads format their messages into
+ * a bounded lock-free ring, and a dedicated thread passes them to the
+ * logger. */
+#define LOG_ASYNC_SLOTS     1024 /* must be a power of 2 */
+#define LOG_ASYNC_MSG_SIZE  256
+#define LOG_ASYNC_MOD_SIZE  32
+
+typedef struct
+{
+    atomic_size_t seq;
+    int type;
+    vlc_log_t meta;
+    char module[LOG_ASYNC_MOD_SIZE];
+    char *header;
+    char *msg_alloc; /* for the messages too long for msg */
+    char msg[LOG_ASYNC_MSG_SIZE];
+} vlc_log_slot_t;
+
+typedef struct
+{
+    vlc_log_slot_t slots[LOG_ASYNC_SLOTS];
+    atomic_size_t enqueue;
+    size_t dequeue;
+    atomic_uint dropped;
+    int verbosity; /* of the logger module, VLC_MSG_DBG if unknown */
+    atomic_bool stop;
+    vlc_sem_t wait;
+    vlc_thread_t thread;
+} vlc_logger_async_t;
+
 struct vlc_logger_t
 {
     VLC_COMMON_MEMBERS
@@ -50,6 +81,12 @@ struct vlc_logger_t
     vlc_log_cb log;
     void *sys;
     module_t *module;
+
+    /* The ring is kept until vlc_LogDeinit(), as threads may still be
+     * pushing to it after the dispatch stopped. Those last messages are
+     * dropped. */
+    vlc_logger_async_t *async;
+    atomic_bool async_on;
 };
 
 static void vlc_vaLogCallback(libvlc_int_t *vlc, int type,
@@ -82,6 +119,160 @@ static void Win32DebugOutputMsg (void *, int , const vlc_log_t *,
                                  const char *, va_list);
 #endif
 
+static void vlc_LogAsyncPush(vlc_logger_async_t *async, int type,
+                             const vlc_log_t *item, const char *format,
+                             va_list ap)
+{
+    size_t pos = atomic_load_explicit(&async->enqueue, memory_order_relaxed);
+    vlc_log_slot_t *slot;
+
+    /* Claim a slot, the sequence number tells whether it is free */
+    for (;;)
+    {
+        slot = &async->slots[pos & (LOG_ASYNC_SLOTS - 1)];
+
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)(seq - pos);
+
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak(&async->enqueue, &pos, pos + 1))
+                break;
+        }
+        else if (diff < 0)
+        {   /* The ring is full */
+            atomic_fetch_add_explicit(&async->dropped, 1,
+                                      memory_order_relaxed);
+            return;
+        }
+        else
+            pos = atomic_load_explicit(&async->enqueue, memory_order_relaxed);
+    }
+
+    slot->type = type;
+    slot->meta = *item;
+    /* The module name is on the stack of vlc_vaLog() */
+    strlcpy(slot->module, item->psz_module, sizeof (slot->module));
+    slot->header = (item->psz_header != NULL) ? strdup(item->psz_header)
+                                              : NULL;
+    slot->msg_alloc = NULL;
+
+    va_list aq;
+    va_copy(aq, ap);
+    int len = vsnprintf(slot->msg, sizeof (slot->msg), format, aq);
+    va_end(aq);
+    if (len >= (int)sizeof (slot->msg)
+     && vasprintf(&slot->msg_alloc, format, ap) == -1)
+        slot->msg_alloc = NULL;
+
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    vlc_sem_post(&async->wait);
+}
+
+static void vlc_LogAsyncDrain(libvlc_int_t *vlc, vlc_logger_async_t *async)
+{
+    for (;;)
+    {
+        vlc_log_slot_t *slot =
+            &async->slots[async->dequeue & (LOG_ASYNC_SLOTS - 1)];
+
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire)
+                                                        != async->dequeue + 1)
+            break; /* empty, or not written yet */
+
+        if (vlc != NULL)
+        {
+            slot->meta.psz_module = slot->module;
+            slot->meta.psz_header = slot->header;
+            vlc_LogCallback(vlc, slot->type, &slot->meta, "%s",
+                            (slot->msg_alloc != NULL) ? slot->msg_alloc
+                                                      : slot->msg);
+        }
+        free(slot->msg_alloc);
+        free(slot->header);
+
+        atomic_store_explicit(&slot->seq, async->dequeue + LOG_ASYNC_SLOTS,
+                              memory_order_release);
+        async->dequeue++;
+    }
+
+    unsigned dropped = atomic_exchange(&async->dropped, 0);
+    if (dropped > 0 && vlc != NULL)
+    {
+        vlc_log_t meta = {
+            .i_object_id = (uintptr_t)vlc,
+            .psz_object_type = "logger",
+            .psz_module = "core",
+            .psz_header = NULL,
+            .file = __FILE__,
+            .line = __LINE__,
+            .func = __func__,
+        };
+        vlc_LogCallback(vlc, VLC_MSG_WARN, &meta, "%u messages dropped",
+                        dropped);
+    }
+}
+
+static void *vlc_LogAsyncThread(void *data)
+{
+    vlc_logger_t *logger = data;
+    vlc_logger_async_t *async = logger->async;
+
+    for (;;)
+    {
+        vlc_sem_wait(&async->wait);
+        vlc_LogAsyncDrain(logger->p_libvlc, async);
+        if (atomic_load(&async->stop))
+            break;
+    }
+    return NULL;
+}
+
+static void vlc_LogAsyncStart(vlc_logger_t *logger)
+{
+    vlc_logger_async_t *async = malloc(sizeof (*async));
+    if (unlikely(async == NULL))
+        return;
+
+    for (size_t i = 0; i < LOG_ASYNC_SLOTS; i++)
+        atomic_init(&async->slots[i].seq, i);
+    atomic_init(&async->enqueue, 0);
+    async->dequeue = 0;
+    atomic_init(&async->dropped, 0);
+    atomic_init(&async->stop, false);
+    vlc_sem_init(&async->wait, 0);
+
+    /* Only the logger module knows which messages it keeps */
+    async->verbosity = var_GetInteger(logger, "log-verbosity");
+
+    logger->async = async;
+    if (vlc_clone(&async->thread, vlc_LogAsyncThread, logger,
+                  VLC_THREAD_PRIORITY_LOW))
+    {
+        vlc_sem_destroy(&async->wait);
+        free(async);
+        logger->async = NULL;
+        return;
+    }
+    atomic_store_explicit(&logger->async_on, true, memory_order_release);
+}
+
+/**
+ * Stops the asynchronous dispatch, after passing the queued messages to the
+ * logger.
+ */
+static void vlc_LogAsyncStop(vlc_logger_t *logger)
+{
+    vlc_logger_async_t *async = logger->async;
+
+    if (async == NULL || !atomic_exchange(&logger->async_on, false))
+        return;
+
+    atomic_store(&async->stop, true);
+    vlc_sem_post(&async->wait);
+    vlc_join(async->thread, NULL);
+}
+
 /**
  * Emit a log message. This function is the variable argument list equivalent
  * to vlc_Log().
@@ -93,6 +284,20 @@ void vlc_vaLog (vlc_object_t *obj, int type, const char *module,
     if (obj != NULL && obj->i_flags & OBJECT_FLAGS_QUIET)
         return;
 
+    vlc_logger_async_t *async = NULL;
+    if (obj != NULL)
+    {
+        vlc_logger_t *logger = libvlc_priv(obj->p_libvlc)->logger;
+
+        if (atomic_load_explicit(&logger->async_on, memory_order_acquire))
+        {
+            async = logger->async;
+            /* Filter before doing any work */
+            if (type > async->verbosity)
+                return;
+        }
+    }
+
     /* Get basename from the module filename */
     char *p = strrchr(module, '/');
     if (p != NULL)
@@ -135,7 +340,9 @@ void vlc_vaLog (vlc_object_t *obj, int type, const char *module,
 #endif
 
     /* Pass message to the callback */
-    if (obj != NULL)
+    if (async != NULL)
+        vlc_LogAsyncPush(async, type, &msg, format, args);
+    else if (obj != NULL)
         vlc_vaLogCallback(obj->p_libvlc, type, &msg, format, args);
 }
 
@@ -329,6 +536,8 @@ int vlc_LogPreinit(libvlc_int_t *vlc)
         return -1;
 
     vlc_rwlock_init(&logger->lock);
+    logger->async = NULL;
+    atomic_init(&logger->async_on, false);
 
     if (vlc_LogEarlyOpen(logger))
     {
@@ -359,6 +568,11 @@ int vlc_LogInit(libvlc_int_t *vlc)
     vlc_log_cb cb;
     void *sys, *early_sys = NULL;
 
+    /* A logger module filtering the messages on their type may set this to
+     * the highest type it keeps, so that the others are not queued */
+    var_Create(logger, "log-verbosity", VLC_VAR_INTEGER);
+    var_SetInteger(logger, "log-verbosity", VLC_MSG_DBG);
+
     /* TODO: module configuration item */
     module_t *module = vlc_module_load(logger, "logger", NULL, false,
                                        vlc_logger_load, logger, &cb, &sys);
@@ -378,11 +592,20 @@ int vlc_LogInit(libvlc_int_t *vlc)
     if (early_sys != NULL)
         vlc_LogEarlyClose(logger, early_sys);
 
+    if (module != NULL && var_InheritBool(logger, "log-async"))
+        vlc_LogAsyncStart(logger);
+
     return 0;
 }
 
 /**
  * Sets the message logging callback.
+ *
+ * The asynchronous dispatch, if any, is stopped first, and the callback gets
+ * all the messages synchronously and unfiltered. Messages a thread was still
+ * pushing to the asynchronous queue at that time are not passed to any
+ * callback: they are dropped by vlc_LogDeinit().
+ *
  * \param cb message callback, or NULL to clear
  * \param data data pointer for the message callback
  */
@@ -399,6 +622,9 @@ void vlc_LogSet(libvlc_int_t *vlc, vlc_log_cb cb, void *opaque)
     if (cb == NULL)
         cb = vlc_vaLogDiscard;
 
+    /* Messages are passed synchronously to the application callback */
+    vlc_LogAsyncStop(logger);
+
     vlc_rwlock_wrlock(&logger->lock);
     sys = logger->sys;
     module = logger->module;
@@ -425,6 +651,14 @@ void vlc_LogDeinit(libvlc_int_t *vlc)
     if (unlikely(logger == NULL))
         return;
 
+    vlc_LogAsyncStop(logger);
+    if (logger->async != NULL)
+    {   /* Drop whatever was pushed after the dispatch stopped */
+        vlc_LogAsyncDrain(NULL, logger->async);
+        vlc_sem_destroy(&logger->async->wait);
+        free(logger->async);
+    }
+
     if (logger->module != NULL)
         vlc_module_unload(logger->module, vlc_logger_unload, logger->sys);
     else
@@ -50,7 +50,10 @@ static struct
     vlc_mutex_t lock;
     module_t *head;
     unsigned usage;
-} modules = { VLC_STATIC_MUTEX, NULL, 0 };
+    /* All modules by capability, then from the highest score to the lowest */
+    module_t **caps;
+    size_t caps_count;
+} modules = { VLC_STATIC_MUTEX, NULL, 0, NULL, 0 };
 
 /*****************************************************************************
  * Local prototypes
@@ -59,6 +62,7 @@ static struct
 static void AllocateAllPlugins (vlc_object_t *);
 #endif
 static module_t *module_InitStatic (vlc_plugin_cb);
+static void module_IndexCaps (void);
 
 static void module_StoreBank (module_t *module)
 {
@@ -145,6 +149,9 @@ void module_EndBank (bool b_plugins)
         config_UnsortConfig ();
         head = modules.head;
         modules.head = NULL;
+        free (modules.caps);
+        modules.caps = NULL;
+        modules.caps_count = 0;
     }
     vlc_mutex_unlock (&modules.lock);
 
@@ -185,6 +192,7 @@ size_t module_LoadPlugins (vlc_object_t *obj)
 #endif
         config_UnsortConfig ();
         config_SortConfig ();
+        module_IndexCaps ();
     }
     vlc_mutex_unlock (&modules.lock);
 
@@ -247,20 +255,63 @@ static int modulecmp (const void *a, const void *b)
     return (*mb)->i_score - (*ma)->i_score;
 }
 
+typedef struct
+{
+    module_t *module;
+    size_t rank; /* position in the bank, to keep the sort stable */
+} module_rank_t;
+
+static int modulecapcmp (const void *a, const void *b)
+{
+    const module_rank_t *ra = a, *rb = b;
+    int ret = strcmp (module_get_capability (ra->module),
+                      module_get_capability (rb->module));
+    if (ret == 0)
+        ret = rb->module->i_score - ra->module->i_score;
+    if (ret == 0)
+        ret = (ra->rank > rb->rank) - (ra->rank < rb->rank);
+    return ret;
+}
+
 /**
- * Builds a sorted list of all VLC modules with a given capability.
- * The list is sorted from the highest module score to the lowest.
- * @param list pointer to the table of modules [OUT]
- * @param cap capability of modules to look for
- * @return the number of matching found, or -1 on error (*list is then NULL).
- * @note *list must be freed with module_list_free().
+ * Sorts all modules by capability once the bank is complete, so that
+ * module_list_cap() does not have to go through the whole bank.
  */
-ssize_t module_list_cap (module_t ***restrict list, const char *cap)
+static void module_IndexCaps (void)
 {
-    /* TODO: This is quite inefficient. List should be sorted by capability. */
-    ssize_t n = 0;
+    size_t n;
+    module_t **tab = module_list_get (&n);
+    module_rank_t *ranks = malloc (n * sizeof (*ranks));
+
+    free (modules.caps);
+    modules.caps = NULL;
+    modules.caps_count = 0;
+
+    if (tab == NULL || ranks == NULL)
+    {   /* module_list_cap() will fall back to a linear search */
+        free (ranks);
+        module_list_free (tab);
+        return;
+    }
 
-    assert (list != NULL);
+    for (size_t i = 0; i < n; i++)
+    {
+        ranks[i].module = tab[i];
+        ranks[i].rank = i;
+    }
+    qsort (ranks, n, sizeof (*ranks), modulecapcmp);
+    for (size_t i = 0; i < n; i++)
+        tab[i] = ranks[i].module;
+    free (ranks);
+
+    modules.caps = tab;
+    modules.caps_count = n;
+}
+
+static ssize_t module_list_cap_slow (module_t ***restrict list,
+                                     const char *cap)
+{
+    ssize_t n = 0;
 
     for (module_t *mod = modules.head; mod != NULL; mod = mod->next)
     {
@@ -290,6 +341,45 @@ ssize_t module_list_cap (module_t ***restrict list, const char *cap)
     return n;
 }
 
+/**
+ * Builds a sorted list of all VLC modules with a given capability.
+ * The list is sorted from the highest module score to the lowest.
+ * @param list pointer to the table of modules [OUT]
+ * @param cap capability of modules to look for
+ * @return the number of matching found, or -1 on error (*list is then NULL).
+ * @note *list must be freed with module_list_free().
+ */
+ssize_t module_list_cap (module_t ***restrict list, const char *cap)
+{
+    assert (list != NULL);
+
+    if (modules.caps == NULL)
+        return module_list_cap_slow (list, cap);
+
+    /* Binary search for the first module with the capability */
+    size_t lo = 0, hi = modules.caps_count;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (strcmp (module_get_capability (modules.caps[mid]), cap) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    size_t n = 0;
+    while (lo + n < modules.caps_count
+        && module_provides (modules.caps[lo + n], cap))
+        n++;
+
+    module_t **tab = malloc (sizeof (*tab) * n);
+    *list = tab;
+    if (unlikely(tab == NULL))
+        return -1;
+    memcpy (tab, modules.caps + lo, sizeof (*tab) * n);
+    return n;
+}
+
 #ifdef HAVE_DYNAMIC_PLUGINS
 typedef enum { CACHE_USE, CACHE_RESET, CACHE_IGNORE } cache_mode_t;
 
@@ -357,8 +447,8 @@ typedef struct module_bank
     size_t         i_cache;
     module_cache_t *cache;
 
-    int            i_loaded_cache;
-    module_cache_t *loaded_cache;
+    module_cache_map_t *loaded_cache;
+    bool           b_cache_stale; /* loaded cache needs to be rewritten */
 } module_bank_t;
 
 static void AllocatePluginDir (module_bank_t *, unsigned,
@@ -372,13 +462,12 @@ static void AllocatePluginPath (vlc_object_t *p_this, const char *path,
                                 cache_mode_t mode)
 {
     module_bank_t bank;
-    module_cache_t *cache = NULL;
-    size_t count = 0;
+    module_cache_map_t *cache = NULL;
 
     switch( mode )
     {
         case CACHE_USE:
-            count = CacheLoad( p_this, path, &cache );
+            cache = CacheLoad( p_this, path );
             break;
         case CACHE_RESET:
             CacheDelete( p_this, path );
@@ -395,7 +484,7 @@ static void AllocatePluginPath (vlc_object_t *p_this, const char *path,
     bank.cache = NULL;
     bank.i_cache = 0;
     bank.loaded_cache = cache;
-    bank.i_loaded_cache = count;
+    bank.b_cache_stale = (cache == NULL);
 
     /* Don't go deeper than 5 subdirectories */
     AllocatePluginDir (&bank, 5, path, NULL);
@@ -403,14 +492,18 @@ static void AllocatePluginPath (vlc_object_t *p_this, const char *path,
     switch( mode )
     {
         case CACHE_USE:
-            /* Discard unmatched cache entries */
-            for( size_t i = 0; i < count; i++ )
+            /* Unmatched cache entries were never parsed, and an up-to-date
+             * cache need not be written again. */
+            if (CacheCount (cache) != bank.i_cache)
+                bank.b_cache_stale = true;
+            CacheUnload (cache);
+            if (!bank.b_cache_stale)
             {
-                if (cache[i].p_module != NULL)
-                   vlc_module_destroy (cache[i].p_module);
-                free (cache[i].path);
+                for (size_t i = 0; i < bank.i_cache; i++)
+                    free (bank.cache[i].path);
+                free (bank.cache);
+                break;
             }
-            free( cache );
         case CACHE_RESET:
             CacheSave (p_this, path, bank.cache, bank.i_cache);
         case CACHE_IGNORE:
@@ -510,9 +603,10 @@ static int AllocatePluginFile (module_bank_t *bank, const char *abspath,
     /* Check our plugins cache first then load plugin if needed */
     if (bank->mode == CACHE_USE)
     {
-        module = CacheFind (bank->loaded_cache, bank->i_loaded_cache,
-                            relpath, st);
-        if (module != NULL)
+        module = CacheFind (bank->loaded_cache, relpath, st);
+        if (module == NULL)
+            bank->b_cache_stale = true;
+        else
         {
             module->psz_filename = strdup (abspath);
             if (unlikely(module->psz_filename == NULL))
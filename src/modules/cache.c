@@ -45,6 +45,8 @@
 #include "config/configuration.h"
 
 #include <vlc_fs.h>
+#include <vlc_block.h>
+#include <fcntl.h>
 
 #include "modules/modules.h"
 
@@ -55,7 +57,7 @@
 #ifdef HAVE_DYNAMIC_PLUGINS
 /* Sub-version number
  * (only used to avoid breakage in dev version when cache structure changes) */
-#define CACHE_SUBVERSION_NUM 23
+#define CACHE_SUBVERSION_NUM 24
 
 /* Cache filename */
 #define CACHE_NAME "plugins.dat"
@@ -76,8 +78,48 @@ void CacheDelete( vlc_object_t *obj, const char *dir )
     free( path );
 }
 
+/* A loaded cache file. Records are only parsed when looked up. */
+struct module_cache_map_t
+{
+    vlc_object_t *obj;
+    block_t      *file; /* memory mapping of the whole cache file */
+    const uint8_t *index; /* hash table of records by path */
+    uint32_t      mask;
+    uint32_t      count; /* number of records */
+    size_t        start; /* offset of the first record */
+    size_t        end; /* offset past the last record */
+};
+
+/* FNV-1a hash of a plugin path */
+static uint32_t CacheHash (const char *path)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*path)
+    {
+        hash ^= (unsigned char)*(path++);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+typedef struct
+{
+    const uint8_t *p;
+    const uint8_t *end;
+} cache_cursor_t;
+
+static int CacheRead (cache_cursor_t *cur, void *buf, size_t len)
+{
+    if ((size_t)(cur->end - cur->p) < len)
+        return -1;
+    memcpy (buf, cur->p, len);
+    cur->p += len;
+    return 0;
+}
+
 #define LOAD_IMMEDIATE(a) \
-    if (fread (&(a), sizeof (char), sizeof (a), file) != sizeof (a)) \
+    if (CacheRead (cur, &(a), sizeof (a))) \
         goto error
 #define LOAD_FLAG(a) \
     do { \
@@ -88,13 +130,13 @@ void CacheDelete( vlc_object_t *obj, const char *dir )
         (a) = b; \
     } while (0)
 
-static int CacheLoadString (char **p, FILE *file)
+static int CacheLoadString (char **p, cache_cursor_t *cur)
 {
     char *psz = NULL;
     uint16_t size;
 
     LOAD_IMMEDIATE (size);
-    if (size > 16384)
+    if (size > 16384 || (size_t)(cur->end - cur->p) < size)
     {
 error:
         return -1;
@@ -105,22 +147,24 @@ error:
         psz = malloc (size+1);
         if (unlikely(psz == NULL))
             goto error;
-        if (fread (psz, 1, size, file) != size)
-        {
-            free (psz);
-            goto error;
-        }
+        memcpy (psz, cur->p, size);
         psz[size] = '\0';
+        cur->p += size;
     }
     *p = psz;
     return 0;
 }
 
 #define LOAD_STRING(a) \
-    if (CacheLoadString (&(a), file)) goto error
+    if (CacheLoadString (&(a), cur)) goto error
 
-static int CacheLoadConfig (module_config_t *cfg, FILE *file)
+static int CacheLoadConfig (module_config_t *cfg, cache_cursor_t *cur)
 {
+    uint16_t count;
+
+    /* The item must remain safe to free with config_Free() whenever the
+     * cache turns out to be corrupted: the list is counted only once its
+     * tables are allocated and zeroed. */
     LOAD_IMMEDIATE (cfg->i_type);
     LOAD_IMMEDIATE (cfg->i_short);
     LOAD_FLAG (cfg->b_advanced);
@@ -132,7 +176,7 @@ static int CacheLoadConfig (module_config_t *cfg, FILE *file)
     LOAD_STRING (cfg->psz_name);
     LOAD_STRING (cfg->psz_text);
     LOAD_STRING (cfg->psz_longtext);
-    LOAD_IMMEDIATE (cfg->list_count);
+    LOAD_IMMEDIATE (count);
 
     if (IsConfigStringType (cfg->i_type))
     {
@@ -142,11 +186,13 @@ static int CacheLoadConfig (module_config_t *cfg, FILE *file)
         else
             cfg->value.psz = NULL;
 
-        if (cfg->list_count)
-            cfg->list.psz = xmalloc (cfg->list_count * sizeof (char *));
+        if (count)
+            cfg->list.psz = xcalloc (count, sizeof (char *));
         else /* TODO: fix config_GetPszChoices() instead of this hack: */
             LOAD_IMMEDIATE(cfg->list.psz_cb);
-        for (unsigned i = 0; i < cfg->list_count; i++)
+        cfg->list_text = xcalloc (count, sizeof (char *));
+        cfg->list_count = count;
+        for (unsigned i = 0; i < count; i++)
         {
             LOAD_STRING (cfg->list.psz[i]);
             if (cfg->list.psz[i] == NULL /* NULL -> empty string */
@@ -161,15 +207,16 @@ static int CacheLoadConfig (module_config_t *cfg, FILE *file)
         LOAD_IMMEDIATE (cfg->max);
         cfg->value = cfg->orig;
 
-        if (cfg->list_count)
-            cfg->list.i = xmalloc (cfg->list_count * sizeof (int));
+        if (count)
+            cfg->list.i = xcalloc (count, sizeof (int));
         else /* TODO: fix config_GetPszChoices() instead of this hack: */
             LOAD_IMMEDIATE(cfg->list.i_cb);
-        for (unsigned i = 0; i < cfg->list_count; i++)
+        cfg->list_text = xcalloc (count, sizeof (char *));
+        cfg->list_count = count;
+        for (unsigned i = 0; i < count; i++)
              LOAD_IMMEDIATE (cfg->list.i[i]);
     }
-    cfg->list_text = xmalloc (cfg->list_count * sizeof (char *));
-    for (unsigned i = 0; i < cfg->list_count; i++)
+    for (unsigned i = 0; i < count; i++)
     {
         LOAD_STRING (cfg->list_text[i]);
         if (cfg->list_text[i] == NULL /* NULL -> empty string */
@@ -182,7 +229,7 @@ error:
     return -1; /* FIXME: leaks */
 }
 
-static int CacheLoadModuleConfig (module_t *module, FILE *file)
+static int CacheLoadModuleConfig (module_t *module, cache_cursor_t *cur)
 {
     uint16_t lines;
 
@@ -194,7 +241,7 @@ static int CacheLoadModuleConfig (module_t *module, FILE *file)
     /* Allocate memory */
     if (lines)
     {
-        module->p_config = malloc (lines * sizeof (module_config_t));
+        module->p_config = calloc (lines, sizeof (module_config_t));
         if (unlikely(module->p_config == NULL))
         {
             module->confsize = 0;
@@ -207,14 +254,31 @@ static int CacheLoadModuleConfig (module_t *module, FILE *file)
 
     /* Do the duplication job */
     for (size_t i = 0; i < lines; i++)
-        if (CacheLoadConfig (module->p_config + i, file))
+        if (CacheLoadConfig (module->p_config + i, cur))
             return -1;
     return 0;
 error:
     return -1; /* FIXME: leaks */
 }
 
-static module_t *CacheLoadModule (FILE *file)
+static int CacheLoadShortcuts (module_t *module, cache_cursor_t *cur)
+{
+    unsigned count;
+
+    LOAD_IMMEDIATE(count);
+    if (count > MODULE_SHORTCUT_MAX)
+        goto error;
+
+    module->pp_shortcuts = xcalloc (count, sizeof (*module->pp_shortcuts));
+    module->i_shortcuts = count;
+    for (unsigned j = 0; j < count; j++)
+        LOAD_STRING(module->pp_shortcuts[j]);
+    return 0;
+error:
+    return -1;
+}
+
+static module_t *CacheLoadModule (cache_cursor_t *cur)
 {
     module_t *module = vlc_module_create (NULL);
     if (unlikely(module == NULL))
@@ -225,23 +289,15 @@ static module_t *CacheLoadModule (FILE *file)
     LOAD_STRING(module->psz_longname);
     LOAD_STRING(module->psz_help);
 
-    LOAD_IMMEDIATE(module->i_shortcuts);
-    if (module->i_shortcuts > MODULE_SHORTCUT_MAX)
+    if (CacheLoadShortcuts (module, cur))
         goto error;
-    else
-    {
-        module->pp_shortcuts =
-            xmalloc (sizeof (*module->pp_shortcuts) * module->i_shortcuts);
-        for (unsigned j = 0; j < module->i_shortcuts; j++)
-            LOAD_STRING(module->pp_shortcuts[j]);
-    }
 
     LOAD_STRING(module->psz_capability);
     LOAD_IMMEDIATE(module->i_score);
     LOAD_IMMEDIATE(module->b_unloadable);
 
     /* Config stuff */
-    if (CacheLoadModuleConfig (module, file) != VLC_SUCCESS)
+    if (CacheLoadModuleConfig (module, cur) != VLC_SUCCESS)
         goto error;
 
     LOAD_STRING(module->domain);
@@ -254,21 +310,14 @@ static module_t *CacheLoadModule (FILE *file)
     for (; submodules > 0; submodules--)
     {
         module_t *submodule = vlc_module_create (module);
+        if (unlikely(submodule == NULL))
+            goto error;
 
-        free (submodule->pp_shortcuts);
         LOAD_STRING(submodule->psz_shortname);
         LOAD_STRING(submodule->psz_longname);
 
-        LOAD_IMMEDIATE(submodule->i_shortcuts);
-        if (submodule->i_shortcuts > MODULE_SHORTCUT_MAX)
+        if (CacheLoadShortcuts (submodule, cur))
             goto error;
-        else
-        {
-            submodule->pp_shortcuts =
-                xmalloc (sizeof (*submodule->pp_shortcuts) * submodule->i_shortcuts);
-            for (unsigned j = 0; j < submodule->i_shortcuts; j++)
-                LOAD_STRING(submodule->pp_shortcuts[j]);
-        }
 
         LOAD_STRING(submodule->psz_capability);
         LOAD_IMMEDIATE(submodule->i_score);
@@ -283,124 +332,135 @@ error:
 /**
  * Loads a plugins cache file.
  *
- * This function will load the plugin cache if present and valid. This cache
+ * This function will map the plugin cache if present and valid. This cache
  * will in turn be queried by AllocateAllPlugins() to see if it needs to
  * actually load the dynamically loadable module.
  * This allows us to only fully load plugins when they are actually used.
+ * Only the header and the index are checked here: the records are parsed in
+ * place by CacheFind().
  */
-size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r )
+module_cache_map_t *CacheLoad (vlc_object_t *p_this, const char *dir)
 {
     char *psz_filename;
-    FILE *file;
-    int i_size, i_read;
-    char p_cachestring[sizeof(CACHE_STRING)];
-    int32_t i_marker;
+    int fd;
 
     assert( dir != NULL );
 
-    *r = NULL;
     if( asprintf( &psz_filename, "%s"DIR_SEP CACHE_NAME, dir ) == -1 )
-        return 0;
+        return NULL;
 
     msg_Dbg( p_this, "loading plugins cache file %s", psz_filename );
 
-    file = vlc_fopen( psz_filename, "rb" );
-    if( !file )
+    fd = vlc_open( psz_filename, O_RDONLY );
+    if( fd == -1 )
     {
         msg_Warn( p_this, "cannot read %s: %s", psz_filename,
                   vlc_strerror_c(errno) );
         free( psz_filename );
-        return 0;
+        return NULL;
     }
     free( psz_filename );
 
-    /* Check the file is a plugins cache */
-    i_size = sizeof(CACHE_STRING) - 1;
-    i_read = fread( p_cachestring, 1, i_size, file );
-    if( i_read != i_size ||
-        memcmp( p_cachestring, CACHE_STRING, i_size ) )
+    block_t *file = block_File( fd );
+    close( fd );
+    if( file == NULL )
     {
-        msg_Warn( p_this, "This doesn't look like a valid plugins cache" );
-        fclose( file );
-        return 0;
+        msg_Err( p_this, "plugins cache read error: %s",
+                 vlc_strerror_c(errno) );
+        return NULL;
     }
 
+    cache_cursor_t c = { file->p_buffer, file->p_buffer + file->i_buffer };
+    cache_cursor_t *cur = &c;
+    uint32_t i_marker, i_index, i_buckets;
+
+    /* Check the file is a plugins cache */
+    if( file->i_buffer < sizeof(CACHE_STRING) - 1 ||
+        memcmp( cur->p, CACHE_STRING, sizeof(CACHE_STRING) - 1 ) )
+        goto error;
+    cur->p += sizeof(CACHE_STRING) - 1;
+
 #ifdef DISTRO_VERSION
     /* Check for distribution specific version */
-    char p_distrostring[sizeof( DISTRO_VERSION )];
-    i_size = sizeof( DISTRO_VERSION ) - 1;
-    i_read = fread( p_distrostring, 1, i_size, file );
-    if( i_read != i_size ||
-        memcmp( p_distrostring, DISTRO_VERSION, i_size ) )
-    {
-        msg_Warn( p_this, "This doesn't look like a valid plugins cache" );
-        fclose( file );
-        return 0;
-    }
+    if( (size_t)(cur->end - cur->p) < sizeof(DISTRO_VERSION) - 1 ||
+        memcmp( cur->p, DISTRO_VERSION, sizeof(DISTRO_VERSION) - 1 ) )
+        goto error;
+    cur->p += sizeof(DISTRO_VERSION) - 1;
 #endif
 
     /* Check sub-version number */
-    i_read = fread( &i_marker, 1, sizeof(i_marker), file );
-    if( i_read != sizeof(i_marker) || i_marker != CACHE_SUBVERSION_NUM )
-    {
-        msg_Warn( p_this, "This doesn't look like a valid plugins cache "
-                  "(corrupted header)" );
-        fclose( file );
-        return 0;
-    }
+    LOAD_IMMEDIATE( i_marker );
+    if( i_marker != CACHE_SUBVERSION_NUM )
+        goto error;
 
     /* Check header marker */
-    i_read = fread( &i_marker, 1, sizeof(i_marker), file );
-    if( i_read != sizeof(i_marker) ||
-        i_marker != ftell( file ) - (int)sizeof(i_marker) )
-    {
-        msg_Warn( p_this, "This doesn't look like a valid plugins cache "
-                  "(corrupted header)" );
-        fclose( file );
-        return 0;
-    }
-
-    module_cache_t *cache = NULL;
-    size_t count = 0;
+    LOAD_IMMEDIATE( i_marker );
+    if( i_marker != (size_t)(cur->p - file->p_buffer) - sizeof(i_marker) )
+        goto error;
 
-    for (;;)
-    {
-        module_t *module = CacheLoadModule (file);
-        if (module == NULL)
-        {
-            if (feof (file))
-                break;
-            goto error;
-        }
+    const size_t start = cur->p - file->p_buffer;
 
-        char *path;
-        struct stat st;
+    /* The index offset is at the very end of the file */
+    cur->p = cur->end - sizeof(i_index);
+    if( cur->p < file->p_buffer + start )
+        goto error;
+    LOAD_IMMEDIATE( i_index );
+    if( i_index < start || i_index > file->i_buffer - sizeof(i_index) )
+        goto error;
 
-        /* Load common info */
-        LOAD_STRING(path);
-        if (path == NULL)
-            goto error;
-        LOAD_IMMEDIATE(st.st_mtime);
-        LOAD_IMMEDIATE(st.st_size);
+    cur->p = file->p_buffer + i_index;
+    cur->end -= sizeof(i_index);
 
-        CacheAdd (&cache, &count, path, &st, module);
-        free (path);
-        /* TODO: deal with errors */
+    module_cache_map_t *map = malloc( sizeof (*map) );
+    if( unlikely(map == NULL) )
+    {
+        block_Release( file );
+        return NULL;
     }
 
-    fclose( file );
+    LOAD_IMMEDIATE( map->count );
+    LOAD_IMMEDIATE( i_buckets );
+    /* The bucket count is a power of two and the index fills the rest */
+    if( i_buckets == 0 || (i_buckets & (i_buckets - 1))
+     || map->count > i_buckets
+     || (size_t)(cur->end - cur->p) / 8 != i_buckets
+     || (size_t)(cur->end - cur->p) % 8 )
+    {
+        free( map );
+        goto error;
+    }
 
-    *r = cache;
-    return count;
+    map->obj = p_this;
+    map->file = file;
+    map->index = cur->p;
+    map->mask = i_buckets - 1;
+    map->start = start;
+    map->end = i_index;
+    return map;
 
 error:
-    if (ferror (file))
-        msg_Err(p_this, "plugins cache read error: %s", vlc_strerror_c(errno));
-    msg_Warn( p_this, "plugins cache not loaded (corrupted)" );
+    msg_Warn( p_this, "This doesn't look like a valid plugins cache" );
+    block_Release( file );
+    return NULL;
+}
 
-    /* TODO: cleanup */
-    fclose( file );
-    return 0;
+/**
+ * Releases a plugins cache file loaded with CacheLoad().
+ */
+void CacheUnload (module_cache_map_t *map)
+{
+    if (map == NULL)
+        return;
+    block_Release (map->file);
+    free (map);
+}
+
+/**
+ * Returns the number of plugins a cache file describes.
+ */
+size_t CacheCount (const module_cache_map_t *map)
+{
+    return (map != NULL) ? map->count : 0;
 }
 
 #define SAVE_IMMEDIATE( a ) \
@@ -546,6 +606,17 @@ static int CacheSaveBank (FILE *file, const module_cache_t *cache,
                           size_t i_cache)
 {
     uint32_t i_file_size = 0;
+    uint32_t *index = NULL;
+
+    /* Hash table of the record offsets by path, with linear probing and at
+     * most half full. Offset zero (in the header) marks a free bucket. */
+    uint32_t i_buckets = 1;
+    while (i_buckets < 2 * i_cache)
+        i_buckets <<= 1;
+
+    index = calloc (i_buckets, 2 * sizeof (*index));
+    if (unlikely(index == NULL))
+        goto error;
 
     /* Contains version number */
     if (fputs (CACHE_STRING, file) == EOF)
@@ -570,6 +641,18 @@ static int CacheSaveBank (FILE *file, const module_cache_t *cache,
     {
         module_t *module = cache[i].p_module;
         uint32_t i_submodule;
+        uint32_t hash = CacheHash (cache[i].path);
+        uint32_t b = hash & (i_buckets - 1);
+
+        while (index[2 * b + 1] != 0)
+            b = (b + 1) & (i_buckets - 1);
+        index[2 * b] = hash;
+        index[2 * b + 1] = ftell (file);
+
+        /* Save common info */
+        SAVE_STRING(cache[i].path);
+        SAVE_IMMEDIATE(cache[i].mtime);
+        SAVE_IMMEDIATE(cache[i].size);
 
         /* Save additional infos */
         SAVE_STRING(module->psz_shortname);
@@ -593,18 +676,24 @@ static int CacheSaveBank (FILE *file, const module_cache_t *cache,
         SAVE_IMMEDIATE( i_submodule );
         if (CacheSaveSubmodule (file, module->submodule))
             goto error;
-
-        /* Save common info */
-        SAVE_STRING(cache[i].path);
-        SAVE_IMMEDIATE(cache[i].mtime);
-        SAVE_IMMEDIATE(cache[i].size);
     }
 
-    if (fflush (file)) /* flush libc buffers */
+    /* Index, then its offset at the very end */
+    i_file_size = ftell (file);
+    uint32_t i_count = i_cache;
+    SAVE_IMMEDIATE (i_count);
+    SAVE_IMMEDIATE (i_buckets);
+    if (fwrite (index, 2 * sizeof (*index), i_buckets, file) != i_buckets)
         goto error;
+    SAVE_IMMEDIATE (i_file_size);
+    free (index);
+
+    if (fflush (file)) /* flush libc buffers */
+        return -1;
     return 0; /* success! */
 
 error:
+    free (index);
     return -1;
 }
 
@@ -658,26 +747,59 @@ void CacheMerge( vlc_object_t *p_this, module_t *p_cache, module_t *p_module )
 }
 
 /**
- * Looks up a plugin file in a table of cached plugins.
+ * Looks up a plugin file in a cache file, and parses its cached descriptor.
+ * @return the module or NULL if the plugin is not cached or has changed
  */
-module_t *CacheFind (module_cache_t *cache, size_t count,
+module_t *CacheFind (module_cache_map_t *map,
                      const char *path, const struct stat *st)
 {
-    while (count > 0)
+    if (map == NULL)
+        return NULL;
+
+    const uint8_t *data = map->file->p_buffer;
+    const uint32_t hash = CacheHash (path);
+    const size_t len = strlen (path);
+
+    for (uint32_t b = hash & map->mask, n = 0; n <= map->mask;
+         b = (b + 1) & map->mask, n++)
     {
-        if (cache->path != NULL
-         && !strcmp (cache->path, path)
-         && cache->mtime == st->st_mtime
-         && cache->size == st->st_size)
-       {
-            module_t *module = cache->p_module;
-            cache->p_module = NULL;
-            return module;
-       }
-       cache++;
-       count--;
+        uint32_t bucket[2];
+
+        memcpy (bucket, map->index + 8 * b, sizeof (bucket));
+        if (bucket[1] == 0)
+            break; /* free bucket: not cached */
+        if (bucket[0] != hash)
+            continue;
+        if (bucket[1] < map->start || bucket[1] >= map->end)
+            goto error;
+
+        cache_cursor_t c = { data + bucket[1], data + map->end };
+        cache_cursor_t *cur = &c;
+        uint16_t size;
+        time_t mtime;
+        off_t fsize;
+
+        LOAD_IMMEDIATE (size);
+        if ((size_t)(cur->end - cur->p) < size)
+            goto error;
+        if (size != len || memcmp (cur->p, path, len))
+            continue;
+        cur->p += size;
+
+        LOAD_IMMEDIATE (mtime);
+        LOAD_IMMEDIATE (fsize);
+        if (mtime != st->st_mtime || fsize != st->st_size)
+            return NULL;
+
+        module_t *module = CacheLoadModule (cur);
+        if (module == NULL)
+            goto error;
+        return module;
     }
+    return NULL;
 
+error:
+    msg_Warn (map->obj, "plugins cache entry for %s corrupted", path);
     return NULL;
 }
 
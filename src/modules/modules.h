@@ -25,6 +25,7 @@
 # define LIBVLC_MODULES_H 1
 
 typedef struct module_cache_t module_cache_t;
+typedef struct module_cache_map_t module_cache_map_t;
 
 /*****************************************************************************
  * Module cache description structure
@@ -122,14 +123,16 @@ void module_Unload (module_handle_t);
 /* Plugins cache */
 void   CacheMerge (vlc_object_t *, module_t *, module_t *);
 void   CacheDelete(vlc_object_t *, const char *);
-size_t CacheLoad  (vlc_object_t *, const char *, module_cache_t **);
+module_cache_map_t *CacheLoad (vlc_object_t *, const char *);
+void   CacheUnload (module_cache_map_t *);
+size_t CacheCount (const module_cache_map_t *);
 
 struct stat;
 
 int CacheAdd (module_cache_t **, size_t *,
               const char *, const struct stat *, module_t *);
 void CacheSave  (vlc_object_t *, const char *, module_cache_t *, size_t);
-module_t *CacheFind (module_cache_t *, size_t,
+module_t *CacheFind (module_cache_map_t *,
                      const char *, const struct stat *);
 
 #endif /* !LIBVLC_MODULES_H */
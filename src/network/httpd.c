@@ -40,6 +40,8 @@
 #include <vlc_url.h>
 #include <vlc_mime.h>
 #include <vlc_block.h>
+#include <vlc_fs.h>
+#include <vlc_atomic.h>
 #include "../libvlc.h"
 
 #include <string.h>
@@ -49,6 +51,9 @@
 #ifdef HAVE_POLL
 # include <poll.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
 
 #if defined(_WIN32)
 #   include <winsock2.h>
@@ -63,8 +68,16 @@
 #define HTTPD_CL_BUFSIZE 10000
 #endif
 
+/* Maximum number of blocks sent at once to a stream client */
+#define HTTPD_STREAM_IOV 64
+
 static void httpd_ClientClean(httpd_client_t *cl);
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data);
+static ssize_t httpd_NetSend(httpd_client_t *, const uint8_t *, size_t);
+static bool httpd_StreamHasData(httpd_stream_t *, const httpd_client_t *);
+static void httpd_StreamSendClient(httpd_stream_t *, httpd_client_t *);
+static void httpd_HostWakeWorkers(httpd_host_t *);
+
+typedef struct httpd_worker_t httpd_worker_t;
 
 /* each host run in his own thread */
 struct httpd_host_t
@@ -93,6 +106,11 @@ struct httpd_host_t
     int            i_client;
     httpd_client_t **client;
 
+    /* threads sending the stream data, started along with the clients */
+    httpd_worker_t *workers;
+    unsigned        i_worker_max;
+    atomic_uint     i_worker;
+
     /* TLS data */
     vlc_tls_creds_t *p_tls;
 };
@@ -165,6 +183,11 @@ struct httpd_client_t
      */
     int64_t i_keyframe_wait_to_pass;
 
+    /* Stream whose data is sent from its window, in stream mode */
+    httpd_stream_t *stream;
+    uint32_t        i_events; /* registered with the worker */
+    bool            b_removed; /* url deleted, under the worker lock */
+
     /* */
     httpd_message_t query;  /* client -> httpd */
     httpd_message_t answer; /* httpd -> client */
@@ -592,6 +615,12 @@ void httpd_RedirectDelete(httpd_redirect_t *rdir)
 /*****************************************************************************
  * High Level Funtions: httpd_stream_t
  *****************************************************************************/
+typedef struct
+{
+    block_t *p_block;   /* shareable, clients send from references */
+    int64_t i_pos;      /* absolute position of the block data */
+} httpd_stream_chunk_t;
+
 struct httpd_stream_t
 {
     vlc_mutex_t lock;
@@ -611,9 +640,13 @@ struct httpd_stream_t
     bool        b_has_keyframes;
     int64_t     i_last_keyframe_seen_pos;
 
-    /* circular buffer */
-    int         i_buffer_size;      /* buffer size, can't be reallocated smaller */
-    uint8_t     *p_buffer;          /* buffer */
+    /* Window of the last blocks, all clients send directly from them */
+    httpd_stream_chunk_t *p_chunks; /* ring of blocks */
+    unsigned    i_chunks_max;       /* ring size */
+    unsigned    i_chunks_first;     /* index of the oldest block */
+    unsigned    i_chunks;           /* number of blocks */
+    size_t      i_window;           /* bytes in the window */
+    size_t      i_window_max;       /* oldest blocks are dropped past that */
     int64_t     i_buffer_pos;       /* absolute position from begining */
     int64_t     i_buffer_last_pos;  /* a new connection will start with that */
 
@@ -632,47 +665,8 @@ static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
         return VLC_SUCCESS;
 
     if (answer->i_body_offset > 0) {
-        int     i_pos;
-
-        if (answer->i_body_offset >= stream->i_buffer_pos)
-            return VLC_EGENERIC;    /* wait, no data available */
-
-        if (cl->i_keyframe_wait_to_pass >= 0) {
-            if (stream->i_last_keyframe_seen_pos <= cl->i_keyframe_wait_to_pass)
-                /* still waiting for the next keyframe */
-                return VLC_EGENERIC;
-
-            /* seek to the new keyframe */
-            answer->i_body_offset = stream->i_last_keyframe_seen_pos;
-            cl->i_keyframe_wait_to_pass = -1;
-        }
-
-        if (answer->i_body_offset + stream->i_buffer_size < stream->i_buffer_pos)
-            answer->i_body_offset = stream->i_buffer_last_pos; /* this client isn't fast enough */
-
-        i_pos   = answer->i_body_offset % stream->i_buffer_size;
-        int64_t i_write = stream->i_buffer_pos - answer->i_body_offset;
-
-        if (i_write > HTTPD_CL_BUFSIZE)
-            i_write = HTTPD_CL_BUFSIZE;
-        else if (i_write <= 0)
-            return VLC_EGENERIC;    /* wait, no data available */
-
-        /* Don't go past the end of the circular buffer */
-        i_write = __MIN(i_write, stream->i_buffer_size - i_pos);
-
-        /* using HTTPD_MSG_ANSWER -> data available */
-        answer->i_proto  = HTTPD_PROTO_HTTP;
-        answer->i_version= 0;
-        answer->i_type   = HTTPD_MSG_ANSWER;
-
-        answer->i_body = i_write;
-        answer->p_body = xmalloc(i_write);
-        memcpy(answer->p_body, &stream->p_buffer[i_pos], i_write);
-
-        answer->i_body_offset += i_write;
-
-        return VLC_SUCCESS;
+        /* data is sent by httpd_StreamSendClient() */
+        return VLC_EGENERIC;
     } else {
         answer->i_proto  = HTTPD_PROTO_HTTP;
         answer->i_version= 0;
@@ -740,6 +734,9 @@ static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
 
         if (!b_has_cache_control)
             httpd_MsgAdd(answer, "Cache-Control", "no-cache");
+
+        if (cl->b_stream_mode && answer->i_body_offset > 0)
+            cl->stream = stream;
         return VLC_SUCCESS;
     }
 }
@@ -765,8 +762,12 @@ httpd_stream_t *httpd_StreamNew(httpd_host_t *host,
 
     stream->i_header = 0;
     stream->p_header = NULL;
-    stream->i_buffer_size = 5000000;    /* 5 Mo per stream */
-    stream->p_buffer = xmalloc(stream->i_buffer_size);
+    stream->p_chunks = NULL;
+    stream->i_chunks_max = 0;
+    stream->i_chunks_first = 0;
+    stream->i_chunks = 0;
+    stream->i_window = 0;
+    stream->i_window_max = 1024 * __MAX(var_InheritInteger(host, "http-stream-window"), 1);
     /* We set to 1 to make life simpler
      * (this way i_body_offset can never be 0) */
     stream->i_buffer_pos = 1;
@@ -802,45 +803,213 @@ int httpd_StreamHeader(httpd_stream_t *stream, uint8_t *p_data, int i_data)
     return VLC_SUCCESS;
 }
 
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data)
+static httpd_stream_chunk_t *httpd_StreamChunk(httpd_stream_t *stream,
+                                               unsigned i)
 {
-    int i_pos = stream->i_buffer_pos % stream->i_buffer_size;
-    int i_count = i_data;
-    while (i_count > 0) {
-        int i_copy = __MIN(i_count, stream->i_buffer_size - i_pos);
-
-        /* Ok, we can't go past the end of our buffer */
-        memcpy(&stream->p_buffer[i_pos], p_data, i_copy);
+    return &stream->p_chunks[(stream->i_chunks_first + i) % stream->i_chunks_max];
+}
 
-        i_pos = (i_pos + i_copy) % stream->i_buffer_size;
-        i_count -= i_copy;
-        p_data  += i_copy;
+static int httpd_StreamAppend(httpd_stream_t *stream, block_t *p_block)
+{
+    if (stream->i_chunks >= stream->i_chunks_max) {
+        unsigned i_max = stream->i_chunks_max ? 2 * stream->i_chunks_max : 64;
+        httpd_stream_chunk_t *p_chunks = malloc(i_max * sizeof(*p_chunks));
+        if (!p_chunks)
+            return VLC_ENOMEM;
+
+        for (unsigned i = 0; i < stream->i_chunks; i++)
+            p_chunks[i] = *httpd_StreamChunk(stream, i);
+        free(stream->p_chunks);
+        stream->p_chunks = p_chunks;
+        stream->i_chunks_max = i_max;
+        stream->i_chunks_first = 0;
     }
 
-    stream->i_buffer_pos += i_data;
+    httpd_stream_chunk_t *chunk = httpd_StreamChunk(stream, stream->i_chunks++);
+    chunk->p_block = p_block;
+    chunk->i_pos = stream->i_buffer_pos;
+
+    stream->i_buffer_pos += p_block->i_buffer;
+    stream->i_window += p_block->i_buffer;
+
+    /* Drop the oldest blocks, clients still behind will skip ahead */
+    while (stream->i_window > stream->i_window_max && stream->i_chunks > 1) {
+        chunk = httpd_StreamChunk(stream, 0);
+        stream->i_window -= chunk->p_block->i_buffer;
+        block_Release(chunk->p_block);
+        stream->i_chunks_first = (stream->i_chunks_first + 1) % stream->i_chunks_max;
+        stream->i_chunks--;
+    }
+    return VLC_SUCCESS;
 }
 
 int httpd_StreamSend(httpd_stream_t *stream, const block_t *p_block)
 {
-    if (!p_block || !p_block->p_buffer)
+    if (!p_block || !p_block->p_buffer || p_block->i_buffer == 0)
         return VLC_SUCCESS;
 
+    /* The only copy: clients send from the window */
+    block_t *p_copy = block_Alloc(p_block->i_buffer);
+    if (!p_copy)
+        return VLC_ENOMEM;
+    memcpy(p_copy->p_buffer, p_block->p_buffer, p_block->i_buffer);
+    p_copy = block_Shareable(p_copy);
+
     vlc_mutex_lock(&stream->lock);
 
     /* save this pointer (to be used by new connection) */
-    stream->i_buffer_last_pos = stream->i_buffer_pos;
+    int64_t i_last_pos = stream->i_buffer_pos;
+
+    if (httpd_StreamAppend(stream, p_copy)) {
+        vlc_mutex_unlock(&stream->lock);
+        block_Release(p_copy);
+        return VLC_ENOMEM;
+    }
 
+    stream->i_buffer_last_pos = i_last_pos;
     if (p_block->i_flags & BLOCK_FLAG_TYPE_I) {
         stream->b_has_keyframes = true;
-        stream->i_last_keyframe_seen_pos = stream->i_buffer_pos;
+        stream->i_last_keyframe_seen_pos = i_last_pos;
     }
 
-    httpd_AppendData(stream, p_block->p_buffer, p_block->i_buffer);
-
     vlc_mutex_unlock(&stream->lock);
+    httpd_HostWakeWorkers(stream->url->host);
     return VLC_SUCCESS;
 }
 
+static bool httpd_StreamHasData(httpd_stream_t *stream,
+                                const httpd_client_t *cl)
+{
+    bool b_data;
+
+    vlc_mutex_lock(&stream->lock);
+    if (cl->i_keyframe_wait_to_pass >= 0)
+        b_data = stream->i_last_keyframe_seen_pos > cl->i_keyframe_wait_to_pass;
+    else
+        b_data = cl->answer.i_body_offset < stream->i_buffer_pos;
+    vlc_mutex_unlock(&stream->lock);
+
+    return b_data;
+}
+
+/* Sends the stream data following the client position straight from the
+ * window blocks. References to the blocks are taken with the stream lock
+ * held, and the data is sent without it, so that the stream and the other
+ * clients are not held back by this one. The caller keeps the stream alive
+ * meanwhile: the host thread holds the host lock, and httpd_UrlDelete()
+ * waits for the worker clients to be removed. */
+static void httpd_StreamSendClient(httpd_stream_t *stream, httpd_client_t *cl)
+{
+    struct iovec iov[HTTPD_STREAM_IOV];
+    block_t *p_blocks[HTTPD_STREAM_IOV];
+    unsigned i_iov = 0;
+    ssize_t i_len = 0;
+    bool b_wait;
+
+    vlc_mutex_lock(&stream->lock);
+
+    if (cl->i_keyframe_wait_to_pass >= 0) {
+        if (stream->i_last_keyframe_seen_pos <= cl->i_keyframe_wait_to_pass) {
+            /* still waiting for the next keyframe */
+            vlc_mutex_unlock(&stream->lock);
+            cl->i_state = HTTPD_CLIENT_WAITING;
+            return;
+        }
+
+        /* seek to the new keyframe */
+        cl->answer.i_body_offset = stream->i_last_keyframe_seen_pos;
+        cl->i_keyframe_wait_to_pass = -1;
+    }
+
+    int64_t i_offset = cl->answer.i_body_offset;
+    if (stream->i_chunks == 0 || i_offset >= stream->i_buffer_pos) {
+        vlc_mutex_unlock(&stream->lock);
+        cl->i_state = HTTPD_CLIENT_WAITING;
+        return;
+    }
+
+    if (i_offset < httpd_StreamChunk(stream, 0)->i_pos)
+        i_offset = stream->i_buffer_last_pos; /* this client isn't fast enough */
+
+    /* Find the block holding the client position */
+    unsigned i_low = 0, i_high = stream->i_chunks - 1;
+    while (i_low < i_high) {
+        unsigned i_mid = (i_low + i_high + 1) / 2;
+        if (httpd_StreamChunk(stream, i_mid)->i_pos <= i_offset)
+            i_low = i_mid;
+        else
+            i_high = i_mid - 1;
+    }
+
+    for (unsigned i = i_low; i < stream->i_chunks && i_iov < HTTPD_STREAM_IOV; i++) {
+        const httpd_stream_chunk_t *chunk = httpd_StreamChunk(stream, i);
+        size_t i_skip = (i == i_low) ? i_offset - chunk->i_pos : 0;
+
+        p_blocks[i_iov] = block_Share(chunk->p_block);
+        if (unlikely(p_blocks[i_iov] == NULL))
+            break;
+        iov[i_iov].iov_base = p_blocks[i_iov]->p_buffer + i_skip;
+        iov[i_iov].iov_len = p_blocks[i_iov]->i_buffer - i_skip;
+        i_iov++;
+    }
+    vlc_mutex_unlock(&stream->lock);
+
+    if (i_iov == 0) {
+        cl->i_state = HTTPD_CLIENT_WAITING;
+        return;
+    }
+
+#ifndef _WIN32
+    if (cl->p_tls == NULL) {
+        struct msghdr msg = {
+            .msg_iov = iov,
+            .msg_iovlen = i_iov,
+        };
+
+        do
+            i_len = sendmsg(cl->fd, &msg, MSG_NOSIGNAL);
+        while (i_len == -1 && errno == EINTR);
+    } else
+#endif
+    for (unsigned i = 0; i < i_iov; i++) {
+        ssize_t i_ret = httpd_NetSend(cl, iov[i].iov_base, iov[i].iov_len);
+        if (i_ret < 0) {
+            if (i == 0)
+                i_len = i_ret;
+            break;
+        }
+        i_len += i_ret;
+        if ((size_t)i_ret < iov[i].iov_len)
+            break;
+    }
+
+#if defined(_WIN32)
+    const bool b_error = (i_len < 0 && WSAGetLastError() != WSAEWOULDBLOCK) || (i_len == 0);
+#else
+    const bool b_error = (i_len < 0 && errno != EAGAIN) || (i_len == 0);
+#endif
+
+    for (unsigned i = 0; i < i_iov; i++)
+        block_Release(p_blocks[i]);
+
+    vlc_mutex_lock(&stream->lock);
+    if (i_len >= 0)
+        i_offset += i_len;
+    cl->answer.i_body_offset = i_offset;
+    b_wait = i_offset >= stream->i_buffer_pos;
+    vlc_mutex_unlock(&stream->lock);
+
+    if (i_len > 0) {
+        if (b_wait)
+            cl->i_state = HTTPD_CLIENT_WAITING;
+    }
+    else if (b_error)
+    {
+        /* error */
+        cl->i_state = HTTPD_CLIENT_DEAD;
+    }
+}
+
 void httpd_StreamDelete(httpd_stream_t *stream)
 {
     httpd_UrlDelete(stream->url);
@@ -852,10 +1021,315 @@ void httpd_StreamDelete(httpd_stream_t *stream)
     vlc_mutex_destroy(&stream->lock);
     free(stream->psz_mime);
     free(stream->p_header);
-    free(stream->p_buffer);
+    for (unsigned i = 0; i < stream->i_chunks; i++)
+        block_Release(httpd_StreamChunk(stream, i)->p_block);
+    free(stream->p_chunks);
     free(stream);
 }
 
+/*****************************************************************************
+ * Stream workers: clients only left with stream data to send are moved to
+ * a small pool of threads, each watching its clients with persistent
+ * registrations. Once handed over, a client is only used by its worker
+ * thread, which is also the only one removing it.
+ *****************************************************************************/
+struct httpd_worker_t
+{
+    vlc_thread_t thread;
+    vlc_mutex_t lock;           /* protects the clients */
+    vlc_cond_t  wait;           /* removed clients are gone */
+
+    int            i_client;
+    httpd_client_t **client;
+
+#ifdef HAVE_SYS_EPOLL_H
+    int         epfd;
+#endif
+    int         wakefd[2];
+    atomic_bool b_wake;         /* a wake up is pending */
+    bool        b_die;
+};
+
+static void httpd_WorkerWake(httpd_worker_t *w)
+{
+    if (!atomic_exchange(&w->b_wake, true))
+        if (write(w->wakefd[1], &(char){ 0 }, 1) < 0)
+            atomic_store(&w->b_wake, false);
+}
+
+/* Called by the stream writers when new data is available */
+static void httpd_HostWakeWorkers(httpd_host_t *host)
+{
+    unsigned n = atomic_load_explicit(&host->i_worker, memory_order_acquire);
+
+    for (unsigned i = 0; i < n; i++)
+        httpd_WorkerWake(&host->workers[i]);
+}
+
+static void httpd_WorkerWatch(httpd_worker_t *w, httpd_client_t *cl)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    /* Caught up clients are only watched for errors until woken up */
+    uint32_t i_events = (cl->i_state == HTTPD_CLIENT_SENDING) ? EPOLLOUT : 0;
+
+    if (i_events != cl->i_events) {
+        struct epoll_event ev = { .events = i_events, .data.ptr = cl };
+
+        if (epoll_ctl(w->epfd, EPOLL_CTL_MOD, cl->fd, &ev) == 0)
+            cl->i_events = i_events;
+    }
+#else
+    VLC_UNUSED(w); VLC_UNUSED(cl);
+#endif
+}
+
+static void httpd_WorkerSend(httpd_client_t *cl, mtime_t now)
+{
+    int64_t i_offset = cl->answer.i_body_offset;
+
+    httpd_StreamSendClient(cl->stream, cl);
+    if (cl->answer.i_body_offset != i_offset)
+        cl->i_activity_date = now;
+}
+
+static void httpd_WorkerRemove(httpd_worker_t *w, httpd_client_t *cl)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    epoll_ctl(w->epfd, EPOLL_CTL_DEL, cl->fd, NULL);
+#endif
+    httpd_ClientClean(cl);
+    TAB_REMOVE(w->i_client, w->client, cl);
+    free(cl);
+}
+
+static void *httpd_WorkerThread(void *data)
+{
+    httpd_worker_t *w = data;
+
+    for (;;) {
+        bool b_wake = false;
+#ifdef HAVE_SYS_EPOLL_H
+        struct epoll_event ev[64];
+        int i_ev = epoll_wait(w->epfd, ev, 64, 1000);
+#else
+        vlc_mutex_lock(&w->lock);
+        int i_watched = w->i_client;
+        struct pollfd ufd[1 + i_watched];
+
+        ufd[0].fd = w->wakefd[0];
+        ufd[0].events = POLLIN;
+        for (int i = 0; i < i_watched; i++) {
+            httpd_client_t *cl = w->client[i];
+
+            ufd[1 + i].fd = cl->fd;
+            ufd[1 + i].events = (cl->i_state == HTTPD_CLIENT_SENDING) ? POLLOUT : 0;
+        }
+        vlc_mutex_unlock(&w->lock);
+
+        int i_ev = poll(ufd, 1 + i_watched, 1000);
+#endif
+        mtime_t now = mdate();
+
+        vlc_mutex_lock(&w->lock);
+        if (w->b_die) {
+            vlc_mutex_unlock(&w->lock);
+            break;
+        }
+
+        /* Clients are only removed by this thread: the events and the list
+         * snapshot are still valid without the lock, while clients are
+         * added. Those whose url is deleted meanwhile are only marked, and
+         * their stream remains until they are removed below. */
+        int i_client = w->i_client;
+        httpd_client_t *clients[i_client + 1];
+
+        memcpy(clients, w->client, i_client * sizeof (*clients));
+        vlc_mutex_unlock(&w->lock);
+
+#ifdef HAVE_SYS_EPOLL_H
+        for (int i = 0; i < i_ev; i++) {
+            httpd_client_t *cl = ev[i].data.ptr;
+            uint32_t i_revents = ev[i].events;
+#else
+        for (int i = 0; i_ev > 0 && i <= i_watched; i++) {
+            httpd_client_t *cl = (i > 0) ? clients[i - 1] : NULL;
+            short i_revents = ufd[i].revents;
+            if (i_revents == 0)
+                continue;
+#endif
+            if (cl == NULL) {
+                b_wake = true;
+                continue;
+            }
+            if (cl->i_state == HTTPD_CLIENT_SENDING)
+                httpd_WorkerSend(cl, now);
+            else if (cl->i_state == HTTPD_CLIENT_WAITING &&
+                     (i_revents & (POLLERR|POLLHUP)))
+                cl->i_state = HTTPD_CLIENT_DEAD;
+        }
+
+        if (b_wake) {
+            char dummy[16];
+
+            /* At most one byte is pending while the flag is set. Wake ups
+             * until it is cleared write nothing, but their data is seen
+             * by the checks below. */
+            while (read(w->wakefd[0], dummy, sizeof (dummy)) < 0
+                && errno == EINTR);
+            atomic_store(&w->b_wake, false);
+
+            for (int i = 0; i < i_client; i++) {
+                httpd_client_t *cl = clients[i];
+
+                if (cl->i_state == HTTPD_CLIENT_WAITING &&
+                    httpd_StreamHasData(cl->stream, cl)) {
+                    cl->i_state = HTTPD_CLIENT_SENDING;
+                    httpd_WorkerSend(cl, now);
+                }
+            }
+        }
+
+        /* The snapshot is not used anymore: removed clients can go */
+        vlc_mutex_lock(&w->lock);
+        for (int i = 0; i < w->i_client; i++) {
+            httpd_client_t *cl = w->client[i];
+
+            if (cl->b_removed || cl->i_state == HTTPD_CLIENT_DEAD ||
+                (cl->i_activity_timeout > 0 &&
+                 cl->i_activity_date + cl->i_activity_timeout < now)) {
+                httpd_WorkerRemove(w, cl);
+                i--;
+                continue;
+            }
+            httpd_WorkerWatch(w, cl);
+        }
+        vlc_cond_broadcast(&w->wait);
+        vlc_mutex_unlock(&w->lock);
+    }
+    return NULL;
+}
+
+static int httpd_WorkerStart(httpd_worker_t *w)
+{
+    if (vlc_pipe(w->wakefd))
+        return VLC_EGENERIC;
+
+#ifdef HAVE_SYS_EPOLL_H
+    w->epfd = epoll_create1(EPOLL_CLOEXEC);
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    if (w->epfd == -1 ||
+        epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->wakefd[0], &ev)) {
+        if (w->epfd != -1)
+            close(w->epfd);
+        close(w->wakefd[1]);
+        close(w->wakefd[0]);
+        return VLC_EGENERIC;
+    }
+#endif
+
+    vlc_mutex_init(&w->lock);
+    vlc_cond_init(&w->wait);
+    w->i_client = 0;
+    w->client = NULL;
+    atomic_init(&w->b_wake, false);
+    w->b_die = false;
+
+    if (vlc_clone(&w->thread, httpd_WorkerThread, w, VLC_THREAD_PRIORITY_LOW)) {
+        vlc_cond_destroy(&w->wait);
+        vlc_mutex_destroy(&w->lock);
+#ifdef HAVE_SYS_EPOLL_H
+        close(w->epfd);
+#endif
+        close(w->wakefd[1]);
+        close(w->wakefd[0]);
+        return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+static void httpd_WorkerStop(httpd_worker_t *w)
+{
+    vlc_mutex_lock(&w->lock);
+    w->b_die = true;
+    vlc_mutex_unlock(&w->lock);
+    atomic_store(&w->b_wake, false);
+    httpd_WorkerWake(w); /* or the poll timeout */
+    vlc_join(w->thread, NULL);
+
+    while (w->i_client > 0)
+        httpd_WorkerRemove(w, w->client[0]);
+    TAB_CLEAN(w->i_client, w->client);
+
+#ifdef HAVE_SYS_EPOLL_H
+    close(w->epfd);
+#endif
+    close(w->wakefd[1]);
+    close(w->wakefd[0]);
+    vlc_cond_destroy(&w->wait);
+    vlc_mutex_destroy(&w->lock);
+}
+
+/* Hands a client over to the least loaded worker, starting another worker
+ * if they all have clients. Called by the host thread. */
+static bool httpd_WorkerAdd(httpd_host_t *host, httpd_client_t *cl)
+{
+    unsigned n = atomic_load_explicit(&host->i_worker, memory_order_relaxed);
+    httpd_worker_t *w = NULL;
+    int i_client = 0;
+
+    for (unsigned i = 0; i < n; i++) {
+        httpd_worker_t *cand = &host->workers[i];
+
+        vlc_mutex_lock(&cand->lock);
+        if (w == NULL || cand->i_client < i_client) {
+            w = cand;
+            i_client = cand->i_client;
+        }
+        vlc_mutex_unlock(&cand->lock);
+    }
+
+    if ((w == NULL || i_client > 0) && n < host->i_worker_max) {
+        if (httpd_WorkerStart(&host->workers[n]) == VLC_SUCCESS) {
+            w = &host->workers[n];
+            /* the stream writers may now wake it up */
+            atomic_store_explicit(&host->i_worker, n + 1,
+                                  memory_order_release);
+        } else
+            host->i_worker_max = n; /* do not try again */
+    }
+    if (w == NULL)
+        return false;
+
+    vlc_mutex_lock(&w->lock);
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event ev = { .events = EPOLLOUT, .data.ptr = cl };
+    if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, cl->fd, &ev)) {
+        vlc_mutex_unlock(&w->lock);
+        return false;
+    }
+    cl->i_events = EPOLLOUT;
+#endif
+    TAB_APPEND(w->i_client, w->client, cl);
+    vlc_mutex_unlock(&w->lock);
+
+    /* the poll() fallback rebuilds its set */
+    httpd_WorkerWake(w);
+    return true;
+}
+
+static void httpd_HostStopWorkers(httpd_host_t *host)
+{
+    unsigned n = atomic_load_explicit(&host->i_worker, memory_order_relaxed);
+
+    for (unsigned i = 0; i < n; i++)
+        httpd_WorkerStop(&host->workers[i]);
+    free(host->workers);
+    host->workers = NULL;
+    host->i_worker_max = 0;
+    atomic_store_explicit(&host->i_worker, 0, memory_order_relaxed);
+}
+
 /*****************************************************************************
  * Low level
  *****************************************************************************/
@@ -959,6 +1433,9 @@ static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
     vlc_mutex_init(&host->lock);
     vlc_cond_init(&host->wait);
     host->i_ref = 1;
+    host->workers = NULL;
+    host->i_worker_max = 0;
+    atomic_init(&host->i_worker, 0);
 
     host->fds = net_ListenTCP(p_this, url.psz_host, port);
     if (!host->fds) {
@@ -974,6 +1451,11 @@ static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
     host->client   = NULL;
     host->p_tls    = p_tls;
 
+    /* stream clients are served by the workers, if any can be started */
+    unsigned i_worker = vlc_GetCPUCount();
+    host->i_worker_max = VLC_CLIP(i_worker, 1, 4);
+    host->workers  = xmalloc(host->i_worker_max * sizeof (*host->workers));
+
     /* create the thread */
     if (vlc_clone(&host->thread, httpd_HostThread, host,
                    VLC_THREAD_PRIORITY_LOW)) {
@@ -993,6 +1475,7 @@ error:
     vlc_mutex_unlock(&httpd.mutex);
 
     if (host) {
+        httpd_HostStopWorkers(host);
         net_ListenClose(host->fds);
         vlc_cond_destroy(&host->wait);
         vlc_mutex_destroy(&host->lock);
@@ -1026,6 +1509,7 @@ void httpd_HostDelete(httpd_host_t *host)
 
     vlc_cancel(host->thread);
     vlc_join(host->thread, NULL);
+    httpd_HostStopWorkers(host);
 
     msg_Dbg(host, "HTTP host removed");
 
@@ -1123,6 +1607,36 @@ void httpd_UrlDelete(httpd_url_t *url)
         free(client);
         i--;
     }
+
+    /* The workers free their clients. Wait for them to be gone, as they
+     * may be sending from the stream the caller is about to delete. */
+    unsigned i_worker = atomic_load_explicit(&host->i_worker,
+                                             memory_order_relaxed);
+    for (unsigned i = 0; i < i_worker; i++) {
+        httpd_worker_t *w = &host->workers[i];
+        bool b_removed = false;
+
+        vlc_mutex_lock(&w->lock);
+        for (int j = 0; j < w->i_client; j++) {
+            httpd_client_t *client = w->client[j];
+
+            if (client->url != url)
+                continue;
+            client->b_removed = true;
+            b_removed = true;
+        }
+
+        while (b_removed) {
+            httpd_WorkerWake(w);
+            vlc_cond_wait(&w->wait, &w->lock);
+
+            b_removed = false;
+            for (int j = 0; j < w->i_client; j++)
+                if (w->client[j]->url == url)
+                    b_removed = true;
+        }
+        vlc_mutex_unlock(&w->lock);
+    }
     free(url);
     vlc_mutex_unlock(&host->lock);
 }
@@ -1206,6 +1720,9 @@ static void httpd_ClientInit(httpd_client_t *cl, mtime_t now)
     cl->p_buffer = xmalloc(cl->i_buffer_size);
     cl->i_keyframe_wait_to_pass = -1;
     cl->b_stream_mode = false;
+    cl->stream = NULL;
+    cl->i_events = 0;
+    cl->b_removed = false;
 
     httpd_MsgInit(&cl->query);
     httpd_MsgInit(&cl->answer);
@@ -1591,6 +2108,11 @@ static void httpd_ClientSend(httpd_client_t *cl)
 {
     int i_len;
 
+    if (cl->stream != NULL && cl->p_buffer == NULL) {
+        httpd_StreamSendClient(cl->stream, cl);
+        return;
+    }
+
     if (cl->i_buffer < 0) {
         /* We need to create the header */
         int i_size = 0;
@@ -1628,6 +2150,16 @@ static void httpd_ClientSend(httpd_client_t *cl)
         cl->i_buffer += i_len;
 
         if (cl->i_buffer >= cl->i_buffer_size) {
+            if (cl->answer.i_body == 0 && cl->answer.i_body_offset > 0 &&
+                cl->stream != NULL) {
+                /* the header is sent, the data comes from the stream window */
+                free(cl->p_buffer);
+                cl->p_buffer = NULL;
+                cl->i_buffer = 0;
+                cl->i_buffer_size = 0;
+                return;
+            }
+
             if (cl->answer.i_body == 0  && cl->answer.i_body_offset > 0) {
                 /* catch more body data */
                 int     i_msg = cl->query.i_type;
@@ -1751,6 +2283,16 @@ static void httpdLoop(httpd_host_t *host)
             continue;
         }
 
+        /* Once the answer header is sent, a stream client only needs data */
+        if (cl->stream != NULL && cl->p_buffer == NULL && cl->i_ref == 0 &&
+            (cl->i_state == HTTPD_CLIENT_SENDING ||
+             cl->i_state == HTTPD_CLIENT_WAITING) &&
+            httpd_WorkerAdd(host, cl)) {
+            TAB_REMOVE(host->i_client, host->client, cl);
+            i_client--;
+            continue;
+        }
+
         struct pollfd *pufd = ufd + nfd;
         assert (pufd < ufd + (sizeof (ufd) / sizeof (ufd[0])));
 
@@ -1955,6 +2497,12 @@ static void httpdLoop(httpd_host_t *host)
                 break;
 
             case HTTPD_CLIENT_WAITING:
+                if (cl->stream != NULL) {
+                    if (httpd_StreamHasData(cl->stream, cl))
+                        cl->i_state = HTTPD_CLIENT_SENDING;
+                    break;
+                }
+
                 i_offset = cl->answer.i_body_offset;
                 int i_msg = cl->query.i_type;
 
@@ -224,6 +224,12 @@ playlist_t *playlist_Create( vlc_object_t *p_parent )
     ARRAY_INIT( p_playlist->all_items );
     ARRAY_INIT( pl_priv(p_playlist)->items_to_delete );
     ARRAY_INIT( p_playlist->current );
+    p->input_index.pp_buckets = NULL;
+    p->input_index.i_buckets = 0;
+    p->input_index.i_count = 0;
+    p->input_index.b_incomplete = false;
+    p->search.psz_string = NULL;
+    atomic_init( &p->search.b_stale, false );
 
     p_playlist->i_current_index = 0;
     pl_priv(p_playlist)->b_reset_currently_playing = true;
@@ -327,7 +333,10 @@ void playlist_Destroy( playlist_t *p_playlist )
 
     playlist_Deactivate( p_playlist );
     if( p_sys->p_preparser )
+    {
         playlist_preparser_Delete( p_sys->p_preparser );
+        p_sys->p_preparser = NULL;
+    }
 
     /* Release input resources */
     assert( p_sys->p_input == NULL );
@@ -347,6 +356,8 @@ void playlist_Destroy( playlist_t *p_playlist )
     vlc_mutex_destroy( &p_sys->lock );
 
     /* Remove all remaining items */
+    playlist_ItemIndexClear( p_playlist );
+    free( p_sys->search.psz_string );
     FOREACH_ARRAY( playlist_item_t *p_del, p_playlist->all_items )
         free( p_del->pp_children );
         vlc_gc_decref( p_del->p_input );
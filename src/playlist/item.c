@@ -193,6 +193,8 @@ static void input_item_changed( const vlc_event_t * p_event,
 {
     playlist_item_t *p_item = user_data;
     VLC_UNUSED( p_event );
+    /* A hidden item may match the next search now */
+    atomic_store( &pl_priv(p_item->p_playlist)->search.b_stale, true );
     var_SetAddress( p_item->p_playlist, "item-change", p_item->p_input );
 }
 
@@ -286,6 +288,8 @@ int playlist_ItemRelease( playlist_item_t *p_item )
      *
      * Who wants to add proper memory management? */
     uninstall_input_item_observer( p_item );
+    if( pl_priv(p_playlist)->p_preparser != NULL )
+        playlist_preparser_Cancel( pl_priv(p_playlist)->p_preparser, p_item );
     ARRAY_APPEND( pl_priv(p_playlist)->items_to_delete, p_item);
     return VLC_SUCCESS;
 }
@@ -781,7 +785,10 @@ static void GoAndPreparse( playlist_t *p_playlist, int i_mode,
     char *psz_album = input_item_GetAlbum( p_item->p_input );
     if( sys->p_preparser != NULL && !input_item_IsPreparsed( p_item->p_input )
      && (EMPTY_STR(psz_artist) || EMPTY_STR(psz_album)) )
-        playlist_preparser_Push( sys->p_preparser, p_item->p_input, 0 );
+        playlist_preparser_Push( sys->p_preparser, p_item->p_input, 0,
+                                 (i_mode & PLAYLIST_GO)
+                                     ? PREPARSER_PRIORITY_HIGH
+                                     : PREPARSER_PRIORITY_LOW, p_item );
     free( psz_artist );
     free( psz_album );
 }
@@ -793,6 +800,7 @@ static void AddItem( playlist_t *p_playlist, playlist_item_t *p_item,
     PL_ASSERT_LOCKED;
     ARRAY_APPEND(p_playlist->items, p_item);
     ARRAY_APPEND(p_playlist->all_items, p_item);
+    playlist_ItemIndexAdd( p_playlist, p_item );
 
     if( i_pos == PLAYLIST_END )
         playlist_NodeAppend( p_playlist, p_item, p_node );
@@ -816,6 +824,7 @@ static void ChangeToNode( playlist_t *p_playlist, playlist_item_t *p_item )
     p_input->i_type = ITEM_TYPE_NODE;
     vlc_mutex_unlock( &p_input->lock );
 
+    atomic_store( &pl_priv(p_playlist)->search.b_stale, true );
     var_SetAddress( p_playlist, "item-change", p_item->p_input );
 
     /* Remove it from the array of available items */
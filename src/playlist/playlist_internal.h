@@ -36,11 +36,13 @@
 
 #include "input/input_interface.h"
 #include <assert.h>
+#include <vlc_atomic.h>
 
 #include "art.h"
 #include "preparser.h"
 
 typedef struct vlc_sd_internal_t vlc_sd_internal_t;
+typedef struct playlist_index_entry_t playlist_index_entry_t;
 
 void playlist_ServicesDiscoveryKillAll( playlist_t *p_playlist );
 
@@ -87,6 +89,22 @@ typedef struct playlist_private_t
     bool     b_reset_currently_playing; /** Reset current item array */
 
     bool     b_tree; /**< Display as a tree */
+
+    struct {
+        /* Hash table of all_items by input item */
+        playlist_index_entry_t **pp_buckets;
+        size_t              i_buckets; /**< Power of two, or 0 */
+        size_t              i_count;
+        bool                b_incomplete; /**< An insertion failed */
+    } input_index;
+
+    struct {
+        /* Last live search, refined if the next one is more specific */
+        char               *psz_string;
+        int                 i_root_id;
+        bool                b_recursive;
+        atomic_bool         b_stale; /**< An item changed since, even hidden */
+    } search;
 } playlist_private_t;
 
 #define pl_priv( pl ) ((playlist_private_t *)(pl))
@@ -110,6 +128,11 @@ playlist_item_t * get_current_status_node( playlist_t * p_playlist );
 void set_current_status_item( playlist_t *, playlist_item_t * );
 void set_current_status_node( playlist_t *, playlist_item_t * );
 
+/* Search */
+void playlist_ItemIndexAdd( playlist_t *, playlist_item_t * );
+void playlist_ItemIndexRemove( playlist_t *, playlist_item_t * );
+void playlist_ItemIndexClear( playlist_t * );
+
 /* Load/Save */
 int playlist_MLLoad( playlist_t *p_playlist );
 int playlist_MLDump( playlist_t *p_playlist );
@@ -25,6 +25,8 @@
 # include "config.h"
 #endif
 
+#include <assert.h>
+
 #include <vlc_common.h>
 
 #include "fetcher.h"
@@ -36,12 +38,32 @@
  *****************************************************************************/
 typedef struct preparser_entry_t preparser_entry_t;
 
+#define PREPARSER_BUCKETS 1024
+
 struct preparser_entry_t
 {
+    preparser_entry_t *p_prev; /* in the queue of its priority */
+    preparser_entry_t *p_next;
+    preparser_entry_t *p_hnext; /* in the hash bucket of its id */
+    preparser_priority_t i_priority;
+    void            *id;
     input_item_t    *p_item;
     input_item_meta_request_option_t i_options;
 };
 
+typedef struct preparser_worker_t preparser_worker_t;
+
+struct preparser_worker_t
+{
+    playlist_preparser_t *p_preparser;
+    vlc_timer_t     timer; /* preparsing deadline */
+    input_item_t   *p_item; /* being preparsed, or NULL */
+    void           *id; /* of the request being preparsed */
+    input_thread_t *p_input;
+    bool            b_cancelled;
+    bool            b_timed_out;
+};
+
 struct playlist_preparser_t
 {
     vlc_object_t        *object;
@@ -49,12 +71,85 @@ struct playlist_preparser_t
 
     vlc_mutex_t     lock;
     vlc_cond_t      wait;
-    bool            b_live;
-    preparser_entry_t  **pp_waiting;
+    /* One FIFO per priority */
+    struct
+    {
+        preparser_entry_t *p_first;
+        preparser_entry_t *p_last;
+    } queue[PREPARSER_PRIORITY_COUNT];
     int             i_waiting;
+    /* The same entries by id, so that they can be cancelled quickly */
+    preparser_entry_t *buckets[PREPARSER_BUCKETS];
+
+    preparser_worker_t **pp_workers; /* running */
+    int             i_workers;
+    int             i_max_workers;
+    int             i_exiting; /* workers destroying their timer */
+    mtime_t         i_timeout;
 };
 
+/* Interval at which a timed out or cancelled input is stopped again, as
+ * input_Stop() does not reach the objects created afterwards */
+#define PREPARSER_STOP_PERIOD (CLOCK_FREQ / 10)
+
 static void *Thread( void * );
+static void Stop( void * );
+
+static preparser_entry_t **Bucket( playlist_preparser_t *p_preparser,
+                                   const void *id )
+{
+    uintptr_t i_hash = (uintptr_t)id / sizeof(void *);
+    return &p_preparser->buckets[i_hash % PREPARSER_BUCKETS];
+}
+
+static void Enqueue( playlist_preparser_t *p_preparser,
+                     preparser_entry_t *p_entry )
+{
+    /* Requests without an id cannot be cancelled one by one */
+    if( p_entry->id != NULL )
+    {
+        preparser_entry_t **pp_bucket = Bucket( p_preparser, p_entry->id );
+        p_entry->p_hnext = *pp_bucket;
+        *pp_bucket = p_entry;
+    }
+
+    p_entry->p_prev = p_preparser->queue[p_entry->i_priority].p_last;
+    p_entry->p_next = NULL;
+    if( p_entry->p_prev != NULL )
+        p_entry->p_prev->p_next = p_entry;
+    else
+        p_preparser->queue[p_entry->i_priority].p_first = p_entry;
+    p_preparser->queue[p_entry->i_priority].p_last = p_entry;
+    p_preparser->i_waiting++;
+}
+
+/* Removes the entry from its queue, its bucket is left to the caller */
+static void Unqueue( playlist_preparser_t *p_preparser,
+                     preparser_entry_t *p_entry )
+{
+    if( p_entry->p_prev != NULL )
+        p_entry->p_prev->p_next = p_entry->p_next;
+    else
+        p_preparser->queue[p_entry->i_priority].p_first = p_entry->p_next;
+    if( p_entry->p_next != NULL )
+        p_entry->p_next->p_prev = p_entry->p_prev;
+    else
+        p_preparser->queue[p_entry->i_priority].p_last = p_entry->p_prev;
+    p_preparser->i_waiting--;
+}
+
+static void Dequeue( playlist_preparser_t *p_preparser,
+                     preparser_entry_t *p_entry )
+{
+    if( p_entry->id != NULL )
+    {
+        preparser_entry_t **pp = Bucket( p_preparser, p_entry->id );
+        while( *pp != p_entry )
+            pp = &(*pp)->p_hnext;
+        *pp = p_entry->p_hnext;
+    }
+    Unqueue( p_preparser, p_entry );
+}
 
 /*****************************************************************************
  * Public functions
@@ -72,34 +167,65 @@ playlist_preparser_t *playlist_preparser_New( vlc_object_t *parent )
 
     vlc_mutex_init( &p_preparser->lock );
     vlc_cond_init( &p_preparser->wait );
-    p_preparser->b_live = false;
+    for( int i = 0; i < PREPARSER_PRIORITY_COUNT; i++ )
+    {
+        p_preparser->queue[i].p_first = NULL;
+        p_preparser->queue[i].p_last = NULL;
+    }
     p_preparser->i_waiting = 0;
-    p_preparser->pp_waiting = NULL;
+    for( int i = 0; i < PREPARSER_BUCKETS; i++ )
+        p_preparser->buckets[i] = NULL;
+    p_preparser->pp_workers = NULL;
+    p_preparser->i_workers = 0;
+    p_preparser->i_exiting = 0;
+    p_preparser->i_max_workers = var_InheritInteger( parent, "preparse-threads" );
+    if( p_preparser->i_max_workers < 1 )
+        p_preparser->i_max_workers = 1;
+    p_preparser->i_timeout = var_InheritInteger( parent, "preparse-timeout" )
+                             * (CLOCK_FREQ / 1000);
 
     return p_preparser;
 }
 
 void playlist_preparser_Push( playlist_preparser_t *p_preparser, input_item_t *p_item,
-                              input_item_meta_request_option_t i_options )
+                              input_item_meta_request_option_t i_options,
+                              preparser_priority_t i_priority, void *id )
 {
     preparser_entry_t *p_entry = malloc( sizeof(preparser_entry_t) );
 
     if ( !p_entry )
         return;
+    p_entry->i_priority = i_priority;
+    p_entry->id = id;
     p_entry->p_item = p_item;
     p_entry->i_options = i_options;
     vlc_gc_incref( p_entry->p_item );
 
     vlc_mutex_lock( &p_preparser->lock );
-    INSERT_ELEM( p_preparser->pp_waiting, p_preparser->i_waiting,
-                 p_preparser->i_waiting, p_entry );
-    if( !p_preparser->b_live )
+    Enqueue( p_preparser, p_entry );
+
+    /* Spawn a worker unless enough are running for the waiting items */
+    if( p_preparser->i_workers < p_preparser->i_max_workers
+     && p_preparser->i_workers < p_preparser->i_waiting )
     {
-        if( vlc_clone_detach( NULL, Thread, p_preparser,
-                              VLC_THREAD_PRIORITY_LOW ) )
-            msg_Warn( p_preparser->object, "cannot spawn pre-parser thread" );
-        else
-            p_preparser->b_live = true;
+        preparser_worker_t *p_worker = calloc( 1, sizeof(*p_worker) );
+
+        if( likely(p_worker != NULL) )
+        {
+            p_worker->p_preparser = p_preparser;
+            if( vlc_timer_create( &p_worker->timer, Stop, p_worker ) )
+                free( p_worker );
+            else if( vlc_clone_detach( NULL, Thread, p_worker,
+                                       VLC_THREAD_PRIORITY_LOW ) )
+            {
+                msg_Warn( p_preparser->object, "cannot spawn pre-parser thread" );
+                vlc_timer_destroy( p_worker->timer );
+                free( p_worker );
+            }
+            else
+                TAB_APPEND( p_preparser->i_workers, p_preparser->pp_workers,
+                            p_worker );
+        }
     }
     vlc_mutex_unlock( &p_preparser->lock );
 }
@@ -111,19 +237,77 @@ void playlist_preparser_fetcher_Push( playlist_preparser_t *p_preparser,
         playlist_fetcher_Push( p_preparser->p_fetcher, p_item, i_options );
 }
 
-void playlist_preparser_Delete( playlist_preparser_t *p_preparser )
+/* Drops the waiting requests with the id, or all of them if id is NULL,
+ * and aborts the matching preparsing in progress */
+static void Cancel( playlist_preparser_t *p_preparser, void *id )
 {
-    vlc_mutex_lock( &p_preparser->lock );
-    /* Remove pending item to speed up preparser thread exit */
-    while( p_preparser->i_waiting > 0 )
+    if( id != NULL )
     {
-        preparser_entry_t *p_entry = p_preparser->pp_waiting[0];
-        vlc_gc_decref( p_entry->p_item );
-        free( p_entry );
-        REMOVE_ELEM( p_preparser->pp_waiting, p_preparser->i_waiting, 0 );
+        preparser_entry_t **pp = Bucket( p_preparser, id );
+
+        while( *pp != NULL )
+        {
+            preparser_entry_t *p_entry = *pp;
+
+            if( p_entry->id != id )
+            {
+                pp = &p_entry->p_hnext;
+                continue;
+            }
+            *pp = p_entry->p_hnext;
+            Unqueue( p_preparser, p_entry );
+            vlc_gc_decref( p_entry->p_item );
+            free( p_entry );
+        }
+    }
+    else
+    {
+        for( int i = 0; i < PREPARSER_PRIORITY_COUNT; i++ )
+            while( p_preparser->queue[i].p_first != NULL )
+            {
+                preparser_entry_t *p_entry = p_preparser->queue[i].p_first;
+
+                Dequeue( p_preparser, p_entry );
+                vlc_gc_decref( p_entry->p_item );
+                free( p_entry );
+            }
+    }
+
+    for( int i = 0; i < p_preparser->i_workers; i++ )
+    {
+        preparser_worker_t *p_worker = p_preparser->pp_workers[i];
+
+        if( p_worker->p_item == NULL || (id != NULL && p_worker->id != id) )
+            continue;
+
+        p_worker->b_cancelled = true;
+        if( p_worker->p_input != NULL )
+        {
+            input_Stop( p_worker->p_input );
+            /* Stop the objects the input may still create */
+            vlc_timer_schedule( p_worker->timer, false, PREPARSER_STOP_PERIOD,
+                                PREPARSER_STOP_PERIOD );
+        }
     }
+}
+
+void playlist_preparser_Cancel( playlist_preparser_t *p_preparser, void *id )
+{
+    assert( id != NULL );
+
+    vlc_mutex_lock( &p_preparser->lock );
+    Cancel( p_preparser, id );
+    vlc_mutex_unlock( &p_preparser->lock );
+}
+
+void playlist_preparser_Delete( playlist_preparser_t *p_preparser )
+{
+    vlc_mutex_lock( &p_preparser->lock );
+    /* Remove pending items and abort the current ones to speed up preparser
+     * threads exit */
+    Cancel( p_preparser, NULL );
 
-    while( p_preparser->b_live )
+    while( p_preparser->i_workers > 0 || p_preparser->i_exiting > 0 )
         vlc_cond_wait( &p_preparser->wait, &p_preparser->lock );
     vlc_mutex_unlock( &p_preparser->lock );
 
@@ -142,9 +326,12 @@ void playlist_preparser_Delete( playlist_preparser_t *p_preparser )
 /**
  * This function preparses an item when needed.
  */
-static void Preparse( vlc_object_t *obj, input_item_t *p_item,
+static void Preparse( preparser_worker_t *p_worker, input_item_t *p_item,
                       input_item_meta_request_option_t i_options )
 {
+    playlist_preparser_t *p_preparser = p_worker->p_preparser;
+    vlc_object_t *obj = p_preparser->object;
+
     vlc_mutex_lock( &p_item->lock );
     int i_type = p_item->i_type;
     bool b_net = p_item->b_net;
@@ -170,9 +357,34 @@ static void Preparse( vlc_object_t *obj, input_item_t *p_item,
     /* Do not preparse if it is already done (like by playing it) */
     if( !input_item_IsPreparsed( p_item ) )
     {
-        input_Preparse( obj, p_item );
-        input_item_SetPreparsed( p_item, true );
+        input_thread_t *p_input = input_CreatePreparser( obj, p_item );
+
+        if( p_input != NULL )
+        {
+            vlc_mutex_lock( &p_preparser->lock );
+            if( !p_worker->b_cancelled )
+                p_worker->p_input = p_input;
+            vlc_mutex_unlock( &p_preparser->lock );
+
+            if( p_worker->p_input != NULL )
+            {
+                if( p_preparser->i_timeout > 0 )
+                    vlc_timer_schedule( p_worker->timer, false,
+                                        p_preparser->i_timeout,
+                                        PREPARSER_STOP_PERIOD );
+                input_Preparse( p_input );
+
+                vlc_mutex_lock( &p_preparser->lock );
+                p_worker->p_input = NULL;
+                vlc_mutex_unlock( &p_preparser->lock );
+                vlc_timer_schedule( p_worker->timer, false, 0, 0 );
+            }
+            vlc_object_release( p_input );
+        }
 
+        /* Like a failed preparsing, a timed out or cancelled one is reported
+         * as done and not retried */
+        input_item_SetPreparsed( p_item, true );
         var_SetAddress( obj, "item-change", p_item );
     }
     input_item_SignalPreparseEnded( p_item );
@@ -219,45 +431,98 @@ static void Art( playlist_preparser_t *p_preparser, input_item_t *p_item )
         playlist_fetcher_Push( p_fetcher, p_item, 0 );
 }
 
+/**
+ * This function aborts the preparsing in progress once it timed out
+ */
+static void Stop( void *data )
+{
+    preparser_worker_t *p_worker = data;
+    playlist_preparser_t *p_preparser = p_worker->p_preparser;
+
+    vlc_mutex_lock( &p_preparser->lock );
+    if( p_worker->p_input != NULL )
+    {
+        if( !p_worker->b_cancelled && !p_worker->b_timed_out )
+        {
+            char *psz_uri = input_item_GetURI( p_worker->p_item );
+            msg_Warn( p_preparser->object, "preparsing %s timed out",
+                      psz_uri ? psz_uri : "(null)" );
+            free( psz_uri );
+        }
+        p_worker->b_timed_out = true;
+        input_Stop( p_worker->p_input );
+    }
+    vlc_mutex_unlock( &p_preparser->lock );
+}
+
+/**
+ * Dequeues the waiting entry of highest priority
+ */
+static preparser_entry_t *Pop( playlist_preparser_t *p_preparser )
+{
+    for( int i = PREPARSER_PRIORITY_COUNT - 1; i >= 0; i-- )
+    {
+        preparser_entry_t *p_entry = p_preparser->queue[i].p_first;
+
+        if( p_entry == NULL )
+            continue;
+        Dequeue( p_preparser, p_entry );
+        return p_entry;
+    }
+    return NULL;
+}
+
 /**
  * This function does the preparsing and issues the art fetching requests
  */
 static void *Thread( void *data )
 {
-    playlist_preparser_t *p_preparser = data;
-    vlc_object_t *obj = p_preparser->object;
+    preparser_worker_t *p_worker = data;
+    playlist_preparser_t *p_preparser = p_worker->p_preparser;
 
+    vlc_mutex_lock( &p_preparser->lock );
     for( ;; )
     {
-        input_item_t *p_current;
-        input_item_meta_request_option_t i_options;
+        preparser_entry_t *p_entry = Pop( p_preparser );
+        if( p_entry == NULL )
+            break;
 
-        /* */
-        vlc_mutex_lock( &p_preparser->lock );
-        if( p_preparser->i_waiting > 0 )
-        {
-            preparser_entry_t *p_entry = p_preparser->pp_waiting[0];
-            p_current = p_entry->p_item;
-            i_options = p_entry->i_options;
-            free( p_entry );
-            REMOVE_ELEM( p_preparser->pp_waiting, p_preparser->i_waiting, 0 );
-        }
-        else
-        {
-            p_current = NULL;
-            p_preparser->b_live = false;
-            vlc_cond_signal( &p_preparser->wait );
-        }
+        input_item_t *p_current = p_entry->p_item;
+        input_item_meta_request_option_t i_options = p_entry->i_options;
+        p_worker->id = p_entry->id;
+        free( p_entry );
+
+        p_worker->p_item = p_current;
+        p_worker->b_cancelled = false;
+        p_worker->b_timed_out = false;
         vlc_mutex_unlock( &p_preparser->lock );
 
-        if( !p_current )
-            break;
+        Preparse( p_worker, p_current, i_options );
 
-        Preparse( obj, p_current, i_options );
+        vlc_mutex_lock( &p_preparser->lock );
+        bool b_cancelled = p_worker->b_cancelled;
+        p_worker->p_item = NULL;
+        vlc_mutex_unlock( &p_preparser->lock );
 
-        Art( p_preparser, p_current );
+        if( !b_cancelled )
+            Art( p_preparser, p_current );
         vlc_gc_decref(p_current);
+
+        vlc_mutex_lock( &p_preparser->lock );
     }
+
+    /* New items now need a new worker */
+    TAB_REMOVE( p_preparser->i_workers, p_preparser->pp_workers, p_worker );
+    p_preparser->i_exiting++;
+    vlc_mutex_unlock( &p_preparser->lock );
+
+    vlc_timer_destroy( p_worker->timer );
+
+    vlc_mutex_lock( &p_preparser->lock );
+    p_preparser->i_exiting--;
+    vlc_cond_signal( &p_preparser->wait );
+    vlc_mutex_unlock( &p_preparser->lock );
+
+    free( p_worker );
     return NULL;
 }
-
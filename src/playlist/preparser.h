@@ -35,6 +35,16 @@
  */
 typedef struct playlist_preparser_t playlist_preparser_t;
 
+/**
+ * Preparsing priorities, highest last.
+ */
+typedef enum
+{
+    PREPARSER_PRIORITY_LOW,    /**< bulk additions, library scans */
+    PREPARSER_PRIORITY_HIGH,   /**< items shown or requested by the user */
+    PREPARSER_PRIORITY_COUNT
+} preparser_priority_t;
+
 /**
  * This function creates the preparser object and thread.
  */
@@ -45,17 +55,34 @@ playlist_preparser_t *playlist_preparser_New( vlc_object_t * );
  *
  * The input item is retained until the preparsing is done or until the
  * preparser object is deleted.
+ * Items are preparsed by priority, then in order, by up to "preparse-threads"
+ * workers. Preparsing is aborted after "preparse-timeout".
  * Listen to vlc_InputItemPreparseEnded event to get notified when item is
  * preparsed.
+ *
+ * The id tags the request for playlist_preparser_Cancel(). It is chosen by
+ * the caller, so that the requests of other callers for the same item are
+ * left alone. NULL means the request can not be cancelled.
  */
 void playlist_preparser_Push( playlist_preparser_t *, input_item_t *,
-                              input_item_meta_request_option_t );
+                              input_item_meta_request_option_t,
+                              preparser_priority_t, void *id );
 
 void playlist_preparser_fetcher_Push( playlist_preparser_t *, input_item_t *,
                                       input_item_meta_request_option_t );
 
 /**
- * This function destroys the preparser object and thread.
+ * This function removes all the waiting requests tagged with the provided
+ * id, and aborts their preparsing if it is in progress.
+ *
+ * A removed request is dropped without any event. An aborted one is reported
+ * like a failed one: the item is marked preparsed, and the
+ * vlc_InputItemPreparseEnded event is sent.
+ */
+void playlist_preparser_Cancel( playlist_preparser_t *, void *id );
+
+/**
+ * This function destroys the preparser object and threads.
  *
  * All pending input items will be released.
  */
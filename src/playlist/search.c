@@ -52,6 +52,132 @@ playlist_item_t* playlist_ItemGetById( playlist_t * p_playlist , int i_id )
         return NULL;
 }
 
+/***************************************************************************
+ * Index of the items by input item
+ ***************************************************************************/
+
+struct playlist_index_entry_t
+{
+    playlist_index_entry_t *p_next;
+    playlist_item_t        *p_item;
+};
+
+static size_t playlist_ItemIndexHash( const input_item_t *p_input,
+                                      size_t i_buckets )
+{
+    return ((uintptr_t)p_input / sizeof(void *)) & (i_buckets - 1);
+}
+
+/* Doubles the bucket count, keeps the current table on error */
+static void playlist_ItemIndexGrow( playlist_t *p_playlist )
+{
+    playlist_private_t *p_sys = pl_priv(p_playlist);
+    size_t i_buckets = p_sys->input_index.i_buckets ?
+                       2 * p_sys->input_index.i_buckets : 64;
+    playlist_index_entry_t **pp_buckets =
+        calloc( i_buckets, sizeof(*pp_buckets) );
+    if( unlikely(pp_buckets == NULL) )
+        return;
+
+    for( size_t i = 0; i < p_sys->input_index.i_buckets; i++ )
+    {
+        playlist_index_entry_t *p_entry = p_sys->input_index.pp_buckets[i];
+        while( p_entry != NULL )
+        {
+            playlist_index_entry_t *p_next = p_entry->p_next;
+            size_t h = playlist_ItemIndexHash( p_entry->p_item->p_input,
+                                               i_buckets );
+            p_entry->p_next = pp_buckets[h];
+            pp_buckets[h] = p_entry;
+            p_entry = p_next;
+        }
+    }
+    free( p_sys->input_index.pp_buckets );
+    p_sys->input_index.pp_buckets = pp_buckets;
+    p_sys->input_index.i_buckets = i_buckets;
+}
+
+/**
+ * Adds an item to the index of playlist_ItemGetByInput()
+ * The playlist have to be locked
+ */
+void playlist_ItemIndexAdd( playlist_t *p_playlist, playlist_item_t *p_item )
+{
+    playlist_private_t *p_sys = pl_priv(p_playlist);
+    PL_ASSERT_LOCKED;
+
+    if( p_sys->input_index.i_count >= p_sys->input_index.i_buckets )
+        playlist_ItemIndexGrow( p_playlist );
+
+    playlist_index_entry_t *p_entry = malloc( sizeof(*p_entry) );
+    if( unlikely(p_entry == NULL || p_sys->input_index.i_buckets == 0) )
+    {   /* Lookups will fall back to a linear search */
+        free( p_entry );
+        p_sys->input_index.b_incomplete = true;
+        return;
+    }
+
+    size_t h = playlist_ItemIndexHash( p_item->p_input,
+                                       p_sys->input_index.i_buckets );
+    p_entry->p_item = p_item;
+    p_entry->p_next = p_sys->input_index.pp_buckets[h];
+    p_sys->input_index.pp_buckets[h] = p_entry;
+    p_sys->input_index.i_count++;
+}
+
+/**
+ * Removes an item from the index of playlist_ItemGetByInput()
+ * The playlist have to be locked
+ */
+void playlist_ItemIndexRemove( playlist_t *p_playlist,
+                               playlist_item_t *p_item )
+{
+    playlist_private_t *p_sys = pl_priv(p_playlist);
+    PL_ASSERT_LOCKED;
+
+    if( p_sys->input_index.i_buckets == 0 )
+        return;
+
+    size_t h = playlist_ItemIndexHash( p_item->p_input,
+                                       p_sys->input_index.i_buckets );
+    for( playlist_index_entry_t **pp = &p_sys->input_index.pp_buckets[h];
+         *pp != NULL; pp = &(*pp)->p_next )
+    {
+        playlist_index_entry_t *p_entry = *pp;
+        if( p_entry->p_item == p_item )
+        {
+            *pp = p_entry->p_next;
+            free( p_entry );
+            p_sys->input_index.i_count--;
+            return;
+        }
+    }
+}
+
+/**
+ * Empties the index of playlist_ItemGetByInput()
+ */
+void playlist_ItemIndexClear( playlist_t *p_playlist )
+{
+    playlist_private_t *p_sys = pl_priv(p_playlist);
+
+    for( size_t i = 0; i < p_sys->input_index.i_buckets; i++ )
+    {
+        playlist_index_entry_t *p_entry = p_sys->input_index.pp_buckets[i];
+        while( p_entry != NULL )
+        {
+            playlist_index_entry_t *p_next = p_entry->p_next;
+            free( p_entry );
+            p_entry = p_next;
+        }
+    }
+    free( p_sys->input_index.pp_buckets );
+    p_sys->input_index.pp_buckets = NULL;
+    p_sys->input_index.i_buckets = 0;
+    p_sys->input_index.i_count = 0;
+    p_sys->input_index.b_incomplete = false;
+}
+
 /**
  * Search an item by its input_item_t
  * The playlist have to be locked
@@ -62,6 +188,7 @@ playlist_item_t* playlist_ItemGetById( playlist_t * p_playlist , int i_id )
 playlist_item_t* playlist_ItemGetByInput( playlist_t * p_playlist,
                                           input_item_t *p_item )
 {
+    playlist_private_t *p_sys = pl_priv(p_playlist);
     int i;
     PL_ASSERT_LOCKED;
     if( get_current_status_item( p_playlist ) &&
@@ -69,7 +196,26 @@ playlist_item_t* playlist_ItemGetByInput( playlist_t * p_playlist,
     {
         return get_current_status_item( p_playlist );
     }
-    /** \todo Check if this is always incremental and whether we can bsearch */
+
+    if( !p_sys->input_index.b_incomplete )
+    {
+        /* Several items can share an input: return the oldest one, as it
+         * comes first in all_items */
+        playlist_item_t *p_found = NULL;
+
+        if( p_sys->input_index.i_buckets == 0 )
+            return NULL;
+
+        size_t h = playlist_ItemIndexHash( p_item,
+                                           p_sys->input_index.i_buckets );
+        for( playlist_index_entry_t *p_entry = p_sys->input_index.pp_buckets[h];
+             p_entry != NULL; p_entry = p_entry->p_next )
+            if( p_entry->p_item->p_input == p_item
+             && (p_found == NULL || p_entry->p_item->i_id < p_found->i_id) )
+                p_found = p_entry->p_item;
+        return p_found;
+    }
+
     for( i =  0 ; i < p_playlist->all_items.i_size; i++ )
     {
         if( ARRAY_VAL(p_playlist->all_items, i)->p_input == p_item )
@@ -105,10 +251,13 @@ static void playlist_LiveSearchClean( playlist_item_t *p_root )
  * Enable/Disable items in the playlist according to the search argument
  * @param p_root: the current root item
  * @param psz_string: the string to search
+ * @param b_refine: only check the items matching the previous search,
+ * which psz_string is more specific than
  * @return true if an item match
  */
 static bool playlist_LiveSearchUpdateInternal( playlist_item_t *p_root,
-                                               const char *psz_string, bool b_recursive )
+                                               const char *psz_string, bool b_recursive,
+                                               bool b_refine )
 {
     int i;
     bool b_match = false;
@@ -116,9 +265,14 @@ static bool playlist_LiveSearchUpdateInternal( playlist_item_t *p_root,
     {
         bool b_enable = false;
         playlist_item_t *p_item = p_root->pp_children[i];
+        /* A disabled item can not match a more specific search. Neither
+         * can its children, that were disabled too. */
+        if( b_refine && (p_item->i_flags & PLAYLIST_DBL_FLAG) )
+            continue;
         // Go recurssively if their is some children
         if( b_recursive && p_item->i_children >= 0 &&
-            playlist_LiveSearchUpdateInternal( p_item, psz_string, true ) )
+            playlist_LiveSearchUpdateInternal( p_item, psz_string, true,
+                                               b_refine ) )
         {
             b_enable = true;
         }
@@ -166,12 +320,30 @@ static bool playlist_LiveSearchUpdateInternal( playlist_item_t *p_root,
 int playlist_LiveSearchUpdate( playlist_t *p_playlist, playlist_item_t *p_root,
                                const char *psz_string, bool b_recursive )
 {
+    playlist_private_t *p_sys = pl_priv(p_playlist);
+
     PL_ASSERT_LOCKED;
-    pl_priv(p_playlist)->b_reset_currently_playing = true;
+    p_sys->b_reset_currently_playing = true;
     if( *psz_string )
-        playlist_LiveSearchUpdateInternal( p_root, psz_string, b_recursive );
+    {
+        /* Typing more characters only narrows the previous results down,
+         * unless an item changed since the previous search */
+        bool b_stale = atomic_exchange( &p_sys->search.b_stale, false );
+        bool b_refine = !b_stale && p_sys->search.psz_string != NULL
+                     && p_sys->search.i_root_id == p_root->i_id
+                     && p_sys->search.b_recursive == b_recursive
+                     && vlc_strcasestr( psz_string, p_sys->search.psz_string );
+
+        playlist_LiveSearchUpdateInternal( p_root, psz_string, b_recursive,
+                                           b_refine );
+    }
     else
         playlist_LiveSearchClean( p_root );
+
+    free( p_sys->search.psz_string );
+    p_sys->search.psz_string = *psz_string ? strdup( psz_string ) : NULL;
+    p_sys->search.i_root_id = p_root->i_id;
+    p_sys->search.b_recursive = b_recursive;
     vlc_cond_signal( &pl_priv(p_playlist)->signal );
     return VLC_SUCCESS;
 }
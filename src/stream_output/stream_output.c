@@ -49,6 +49,7 @@
 #include <vlc_modules.h>
 
 #include "input/input_interface.h"
+#include "libvlc.h"
 
 #define VLC_CODEC_NULL VLC_FOURCC( 'n', 'u', 'l', 'l' )
 
@@ -75,6 +76,19 @@ static int  mrl_Parse( mrl_t *p_mrl, const char *psz_mrl );
 /* mrl_Clean: clean p_mrl  after a call to mrl_Parse */
 static void mrl_Clean( mrl_t *p_mrl );
 
+/* Private part of the stream output instance */
+typedef struct
+{
+    sout_instance_t instance;
+
+    /* packets sent late by the access outputs, updated from their threads */
+    counter_t *p_late_packets;
+} sout_instance_private_t;
+
+#define sout_instance_priv( p ) ((sout_instance_private_t *)(p))
+
+static const char sout_instance_type[] = "stream output";
+
 #undef sout_NewInstance
 
 /*****************************************************************************
@@ -100,12 +114,14 @@ sout_instance_t *sout_NewInstance( vlc_object_t *p_parent, const char *psz_dest
         return NULL;
 
     /* *** Allocate descriptor *** */
-    p_sout = vlc_custom_create( p_parent, sizeof( *p_sout ), "stream output" );
-    if( p_sout == NULL )
+    sout_instance_private_t *p_priv =
+        vlc_custom_create( p_parent, sizeof( *p_priv ), sout_instance_type );
+    if( p_priv == NULL )
     {
         free( psz_chain );
         return NULL;
     }
+    p_sout = &p_priv->instance;
 
     msg_Dbg( p_sout, "using sout chain=`%s'", psz_chain );
 
@@ -115,6 +131,8 @@ sout_instance_t *sout_NewInstance( vlc_object_t *p_parent, const char *psz_dest
 
     vlc_mutex_init( &p_sout->lock );
     p_sout->p_stream = NULL;
+    p_priv->p_late_packets = libvlc_stats( p_sout )
+                           ? stats_CounterCreate( STATS_COUNTER ) : NULL;
 
     var_Create( p_sout, "sout-mux-caching", VLC_VAR_INTEGER | VLC_VAR_DOINHERIT );
 
@@ -130,6 +148,7 @@ sout_instance_t *sout_NewInstance( vlc_object_t *p_parent, const char *psz_dest
 
     FREENULL( p_sout->psz_sout );
 
+    stats_CounterClean( p_priv->p_late_packets );
     vlc_mutex_destroy( &p_sout->lock );
     vlc_object_release( p_sout );
     return NULL;
@@ -146,12 +165,27 @@ void sout_DeleteInstance( sout_instance_t * p_sout )
     /* *** free all string *** */
     FREENULL( p_sout->psz_sout );
 
+    /* the access output threads are gone with the chain */
+    stats_CounterClean( sout_instance_priv( p_sout )->p_late_packets );
     vlc_mutex_destroy( &p_sout->lock );
 
     /* *** free structure *** */
     vlc_object_release( p_sout );
 }
 
+/**
+ * Returns the number of packets the access outputs of the instance reported
+ * as sent late, since the instance was created.
+ */
+uint64_t sout_GetLatePackets( sout_instance_t *p_sout )
+{
+    counter_t *p_counter = sout_instance_priv( p_sout )->p_late_packets;
+
+    if( p_counter == NULL )
+        return 0;
+    return atomic_load_explicit( &p_counter->value, memory_order_relaxed );
+}
+
 /*****************************************************************************
  * Packetizer/Input
  *****************************************************************************/
@@ -313,6 +347,24 @@ ssize_t sout_AccessOutWrite( sout_access_out_t *p_access, block_t *p_buffer )
     return p_access->pf_write( p_access, p_buffer );
 }
 
+/**
+ * sout_AccessOutReportLate
+ */
+void sout_AccessOutReportLate( sout_access_out_t *p_access, unsigned i_count )
+{
+    /* The access output hangs below a stream or a muxer of the instance */
+    for( vlc_object_t *p_obj = p_access->p_parent; p_obj != NULL;
+         p_obj = p_obj->p_parent )
+    {
+        if( p_obj->psz_object_type == sout_instance_type )
+        {
+            sout_instance_private_t *p_priv = (sout_instance_private_t *)p_obj;
+            stats_Update( p_priv->p_late_packets, i_count, NULL );
+            return;
+        }
+    }
+}
+
 /**
  * sout_AccessOutControl
  */
@@ -23,6 +23,7 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #undef NDEBUG
 #include <assert.h>
@@ -84,10 +85,180 @@ static void test_block (void)
     //assert (block == NULL);
 }
 
+static unsigned released;
+
+static void test_block_Release (block_t *block)
+{
+    released++;
+    free (block);
+}
+
+static void test_block_Shared (void)
+{
+    block_t *block = malloc (sizeof (*block) + sizeof (text));
+    assert (block != NULL);
+    block_Init (block, block + 1, sizeof (text));
+    block->pf_release = test_block_Release;
+    memcpy (block->p_buffer, text, sizeof (text));
+    released = 0;
+
+    block_t *a = block_Shareable (block);
+    assert (a != NULL);
+    assert (block_Shareable (a) == a);
+
+    block_t *b = block_Share (a);
+    assert (b != NULL && b != a);
+    assert (b->p_buffer == a->p_buffer);
+    assert (b->i_buffer == sizeof (text));
+
+    /* Writing through a copy does not alter the other reference */
+    block_t *c = block_Share (a);
+    assert (c != NULL);
+    c = block_Unshare (c);
+    assert (c != NULL);
+    assert (c->p_buffer != a->p_buffer);
+    assert (!memcmp (c->p_buffer, text, sizeof (text)));
+    memset (c->p_buffer, 'x', c->i_buffer);
+    assert (!memcmp (a->p_buffer, text, sizeof (text)));
+    block_Release (c);
+
+    /* Neither does reallocating a shared payload */
+    b = block_Realloc (b, 16, sizeof (text) + 16);
+    assert (b != NULL);
+    assert (b->i_buffer == 16 + sizeof (text) + 16);
+    assert (!memcmp (b->p_buffer + 16, text, sizeof (text)));
+    memset (b->p_buffer, 'y', b->i_buffer);
+    assert (!memcmp (a->p_buffer, text, sizeof (text)));
+    block_Release (b);
+
+    /* The payload goes away along with its last reference only */
+    b = block_Share (a);
+    assert (b != NULL);
+    block_Release (a);
+    assert (released == 0);
+    assert (!memcmp (b->p_buffer, text, sizeof (text)));
+
+    /* The last reference can be written to in place */
+    a = block_Unshare (b);
+    assert (a == b);
+    assert (released == 0);
+    block_Release (a);
+    assert (released == 1);
+}
+
+static const size_t sizes[] = {
+    0, 1, 400, 480, 1000, 4000, 10000, 30000, 65000, 70000, 1 << 20,
+};
+
+static void test_block_Pool (void)
+{
+    block_t *blocks[ARRAY_SIZE(sizes)];
+
+    for (int n = 0; n < 2; n++)
+    {
+        for (size_t i = 0; i < ARRAY_SIZE(sizes); i++)
+        {
+            blocks[i] = block_Alloc (sizes[i]);
+            assert (blocks[i] != NULL);
+            assert (blocks[i]->i_buffer == sizes[i]);
+            memset (blocks[i]->p_buffer, i, sizes[i]);
+        }
+
+        for (size_t i = 0; i < ARRAY_SIZE(sizes); i++)
+        {
+            for (size_t j = 0; j < sizes[i]; j++)
+                assert (blocks[i]->p_buffer[j] == (uint8_t)i);
+            block_Release (blocks[i]);
+        }
+    }
+
+    /* A block released by this thread is handed out again */
+    block_t *block = block_Alloc (1000);
+    assert (block != NULL);
+    void *p = block;
+    block_Release (block);
+    block = block_Alloc (1000);
+    assert ((void *)block == p);
+    block_Release (block);
+}
+
+#define POOL_BLOCKS 8
+
+static block_t *pool_blocks[POOL_BLOCKS];
+
+static void *test_block_PoolAlloc (void *data)
+{
+    size_t size = *(size_t *)data;
+
+    for (unsigned i = 0; i < POOL_BLOCKS; i++)
+    {
+        pool_blocks[i] = block_Alloc (size);
+        assert (pool_blocks[i] != NULL);
+        memset (pool_blocks[i]->p_buffer, i, size);
+    }
+    return NULL;
+}
+
+static void *test_block_PoolRelease (void *data)
+{
+    (void) data;
+
+    for (unsigned i = 0; i < POOL_BLOCKS; i++)
+        block_Release (pool_blocks[i]);
+    return NULL;
+}
+
+static void *test_block_PoolReuse (void *data)
+{
+    void *const *released = data;
+    /* The cache of this thread is empty: it is refilled from the depot */
+    block_t *block = block_Alloc (3000);
+    bool found = false;
+
+    assert (block != NULL);
+    for (unsigned i = 0; i < POOL_BLOCKS; i++)
+        if ((void *)block == released[i])
+            found = true;
+    assert (found);
+    block_Release (block);
+    return NULL;
+}
+
+static void test_block_PoolThreads (void)
+{
+    size_t size = 3000;
+    void *released[POOL_BLOCKS];
+    vlc_thread_t th;
+    int val;
+
+    /* Blocks allocated by a thread and released by another one */
+    val = vlc_clone (&th, test_block_PoolAlloc, &size,
+                     VLC_THREAD_PRIORITY_LOW);
+    assert (val == 0);
+    vlc_join (th, NULL);
+
+    for (unsigned i = 0; i < POOL_BLOCKS; i++)
+        released[i] = pool_blocks[i];
+
+    val = vlc_clone (&th, test_block_PoolRelease, NULL,
+                     VLC_THREAD_PRIORITY_LOW);
+    assert (val == 0);
+    vlc_join (th, NULL);
+
+    /* The cache of the exited thread went to the depot */
+    val = vlc_clone (&th, test_block_PoolReuse, released,
+                     VLC_THREAD_PRIORITY_LOW);
+    assert (val == 0);
+    vlc_join (th, NULL);
+}
+
 int main (void)
 {
     test_block_File ();
     test_block ();
+    test_block_Shared ();
+    test_block_Pool ();
+    test_block_PoolThreads ();
     return 0;
 }
 